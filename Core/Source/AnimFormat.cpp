@@ -0,0 +1,481 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+
+namespace
+{
+	// The three smallest components of a unit quaternion are all within
+	// +/- 1/sqrt(2), so that's the range they're quantized over
+	const float SQRT_2 = 1.41421356f;
+	const float INV_SQRT_2 = 0.70710678f;
+	const float ROTATION_STEPS = 32767.0f;
+	const float TRANSLATION_STEPS = 65535.0f;
+
+	void EncodeRotation(const Quaternion& rotation, uint16_t* outValues)
+	{
+		Quaternion q = Normalize(rotation);
+		float components[4] = { q.x, q.y, q.z, q.w };
+
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			if (Math::Abs(components[i]) > Math::Abs(components[largest]))
+			{
+				largest = i;
+			}
+		}
+
+		// q and -q are the same rotation, so make the dropped one positive
+		float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+		int k = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (i != largest)
+			{
+				float unit = (components[i] * sign * SQRT_2 + 1.0f) * 0.5f;
+				float value = Math::Clamp(unit * ROTATION_STEPS + 0.5f, 0.0f, ROTATION_STEPS);
+				outValues[k++] = static_cast<uint16_t>(value);
+			}
+		}
+
+		// Which one was dropped goes in the top bits of the first two
+		outValues[0] |= static_cast<uint16_t>((largest & 1) << 15);
+		outValues[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+	}
+
+	Quaternion DecodeRotation(const uint16_t* values)
+	{
+		int largest = (values[0] >> 15) | ((values[1] >> 15) << 1);
+
+		float components[4];
+		float sumSq = 0.0f;
+		int k = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			if (i != largest)
+			{
+				float unit = (values[k++] & 0x7FFF) / ROTATION_STEPS;
+				components[i] = (unit * 2.0f - 1.0f) * INV_SQRT_2;
+				sumSq += components[i] * components[i];
+			}
+		}
+		components[largest] = Math::Sqrt(Math::Max(0.0f, 1.0f - sumSq));
+		return Quaternion(components[0], components[1], components[2], components[3]);
+	}
+
+	void EncodeTranslation(const Vector3& translation, const float* rangeMin, const float* scale, uint16_t* outValues)
+	{
+		float components[3] = { translation.x, translation.y, translation.z };
+		for (int i = 0; i < 3; i++)
+		{
+			float value = scale[i] > 0.0f ? (components[i] - rangeMin[i]) / scale[i] : 0.0f;
+			outValues[i] = static_cast<uint16_t>(Math::Clamp(value + 0.5f, 0.0f, TRANSLATION_STEPS));
+		}
+	}
+
+	Vector3 DecodeTranslation(const uint16_t* values, const float* rangeMin, const float* scale)
+	{
+		return Vector3(rangeMin[0] + values[0] * scale[0],
+			rangeMin[1] + values[1] * scale[1],
+			rangeMin[2] + values[2] * scale[2]);
+	}
+
+	float RotationError(const Quaternion& a, const Quaternion& b)
+	{
+		// The angle between them, either way round
+		float dot = Math::Min(Math::Abs(Dot(a, b)), 1.0f);
+		return 2.0f * Math::Acos(dot);
+	}
+
+	float TranslationError(const Vector3& a, const Vector3& b)
+	{
+		return (a - b).Length();
+	}
+
+	// Picks which frames of a track to keep. A frame is dropped if it can be
+	// interpolated from the keys either side of it to within tolerance of
+	// source. Interpolating between decoded keys, rather than the source,
+	// means the tolerance covers the quantization too
+	template <typename T, typename ErrorFunc, typename InterpFunc>
+	std::vector<uint16_t> ReduceKeys(const std::vector<T>& source, const std::vector<T>& decoded,
+		float tolerance, ErrorFunc error, InterpFunc interpolate)
+	{
+		std::vector<uint16_t> keys;
+		keys.emplace_back(0);
+
+		// A track that never moves from its first frame needs only that
+		size_t numFrames = source.size();
+		bool constant = true;
+		for (size_t i = 1; i < numFrames && constant; i++)
+		{
+			constant = error(decoded[0], source[i]) <= tolerance;
+		}
+		if (constant)
+		{
+			return keys;
+		}
+
+		auto fits = [&](size_t start, size_t end)
+		{
+			for (size_t i = start + 1; i < end; i++)
+			{
+				float f = static_cast<float>(i - start) / (end - start);
+				if (error(interpolate(decoded[start], decoded[end], f), source[i]) > tolerance)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// Push each key as far on as every frame before it still fits
+		size_t start = 0;
+		while (start + 1 < numFrames)
+		{
+			size_t end = start + 1;
+			while (end + 1 < numFrames && fits(start, end + 1))
+			{
+				end++;
+			}
+			keys.emplace_back(static_cast<uint16_t>(end));
+			start = end;
+		}
+		return keys;
+	}
+
+	// Finds the keys either side of frame, and how far it is between them
+	void FindKeys(const uint16_t* keyFrames, size_t numKeys, float frame, size_t& outA, size_t& outB, float& outF)
+	{
+		const uint16_t* after = std::upper_bound(keyFrames, keyFrames + numKeys, frame,
+			[](float value, uint16_t keyFrame) { return value < keyFrame; });
+		if (after == keyFrames)
+		{
+			outA = outB = 0;
+			outF = 0.0f;
+		}
+		else if (after == keyFrames + numKeys)
+		{
+			outA = outB = numKeys - 1;
+			outF = 0.0f;
+		}
+		else
+		{
+			outB = after - keyFrames;
+			outA = outB - 1;
+			outF = (frame - keyFrames[outA]) / (keyFrames[outB] - keyFrames[outA]);
+		}
+	}
+}
+
+namespace AnimFormat
+{
+	bool ReadJson(const char* fileName, AnimData& outData)
+	{
+		JsonFile json;
+		if (!json.Load(fileName))
+		{
+			SDL_Log("File not found: Animation %s", fileName);
+			return false;
+		}
+		rapidjson::Document& doc = json.GetDocument();
+
+		if (!doc.IsObject())
+		{
+			SDL_Log("Animation %s is not valid json", fileName);
+			return false;
+		}
+
+		std::string str = doc["metadata"]["type"].GetString();
+		int ver = doc["metadata"]["version"].GetInt();
+
+		// Check the metadata
+		if (!doc["metadata"].IsObject() ||
+			str != "itpanim" ||
+			ver != 2)
+		{
+			SDL_Log("Animation %s unknown format", fileName);
+			return false;
+		}
+
+		const rapidjson::Value& sequence = doc["sequence"];
+		if (!sequence.IsObject())
+		{
+			SDL_Log("Animation %s doesn't have a sequence.", fileName);
+			return false;
+		}
+
+		const rapidjson::Value& frames = sequence["frames"];
+		const rapidjson::Value& length = sequence["length"];
+		const rapidjson::Value& bonecount = sequence["bonecount"];
+
+		if (!frames.IsUint() || !length.IsDouble() || !bonecount.IsUint())
+		{
+			SDL_Log("Sequence %s has invalid frames, length, or bone count.", fileName);
+			return false;
+		}
+
+		outData.mNumFrames = frames.GetUint();
+		outData.mLength = length.GetDouble();
+		outData.mNumBones = bonecount.GetUint();
+
+		// Key frames are stored in 16 bits
+		if (outData.mNumFrames < 1 || outData.mNumFrames > 0xFFFF)
+		{
+			SDL_Log("Sequence %s has an unsupported number of frames.", fileName);
+			return false;
+		}
+
+		outData.mTracks.resize(outData.mNumBones);
+
+		const rapidjson::Value& tracks = sequence["tracks"];
+
+		if (!tracks.IsArray())
+		{
+			SDL_Log("Sequence %s missing a tracks array.", fileName);
+			return false;
+		}
+
+		for (rapidjson::SizeType i = 0; i < tracks.Size(); i++)
+		{
+			if (!tracks[i].IsObject())
+			{
+				SDL_Log("Animation %s: Track element %d is invalid.", fileName, i);
+				return false;
+			}
+
+			size_t boneIndex = tracks[i]["bone"].GetUint();
+			if (boneIndex >= outData.mNumBones)
+			{
+				SDL_Log("Animation %s: Track element %d has an invalid bone.", fileName, i);
+				return false;
+			}
+
+			const rapidjson::Value& transforms = tracks[i]["transforms"];
+			if (!transforms.IsArray())
+			{
+				SDL_Log("Animation %s: Track element %d is missing transforms.", fileName, i);
+				return false;
+			}
+
+			BoneTransform temp;
+
+			if (transforms.Size() != outData.mNumFrames)
+			{
+				SDL_Log("Animation %s: Track element %d has fewer frames than expected.", fileName, i);
+				return false;
+			}
+
+			for (rapidjson::SizeType j = 0; j < transforms.Size(); j++)
+			{
+				const rapidjson::Value& rot = transforms[j]["rot"];
+				const rapidjson::Value& trans = transforms[j]["trans"];
+
+				if (!rot.IsArray() || !trans.IsArray())
+				{
+					SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
+					return false;
+				}
+
+				temp.mRotation.x = rot[0].GetDouble();
+				temp.mRotation.y = rot[1].GetDouble();
+				temp.mRotation.z = rot[2].GetDouble();
+				temp.mRotation.w = rot[3].GetDouble();
+
+				temp.mTranslation.x = trans[0].GetDouble();
+				temp.mTranslation.y = trans[1].GetDouble();
+				temp.mTranslation.z = trans[2].GetDouble();
+
+				outData.mTracks[boneIndex].emplace_back(temp);
+			}
+		}
+
+		return true;
+	}
+
+	void Compress(const AnimData& data, const Tolerance& tolerance, std::vector<char>& outClip)
+	{
+		std::vector<TrackHeader> trackHeaders(data.mNumBones);
+		// Each track's keys, as they're laid out in the clip
+		std::vector<std::vector<uint16_t>> rotationKeys(data.mNumBones);
+		std::vector<std::vector<uint16_t>> translationKeys(data.mNumBones);
+
+		for (size_t b = 0; b < data.mNumBones; b++)
+		{
+			const std::vector<BoneTransform>& track = data.mTracks[b];
+			TrackHeader& header = trackHeaders[b];
+			memset(&header, 0, sizeof(header));
+			if (track.empty())
+			{
+				continue;
+			}
+
+			size_t numFrames = track.size();
+			std::vector<Quaternion> rotations(numFrames);
+			std::vector<Vector3> translations(numFrames);
+			float rangeMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float rangeMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (size_t i = 0; i < numFrames; i++)
+			{
+				rotations[i] = Normalize(track[i].mRotation);
+				translations[i] = track[i].mTranslation;
+				float components[3] = { translations[i].x, translations[i].y, translations[i].z };
+				for (int c = 0; c < 3; c++)
+				{
+					rangeMin[c] = Math::Min(rangeMin[c], components[c]);
+					rangeMax[c] = Math::Max(rangeMax[c], components[c]);
+				}
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				header.mTranslationMin[c] = rangeMin[c];
+				header.mTranslationScale[c] = (rangeMax[c] - rangeMin[c]) / TRANSLATION_STEPS;
+			}
+
+			// Quantize every frame, so reduction can check what sampling will see
+			std::vector<uint16_t> rotationValues(numFrames * 3);
+			std::vector<uint16_t> translationValues(numFrames * 3);
+			std::vector<Quaternion> decodedRotations(numFrames);
+			std::vector<Vector3> decodedTranslations(numFrames);
+			for (size_t i = 0; i < numFrames; i++)
+			{
+				EncodeRotation(rotations[i], &rotationValues[i * 3]);
+				decodedRotations[i] = DecodeRotation(&rotationValues[i * 3]);
+				EncodeTranslation(translations[i], header.mTranslationMin, header.mTranslationScale, &translationValues[i * 3]);
+				decodedTranslations[i] = DecodeTranslation(&translationValues[i * 3], header.mTranslationMin, header.mTranslationScale);
+			}
+
+			std::vector<uint16_t> rotationFrames = ReduceKeys(rotations, decodedRotations, tolerance.mRotation, RotationError,
+				[](const Quaternion& a, const Quaternion& b, float f) { return Slerp(a, b, f); });
+			std::vector<uint16_t> translationFrames = ReduceKeys(translations, decodedTranslations, tolerance.mTranslation, TranslationError,
+				[](const Vector3& a, const Vector3& b, float f) { return Lerp(a, b, f); });
+
+			// Frames, then values
+			std::vector<uint16_t>& rotationOut = rotationKeys[b];
+			rotationOut = rotationFrames;
+			for (uint16_t frame : rotationFrames)
+			{
+				rotationOut.insert(rotationOut.end(), &rotationValues[frame * 3], &rotationValues[frame * 3] + 3);
+			}
+			std::vector<uint16_t>& translationOut = translationKeys[b];
+			translationOut = translationFrames;
+			for (uint16_t frame : translationFrames)
+			{
+				translationOut.insert(translationOut.end(), &translationValues[frame * 3], &translationValues[frame * 3] + 3);
+			}
+			header.mNumRotationKeys = static_cast<uint16_t>(rotationFrames.size());
+			header.mNumTranslationKeys = static_cast<uint16_t>(translationFrames.size());
+		}
+
+		// Now lay it all out
+		size_t offset = sizeof(Header) + data.mNumBones * sizeof(TrackHeader);
+		for (size_t b = 0; b < data.mNumBones; b++)
+		{
+			trackHeaders[b].mRotationOffset = static_cast<uint32_t>(offset);
+			offset += rotationKeys[b].size() * sizeof(uint16_t);
+			trackHeaders[b].mTranslationOffset = static_cast<uint32_t>(offset);
+			offset += translationKeys[b].size() * sizeof(uint16_t);
+		}
+
+		Header header;
+		memset(&header, 0, sizeof(header));
+		header.mMagic = COOKED_MAGIC;
+		header.mVersion = COOKED_VERSION;
+		header.mNumBones = static_cast<uint32_t>(data.mNumBones);
+		header.mNumFrames = static_cast<uint32_t>(data.mNumFrames);
+		header.mLength = data.mLength;
+		header.mTracksOffset = sizeof(Header);
+		header.mFileSize = static_cast<uint32_t>(offset);
+
+		outClip.assign(offset, 0);
+		char* clip = outClip.data();
+		memcpy(clip, &header, sizeof(header));
+		memcpy(clip + header.mTracksOffset, trackHeaders.data(), trackHeaders.size() * sizeof(TrackHeader));
+		for (size_t b = 0; b < data.mNumBones; b++)
+		{
+			memcpy(clip + trackHeaders[b].mRotationOffset, rotationKeys[b].data(), rotationKeys[b].size() * sizeof(uint16_t));
+			memcpy(clip + trackHeaders[b].mTranslationOffset, translationKeys[b].data(), translationKeys[b].size() * sizeof(uint16_t));
+		}
+	}
+
+	bool WriteCooked(const char* fileName, const std::vector<char>& clip)
+	{
+		std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SDL_Log("Couldn't write cooked animation %s", fileName);
+			return false;
+		}
+
+		file.write(clip.data(), clip.size());
+		if (file.fail())
+		{
+			SDL_Log("Couldn't write cooked animation %s", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	const Header* GetCookedHeader(const void* data, size_t size)
+	{
+		if (size < sizeof(Header))
+		{
+			return nullptr;
+		}
+
+		const Header* header = static_cast<const Header*>(data);
+		if (header->mMagic != COOKED_MAGIC || header->mVersion != COOKED_VERSION ||
+			header->mFileSize != size || header->mNumFrames == 0 || header->mNumFrames > 0xFFFF ||
+			header->mTracksOffset < sizeof(Header) ||
+			header->mTracksOffset + static_cast<uint64_t>(header->mNumBones) * sizeof(TrackHeader) > size)
+		{
+			return nullptr;
+		}
+
+		// Every track's keys have to fit in the clip
+		const TrackHeader* tracks = reinterpret_cast<const TrackHeader*>(static_cast<const char*>(data) + header->mTracksOffset);
+		for (uint32_t b = 0; b < header->mNumBones; b++)
+		{
+			const TrackHeader& track = tracks[b];
+			uint64_t rotationEnd = track.mRotationOffset + static_cast<uint64_t>(track.mNumRotationKeys) * 4 * sizeof(uint16_t);
+			uint64_t translationEnd = track.mTranslationOffset + static_cast<uint64_t>(track.mNumTranslationKeys) * 4 * sizeof(uint16_t);
+			if (rotationEnd > size || translationEnd > size ||
+				track.mRotationOffset % sizeof(uint16_t) != 0 || track.mTranslationOffset % sizeof(uint16_t) != 0)
+			{
+				return nullptr;
+			}
+		}
+		return header;
+	}
+
+	bool SampleBone(const Header& clip, size_t bone, float frame, BoneTransform& outTransform)
+	{
+		const char* data = reinterpret_cast<const char*>(&clip);
+		const TrackHeader& track = reinterpret_cast<const TrackHeader*>(data + clip.mTracksOffset)[bone];
+		if (track.mNumRotationKeys == 0 || track.mNumTranslationKeys == 0)
+		{
+			return false;
+		}
+
+		size_t a, b;
+		float f;
+
+		const uint16_t* rotationFrames = reinterpret_cast<const uint16_t*>(data + track.mRotationOffset);
+		const uint16_t* rotationValues = rotationFrames + track.mNumRotationKeys;
+		FindKeys(rotationFrames, track.mNumRotationKeys, frame, a, b, f);
+		outTransform.mRotation = DecodeRotation(&rotationValues[a * 3]);
+		if (a != b)
+		{
+			outTransform.mRotation = Slerp(outTransform.mRotation, DecodeRotation(&rotationValues[b * 3]), f);
+		}
+
+		const uint16_t* translationFrames = reinterpret_cast<const uint16_t*>(data + track.mTranslationOffset);
+		const uint16_t* translationValues = translationFrames + track.mNumTranslationKeys;
+		FindKeys(translationFrames, track.mNumTranslationKeys, frame, a, b, f);
+		outTransform.mTranslation = DecodeTranslation(&translationValues[a * 3], track.mTranslationMin, track.mTranslationScale);
+		if (a != b)
+		{
+			Vector3 next = DecodeTranslation(&translationValues[b * 3], track.mTranslationMin, track.mTranslationScale);
+			outTransform.mTranslation = Lerp(outTransform.mTranslation, next, f);
+		}
+		return true;
+	}
+}
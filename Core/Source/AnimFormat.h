@@ -0,0 +1,91 @@
+// AnimFormat.h
+// Reads .itpanim2 JSON animations and compresses them into the clip
+// format Animation samples from. The asset cooker writes clips out as
+// they are, next to their source with ".cooked" on the end.
+//
+// Each bone has a rotation track and a translation track, and each track
+// only keeps the frames that can't be interpolated from its neighbours
+// within a tolerance. Rotations are stored "smallest three": the largest
+// component is dropped (it can be worked out from the other three, since
+// the quaternion is unit length), and the other three are quantized to
+// 15 bits each. Translations are quantized to 16 bits each, over the
+// range the track covers. A clip is laid out as:
+//   Header
+//   TrackHeader[mNumBones]
+//   for each track, uint16_t key frames[n], then uint16_t values[n * 3]
+
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BoneTransform.h"
+
+namespace AnimFormat
+{
+	// "ITPA"
+	const uint32_t COOKED_MAGIC = 0x41505449;
+	// Bump this whenever the layout changes, so old cooked files get ignored
+	const uint32_t COOKED_VERSION = 1;
+
+	struct Header
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		uint32_t mNumBones;
+		uint32_t mNumFrames;
+		float mLength;
+		// Offsets are in bytes from the start of the clip
+		uint32_t mTracksOffset;
+		uint32_t mFileSize;
+	};
+
+	struct TrackHeader
+	{
+		uint32_t mRotationOffset;
+		uint32_t mTranslationOffset;
+		// Both are 0 if the bone isn't animated
+		uint16_t mNumRotationKeys;
+		uint16_t mNumTranslationKeys;
+		// A quantized translation is mTranslationMin + value * mTranslationScale
+		float mTranslationMin[3];
+		float mTranslationScale[3];
+	};
+
+	// A whole animation, as read from JSON
+	struct AnimData
+	{
+		size_t mNumBones;
+		size_t mNumFrames;
+		float mLength;
+		// Each index in the outer vector is a bone, inner vector is a
+		// frame. Bones that aren't animated have no frames
+		std::vector<std::vector<BoneTransform>> mTracks;
+	};
+
+	// How far a sampled transform can be from the source before a frame
+	// has to be kept as a key
+	struct Tolerance
+	{
+		Tolerance() :mRotation(0.0005f), mTranslation(0.005f) { }
+
+		// In radians
+		float mRotation;
+		// In the animation's units
+		float mTranslation;
+	};
+
+	// Parses an .itpanim2 file, logging why if it can't
+	bool ReadJson(const char* fileName, AnimData& outData);
+
+	// Compresses data into a clip, ready to sample or write out
+	void Compress(const AnimData& data, const Tolerance& tolerance, std::vector<char>& outClip);
+
+	bool WriteCooked(const char* fileName, const std::vector<char>& clip);
+
+	// Returns the header of the clip in data, or null if it's not one, is
+	// from a different version, or is cut short
+	const Header* GetCookedHeader(const void* data, size_t size);
+
+	// Decodes bone's transform at frame, which can fall between frames, from
+	// the clip that starts with clip. Returns false if the bone isn't animated
+	bool SampleBone(const Header& clip, size_t bone, float frame, BoneTransform& outTransform);
+}
@@ -9,118 +9,54 @@ Animation::Animation(class Game& game)
 
 bool Animation::Load(const char* fileName, class AssetCache* cache)
 {
-	std::ifstream file(fileName);
-	if (!file.is_open())
-	{
-		SDL_Log("File not found: Animation %s", fileName);
-		return false;
-	}
-
-	std::stringstream fileStream;
-	fileStream << file.rdbuf();
-	std::string contents = fileStream.str();
-	rapidjson::StringStream jsonStr(contents.c_str());
-	rapidjson::Document doc;
-	doc.ParseStream(jsonStr);
-
-	if (!doc.IsObject())
-	{
-		SDL_Log("Animation %s is not valid json", fileName);
-		return false;
-	}
+	LoadPhase phase(ELP_Parse);
 
-	std::string str = doc["metadata"]["type"].GetString();
-	int ver = doc["metadata"]["version"].GetInt();
-
-	// Check the metadata
-	if (!doc["metadata"].IsObject() ||
-		str != "itpanim" ||
-		ver != 2)
+	// Use the cooked clip if the asset cooker has made one, since it's
+	// already compressed
+	std::string cookedName = GetCookedFileName(fileName);
+	if (!cookedName.empty())
 	{
-		SDL_Log("Animation %s unknown format", fileName);
-		return false;
+		if (LoadCooked(cookedName.c_str()))
+		{
+			return true;
+		}
+		SDL_Log("Animation %s: Cooked clip %s is invalid. Loading the source instead.", fileName, cookedName.c_str());
 	}
 
-	const rapidjson::Value& sequence = doc["sequence"];
-	if (!sequence.IsObject())
+	AnimFormat::AnimData data;
+	if (!AnimFormat::ReadJson(fileName, data))
 	{
-		SDL_Log("Animation %s doesn't have a sequence.", fileName);
 		return false;
 	}
 
-	const rapidjson::Value& frames = sequence["frames"];
-	const rapidjson::Value& length = sequence["length"];
-	const rapidjson::Value& bonecount = sequence["bonecount"];
+	AnimFormat::Compress(data, AnimFormat::Tolerance(), mClip);
+	mNumFrames = data.mNumFrames;
+	mLength = data.mLength;
+	mNumBones = data.mNumBones;
+	return true;
+}
 
-	if (!frames.IsUint() || !length.IsDouble() || !bonecount.IsUint())
+bool Animation::LoadCooked(const char* fileName)
+{
+	VirtualFile file;
+	if (!file.Open(fileName))
 	{
-		SDL_Log("Sequence %s has invalid frames, length, or bone count.", fileName);
 		return false;
 	}
 
-	mNumFrames = frames.GetUint();
-	mLength = length.GetDouble();
-	mNumBones = bonecount.GetUint();
+	const char* data = static_cast<const char*>(file.GetData());
+	mClip.assign(data, data + file.GetSize());
 
-	mTracks.resize(mNumBones);
-
-	const rapidjson::Value& tracks = sequence["tracks"];
-
-	if (!tracks.IsArray())
+	const AnimFormat::Header* header = AnimFormat::GetCookedHeader(mClip.data(), mClip.size());
+	if (header == nullptr)
 	{
-		SDL_Log("Sequence %s missing a tracks array.", fileName);
+		mClip.clear();
 		return false;
 	}
 
-	for (rapidjson::SizeType i = 0; i < tracks.Size(); i++)
-	{
-		if (!tracks[i].IsObject())
-		{
-			SDL_Log("Animation %s: Track element %d is invalid.", fileName, i);
-			return false;
-		}
-
-		size_t boneIndex = tracks[i]["bone"].GetUint();
-
-		const rapidjson::Value& transforms = tracks[i]["transforms"];
-		if (!transforms.IsArray())
-		{
-			SDL_Log("Animation %s: Track element %d is missing transforms.", fileName, i);
-			return false;
-		}
-
-		BoneTransform temp;
-
-		if (transforms.Size() != mNumFrames)
-		{
-			SDL_Log("Animation %s: Track element %d has fewer frames than expected.", fileName, i);
-			return false;
-		}
-
-		for (rapidjson::SizeType j = 0; j < transforms.Size(); j++)
-		{
-			const rapidjson::Value& rot = transforms[j]["rot"];
-			const rapidjson::Value& trans = transforms[j]["trans"];
-
-			if (!rot.IsArray() || !trans.IsArray())
-			{
-				SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
-				return false;
-			}
-
-			temp.mRotation.x = rot[0].GetDouble();
-			temp.mRotation.y = rot[1].GetDouble();
-			temp.mRotation.z = rot[2].GetDouble();
-			temp.mRotation.w = rot[3].GetDouble();
-
-			temp.mTranslation.x = trans[0].GetDouble();
-			temp.mTranslation.y = trans[1].GetDouble();
-			temp.mTranslation.z = trans[2].GetDouble();
-
-			mTracks[boneIndex].emplace_back(temp);
-		}
-	}
-
+	mNumFrames = header->mNumFrames;
+	mLength = header->mLength;
+	mNumBones = header->mNumBones;
 	return true;
 }
 
@@ -128,19 +64,21 @@ void Animation::GetGlobalPoseAtTime(std::vector<Matrix4>& outPoses, SkeletonPtr
 {
 	float frameDur = mLength / ( mNumFrames - 1 );
 
-	float frame = inTime / frameDur;
-	int A = ( int ) frame;			// closest frame before inTime
-	int B = A + 1;			// closest frame after
-	float f = frame - A;			// percentage between A and B
+	// Which frame inTime falls on, which can be between two of them
+	float frame = Math::Clamp( inTime / frameDur, 0.0f, ( float ) ( mNumFrames - 1 ) );
 
+	const AnimFormat::Header& clip = *reinterpret_cast<const AnimFormat::Header*>( mClip.data() );
+	BoneTransform transform;
 	for ( size_t b = 0; b < mNumBones; b++ )
 	{
+		// If there's no sample, the bone isn't transformed during the animation
+		bool animated = AnimFormat::SampleBone( clip, b, frame, transform );
 		int parentIdx = inSkeleton->GetBone( b ).mParent;
 		if ( parentIdx >= 0 )
 		{
-			if ( !mTracks[b].empty() ) // If empty, the bone isn't transformed during the animation
+			if ( animated )
 			{
-				outPoses[b] = Interpolate( mTracks[b][A], mTracks[b][B], f ).ToMatrix() * outPoses[parentIdx];
+				outPoses[b] = transform.ToMatrix() * outPoses[parentIdx];
 			}
 			else
 			{
@@ -149,9 +87,9 @@ void Animation::GetGlobalPoseAtTime(std::vector<Matrix4>& outPoses, SkeletonPtr
 		}
 		else
 		{
-			if ( !mTracks[b].empty() )
+			if ( animated )
 			{
-				outPoses[b] = Interpolate( mTracks[b][A], mTracks[b][B], f ).ToMatrix();
+				outPoses[b] = transform.ToMatrix();
 			}
 			else
 			{
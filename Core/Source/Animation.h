@@ -3,6 +3,7 @@
 #include "BoneTransform.h"
 #include <vector>
 #include "Skeleton.h"
+#include "AnimFormat.h"
 
 class Animation : public Asset
 {
@@ -11,16 +12,26 @@ public:
 	Animation(class Game& game);
 
 	bool Load(const char* fileName, class AssetCache* cache) override;
+protected:
+	// Nothing goes on the GPU, so an asynchronous load does it all on the worker
+	bool LoadData(const char* fileName) override { return Load(fileName, nullptr); }
+	EFinalizeResult Finalize(const char* fileName, class AssetCache* cache) override { return EFR_Done; }
+public:
 
 	size_t GetNumBones() const { return mNumBones; }
 	size_t GetNumFrames() const { return mNumFrames; }
 	float GetLength() const { return mLength; }
 
+	size_t GetMemorySize() const override { return mClip.size(); }
+
 	// Fills the provided matrix with the global (current) pose matrices for each
 	// bone at the specified time in the animation. It is expected that the time
 	// is >= 0.0f and <= mLength
 	void GetGlobalPoseAtTime(std::vector<Matrix4>& outPoses, SkeletonPtr inSkeleton, float inTime);
 private:
+	// Reads the cooked clip as it is
+	bool LoadCooked(const char* fileName);
+
 	// Number of bones for the animation
 	size_t mNumBones;
 
@@ -30,10 +41,8 @@ private:
 	// Length of the animation in seconds
 	float mLength;
 
-	// Transform information for each frame on the track
-	// Each index in the outer vector is a bone, inner vector
-	// is a frame
-	std::vector<std::vector<BoneTransform>> mTracks;
+	// The compressed clip (see AnimFormat.h), which is sampled directly
+	std::vector<char> mClip;
 };
 
 DECL_PTR(Animation);
@@ -1,4 +1,5 @@
 #include "ITPEnginePCH.h"
+#include <sys/stat.h>
 
 Asset::Asset(class Game& game)
 	:mGame(game)
@@ -10,3 +11,30 @@ Asset::~Asset()
 {
 
 }
+
+std::string Asset::GetCookedFileName(const char* fileName)
+{
+	std::string cookedName(fileName);
+	cookedName += ".cooked";
+
+	// Only cooked files that were up to date get packed, and their sources
+	// are left out, so there's nothing to compare against
+	if (FileSystem::IsInArchive(cookedName.c_str()))
+	{
+		return cookedName;
+	}
+
+	struct stat cookedInfo;
+	if (stat(cookedName.c_str(), &cookedInfo) != 0)
+	{
+		return std::string();
+	}
+
+	// A source that's changed since it was cooked has to be cooked again
+	struct stat sourceInfo;
+	if (stat(fileName, &sourceInfo) == 0 && sourceInfo.st_mtime > cookedInfo.st_mtime)
+	{
+		return std::string();
+	}
+	return cookedName;
+}
@@ -4,19 +4,54 @@
 
 #pragma once
 #include <memory>
+#include <string>
 #include "ObjectMacros.h"
 
 class Game;
 
+// What an asynchronously loaded asset's Finalize did
+enum EFinalizeResult
+{
+	EFR_Done,
+	EFR_Failed,
+	// Still waiting on other assets, so it should be called again next frame
+	EFR_Pending
+};
+
 class Asset : public std::enable_shared_from_this<Asset>
 {
+	// Calls LoadData and Finalize for LoadAsync
+	friend class AssetCache;
 public:
 	Asset(class Game& game);
 	virtual ~Asset();
+
+	// The class name, which AssetCache groups its stats by. Filled in by DECL_ASSET
+	virtual const char* GetAssetType() const = 0;
+	// Roughly how much memory the asset holds, on the CPU and GPU, which
+	// counts towards AssetCache's budget
+	virtual size_t GetMemorySize() const { return 0; }
+
+	// The asset cooker writes cooked versions of source files next to them,
+	// with ".cooked" on the end. Returns its name if there's one at least as
+	// new as fileName (or fileName is gone), or in the mounted archive, or
+	// an empty string if not
+	static std::string GetCookedFileName(const char* fileName);
 protected:
 	// Change the access level to the protected
 	using std::enable_shared_from_this<Asset>::shared_from_this;
 	virtual bool Load(const char* fileName, class AssetCache* cache) = 0;
+
+	// AssetCache::LoadAsync loads in two halves. LoadData runs on a worker
+	// thread, so it should do the file I/O and parsing, and mustn't touch the
+	// GPU or the cache. Finalize then runs on the main thread to create GPU
+	// resources and load other assets. By default all of Load runs in Finalize
+	virtual bool LoadData(const char* /*fileName*/) { return true; }
+	virtual EFinalizeResult Finalize(const char* fileName, class AssetCache* cache)
+	{
+		return Load(fileName, cache) ? EFR_Done : EFR_Failed;
+	}
+
 	class Game& mGame;
 };
 
@@ -1,13 +1,321 @@
 #include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+#include <algorithm>
+
+namespace
+{
+	// Names of every asset type that has been registered, by index
+	std::vector<const char*> sAssetTypes;
+	std::mutex sAssetTypesMutex;
+}
+
+AssetRequest::AssetRequest(AssetCache& cache, AssetId id, const std::string& path, AssetPtr asset, EState state, size_t type)
+	:mCache(cache)
+	,mId(id)
+	,mPath(path)
+	,mAsset(asset)
+	,mState(state)
+	,mDataLoaded(false)
+	,mType(type)
+	,mLoadSeconds(0.0)
+{
+
+}
 
 AssetCache::AssetCache(Game& game, const char* rootDirectory)
-	:mGame(game)
+	:mEntries(INITIAL_TABLE_SIZE)
+	,mNumEntries(0)
+	,mSlotShift(64 - 8)
+	,mMemoryBudget(DEFAULT_MEMORY_BUDGET)
+	,mMemoryUsed(0)
+	,mUseClock(0)
+	,mGame(game)
 	,mRoot(rootDirectory)
 {
 
 }
 
+void AssetCache::Update()
+{
+	FinalizeLoaded();
+
+	if (mMemoryUsed > mMemoryBudget)
+	{
+		Evict();
+	}
+}
+
+void AssetCache::FinalizeLoaded()
+{
+	TakeLoaded();
+
+	// Each request gets one try per update. Finalize can start more loads,
+	// or wait on them, which finalizes again from in here
+	size_t count = mFinalizing.size();
+	for (size_t i = 0; i < count && !mFinalizing.empty(); i++)
+	{
+		std::shared_ptr<AssetRequest> request = mFinalizing.front();
+		mFinalizing.pop_front();
+
+		EFinalizeResult result = EFR_Failed;
+		if (request->mDataLoaded)
+		{
+			LoadScope scope(request->mPath.c_str(), request->mAsset->GetAssetType(), "Finalize", request->mRequestedBy.c_str());
+			auto start = std::chrono::high_resolution_clock::now();
+			result = request->mAsset->Finalize(request->mPath.c_str(), this);
+			request->mLoadSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		if (result == EFR_Pending)
+		{
+			mFinalizing.push_back(request);
+		}
+		else
+		{
+			Finish(*request, result == EFR_Done);
+		}
+	}
+}
+
+void AssetCache::TakeLoaded()
+{
+	std::lock_guard<std::mutex> lock(mLoadedMutex);
+	mFinalizing.insert(mFinalizing.end(), mLoaded.begin(), mLoaded.end());
+	mLoaded.clear();
+}
+
+void AssetCache::Wait(AssetRequest& request)
+{
+	JobSystem& jobs = mGame.GetJobs();
+	while (!request.IsFinished())
+	{
+		FinalizeLoaded();
+
+		// Nothing left to help with, so the rest is already running on workers
+		if (!request.IsFinished() && !jobs.RunOne())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
 void AssetCache::Clear()
 {
-	mAssetMap.clear();
+	// The workers still hold on to the loads they're running, so let those
+	// come in. Every pending request is then waiting to be finalized
+	JobSystem& jobs = mGame.GetJobs();
+	TakeLoaded();
+	while (mFinalizing.size() < mPending.size())
+	{
+		if (!jobs.RunOne())
+		{
+			std::this_thread::yield();
+		}
+		TakeLoaded();
+	}
+
+	// Fail them rather than finalize them, so nothing waits on them forever
+	while (!mFinalizing.empty())
+	{
+		std::shared_ptr<AssetRequest> request = mFinalizing.front();
+		mFinalizing.pop_front();
+		Finish(*request, false);
+	}
+
+	for (auto& entry : mEntries)
+	{
+		entry = Entry();
+	}
+	mNumEntries = 0;
+	for (auto& stats : mStats)
+	{
+		stats.mCount = 0;
+		stats.mBytes = 0;
+	}
+	mMemoryUsed = 0;
+}
+
+size_t AssetCache::RegisterType(const char* type)
+{
+	std::lock_guard<std::mutex> lock(sAssetTypesMutex);
+	sAssetTypes.emplace_back(type);
+	return sAssetTypes.size() - 1;
+}
+
+void AssetCache::AddTypeStats(size_t index)
+{
+	std::lock_guard<std::mutex> lock(sAssetTypesMutex);
+	while (mStats.size() <= index)
+	{
+		AssetTypeStats stats;
+		memset(&stats, 0, sizeof(stats));
+		stats.mType = sAssetTypes[mStats.size()];
+		mStats.emplace_back(stats);
+	}
+}
+
+bool AssetCache::GetFullPath(AssetId id, std::string& outPath) const
+{
+	const char* path = id.GetPath();
+	if (path == nullptr)
+	{
+		SDL_Log("AssetCache: No path for asset ID %016llx. Load it by path first.", static_cast<unsigned long long>(id.GetHash()));
+		return false;
+	}
+	outPath = mRoot;
+	outPath += path;
+	return true;
+}
+
+std::shared_ptr<AssetRequest> AssetCache::MakeReadyRequest(AssetId id, AssetPtr asset, size_t type)
+{
+	return std::make_shared<AssetRequest>(*this, id, std::string(), asset, AssetRequest::ES_Ready, type);
+}
+
+void AssetCache::Add(AssetId id, AssetPtr asset, size_t type)
+{
+	if ((mNumEntries + 1) * 2 > mEntries.size())
+	{
+		Grow();
+	}
+
+	size_t mask = mEntries.size() - 1;
+	size_t i = GetSlot(id);
+	while (mEntries[i].mId.IsValid())
+	{
+		i = (i + 1) & mask;
+	}
+
+	Entry& entry = mEntries[i];
+	entry.mId = id;
+	entry.mAsset = asset;
+	entry.mType = type;
+	entry.mBytes = asset->GetMemorySize();
+	entry.mLastUsed = ++mUseClock;
+	mNumEntries++;
+
+	mStats[type].mCount++;
+	mStats[type].mBytes += entry.mBytes;
+	mMemoryUsed += entry.mBytes;
+}
+
+void AssetCache::Remove(size_t index)
+{
+	// Rather than leave a marker in the slot, shift back any entries after
+	// it that would no longer be found past the gap. An entry can move
+	// into the gap if its probe starts at or before the gap
+	size_t mask = mEntries.size() - 1;
+	size_t gap = index;
+	for (size_t i = (index + 1) & mask; mEntries[i].mId.IsValid(); i = (i + 1) & mask)
+	{
+		size_t start = GetSlot(mEntries[i].mId);
+		if (((i - start) & mask) >= ((i - gap) & mask))
+		{
+			mEntries[gap] = std::move(mEntries[i]);
+			gap = i;
+		}
+	}
+	mEntries[gap] = Entry();
+	mNumEntries--;
+}
+
+void AssetCache::Grow()
+{
+	std::vector<Entry> old(mEntries.size() * 2);
+	old.swap(mEntries);
+	mSlotShift--;
+
+	size_t mask = mEntries.size() - 1;
+	for (auto& entry : old)
+	{
+		if (entry.mId.IsValid())
+		{
+			size_t i = GetSlot(entry.mId);
+			while (mEntries[i].mId.IsValid())
+			{
+				i = (i + 1) & mask;
+			}
+			mEntries[i] = std::move(entry);
+		}
+	}
+}
+
+void AssetCache::Evict()
+{
+	// Evicting a mesh can leave its textures unused, so go round again
+	// until nothing more can go
+	bool evicted = true;
+	while (evicted && mMemoryUsed > mMemoryBudget)
+	{
+		// Assets only the cache refers to, oldest first
+		std::vector<std::pair<uint64_t, AssetId>> unused;
+		for (auto& entry : mEntries)
+		{
+			if (entry.mId.IsValid() && entry.mAsset.use_count() == 1)
+			{
+				unused.emplace_back(entry.mLastUsed, entry.mId);
+			}
+		}
+		std::sort(unused.begin(), unused.end(),
+			[](const std::pair<uint64_t, AssetId>& a, const std::pair<uint64_t, AssetId>& b)
+		{
+			return a.first < b.first;
+		});
+
+		evicted = false;
+		for (auto& candidate : unused)
+		{
+			if (mMemoryUsed <= mMemoryBudget)
+			{
+				break;
+			}
+
+			// Removing shifts entries around, so find it again each time
+			Entry& entry = *Find(candidate.second);
+			mStats[entry.mType].mCount--;
+			mStats[entry.mType].mBytes -= entry.mBytes;
+			mStats[entry.mType].mEvictions++;
+			mMemoryUsed -= entry.mBytes;
+			Remove(&entry - mEntries.data());
+			evicted = true;
+		}
+	}
+}
+
+std::shared_ptr<AssetRequest> AssetCache::StartLoad(AssetId id, const std::string& path, AssetPtr asset, size_t type)
+{
+	auto request = std::make_shared<AssetRequest>(*this, id, path, asset, AssetRequest::ES_Loading, type);
+	request->mRequestedBy = LoadProfiler::GetCurrentPath();
+	mPending.emplace(id, request);
+
+	mGame.GetJobs().Submit([this, request]()
+	{
+		{
+			LoadScope scope(request->mPath.c_str(), request->mAsset->GetAssetType(), "LoadData", request->mRequestedBy.c_str());
+			auto start = std::chrono::high_resolution_clock::now();
+			request->mDataLoaded = request->mAsset->LoadData(request->mPath.c_str());
+			request->mLoadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		std::lock_guard<std::mutex> lock(mLoadedMutex);
+		mLoaded.push_back(request);
+	});
+
+	return request;
+}
+
+void AssetCache::Finish(AssetRequest& request, bool succeeded)
+{
+	mStats[request.mType].mLoadSeconds += request.mLoadSeconds;
+	if (succeeded)
+	{
+		request.mState = AssetRequest::ES_Ready;
+		Add(request.mId, request.mAsset, request.mType);
+	}
+	else
+	{
+		request.mState = AssetRequest::ES_Failed;
+		request.mAsset.reset();
+	}
+	mPending.erase(request.mId);
 }
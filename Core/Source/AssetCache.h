@@ -3,53 +3,380 @@
 // file is only loaded once at most.
 // Generally, you will call the Load function on the AssetCache
 // member in Game
+//
+// Assets are keyed on their AssetId (see AssetId.h), so a path that's
+// already loaded is found without building or hashing any strings.
+//
+// The cache keeps to a memory budget. Once it's over, Update evicts the
+// least recently used assets that nothing but the cache refers to, until
+// it's back under. Asking for an evicted asset again just loads it again
 
 #pragma once
 #include "Asset.h"
+#include "AssetId.h"
+#include "LoadProfiler.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class Game;
 
+// One asynchronous load, shared by every AssetFuture for its path
+struct AssetRequest
+{
+	enum EState
+	{
+		ES_Loading,
+		ES_Ready,
+		ES_Failed
+	};
+
+	AssetRequest(class AssetCache& cache, AssetId id, const std::string& path, AssetPtr asset, EState state, size_t type);
+
+	bool IsFinished() const { return mState != ES_Loading; }
+
+	class AssetCache& mCache;
+	AssetId mId;
+	// Including the root directory
+	std::string mPath;
+	// Null if the load failed
+	AssetPtr mAsset;
+	// Only changed on the main thread
+	EState mState;
+	// Set by the worker before it hands the request back
+	bool mDataLoaded;
+	// Index into the cache's stats
+	size_t mType;
+	// Time spent loading so far, on any thread
+	double mLoadSeconds;
+	// The asset whose load asked for this one, for the LoadProfiler. Empty
+	// if it was asked for directly, or the profiler is off
+	std::string mRequestedBy;
+};
+
+// Memory use and activity for one type of asset
+struct AssetTypeStats
+{
+	// The asset class name
+	const char* mType;
+	// Assets of this type in the cache, and roughly how much memory they hold
+	size_t mCount;
+	size_t mBytes;
+	// Loads that found the asset in the cache or already loading, and loads that didn't
+	size_t mHits;
+	size_t mMisses;
+	size_t mEvictions;
+	// Time spent loading, on any thread. A synchronous load's time includes
+	// the assets it loads in turn, such as a mesh's textures
+	double mLoadSeconds;
+};
+
+// Handle to an asset that's loading in the background. Main thread only
+template <typename T>
+class AssetFuture
+{
+public:
+	AssetFuture() { }
+	explicit AssetFuture(std::shared_ptr<AssetRequest> request) :mRequest(request) { }
+	// So loads of different types can be kept together as AssetFuture<Asset>
+	template <typename U>
+	AssetFuture(const AssetFuture<U>& other) :mRequest(other.mRequest) { }
+
+	// True once the load has finished, whether or not it worked
+	bool IsReady() const { return !mRequest || mRequest->IsFinished(); }
+	// The asset once it's ready. Null before that, or if the load failed
+	std::shared_ptr<T> Get() const
+	{
+		return mRequest && mRequest->mState == AssetRequest::ES_Ready ?
+			std::static_pointer_cast<T>(mRequest->mAsset) : nullptr;
+	}
+	// Finishes the load right away, helping the workers with it, and returns Get()
+	std::shared_ptr<T> Wait() const;
+private:
+	template <typename U>
+	friend class AssetFuture;
+
+	std::shared_ptr<AssetRequest> mRequest;
+};
+
 class AssetCache
 {
 public:
+	static const size_t DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024;
+	static const size_t INITIAL_TABLE_SIZE = 256;
+
 	AssetCache(Game& game, const char* rootDirectory);
 
 	// Template magics to load an arbitrary Asset into the cache
 	// Generally will be used like:
 	// assetCache.Load<AssetClass>("path/file.name")
+	// Finding an asset that's already loaded doesn't allocate anything
 	template <typename T>
 	std::shared_ptr<T> Load(const char* fileName)
 	{
-		std::string path(mRoot);
-		path += fileName;
-		auto iter = mAssetMap.find(path);
+		AssetId id(fileName);
+		size_t type = GetTypeIndex<T>();
+		if (Entry* entry = Find(id))
+		{
+			return std::static_pointer_cast<T>(Use(*entry, type));
+		}
+
+		AssetId::Intern(fileName);
+		return LoadMissing<T>(id, type);
+	}
 
-		if (iter != mAssetMap.end())
+	template <typename T>
+	std::shared_ptr<T> Load(const std::string& fileName)
+	{
+		return Load<T>(fileName.c_str());
+	}
+
+	// Loads an asset by ID. Its path has to have been interned already,
+	// by loading it by path or with AssetId::Intern
+	template <typename T>
+	std::shared_ptr<T> Load(AssetId id)
+	{
+		size_t type = GetTypeIndex<T>();
+		if (Entry* entry = Find(id))
 		{
-			return std::static_pointer_cast<T>(iter->second);
+			return std::static_pointer_cast<T>(Use(*entry, type));
 		}
-		else
+		return LoadMissing<T>(id, type);
+	}
+
+	// Starts loading an asset on the worker threads and returns straight
+	// away. Update finishes it on the main thread once its data is in.
+	// Requests for a path that's already loading share that load
+	// Generally will be used like:
+	// auto future = assetCache.LoadAsync<AssetClass>("path/file.name")
+	template <typename T>
+	AssetFuture<T> LoadAsync(const char* fileName)
+	{
+		AssetId id(fileName);
+		size_t type = GetTypeIndex<T>();
+		if (Entry* entry = Find(id))
 		{
-			std::shared_ptr<T> asset = T::StaticLoad(path.c_str(), this, mGame);
-			if (asset)
-			{
-				mAssetMap.emplace(path, asset);
-			}
-			return asset;
+			return AssetFuture<T>(MakeReadyRequest(id, Use(*entry, type), type));
 		}
+
+		AssetId::Intern(fileName);
+		return LoadAsyncMissing<T>(id, type);
 	}
 
 	template <typename T>
-	std::shared_ptr<T> Load(const std::string& fileName)
+	AssetFuture<T> LoadAsync(const std::string& fileName)
 	{
-		return Load<T>(fileName.c_str());
+		return LoadAsync<T>(fileName.c_str());
 	}
-	
+
+	template <typename T>
+	AssetFuture<T> LoadAsync(AssetId id)
+	{
+		size_t type = GetTypeIndex<T>();
+		if (Entry* entry = Find(id))
+		{
+			return AssetFuture<T>(MakeReadyRequest(id, Use(*entry, type), type));
+		}
+		return LoadAsyncMissing<T>(id, type);
+	}
+
+	// Call once per frame. Finalizes the asynchronous loads whose data has
+	// come in, and adds them to the cache, then evicts assets if the cache
+	// is over budget
+	void Update();
+
+	// Returns once request has finished, running jobs and finalizing loads
+	// in the meantime. It never evicts, so assets don't go mid-load
+	void Wait(AssetRequest& request);
+
+	// Asynchronous loads that haven't finished
+	size_t GetNumPending() const { return mPending.size(); }
+
+	// The most memory the cache should hold, in bytes. Assets that are in
+	// use don't get evicted, so it can still go over
+	void SetMemoryBudget(size_t bytes) { mMemoryBudget = bytes; }
+	size_t GetMemoryBudget() const { return mMemoryBudget; }
+	// How much memory the cached assets hold, roughly
+	size_t GetMemoryUsed() const { return mMemoryUsed; }
+
+	// One entry for each type of asset that has been asked for
+	const std::vector<AssetTypeStats>& GetStats() const { return mStats; }
+
+	// What the paths given to Load are relative to
+	const char* GetRoot() const { return mRoot; }
+
+	// Empties the cache. Loads that are still running are waited for, then
+	// failed instead of finalized
 	void Clear();
 private:
-	std::unordered_map<std::string, AssetPtr> mAssetMap;
+	// A slot in mEntries. Empty slots have an invalid ID
+	struct Entry
+	{
+		Entry() :mType(0), mBytes(0), mLastUsed(0) { }
+
+		AssetId mId;
+		AssetPtr mAsset;
+		// Index into mStats
+		size_t mType;
+		size_t mBytes;
+		// mUseClock when it was last asked for
+		uint64_t mLastUsed;
+	};
+
+	// mEntries is an open addressing hash table, with linear probing. It's
+	// never more than half full, so there's always an empty slot to stop at
+	Entry* Find(AssetId id)
+	{
+		size_t mask = mEntries.size() - 1;
+		for (size_t i = GetSlot(id); ; i = (i + 1) & mask)
+		{
+			Entry& entry = mEntries[i];
+			if (entry.mId == id)
+			{
+				return &entry;
+			}
+			if (!entry.mId.IsValid())
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	// Where id's probe starts. The hash is spread over the table with a
+	// multiply, so paths that only differ at the end still scatter
+	size_t GetSlot(AssetId id) const
+	{
+		return static_cast<size_t>((id.GetHash() * 0x9E3779B97F4A7C15ULL) >> mSlotShift);
+	}
+
+	// Counts a hit on an asset that's already loaded
+	const AssetPtr& Use(Entry& entry, size_t type)
+	{
+		mStats[type].mHits++;
+		entry.mLastUsed = ++mUseClock;
+		return entry.mAsset;
+	}
+
+	template <typename T>
+	std::shared_ptr<T> LoadMissing(AssetId id, size_t type)
+	{
+		// Already loading in the background, so finish that instead of loading it twice
+		auto pending = mPending.find(id);
+		if (pending != mPending.end())
+		{
+			mStats[type].mHits++;
+			std::shared_ptr<AssetRequest> request = pending->second;
+			Wait(*request);
+			return std::static_pointer_cast<T>(request->mAsset);
+		}
+
+		mStats[type].mMisses++;
+		std::string path;
+		if (!GetFullPath(id, path))
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<T> asset;
+		{
+			LoadScope scope(path.c_str(), mStats[type].mType, "Load");
+			auto start = std::chrono::high_resolution_clock::now();
+			asset = T::StaticLoad(path.c_str(), this, mGame);
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			mStats[type].mLoadSeconds += seconds;
+		}
+		if (asset)
+		{
+			Add(id, asset, type);
+		}
+		return asset;
+	}
+
+	template <typename T>
+	AssetFuture<T> LoadAsyncMissing(AssetId id, size_t type)
+	{
+		auto pending = mPending.find(id);
+		if (pending != mPending.end())
+		{
+			mStats[type].mHits++;
+			return AssetFuture<T>(pending->second);
+		}
+
+		mStats[type].mMisses++;
+		std::string path;
+		if (!GetFullPath(id, path))
+		{
+			return AssetFuture<T>(std::make_shared<AssetRequest>(*this, id, path, nullptr, AssetRequest::ES_Failed, type));
+		}
+		return AssetFuture<T>(StartLoad(id, path, std::make_shared<T>(mGame), type));
+	}
+
+	// Every asset type gets an index the first time it's asked for, which
+	// is the same for every cache
+	template <typename T>
+	size_t GetTypeIndex()
+	{
+		static const size_t index = RegisterType(T::StaticAssetType());
+		if (index >= mStats.size())
+		{
+			AddTypeStats(index);
+		}
+		return index;
+	}
+	static size_t RegisterType(const char* type);
+	void AddTypeStats(size_t index);
+
+	// The root directory plus id's interned path. Logs an error and returns
+	// false if id has no path
+	bool GetFullPath(AssetId id, std::string& outPath) const;
+	std::shared_ptr<AssetRequest> MakeReadyRequest(AssetId id, AssetPtr asset, size_t type);
+
+	void Add(AssetId id, AssetPtr asset, size_t type);
+	// Takes the entry in slot index out of the table
+	void Remove(size_t index);
+	// Doubles the size of the table
+	void Grow();
+	// Evicts unused assets, least recently used first, until the cache is
+	// within budget or everything left is in use
+	void Evict();
+	// Finalizes the requests whose data has come in, once each
+	void FinalizeLoaded();
+	// Moves what the workers have loaded over to mFinalizing
+	void TakeLoaded();
+
+	std::shared_ptr<AssetRequest> StartLoad(AssetId id, const std::string& path, AssetPtr asset, size_t type);
+	void Finish(AssetRequest& request, bool succeeded);
+
+	// The size is always a power of two
+	std::vector<Entry> mEntries;
+	size_t mNumEntries;
+	// 64 minus log2 of the table size
+	size_t mSlotShift;
+	// Asynchronous loads, until they finish
+	std::unordered_map<AssetId, std::shared_ptr<AssetRequest>> mPending;
+	// Requests whose data has loaded, waiting on Finalize. A request is
+	// taken off while it's being finalized, so Finalize can wait on others
+	std::deque<std::shared_ptr<AssetRequest>> mFinalizing;
+	// Workers add requests here as their data loads, for Update to pick up
+	std::vector<std::shared_ptr<AssetRequest>> mLoaded;
+	std::mutex mLoadedMutex;
+	std::vector<AssetTypeStats> mStats;
+	size_t mMemoryBudget;
+	size_t mMemoryUsed;
+	uint64_t mUseClock;
 	Game& mGame;
 	const char* mRoot;
 };
+
+template <typename T>
+std::shared_ptr<T> AssetFuture<T>::Wait() const
+{
+	if (mRequest)
+	{
+		mRequest->mCache.Wait(*mRequest);
+	}
+	return Get();
+}
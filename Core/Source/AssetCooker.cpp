@@ -0,0 +1,507 @@
+#include "ITPEnginePCH.h"
+#include "AssetCooker.h"
+#include <SDL/SDL_log.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+	// Levels are still JSON once they're cooked, just without the whitespace
+	const uint32_t LEVEL_COOKED_VERSION = 1;
+
+	const char* MANIFEST_NAME = "cook.manifest";
+
+	// Everything in these gets packed
+	const char* PACK_DIRECTORIES[] =
+	{
+		"Levels/", "Meshes/", "Anims/", "Textures/", "Shaders/", "Fonts/", "Sounds/",
+	};
+
+	// Every kind of asset that has a cooked format
+	struct CookType
+	{
+		const char* mDirectory;
+		const char* mExtension;
+		// Changing this cooks everything of the type again
+		uint32_t mVersion;
+		bool (*mCook)(const char* sourceFile);
+	};
+
+	const CookType COOK_TYPES[] =
+	{
+		{ "Meshes/", ".itpmesh2", MeshFormat::COOKED_VERSION, &AssetCooker::CookMesh },
+		{ "Anims/", ".itpanim2", AnimFormat::COOKED_VERSION, &AssetCooker::CookAnimation },
+		{ "Anims/", ".itpskel", SkeletonFormat::COOKED_VERSION, &AssetCooker::CookSkeleton },
+		{ "Sounds/", ".wav", SOUND_COOKED_VERSION, &AssetCooker::CookSound },
+		{ "Levels/", ".itplevel", LEVEL_COOKED_VERSION, &AssetCooker::CookLevel },
+	};
+
+	enum CookResult
+	{
+		COOK_FAILED,
+		COOK_DONE,
+		// The source hasn't changed since it was last cooked
+		COOK_UP_TO_DATE
+	};
+
+	struct CookJob
+	{
+		std::string mFile;
+		const CookType* mType;
+		uint64_t mHash;
+		CookResult mResult;
+		double mMs;
+	};
+
+	// What was cooked last time, by source file
+	struct ManifestEntry
+	{
+		uint64_t mHash;
+		uint32_t mVersion;
+	};
+	typedef std::unordered_map<std::string, ManifestEntry> Manifest;
+
+	// Appends the files in directory that end in extension to outFiles
+	void FindFiles(const std::string& directory, const char* extension, std::vector<std::string>& outFiles)
+	{
+		size_t extensionLength = strlen(extension);
+#ifdef _WIN32
+		WIN32_FIND_DATAA findData;
+		HANDLE find = FindFirstFileA((directory + "*" + extension).c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		do
+		{
+			std::string name(findData.cFileName);
+			// *.ext also matches longer extensions that start the same way
+			if (name.size() > extensionLength && name.compare(name.size() - extensionLength, extensionLength, extension) == 0)
+			{
+				outFiles.emplace_back(directory + name);
+			}
+		} while (FindNextFileA(find, &findData));
+		FindClose(find);
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir == nullptr)
+		{
+			return;
+		}
+		while (dirent* entry = readdir(dir))
+		{
+			std::string name(entry->d_name);
+			if (name.size() > extensionLength && name.compare(name.size() - extensionLength, extensionLength, extension) == 0)
+			{
+				outFiles.emplace_back(directory + name);
+			}
+		}
+		closedir(dir);
+#endif
+	}
+
+	bool IsFile(const std::string& fileName)
+	{
+		struct stat info;
+		return stat(fileName.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFREG;
+	}
+
+	bool EndsWith(const char* str, const char* suffix)
+	{
+		size_t length = strlen(str);
+		size_t suffixLength = strlen(suffix);
+		return length >= suffixLength && strcmp(str + length - suffixLength, suffix) == 0;
+	}
+
+	const CookType* FindType(const char* file)
+	{
+		for (auto& type : COOK_TYPES)
+		{
+			if (EndsWith(file, type.mExtension))
+			{
+				return &type;
+			}
+		}
+		return nullptr;
+	}
+
+	// A 64 bit hash of the file's contents, a word at a time since the
+	// biggest sources are megabytes. Returns 0 if it can't be read
+	uint64_t HashFile(const char* fileName)
+	{
+		const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+		const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+		MappedFile file;
+		if (!file.Open(fileName))
+		{
+			return 0;
+		}
+
+		const unsigned char* data = static_cast<const unsigned char*>(file.GetData());
+		size_t size = file.GetSize();
+		uint64_t hash = PRIME2 ^ (size * PRIME1);
+		size_t i = 0;
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, data + i, sizeof(word));
+			hash ^= word * PRIME2;
+			hash = ((hash << 31) | (hash >> 33)) * PRIME1;
+		}
+		for (; i < size; i++)
+		{
+			hash ^= data[i] * PRIME1;
+			hash = ((hash << 23) | (hash >> 41)) * PRIME2;
+		}
+
+		// Mix the last words into every bit
+		hash ^= hash >> 33;
+		hash *= PRIME2;
+		hash ^= hash >> 29;
+		return hash != 0 ? hash : 1;
+	}
+
+	// The manifest is a line with the cooker version, then a line for each
+	// source: its hash, the version it was cooked to, and its path. If the
+	// cooker version has changed, it's as good as empty
+	void ReadManifest(const std::string& fileName, Manifest& outManifest)
+	{
+		std::ifstream file(fileName);
+		uint32_t cookerVersion = 0;
+		std::string tag;
+		if (!(file >> tag >> cookerVersion) || tag != "itpcook" || cookerVersion != AssetCooker::COOKER_VERSION)
+		{
+			return;
+		}
+
+		std::string hash;
+		ManifestEntry entry;
+		std::string path;
+		while (file >> hash >> entry.mVersion && std::getline(file >> std::ws, path))
+		{
+			entry.mHash = strtoull(hash.c_str(), nullptr, 16);
+			outManifest[path] = entry;
+		}
+	}
+
+	void WriteManifest(const std::string& fileName, const std::vector<CookJob>& jobs)
+	{
+		std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+		file << "itpcook " << AssetCooker::COOKER_VERSION << "\n";
+		for (auto& job : jobs)
+		{
+			// Anything that failed is left out, so it's tried again next time
+			if (job.mResult != COOK_FAILED)
+			{
+				char hash[17];
+				snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(job.mHash));
+				file << hash << " " << job.mType->mVersion << " " << job.mFile << "\n";
+			}
+		}
+		if (file.fail())
+		{
+			std::cout << "Couldn't write " << fileName << std::endl;
+		}
+	}
+
+	// True if job's source is the same as when it was cooked, and what it
+	// was cooked to is still there
+	bool IsUpToDate(const CookJob& job, const Manifest& manifest)
+	{
+		auto iter = manifest.find(job.mFile);
+		if (iter == manifest.end() || iter->second.mHash != job.mHash || iter->second.mVersion != job.mType->mVersion)
+		{
+			return false;
+		}
+
+		std::string cookedName = job.mFile + ".cooked";
+		struct stat cookedInfo;
+		if (stat(cookedName.c_str(), &cookedInfo) != 0)
+		{
+			return false;
+		}
+
+		// The source may still be newer than the cooked file if it's been
+		// saved or checked out without changing, which would make the
+		// loaders ignore the cooked file, so bring that up to date too
+		struct stat sourceInfo;
+		if (stat(job.mFile.c_str(), &sourceInfo) == 0 && sourceInfo.st_mtime > cookedInfo.st_mtime)
+		{
+			utime(cookedName.c_str(), nullptr);
+		}
+		return true;
+	}
+
+	// Cooks every job that isn't in the manifest as it is, or all of them
+	// if there's no manifest, across all the cores, then prints how it went.
+	// Returns the number that failed
+	int RunJobs(std::vector<CookJob>& jobs, const Manifest* manifest)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		JobSystem jobSystem;
+		JobCounter counter(0);
+		for (auto& job : jobs)
+		{
+			CookJob* cookJob = &job;
+			jobSystem.Submit([cookJob, manifest]()
+			{
+				auto jobStart = std::chrono::high_resolution_clock::now();
+				if (manifest)
+				{
+					cookJob->mHash = HashFile(cookJob->mFile.c_str());
+				}
+
+				if (manifest && cookJob->mHash != 0 && IsUpToDate(*cookJob, *manifest))
+				{
+					cookJob->mResult = COOK_UP_TO_DATE;
+				}
+				else
+				{
+					cookJob->mResult = cookJob->mType->mCook(cookJob->mFile.c_str()) ? COOK_DONE : COOK_FAILED;
+				}
+				cookJob->mMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - jobStart).count();
+			}, &counter);
+		}
+		jobSystem.Wait(counter);
+
+		int failed = 0;
+		int upToDate = 0;
+		for (auto& job : jobs)
+		{
+			if (job.mResult == COOK_UP_TO_DATE)
+			{
+				upToDate++;
+				continue;
+			}
+			if (job.mResult == COOK_FAILED)
+			{
+				failed++;
+			}
+			std::cout << "  " << job.mFile << ": " << (job.mResult == COOK_DONE ? "cooked" : "FAILED") << " (" << job.mMs << " ms)" << std::endl;
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		std::cout << "Cooked " << jobs.size() - failed - upToDate << " of " << jobs.size() << " assets, " << upToDate
+			<< " up to date, " << failed << " failed (" << ms << " ms)" << std::endl;
+		return failed;
+	}
+}
+
+namespace AssetCooker
+{
+	bool CookMesh(const char* sourceFile)
+	{
+		MeshFormat::MeshData data;
+		if (!MeshFormat::ReadJson(sourceFile, data))
+		{
+			return false;
+		}
+
+		std::string cookedName(sourceFile);
+		cookedName += ".cooked";
+		return MeshFormat::WriteCooked(cookedName.c_str(), data);
+	}
+
+	bool CookAnimation(const char* sourceFile)
+	{
+		AnimFormat::AnimData data;
+		if (!AnimFormat::ReadJson(sourceFile, data))
+		{
+			return false;
+		}
+
+		std::vector<char> clip;
+		AnimFormat::Compress(data, AnimFormat::Tolerance(), clip);
+
+		std::string cookedName(sourceFile);
+		cookedName += ".cooked";
+		return AnimFormat::WriteCooked(cookedName.c_str(), clip);
+	}
+
+	bool CookSkeleton(const char* sourceFile)
+	{
+		std::vector<SkeletonFormat::Bone> bones;
+		if (!SkeletonFormat::ReadJson(sourceFile, bones))
+		{
+			return false;
+		}
+
+		std::vector<Matrix4> invBindPoses;
+		SkeletonFormat::ComputeGlobalInvBindPoses(bones, invBindPoses);
+
+		std::string cookedName(sourceFile);
+		cookedName += ".cooked";
+		return SkeletonFormat::WriteCooked(cookedName.c_str(), bones, invBindPoses);
+	}
+
+	bool CookSound(const char* sourceFile)
+	{
+		Sound sound;
+		if (!sound.Load(sourceFile, false))
+		{
+			return false;
+		}
+
+		std::string cookedName(sourceFile);
+		cookedName += ".cooked";
+		return sound.WriteCooked(cookedName.c_str());
+	}
+
+	bool CookLevel(const char* sourceFile)
+	{
+		JsonFile json;
+		if (!json.Load(sourceFile))
+		{
+			SDL_Log("File not found: Level %s", sourceFile);
+			return false;
+		}
+		rapidjson::Document& doc = json.GetDocument();
+
+		// The loader checks the rest as it spawns things
+		if (!doc.IsObject() || !doc.HasMember("metadata") || !doc["metadata"].IsObject() ||
+			!doc["metadata"].HasMember("type") || !doc["metadata"]["type"].IsString() ||
+			strcmp(doc["metadata"]["type"].GetString(), "itplevel") != 0)
+		{
+			SDL_Log("Level %s unknown format", sourceFile);
+			return false;
+		}
+
+		rapidjson::StringBuffer buffer;
+		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+		doc.Accept(writer);
+
+		std::string cookedName(sourceFile);
+		cookedName += ".cooked";
+		std::ofstream file(cookedName, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write(buffer.GetString(), buffer.GetSize());
+		if (file.fail())
+		{
+			SDL_Log("Couldn't write cooked level %s", cookedName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	int CookAll(const char* rootDirectory, bool force)
+	{
+		std::vector<std::string> files;
+		std::vector<const CookType*> types;
+		for (auto& type : COOK_TYPES)
+		{
+			// Directories aren't listed in any particular order, so sort
+			// them to keep the output and manifest the same from run to run
+			size_t first = files.size();
+			FindFiles(std::string(rootDirectory) + type.mDirectory, type.mExtension, files);
+			std::sort(files.begin() + first, files.end());
+			types.resize(files.size(), &type);
+		}
+
+		std::vector<CookJob> jobs(files.size());
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			jobs[i].mFile = files[i];
+			jobs[i].mType = types[i];
+			jobs[i].mHash = 0;
+			jobs[i].mResult = COOK_FAILED;
+			jobs[i].mMs = 0.0;
+		}
+
+		std::string manifestName = std::string(rootDirectory) + MANIFEST_NAME;
+		Manifest manifest;
+		if (!force)
+		{
+			ReadManifest(manifestName, manifest);
+		}
+
+		int failed = RunJobs(jobs, &manifest);
+		WriteManifest(manifestName, jobs);
+		return failed;
+	}
+
+	int CookFiles(const char* const* files, int numFiles)
+	{
+		std::vector<CookJob> jobs;
+		int failed = 0;
+		for (int i = 0; i < numFiles; i++)
+		{
+			const CookType* type = FindType(files[i]);
+			if (type == nullptr)
+			{
+				std::cout << "  " << files[i] << ": no cooked format for this type of asset" << std::endl;
+				failed++;
+				continue;
+			}
+
+			CookJob job;
+			job.mFile = files[i];
+			job.mType = type;
+			job.mHash = 0;
+			job.mResult = COOK_FAILED;
+			job.mMs = 0.0;
+			jobs.emplace_back(job);
+		}
+		return failed + RunJobs(jobs, nullptr);
+	}
+
+	bool Pack(const char* rootDirectory, const char* archiveName)
+	{
+		std::string root(rootDirectory);
+		std::vector<PackFormat::SourceFile> sources;
+		size_t totalSize = 0;
+		for (auto& directory : PACK_DIRECTORIES)
+		{
+			std::vector<std::string> files;
+			FindFiles(root + directory, "", files);
+			std::sort(files.begin(), files.end());
+			for (auto& file : files)
+			{
+				// Cooked files are packed in place of their sources
+				if (!IsFile(file) || EndsWith(file.c_str(), ".cooked"))
+				{
+					continue;
+				}
+
+				PackFormat::SourceFile source;
+				source.mName = file.substr(root.size());
+				source.mFileName = file;
+				std::string cookedName = Asset::GetCookedFileName(file.c_str());
+				if (!cookedName.empty())
+				{
+					source.mName += ".cooked";
+					source.mFileName = cookedName;
+				}
+				// Sounds are streamed from where they are in the archive,
+				// which they couldn't be if they had to be decompressed
+				source.mCompress = !EndsWith(file.c_str(), ".wav");
+
+				struct stat info;
+				if (stat(source.mFileName.c_str(), &info) == 0)
+				{
+					totalSize += static_cast<size_t>(info.st_size);
+				}
+				sources.emplace_back(source);
+			}
+		}
+
+		if (!PackFormat::Write(archiveName, sources))
+		{
+			std::cout << "Couldn't pack " << archiveName << std::endl;
+			return false;
+		}
+
+		struct stat info;
+		size_t archiveSize = stat(archiveName, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+		std::cout << "Packed " << sources.size() << " files (" << totalSize / 1024 << " KB) into " << archiveName
+			<< " (" << archiveSize / 1024 << " KB)" << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,55 @@
+// AssetCooker.h
+// Cooks source assets into the formats the loaders can use without
+// parsing, and writes each one next to its source with ".cooked" on the
+// end (see Asset::GetCookedFileName). Loaders fall back on the source
+// whenever there's no cooked file, or it's older than the source.
+//
+// CookAll keeps a manifest in the root directory with the hash of every
+// source it cooked and the version of the format it was cooked to, and
+// skips any source whose contents and format haven't changed since, so
+// only what's been edited gets cooked again. Files are cooked in parallel.
+//
+// Run the game with -cook [files] to cook the given files, or every
+// asset that has a cooked format if there are none, or -pack to cook
+// them and pack all the assets into Assets.itppak. Tools/AssetCooker
+// builds the same thing as a command line tool that doesn't need the
+// rest of the engine, so assets can be cooked on a build machine
+
+#pragma once
+#include <cstdint>
+
+namespace AssetCooker
+{
+	// Bump this to cook everything again, such as after a change to the
+	// cooker that isn't part of any one format
+	const uint32_t COOKER_VERSION = 1;
+
+	// Cooks one .itpmesh2 mesh
+	bool CookMesh(const char* sourceFile);
+
+	// Compresses one .itpanim2 animation
+	bool CookAnimation(const char* sourceFile);
+
+	// Cooks one .itpskel skeleton, with its inverse bind poses worked out
+	bool CookSkeleton(const char* sourceFile);
+
+	// Converts one .wav sound to 16 bit, trims it and stores its analysis
+	bool CookSound(const char* sourceFile);
+
+	// Checks one .itplevel level and writes it out without the whitespace
+	bool CookLevel(const char* sourceFile);
+
+	// Cooks every asset under rootDirectory that has a cooked format and
+	// has changed since the last time, and prints how each went. force
+	// cooks them all regardless. Returns the number that failed
+	int CookAll(const char* rootDirectory, bool force = false);
+
+	// Cooks each file by its extension, whether it's changed or not.
+	// Returns the number that failed
+	int CookFiles(const char* const* files, int numFiles);
+
+	// Packs every asset under rootDirectory into one archive for the
+	// FileSystem to mount, with the cooked version of anything that has an
+	// up to date one instead of its source, so cook them first
+	bool Pack(const char* rootDirectory, const char* archiveName);
+}
@@ -0,0 +1,48 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	// Every interned path, by ID. Entries are never removed, so the
+	// strings stay where they are once they're in
+	std::unordered_map<AssetId, std::string> sPaths;
+	std::mutex sPathsMutex;
+}
+
+AssetId AssetId::Intern(const char* path)
+{
+	AssetId id(path);
+
+	std::lock_guard<std::mutex> lock(sPathsMutex);
+	auto iter = sPaths.find(id);
+	if (iter == sPaths.end())
+	{
+		sPaths.emplace(id, path);
+	}
+	else if (!SamePath(iter->second.c_str(), path))
+	{
+		SDL_Log("AssetId: %s and %s have the same ID. Rename one of them.", iter->second.c_str(), path);
+	}
+	return id;
+}
+
+bool AssetId::SamePath(const char* a, const char* b)
+{
+	for (; *a != '\0' && *b != '\0'; a++, b++)
+	{
+		if (Fold(*a) != Fold(*b))
+		{
+			return false;
+		}
+	}
+	return *a == *b;
+}
+
+const char* AssetId::GetPath() const
+{
+	std::lock_guard<std::mutex> lock(sPathsMutex);
+	auto iter = sPaths.find(*this);
+	return iter != sPaths.end() ? iter->second.c_str() : nullptr;
+}
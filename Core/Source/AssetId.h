@@ -0,0 +1,82 @@
+// AssetId.h
+// An asset's path relative to the asset root, hashed to 64 bits. The
+// asset cache is keyed on these, so finding an asset that's already
+// loaded doesn't need to build or compare any strings. The hash can be
+// worked out at compile time, so an ID for a fixed path costs nothing:
+// constexpr AssetId DEFAULT_TEXTURE("Textures/Default.png");
+// (though the path still has to be interned before it can be loaded by
+// the ID alone, see below)
+//
+// Case and slash direction don't change the ID, so "Meshes\Cube.itpmesh2"
+// and "meshes/cube.itpmesh2" are the same asset. The hash is 64 bit
+// FNV-1a of the path with those folded, which is the same on every
+// platform, so IDs can be written into cooked files as they are.
+//
+// Loading an asset by ID needs its path, so paths are interned: the
+// first time a path is loaded, the cache remembers it for that ID, and
+// AssetId::Intern does the same for a path read from a cooked file.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+class AssetId
+{
+public:
+	constexpr AssetId() :mHash(0) { }
+	constexpr AssetId(const char* path) :mHash(Hash(path, FNV_OFFSET)) { }
+
+	// An ID as it was written into a cooked file
+	static constexpr AssetId FromHash(uint64_t hash) { return AssetId(hash, 0); }
+
+	constexpr uint64_t GetHash() const { return mHash; }
+	// False for a default constructed ID, which no path hashes to
+	constexpr bool IsValid() const { return mHash != 0; }
+
+	constexpr bool operator==(const AssetId& other) const { return mHash == other.mHash; }
+	constexpr bool operator!=(const AssetId& other) const { return mHash != other.mHash; }
+
+	// Remembers path as the path for its ID, and returns the ID. Logs an
+	// error if a different path already has the same ID
+	static AssetId Intern(const char* path);
+	// The path interned for this ID, or null if there isn't one
+	const char* GetPath() const;
+private:
+	static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+	static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+	constexpr AssetId(uint64_t hash, int) :mHash(hash) { }
+
+	// True if a and b are the same path once case and slashes are folded
+	static bool SamePath(const char* a, const char* b);
+
+	static constexpr uint8_t Fold(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? static_cast<uint8_t>(c - 'A' + 'a') :
+			c == '\\' ? static_cast<uint8_t>('/') : static_cast<uint8_t>(c);
+	}
+	// Zero is kept for invalid IDs, so a path that hashes to it gets 1 instead
+	static constexpr uint64_t Hash(const char* path, uint64_t hash)
+	{
+		return *path != '\0' ? Hash(path + 1, (hash ^ Fold(*path)) * FNV_PRIME) :
+			hash != 0 ? hash : 1;
+	}
+
+	uint64_t mHash;
+};
+
+static_assert(sizeof(AssetId) == sizeof(uint64_t) && std::is_trivially_copyable<AssetId>::value,
+	"AssetId is written to cooked files as a uint64_t");
+
+namespace std
+{
+	template <>
+	struct hash<AssetId>
+	{
+		size_t operator()(const AssetId& id) const
+		{
+			return static_cast<size_t>(id.GetHash() ^ (id.GetHash() >> 32));
+		}
+	};
+}
@@ -0,0 +1,51 @@
+// AudioCommandQueue.h
+// Single producer / single consumer ring buffer used to pass
+// messages between the game thread and the mixer callback.
+// Neither side ever takes a lock, so the mixer can't be blocked
+// by the game thread (or vice versa)
+
+#pragma once
+#include <atomic>
+
+// capacity is the number of slots. One slot is always kept empty
+// to tell a full queue apart from an empty one
+template <typename T, unsigned int capacity>
+class AudioCommandQueue
+{
+public:
+	AudioCommandQueue() : head( 0 ), tail( 0 ) {}
+
+	// Producer only. Returns false if the queue is full
+	bool Push( const T& item )
+	{
+		unsigned int curTail = tail.load( std::memory_order_relaxed );
+		unsigned int next = ( curTail + 1 ) % capacity;
+		if ( next == head.load( std::memory_order_acquire ) )
+		{
+			return false;
+		}
+
+		items[curTail] = item;
+		tail.store( next, std::memory_order_release );
+		return true;
+	}
+
+	// Consumer only. Returns false if the queue is empty
+	bool Pop( T& outItem )
+	{
+		unsigned int curHead = head.load( std::memory_order_relaxed );
+		if ( curHead == tail.load( std::memory_order_acquire ) )
+		{
+			return false;
+		}
+
+		outItem = items[curHead];
+		head.store( ( curHead + 1 ) % capacity, std::memory_order_release );
+		return true;
+	}
+
+private:
+	T items[capacity];
+	std::atomic<unsigned int> head;
+	std::atomic<unsigned int> tail;
+};
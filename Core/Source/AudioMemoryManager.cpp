@@ -0,0 +1,212 @@
+#include "ITPEnginePCH.h"
+#include <algorithm>
+#include <iostream>
+
+AudioMemoryManager::AudioMemoryManager()
+	: budget( ( size_t ) AUDIO_MEMORY_BUDGET_MB * 1024 * 1024 ), compressThreshold( 1024 * 1024 )
+	, streamThreshold( 4 * 1024 * 1024 ), numEvictions( 0 ), lockSamples( false ), lockedBytes( 0 ), numLockFailures( 0 )
+{
+}
+
+void AudioMemoryManager::Register( SoundPtr sound )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	Record& record = records[sound.get()];
+	record.sound = sound;
+	record.lastPlayed = 0;
+	record.playCount = 0;
+	record.playing = 0;
+	record.lockedAddress = 0;
+	record.lockedBytes = 0;
+}
+
+void AudioMemoryManager::OnPlay( const Sound* sound, U64 clock )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	auto iter = records.find( sound );
+	if ( iter != records.end() )
+	{
+		iter->second.lastPlayed = clock;
+		iter->second.playCount++;
+		iter->second.playing++;
+	}
+}
+
+void AudioMemoryManager::OnFinish( const Sound* sound )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	auto iter = records.find( sound );
+	if ( iter != records.end() && iter->second.playing > 0 )
+	{
+		iter->second.playing--;
+	}
+}
+
+void AudioMemoryManager::Update()
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	size_t total = SumResidentBytes();
+	if ( total <= budget )
+	{
+		return;
+	}
+
+	// Only sounds nothing is playing can go, oldest first
+	std::vector<Record*> candidates;
+	for ( auto& pair : records )
+	{
+		Record& record = pair.second;
+		if ( record.playing == 0 && record.sound->GetState() == SOUND_READY && record.sound->GetMemorySize() > 0 )
+		{
+			candidates.push_back( &record );
+		}
+	}
+	std::sort( candidates.begin(), candidates.end(), []( const Record* a, const Record* b )
+	{
+		return a->lastPlayed < b->lastPlayed;
+	} );
+
+	for ( Record* record : candidates )
+	{
+		if ( total <= budget )
+		{
+			break;
+		}
+		total -= record->sound->GetMemorySize();
+		Unlock( *record );
+		record->sound->Evict();
+		numEvictions++;
+	}
+}
+
+SoundStorage AudioMemoryManager::ChooseStorage( const Sound& sound )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	size_t size = sound.count * sizeof( PCM16 );
+
+	// Sounds that are played all the time are worth keeping ready to mix.
+	// The count survives eviction, so this counts plays before a reload
+	auto iter = records.find( &sound );
+	if ( iter != records.end() && iter->second.playCount >= AUDIO_FREQUENT_PLAYS && SumResidentBytes() + size <= budget )
+	{
+		return STORAGE_RESIDENT;
+	}
+
+	if ( size >= streamThreshold )
+	{
+		return STORAGE_STREAMED;
+	}
+	if ( size >= compressThreshold || SumResidentBytes() + size > budget )
+	{
+		return STORAGE_COMPRESSED;
+	}
+	return STORAGE_RESIDENT;
+}
+
+void AudioMemoryManager::OnLoaded( const Sound& sound )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	auto iter = records.find( &sound );
+	if ( !lockSamples || iter == records.end() )
+	{
+		return;
+	}
+
+	// Streams are read into their own buffers as they play, so there's
+	// nothing of theirs to lock here
+	const void* address = sound.storage == STORAGE_COMPRESSED ? ( const void* ) sound.compressed.data() : ( const void* ) sound.data;
+	size_t bytes = sound.GetMemorySize();
+	if ( address == 0 || bytes == 0 )
+	{
+		return;
+	}
+
+	int error = AudioThread::LockMemory( address, bytes );
+	if ( error != 0 )
+	{
+		// Only the first, since the rest will most likely fail the same way.
+		// GetNumLockFailures has the count
+		if ( numLockFailures++ == 0 )
+		{
+			std::cout << "Couldn't lock the samples of " << sound.path << " into memory (" <<
+				AudioThread::GetErrorString( error ) << "), so they play unlocked" << std::endl;
+		}
+		return;
+	}
+	iter->second.lockedAddress = address;
+	iter->second.lockedBytes = bytes;
+	lockedBytes += bytes;
+}
+
+void AudioMemoryManager::SetLockSamples( bool lock )
+{
+	std::lock_guard<std::mutex> guard( mutex );
+	lockSamples = lock;
+}
+
+size_t AudioMemoryManager::GetLockedBytes() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return lockedBytes;
+}
+
+U32 AudioMemoryManager::GetNumLockFailures() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return numLockFailures;
+}
+
+void AudioMemoryManager::SetBudget( size_t bytes )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	budget = bytes;
+}
+
+size_t AudioMemoryManager::GetBudget() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return budget;
+}
+
+void AudioMemoryManager::SetThresholds( size_t compressAt, size_t streamAt )
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	compressThreshold = compressAt;
+	streamThreshold = streamAt;
+}
+
+size_t AudioMemoryManager::GetResidentBytes() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return SumResidentBytes();
+}
+
+U32 AudioMemoryManager::GetNumEvictions() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return numEvictions;
+}
+
+void AudioMemoryManager::Unlock( Record& record )
+{
+	if ( record.lockedBytes > 0 )
+	{
+		AudioThread::UnlockMemory( record.lockedAddress, record.lockedBytes );
+		lockedBytes -= record.lockedBytes;
+		record.lockedAddress = 0;
+		record.lockedBytes = 0;
+	}
+}
+
+size_t AudioMemoryManager::SumResidentBytes() const
+{
+	size_t total = 0;
+	for ( const auto& pair : records )
+	{
+		if ( pair.second.sound->GetState() == SOUND_READY )
+		{
+			total += pair.second.sound->GetMemorySize();
+		}
+	}
+	return total;
+}
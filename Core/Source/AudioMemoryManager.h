@@ -0,0 +1,85 @@
+// AudioMemoryManager.h
+// Keeps the memory held by sound samples within a budget. It decides how each
+// sound is stored when it loads (resident, compressed or streamed) from its
+// size and how often it's played, and evicts the least recently played sounds
+// that aren't playing when the total goes over the budget
+
+#pragma once
+#include "Sound.h"
+#include <mutex>
+#include <unordered_map>
+
+// Default budget in megabytes. Platforms override it in their build settings,
+// or define AUDIO_LOW_MEMORY for a smaller default
+#ifndef AUDIO_MEMORY_BUDGET_MB
+#if AUDIO_LOW_MEMORY
+#define AUDIO_MEMORY_BUDGET_MB 16
+#else
+#define AUDIO_MEMORY_BUDGET_MB 128
+#endif
+#endif
+
+// Sounds played at least this many times stay resident whatever their size
+#define AUDIO_FREQUENT_PLAYS 8
+
+class AudioMemoryManager
+{
+public:
+	AudioMemoryManager();
+
+	// Game thread. Every sound the AudioSystem loads is tracked from here on
+	void Register( SoundPtr sound );
+	void OnPlay( const Sound* sound, U64 clock );
+	void OnFinish( const Sound* sound );
+	// Evicts until the resident total is back within the budget
+	void Update();
+
+	// Loader thread. Picks the storage for a sound that has just loaded
+	SoundStorage ChooseStorage( const Sound& sound );
+	// Loader thread. Called once the sound's storage is set, to lock its
+	// samples if SetLockSamples is on
+	void OnLoaded( const Sound& sound );
+
+	// Locks the samples of every resident or compressed sound that loads
+	// from now on into memory, until it's evicted, so the mixer never waits
+	// on a page fault reading them. A sound that can't be locked (over the
+	// OS lock limit, say) is reported and plays anyway
+	void SetLockSamples( bool lock );
+	size_t GetLockedBytes() const;
+	U32 GetNumLockFailures() const;
+
+	void SetBudget( size_t bytes );
+	size_t GetBudget() const;
+	// Sounds of at least compressAt bytes (decoded) are kept compressed and
+	// sounds of at least streamAt bytes are streamed, unless played often
+	void SetThresholds( size_t compressAt, size_t streamAt );
+
+	// Bytes of samples held by every loaded sound
+	size_t GetResidentBytes() const;
+	U32 GetNumEvictions() const;
+
+private:
+	struct Record
+	{
+		SoundPtr sound;
+		U64 lastPlayed;
+		U32 playCount;
+		int playing;
+		// The samples locked into memory, if any
+		const void* lockedAddress;
+		size_t lockedBytes;
+	};
+
+	size_t SumResidentBytes() const;
+	void Unlock( Record& record );
+
+	std::unordered_map<const Sound*, Record> records;
+	size_t budget;
+	size_t compressThreshold;
+	size_t streamThreshold;
+	U32 numEvictions;
+	bool lockSamples;
+	size_t lockedBytes;
+	U32 numLockFailures;
+	mutable std::mutex mutex;
+};
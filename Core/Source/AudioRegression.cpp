@@ -0,0 +1,647 @@
+#include "ITPEnginePCH.h"
+#include "AudioRegression.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+namespace
+{
+	// Parameters stretch over one mix block, so each block size renders
+	// differently and has goldens of its own
+	struct Configuration
+	{
+		// Also names the goldens, so it should suit a file name
+		std::string name;
+		int blockFrames;
+		// Largest difference from the golden allowed in any sample, in 16 bit
+		// steps. 0 means bit exact. Builds whose floating point differs (a SIMD
+		// path against a scalar one, another compiler) may need a few steps
+		int tolerance;
+		// Surround layouts mix through the surround bus and render one channel
+		// per speaker
+		SpeakerLayout speakers;
+		// The scenarios rendered in this configuration. Empty means all of them
+		std::vector<std::string> scenarios;
+	};
+
+	struct Result
+	{
+		// Wall clock time spent in Render
+		double renderSeconds;
+		U64 frames;
+		int channels;
+	};
+
+	// Events are sorted by clock, and ties keep their order in the file
+	struct Event
+	{
+		U64 clock;
+		const rapidjson::Value* properties;
+	};
+
+	bool ReadGolden( const std::string& path, int channels, std::vector<PCM16>& outSamples )
+	{
+		std::ifstream file( path, std::ios::in | std::ios::binary );
+		if ( !file )
+		{
+			return false;
+		}
+
+		// Goldens are always written by WriteGolden, so the header is the plain
+		// 44 byte one: 16 bit PCM at SAMPLE_RATE
+		unsigned char header[44];
+		file.read( ( char* ) header, sizeof( header ) );
+		U32 rate = header[24] | ( header[25] << 8 ) | ( header[26] << 16 ) | ( header[27] << 24 );
+		U32 bytes = header[40] | ( header[41] << 8 ) | ( header[42] << 16 ) | ( header[43] << 24 );
+		if ( !file || memcmp( header, "RIFF", 4 ) != 0 || memcmp( header + 8, "WAVE", 4 ) != 0 ||
+			header[22] != channels || header[34] != 16 || rate != SAMPLE_RATE || memcmp( header + 36, "data", 4 ) != 0 )
+		{
+			std::cout << "Golden " << path << " isn't a 16 bit " << channels << " channel WAV at " << SAMPLE_RATE << "Hz" << std::endl;
+			return false;
+		}
+
+		outSamples.resize( bytes / sizeof( PCM16 ) );
+		file.read( ( char* ) outSamples.data(), outSamples.size() * sizeof( PCM16 ) );
+		return !file.fail();
+	}
+
+	bool WriteGolden( const std::string& path, int channels, const std::vector<PCM16>& samples )
+	{
+		std::ofstream file( path, std::ios::out | std::ios::binary );
+		if ( !file )
+		{
+			return false;
+		}
+
+		U32 bytes = ( U32 ) ( samples.size() * sizeof( PCM16 ) );
+		auto write32 = [&file]( U32 value ) { file.write( ( const char* ) &value, 4 ); };
+		auto write16 = [&file]( U16 value ) { file.write( ( const char* ) &value, 2 ); };
+		file.write( "RIFF", 4 );
+		write32( 36 + bytes );
+		file.write( "WAVEfmt ", 8 );
+		write32( 16 );
+		write16( 1 );
+		write16( ( U16 ) channels );
+		write32( SAMPLE_RATE );
+		write32( SAMPLE_RATE * channels * sizeof( PCM16 ) );
+		write16( ( U16 ) ( channels * sizeof( PCM16 ) ) );
+		write16( 16 );
+		file.write( "data", 4 );
+		write32( bytes );
+		file.write( ( const char* ) samples.data(), bytes );
+		return !file.fail();
+	}
+
+	SoundStorage GetStorage( const rapidjson::Value& properties )
+	{
+		// Streams fill on the loader thread as the mix runs, which no longer
+		// depends only on the calls made, so scenarios don't stream
+		std::string storage;
+		GetStringFromJSON( properties, "storage", storage );
+		return storage == "compressed" ? STORAGE_COMPRESSED : STORAGE_RESIDENT;
+	}
+
+	RampShape GetShape( const rapidjson::Value& properties )
+	{
+		std::string shape;
+		GetStringFromJSON( properties, "shape", shape );
+		return shape == "exponential" ? RAMP_EXPONENTIAL : RAMP_LINEAR;
+	}
+
+	void ApplyEvent( AudioSystem& audio, const Event& event, std::unordered_map<std::string, VoiceHandle>& voices )
+	{
+		const rapidjson::Value& properties = *event.properties;
+		std::string action, voiceName;
+		GetStringFromJSON( properties, "action", action );
+		GetStringFromJSON( properties, "voice", voiceName );
+		VoiceHandle voice = voices[voiceName];
+
+		float value = 0.0f;
+		GetFloatFromJSON( properties, "value", value );
+		int bus = 0;
+		GetIntFromJSON( properties, "bus", bus );
+
+		if ( action == "play" )
+		{
+			std::string sound;
+			float volume = 1.0f;
+			bool loop = false;
+			GetStringFromJSON( properties, "sound", sound );
+			GetFloatFromJSON( properties, "volume", volume );
+			GetBoolFromJSON( properties, "loop", loop );
+			voices[voiceName] = audio.PlayAt( audio.LoadSoundAsync( sound.c_str(), GetStorage( properties ) ), event.clock, volume, loop );
+		}
+		else if ( action == "stop" )
+		{
+			audio.StopAt( voice, event.clock );
+		}
+		else if ( action == "volume" )
+		{
+			audio.SetVolume( voice, value, GetShape( properties ) );
+		}
+		else if ( action == "pan" )
+		{
+			audio.SetPan( voice, value, GetShape( properties ) );
+		}
+		else if ( action == "master" )
+		{
+			audio.SetMasterVolume( value, GetShape( properties ) );
+		}
+		else if ( action == "lowpass" )
+		{
+			audio.SetLowPass( voice, value );
+		}
+		else if ( action == "highpass" )
+		{
+			audio.SetHighPass( voice, value );
+		}
+		else if ( action == "position" )
+		{
+			Vector3 position;
+			GetVectorFromJSON( properties, "position", position );
+			audio.SetPosition( voice, position );
+		}
+		else if ( action == "reverbPreset" )
+		{
+			std::string name;
+			ReverbPreset preset;
+			GetStringFromJSON( properties, "preset", name );
+			if ( ReverbBus::FindPreset( name, preset ) )
+			{
+				audio.SetReverbPreset( bus, preset );
+			}
+		}
+		else if ( action == "reverbSend" )
+		{
+			audio.SetReverbSend( bus, value );
+		}
+		else if ( action == "bypass" )
+		{
+			bool bypass = true;
+			GetBoolFromJSON( properties, "bypass", bypass );
+			audio.SetReverbBypass( voice, bypass );
+		}
+		else
+		{
+			std::cout << "Unknown audio test action " << action << std::endl;
+		}
+	}
+
+	// Renders scenario through a fresh offline AudioSystem, blockFrames at a time
+	Result Render( const rapidjson::Value& scenario, const Configuration& config, std::vector<PCM16>& outSamples )
+	{
+		AudioThreadConfig threadConfig;
+		threadConfig.realtime = false;
+		threadConfig.lockMemory = false;
+		AudioSystem audio( threadConfig, AUDIO_OUTPUT_OFFLINE, config.speakers );
+		audio.SetListener( Matrix4::Identity );
+
+		float seconds = 1.0f;
+		GetFloatFromJSON( scenario, "seconds", seconds );
+
+		std::vector<Event> events;
+		const rapidjson::Value& list = scenario["events"];
+		for ( rapidjson::SizeType i = 0; i < list.Size(); i++ )
+		{
+			float time = 0.0f;
+			GetFloatFromJSON( list[i], "time", time );
+			Event event;
+			event.clock = AudioSystem::SecondsToSamples( time );
+			event.properties = &list[i];
+			events.push_back( event );
+
+			// Everything is loaded up front, so no play waits on the loader
+			std::string sound;
+			if ( GetStringFromJSON( list[i], "sound", sound ) )
+			{
+				SoundPtr loading = audio.LoadSoundAsync( sound.c_str(), GetStorage( list[i] ) );
+				while ( loading->GetState() == SOUND_PENDING )
+				{
+					std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+				}
+			}
+		}
+		std::stable_sort( events.begin(), events.end(), []( const Event& a, const Event& b )
+		{
+			return a.clock < b.clock;
+		} );
+
+		Result result;
+		result.renderSeconds = 0.0;
+		result.frames = AudioSystem::SecondsToSamples( seconds );
+		result.channels = audio.GetOutputChannels();
+		outSamples.assign( ( size_t ) ( result.frames * result.channels ), 0 );
+
+		std::unordered_map<std::string, VoiceHandle> voices;
+		size_t next = 0;
+		for ( U64 clock = 0; clock < result.frames; )
+		{
+			int frames = ( int ) Math::Min( ( U64 ) config.blockFrames, result.frames - clock );
+
+			// Everything due by the end of this block goes in before it's mixed.
+			// Plays and stops land on their exact frame, the rest at the block start
+			while ( next < events.size() && events[next].clock < clock + frames )
+			{
+				ApplyEvent( audio, events[next++], voices );
+			}
+			audio.Update();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			audio.Render( &outSamples[( size_t ) ( clock * result.channels )], frames );
+			auto end = std::chrono::high_resolution_clock::now();
+			result.renderSeconds += std::chrono::duration<double>( end - start ).count();
+
+			clock += frames;
+		}
+		return result;
+	}
+
+	// SampleConvert kernels ----------------------------------------------
+
+	const char* GetSimdName( SimdLevel level )
+	{
+		return level == SIMD_AVX2 ? "AVX2" : level == SIMD_SSE2 ? "SSE2" : "Scalar";
+	}
+
+	const char* GetFormatName( SampleFormat format )
+	{
+		switch ( format )
+		{
+		case SAMPLE_PCM8: return "PCM8";
+		case SAMPLE_PCM16: return "PCM16";
+		case SAMPLE_PCM24: return "PCM24";
+		case SAMPLE_PCM32: return "PCM32";
+		default: return "Float32";
+		}
+	}
+
+	// Sample index of data, as an integer step or a float
+	double GetSample( const unsigned char* data, SampleFormat format, size_t index )
+	{
+		const unsigned char* p = data + index * SampleConvert::GetSampleSize( format );
+		switch ( format )
+		{
+		case SAMPLE_PCM8: return p[0] - 128;
+		case SAMPLE_PCM16: { PCM16 value; memcpy( &value, p, sizeof( value ) ); return value; }
+		case SAMPLE_PCM24: return ( ( int ) ( p[0] << 8 | p[1] << 16 | ( U32 ) p[2] << 24 ) ) >> 8;
+		case SAMPLE_PCM32: { int value; memcpy( &value, p, sizeof( value ) ); return value; }
+		default: { float value; memcpy( &value, p, sizeof( value ) ); return value; }
+		}
+	}
+
+	// Writes count samples of outFormat to the buffer it's given
+	typedef std::function<void( unsigned char* out )> Kernel;
+
+	// Runs kernel at SIMD_SCALAR and at level, each into a buffer with a sample
+	// of padding in front, so the output is misaligned, and a few samples past
+	// the end to catch overruns. Integer formats may be a step apart, where a
+	// kernel rounds a tie the other way, and floats tolerance apart (relative
+	// to samples bigger than 1), where the kernel adds in a different order
+	bool CheckKernel( SimdLevel level, const std::string& name, int count, SampleFormat outFormat, double tolerance, const Kernel& kernel )
+	{
+		const int padding = 8;
+		size_t sampleSize = SampleConvert::GetSampleSize( outFormat );
+		size_t total = count + padding + 1;
+		// Filled with a pattern that reads as a small float, so the kernels
+		// that add have something to add to
+		std::vector<unsigned char> expected( total * sampleSize, 0x3C );
+		std::vector<unsigned char> actual( total * sampleSize, 0x3C );
+
+		SampleConvert::SetSimdLevel( SIMD_SCALAR );
+		kernel( expected.data() + sampleSize );
+		SampleConvert::SetSimdLevel( level );
+		kernel( actual.data() + sampleSize );
+
+		bool integer = outFormat != SAMPLE_FLOAT32;
+		for ( size_t i = 0; i < total; i++ )
+		{
+			double want = GetSample( expected.data(), outFormat, i );
+			double got = GetSample( actual.data(), outFormat, i );
+			double allowed = integer ? 1.0 : tolerance * Math::Max( 1.0, fabs( want ) );
+			if ( !( fabs( got - want ) <= allowed ) )
+			{
+				std::cout << "  SampleConvert [" << GetSimdName( level ) << "] " << name << " x " << count << " FAILED, sample " <<
+					( int ) i - 1 << " is " << got << ", scalar gives " << want << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks every kernel at every SIMD level the CPU supports against the
+	// scalar one, on odd lengths that leave a tail after the last whole
+	// register, from misaligned input to misaligned output
+	void CheckSimdKernels( int& passed, int& failed )
+	{
+		const SampleFormat formats[] = { SAMPLE_PCM8, SAMPLE_PCM16, SAMPLE_PCM24, SAMPLE_PCM32, SAMPLE_FLOAT32 };
+		const int lengths[] = { 1, 3, 7, 9, 17, 31, 67, 257 };
+		const int maxFrames = 257;
+		const double tolerance = 1.0e-5;
+
+		// Noise a little past [-1, 1], so clipping is tested too, and some
+		// exact values and ties
+		std::vector<float> noise( maxFrames * MAX_DOWNMIX_CHANNELS + 1 );
+		U32 seed = 12345;
+		for ( size_t i = 0; i < noise.size(); i++ )
+		{
+			seed = seed * 1664525 + 1013904223;
+			noise[i] = ( seed >> 8 ) / ( float ) ( 1 << 24 ) * 2.2f - 1.1f;
+		}
+		const float exact[] = { 0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 0.5f / 32768.0f, 1.5f / 32768.0f, -2.5f / 128.0f };
+		for ( size_t i = 0; i < sizeof( exact ) / sizeof( exact[0] ); i++ )
+		{
+			noise[i * 29 + 1] = exact[i];
+		}
+		const float* source = noise.data() + 1;
+
+		// The same noise in every format, a sample past the start of the buffer
+		std::vector<unsigned char> encoded[SAMPLE_FLOAT32 + 1];
+		SampleConvert::SetSimdLevel( SIMD_SCALAR );
+		for ( SampleFormat format : formats )
+		{
+			size_t sampleSize = SampleConvert::GetSampleSize( format );
+			encoded[format].resize( ( noise.size() + 1 ) * sampleSize );
+			SampleConvert::FromFloat( source, encoded[format].data() + sampleSize, format, maxFrames * MAX_DOWNMIX_CHANNELS );
+		}
+
+		SimdLevel best = SIMD_SCALAR;
+		for ( int level = SIMD_SSE2; level <= SIMD_AVX2; level++ )
+		{
+			SampleConvert::SetSimdLevel( ( SimdLevel ) level );
+			best = Math::Max( best, SampleConvert::GetSimdLevel() );
+		}
+
+		for ( int l = SIMD_SSE2; l <= best; l++ )
+		{
+			SimdLevel level = ( SimdLevel ) l;
+			int levelFailed = 0;
+			auto check = [&]( const std::string& name, int count, SampleFormat outFormat, const Kernel& kernel )
+			{
+				if ( !CheckKernel( level, name, count, outFormat, tolerance, kernel ) )
+				{
+					levelFailed++;
+				}
+			};
+
+			for ( int frames : lengths )
+			{
+				for ( SampleFormat in : formats )
+				{
+					const unsigned char* raw = encoded[in].data() + SampleConvert::GetSampleSize( in );
+					check( std::string( "ToFloat " ) + GetFormatName( in ), frames, SAMPLE_FLOAT32, [&]( unsigned char* out )
+					{
+						SampleConvert::ToFloat( raw, in, ( float* ) out, frames );
+					} );
+					check( std::string( "FromFloat " ) + GetFormatName( in ), frames, in, [&]( unsigned char* out )
+					{
+						SampleConvert::FromFloat( source, out, in, frames );
+					} );
+					for ( SampleFormat outFormat : formats )
+					{
+						check( std::string( "Convert " ) + GetFormatName( in ) + " to " + GetFormatName( outFormat ), frames, outFormat,
+							[&]( unsigned char* out )
+						{
+							SampleConvert::Convert( raw, in, out, outFormat, frames );
+						} );
+					}
+				}
+
+				for ( int channels = 1; channels <= MAX_DOWNMIX_CHANNELS; channels++ )
+				{
+					std::string suffix = " " + std::to_string( channels ) + " channels";
+					const float* planes[MAX_DOWNMIX_CHANNELS];
+					for ( int c = 0; c < channels; c++ )
+					{
+						planes[c] = source + c * maxFrames;
+					}
+					check( "Interleave" + suffix, frames * channels, SAMPLE_FLOAT32, [&]( unsigned char* out )
+					{
+						SampleConvert::Interleave( planes, channels, ( float* ) out, frames );
+					} );
+					// Every plane is one buffer, a plane apart
+					check( "Deinterleave" + suffix, maxFrames * channels, SAMPLE_FLOAT32, [&]( unsigned char* out )
+					{
+						float* outPlanes[MAX_DOWNMIX_CHANNELS];
+						for ( int c = 0; c < channels; c++ )
+						{
+							outPlanes[c] = ( float* ) out + c * maxFrames;
+						}
+						SampleConvert::Deinterleave( source, channels, outPlanes, frames );
+					} );
+
+					float gains[MAX_DOWNMIX_CHANNELS];
+					float steps[MAX_DOWNMIX_CHANNELS];
+					for ( int c = 0; c < channels; c++ )
+					{
+						gains[c] = source[c] * 0.5f + 0.5f;
+						steps[c] = source[c + MAX_DOWNMIX_CHANNELS] / 512.0f;
+					}
+					check( "AddPanned" + suffix, frames * channels, SAMPLE_FLOAT32, [&]( unsigned char* out )
+					{
+						SampleConvert::AddPanned( source, ( float* ) out, channels, gains, steps, frames );
+					} );
+
+					if ( channels >= 2 )
+					{
+						check( "AddInterleaved" + suffix, frames * channels, SAMPLE_FLOAT32, [&]( unsigned char* out )
+						{
+							SampleConvert::AddInterleaved( source, source + maxFrames, ( float* ) out, channels, frames );
+						} );
+					}
+
+					// The standard matrices where there is one, and noise for every layout
+					for ( int outChannels = 1; outChannels <= MAX_DOWNMIX_CHANNELS; outChannels++ )
+					{
+						float matrix[MAX_DOWNMIX_CHANNELS * MAX_DOWNMIX_CHANNELS];
+						if ( !SampleConvert::GetDownmixMatrix( channels, outChannels, matrix ) )
+						{
+							memcpy( matrix, source + frames, sizeof( matrix ) );
+						}
+						check( "Downmix" + suffix + " to " + std::to_string( outChannels ), frames * outChannels, SAMPLE_FLOAT32,
+							[&]( unsigned char* out )
+						{
+							SampleConvert::Downmix( source, channels, ( float* ) out, outChannels, matrix, frames );
+						} );
+					}
+				}
+
+				check( "AddInterleaved stereo", frames * 2, SAMPLE_FLOAT32, [&]( unsigned char* out )
+				{
+					SampleConvert::AddInterleaved( source, source + maxFrames, ( float* ) out, frames );
+				} );
+				check( "MonoToStereo", frames * 2, SAMPLE_FLOAT32, [&]( unsigned char* out )
+				{
+					SampleConvert::MonoToStereo( source, ( float* ) out, frames );
+				} );
+				check( "StereoToMono", frames, SAMPLE_FLOAT32, [&]( unsigned char* out )
+				{
+					SampleConvert::StereoToMono( source, ( float* ) out, frames );
+				} );
+			}
+
+			if ( levelFailed == 0 )
+			{
+				std::cout << "  SampleConvert [" << GetSimdName( level ) << "] PASSED, every kernel matches scalar" << std::endl;
+				passed++;
+			}
+			else
+			{
+				failed++;
+			}
+		}
+
+		SampleConvert::SetSimdLevel( best );
+	}
+}
+
+bool AudioRegression::Run( const char* path, bool record )
+{
+	// The scenarios' events point into the document, so it stays loaded
+	// for the whole run
+	JsonFile json;
+	if ( !json.Load( path ) )
+	{
+		std::cout << "Audio test file " << path << " not found" << std::endl;
+		return false;
+	}
+
+	rapidjson::Document& doc = json.GetDocument();
+
+	std::string type;
+	if ( !doc.IsObject() || !doc.HasMember( "metadata" ) || !GetStringFromJSON( doc["metadata"], "type", type ) ||
+		type != "itpaudiotest" || !doc.HasMember( "scenarios" ) || !doc.HasMember( "configurations" ) )
+	{
+		std::cout << "Audio test file " << path << " is not a valid itpaudiotest file" << std::endl;
+		return false;
+	}
+
+	std::vector<Configuration> configurations;
+	const rapidjson::Value& configList = doc["configurations"];
+	for ( rapidjson::SizeType i = 0; i < configList.Size(); i++ )
+	{
+		Configuration config;
+		config.blockFrames = MIX_BLOCK_FRAMES;
+		config.tolerance = 0;
+		GetStringFromJSON( configList[i], "name", config.name );
+		GetIntFromJSON( configList[i], "blockFrames", config.blockFrames );
+		GetIntFromJSON( configList[i], "tolerance", config.tolerance );
+		config.blockFrames = Math::Clamp( config.blockFrames, 1, MIX_BLOCK_FRAMES );
+
+		std::string speakers = "stereo";
+		GetStringFromJSON( configList[i], "speakers", speakers );
+		config.speakers = speakers == "7.1" ? SPEAKERS_7_1 : speakers == "5.1" ? SPEAKERS_5_1 : SPEAKERS_STEREO;
+
+		if ( configList[i].HasMember( "scenarios" ) )
+		{
+			const rapidjson::Value& names = configList[i]["scenarios"];
+			for ( rapidjson::SizeType n = 0; n < names.Size(); n++ )
+			{
+				config.scenarios.push_back( names[n].GetString() );
+			}
+		}
+		configurations.push_back( config );
+	}
+
+	// Goldens live next to the test file
+	std::string directory( path );
+	size_t slash = directory.find_last_of( "/\\" );
+	directory = slash == std::string::npos ? "" : directory.substr( 0, slash + 1 );
+
+	std::cout << "Audio regression: " << path << std::endl;
+	int passed = 0;
+	int failed = 0;
+	CheckSimdKernels( passed, failed );
+	const rapidjson::Value& scenarios = doc["scenarios"];
+	for ( rapidjson::SizeType s = 0; s < scenarios.Size(); s++ )
+	{
+		std::string name;
+		GetStringFromJSON( scenarios[s], "name", name );
+
+		for ( const Configuration& config : configurations )
+		{
+			if ( !config.scenarios.empty() &&
+				std::find( config.scenarios.begin(), config.scenarios.end(), name ) == config.scenarios.end() )
+			{
+				continue;
+			}
+
+			int channels = config.speakers == SPEAKERS_7_1 ? 8 : config.speakers == SPEAKERS_5_1 ? 6 : 2;
+			std::string goldenPath = directory + name + "." + config.name + ".golden.wav";
+			std::vector<PCM16> golden;
+			if ( !record && !ReadGolden( goldenPath, channels, golden ) )
+			{
+				// Nothing to compare with means nothing was checked
+				std::cout << "  " << name << " [" << config.name << "] FAILED, no golden at " << goldenPath <<
+					" (run with -record to make one)" << std::endl;
+				failed++;
+				continue;
+			}
+
+			std::vector<PCM16> samples;
+			Result result = Render( scenarios[s], config, samples );
+
+			double realtime = result.renderSeconds > 0.0 ? result.frames / ( double ) SAMPLE_RATE / result.renderSeconds : 0.0;
+			double blockMicroseconds = result.renderSeconds * 1000000.0 * MIX_BLOCK_FRAMES / Math::Max( result.frames, ( U64 ) 1 );
+			std::cout << "  " << name << " [" << config.name << "] ";
+
+			if ( record )
+			{
+				if ( WriteGolden( goldenPath, channels, samples ) )
+				{
+					std::cout << "RECORDED " << goldenPath;
+				}
+				else
+				{
+					std::cout << "FAILED, couldn't write " << goldenPath;
+					failed++;
+				}
+			}
+			else
+			{
+				int maxDiff = golden.size() == samples.size() ? 0 : 65536;
+				size_t firstDiff = samples.size();
+				for ( size_t i = 0; i < samples.size() && i < golden.size(); i++ )
+				{
+					int diff = abs( samples[i] - golden[i] );
+					if ( diff > 0 && firstDiff == samples.size() )
+					{
+						firstDiff = i;
+					}
+					maxDiff = Math::Max( maxDiff, diff );
+				}
+
+				if ( maxDiff <= config.tolerance )
+				{
+					std::cout << "PASSED";
+					passed++;
+				}
+				else
+				{
+					std::cout << "FAILED";
+					failed++;
+				}
+
+				if ( golden.size() != samples.size() )
+				{
+					std::cout << ", length " << samples.size() / channels << " frames, golden has " << golden.size() / channels;
+				}
+				else if ( maxDiff == 0 )
+				{
+					std::cout << ", bit exact";
+				}
+				else
+				{
+					std::cout << ", max difference " << maxDiff << " (tolerance " << config.tolerance <<
+						") from frame " << firstDiff / channels;
+				}
+			}
+
+			std::cout << ", " << realtime << "x realtime, " << blockMicroseconds << "us per " << MIX_BLOCK_FRAMES << " frames" << std::endl;
+		}
+	}
+
+	std::cout << passed << " passed, " << failed << " failed" << std::endl;
+	return failed == 0;
+}
@@ -0,0 +1,32 @@
+// AudioRegression.h
+// Regression tests for the mixer. A scenario is a script of voice commands
+// (plays, volume and pan changes, filters, positions, reverb sends) on the
+// mixer clock, rendered through an offline AudioSystem and compared with a
+// golden render. An offline AudioSystem depends only on the calls made to
+// it, so a scenario renders the same samples on every run, and mixer
+// optimisations can be checked bit for bit, or within a tolerance where a
+// configuration allows for floating point that differs between builds.
+// Every scenario is rendered in every configuration (mix block size,
+// tolerance and speaker layout), each with its own golden. A configuration
+// can list the scenarios it renders instead, so the surround layouts only
+// render the ones that pan or spread across the speakers.
+//
+// Before the scenarios, every SampleConvert kernel is run at each SIMD
+// level the CPU supports and checked against the scalar version, on odd
+// lengths and misaligned buffers, so the SIMD tails are covered too.
+//
+// Run the game with -audiotest [file] [-record]. A missing golden is a
+// failure, and -record records every one from the current build, for new
+// scenarios or after a change that is meant to alter the output. The
+// goldens are committed next to the test file
+
+#pragma once
+
+namespace AudioRegression
+{
+	// Checks the SampleConvert kernels, then renders every scenario in the
+	// file in every configuration, and prints whether each matched its golden
+	// and how fast it rendered. Returns false if the file couldn't be read,
+	// or any kernel or render didn't match
+	bool Run( const char* path, bool record );
+}
@@ -1,72 +1,903 @@
 #include "ITPEnginePCH.h"
 #include <iostream>
 
-AudioSystem::AudioSystem()
+namespace
+{
+	// Low 16 bits of a VoiceHandle hold the channel index + 1 (so a handle is never 0),
+	// high 16 bits hold the generation, which changes every time the channel is reused
+	VoiceHandle MakeVoiceHandle( U16 voice, U16 generation )
+	{
+		return ( ( VoiceHandle ) generation << 16 ) | ( VoiceHandle ) ( voice + 1 );
+	}
+}
+
+AudioSystem::AudioSystem( const AudioThreadConfig& threadConfig, AudioOutput output, SpeakerLayout speakers )
+	: loader( &memory ), coalesceWindow( SAMPLE_RATE / 50 ), threadReported( false ), dspClock( 0 ), pendingDeadline( SAMPLE_RATE / 4 )
+	, threadConfig( threadConfig ), threadConfigured( false )
+	, filters( MAX_VOICES * 2, MIX_BLOCK_FRAMES, SAMPLE_RATE ), spatializer( MAX_VOICES, MIX_BLOCK_FRAMES, SAMPLE_RATE )
+	, panner( MAX_VOICES, MIX_BLOCK_FRAMES ), masterGain( 1.0f ), analyzer( SAMPLE_RATE ), mixClock( 0 )
+	, speakerLayout( speakers ), outputChannels( 2 ), busChannels( 2 ), system( 0 ), stream( 0 ), streamChannel( 0 )
 {
 	FMOD_RESULT result;
 	int numDrivers;
 
+	// Every voice starts out free
+	for ( U16 i = 0; i < MAX_VOICES; i++ )
+	{
+		voiceGenerations[i] = 0;
+		voicePositioned[i] = false;
+		voiceSounds[i] = 0;
+		voiceLooping[i] = false;
+		reverbBypass[i] = false;
+		freeVoices.push_back( MAX_VOICES - 1 - i );
+	}
+
+	for ( int i = 0; i < MAX_REVERB_BUSES; i++ )
+	{
+		reverbs[i] = new ReverbBus( SAMPLE_RATE );
+	}
+
+	// Lock the mixer's state before it starts running, so the mix buffers,
+	// channels and queues are never paged out. Sounds are locked as they load,
+	// which on Windows needs room for all of the budget up front
+	if ( threadConfig.lockMemory )
+	{
+		AudioThread::ReserveLockedMemory( sizeof( *this ) + memory.GetBudget() );
+		threadReport.memoryError = AudioThread::LockMemory( this, sizeof( *this ) );
+		threadReport.memoryLocked = threadReport.memoryError == 0;
+		memory.SetLockSamples( true );
+	}
+
+	int layoutChannels = speakers == SPEAKERS_7_1 ? 8 : speakers == SPEAKERS_5_1 ? 6 : 2;
+
+	// Offline, Render stands in for the device callback
+	if ( output == AUDIO_OUTPUT_OFFLINE )
+	{
+		SetOutputChannels( layoutChannels );
+		return;
+	}
+
 	// System initialization with error checking
 	result = FMOD::System_Create( &system );
-	system->init( 50, FMOD_INIT_NORMAL, 0 );
+	ErrorCheck( result );
+
+	// FMOD's own mixer has to be in the layout too, or it would downmix the
+	// stream. That has to be set before init
+	if ( layoutChannels > 2 )
+	{
+		int deviceRate = 0;
+		int deviceChannels = 0;
+		FMOD_SPEAKERMODE deviceMode;
+		result = system->getDriverInfo( 0, 0, 0, 0, &deviceRate, &deviceMode, &deviceChannels );
+		ErrorCheck( result );
+		if ( result == FMOD_OK && deviceChannels >= layoutChannels )
+		{
+			int mixRate = 0;
+			system->getSoftwareFormat( &mixRate, 0, 0 );
+			result = system->setSoftwareFormat( mixRate, speakers == SPEAKERS_7_1 ? FMOD_SPEAKERMODE_7POINT1 : FMOD_SPEAKERMODE_5POINT1, 0 );
+			ErrorCheck( result );
+		}
+		else
+		{
+			std::cout << "Audio device has " << deviceChannels << " channels, folding " << layoutChannels <<
+				" channel panning down to stereo" << std::endl;
+			layoutChannels = 2;
+		}
+	}
+	SetOutputChannels( layoutChannels );
+
+	result = system->init( 50, FMOD_INIT_NORMAL, 0 );
 	ErrorCheck( result );
 	result = system->getNumDrivers( &numDrivers );
 	ErrorCheck( result );
-}
-
-FMOD_RESULT AudioSystem::PlayAudioData( const char* path )
-{
-	Sound* sound1 = new Sound( path );
-	mainChannel.Play( sound1 );	
 
-	// Create and init sound info structure
+	// Create and init sound info structure for the one stream all channels are mixed into
 	// Sets the WriteSoundData callback which uses the function defined in Channel
 	FMOD_CREATESOUNDEXINFO info;
 	memset( &info, 0, sizeof( FMOD_CREATESOUNDEXINFO ) );
 	info.cbsize = sizeof( FMOD_CREATESOUNDEXINFO );
 
-	// 44100 Hz, Signed 16 bit format, 2 channels
+	// 44100 Hz, Signed 16 bit format, one channel per speaker
 	info.defaultfrequency = SAMPLE_RATE;
 	info.format = FMOD_SOUND_FORMAT_PCM16;
-	info.numchannels = 2;
-	info.length = sound1->length;	// length of the sound file
-	info.decodebuffersize = 4410;	// Number of samples submitted every 100ms, Sample Rate (44100) * 0.1
+	info.numchannels = outputChannels;
+	info.length = SAMPLE_RATE * outputChannels * sizeof( PCM16 );	// one second, looped forever
+	info.decodebuffersize = MIX_BLOCK_FRAMES;	// Number of samples submitted per callback, ~23ms
 	info.pcmreadcallback = &AudioSystem::WriteSoundDataCB; //FMOD_SOUND_PCMREAD_CALLBACK
 	info.pcmsetposcallback = &AudioSystem::PCMSetPosCB;
 	info.userdata = this;
 
-	FMOD::Sound* sound;
-	FMOD_MODE mode = FMOD_LOOP_NORMAL | FMOD_OPENMEMORY;
-	FMOD_RESULT result;
+	result = system->createStream( 0, FMOD_OPENUSER | FMOD_LOOP_NORMAL, &info, &stream );
+	ErrorCheck( result );
+	result = system->playSound( stream, nullptr, false, &streamChannel ); // 2nd param: Channel group defaults to FMOD_CHANNEL_FREE
+	ErrorCheck( result );
+}
+
+AudioSystem::~AudioSystem()
+{
+	if ( stream )
+	{
+		stream->release();
+	}
+	if ( system )
+	{
+		system->close();
+		system->release();
+	}
+	if ( threadReport.memoryLocked )
+	{
+		AudioThread::UnlockMemory( this, sizeof( *this ) );
+	}
+	for ( int i = 0; i < MAX_REVERB_BUSES; i++ )
+	{
+		delete reverbs[i];
+	}
+}
+
+void AudioSystem::Update()
+{
+	if ( system )
+	{
+		system->update();
+	}
+
+	if ( !threadReported && threadConfigured.load( std::memory_order_acquire ) )
+	{
+		AudioThread::PrintReport( threadConfig, threadReport );
+		threadReported = true;
+	}
+
+	// Channels the mixer has finished with can be handed out again
+	U16 voice;
+	while ( finishedVoices.Pop( voice ) )
+	{
+		voiceGenerations[voice]++;
+		voicePositioned[voice] = false;
+		freeVoices.push_back( voice );
+
+		soundInstances[voiceSounds[voice]].liveCount--;
+		memory.OnFinish( voiceSounds[voice] );
+		voiceSounds[voice] = 0;
+
+		// The mixer stopped reading it before reporting the voice finished
+		if ( voiceStreams[voice] )
+		{
+			voiceStreams[voice]->Close();
+			voiceStreams[voice].reset();
+		}
+	}
+
+	// Streamed sounds that were still loading when they were played
+	for ( U16 i = 0; i < MAX_VOICES; i++ )
+	{
+		if ( voiceSounds[i] && !voiceStreams[i] )
+		{
+			OpenStream( i );
+		}
+	}
+
+	// Stay within the memory budget now that finished sounds can go
+	memory.Update();
+
+	// Positioned voices follow the listener as it moves
+	for ( U16 i = 0; i < MAX_VOICES; i++ )
+	{
+		if ( voicePositioned[i] )
+		{
+			VoiceCommand command;
+			command.type = VoiceCommand::SET_DIRECTION;
+			command.voice = i;
+			command.direction = Transform( voicePositions[i], listener );
+			SendCommand( command );
+		}
+	}
+}
+
+SoundPtr AudioSystem::LoadSoundAsync( const char* path, SoundStorage storage )
+{
+	auto iter = sounds.find( path );
+	if ( iter != sounds.end() )
+	{
+		return iter->second;
+	}
+
+	SoundPtr sound = std::make_shared<Sound>();
+	sound->path = path;
+	sound->storageHint = storage;
+	sounds.emplace( sound->path, sound );
+	memory.Register( sound );
+	loader.Enqueue( sound );
+	return sound;
+}
+
+VoiceHandle AudioSystem::Play( SoundPtr sound, float volume, bool loop )
+{
+	// As soon as possible is whatever the mixer is about to mix next, and the
+	// whole sound plays however long its data takes
+	return StartVoice( sound, dspClock.load( std::memory_order_acquire ), volume, loop, false );
+}
+
+VoiceHandle AudioSystem::PlayAt( SoundPtr sound, U64 dspClockSample, float volume, bool loop )
+{
+	return StartVoice( sound, dspClockSample, volume, loop, true );
+}
+
+VoiceHandle AudioSystem::StartVoice( SoundPtr sound, U64 dspClockSample, float volume, bool loop, bool keepTime )
+{
+	if ( !sound || sound->GetState() == SOUND_FAILED )
+	{
+		return 0;
+	}
+
+	// Evicted to save memory, so load it again. Until it's back the voice
+	// waits like any other pending play
+	if ( sound->GetState() == SOUND_EVICTED )
+	{
+		sound->SetState( SOUND_PENDING );
+		loader.Enqueue( sound );
+	}
+
+	SoundInstances& instances = soundInstances[sound.get()];
+	if ( instances.lastVoice != 0 )
+	{
+		// Coalesce into the previous voice if it started close enough. The
+		// copies are a few milliseconds apart so they add up in power, not amplitude
+		U64 apart = dspClockSample > instances.lastStart ?
+			dspClockSample - instances.lastStart : instances.lastStart - dspClockSample;
+		U16 last;
+		if ( apart <= coalesceWindow && loop == instances.lastLoop &&
+			ResolveVoice( instances.lastVoice, last ) && !voicePositioned[last] )
+		{
+			instances.lastVolume = Math::Sqrt( instances.lastVolume * instances.lastVolume + volume * volume );
+			SetVolume( instances.lastVoice, instances.lastVolume );
+			return instances.lastVoice;
+		}
+
+		if ( dspClockSample < instances.lastStart + instances.cooldown )
+		{
+			return 0;
+		}
+	}
+
+	if ( ( instances.maxInstances > 0 && instances.liveCount >= instances.maxInstances ) || freeVoices.empty() )
+	{
+		return 0;
+	}
+
+	U16 voice = freeVoices.back();
+
+	VoiceCommand command;
+	command.type = VoiceCommand::PLAY;
+	command.voice = voice;
+	command.sound = sound.get();
+	command.clock = dspClockSample;
+	command.value = volume;
+	command.flag = loop;
+	command.keepTime = keepTime;
+	if ( !commands.Push( command ) )
+	{
+		std::cout << "Audio command queue is full, dropping sound " << sound->path << std::endl;
+		return 0;
+	}
+
+	freeVoices.pop_back();
+	voicePositioned[voice] = false;
+	voiceSounds[voice] = sound.get();
+	voiceLooping[voice] = loop;
+	memory.OnPlay( sound.get(), dspClockSample );
+	OpenStream( voice );
+
+	VoiceHandle handle = MakeVoiceHandle( voice, voiceGenerations[voice] );
+	instances.liveCount++;
+	instances.lastVoice = handle;
+	instances.lastStart = dspClockSample;
+	instances.lastVolume = volume;
+	instances.lastLoop = loop;
+	return handle;
+}
+
+void AudioSystem::Stop( VoiceHandle voice )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::STOP;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::StopAt( VoiceHandle voice, U64 dspClockSample )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::STOP_AT;
+		command.clock = dspClockSample;
+		SendCommand( command );
+	}
+}
+
+bool AudioSystem::IsPlaying( VoiceHandle voice ) const
+{
+	U16 index;
+	return ResolveVoice( voice, index );
+}
+
+void AudioSystem::SetVolume( VoiceHandle voice, float volume, RampShape shape )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_VOLUME;
+		command.value = volume;
+		command.shape = shape;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetPan( VoiceHandle voice, float pan, RampShape shape )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_PAN;
+		command.value = pan;
+		command.shape = shape;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetMasterVolume( float volume, RampShape shape )
+{
+	VoiceCommand command;
+	command.type = VoiceCommand::SET_MASTER_VOLUME;
+	command.voice = 0;
+	command.value = Math::Max( volume, 0.0f );
+	command.shape = shape;
+	SendCommand( command );
+}
+
+void AudioSystem::SetPaused( VoiceHandle voice, bool paused )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_PAUSED;
+		command.flag = paused;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetLooping( VoiceHandle voice, bool loop )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_LOOPING;
+		command.flag = loop;
+		SendCommand( command );
+		voiceLooping[command.voice] = loop;
+	}
+}
+
+void AudioSystem::SetLowPass( VoiceHandle voice, float cutoff )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_LOWPASS;
+		command.value = cutoff;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetHighPass( VoiceHandle voice, float cutoff )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_HIGHPASS;
+		command.value = cutoff;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetPosition( VoiceHandle voice, const Vector3& position )
+{
+	// The direction is sent from Update, once the listener is known for this frame
+	U16 index;
+	if ( ResolveVoice( voice, index ) )
+	{
+		voicePositions[index] = position;
+		voicePositioned[index] = true;
+	}
+}
+
+void AudioSystem::SetListener( const Matrix4& viewMatrix )
+{
+	listener = viewMatrix;
+
+	Matrix4 world = viewMatrix;
+	world.Invert();
+	listenerPosition = world.GetTranslation();
+}
+
+void AudioSystem::SetReverbPreset( int bus, const ReverbPreset& preset )
+{
+	if ( bus >= 0 && bus < MAX_REVERB_BUSES )
+	{
+		VoiceCommand command;
+		command.type = VoiceCommand::SET_REVERB_PRESET;
+		command.voice = ( U16 ) bus;
+		command.reverb = preset;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetReverbSend( int bus, float level )
+{
+	if ( bus >= 0 && bus < MAX_REVERB_BUSES )
+	{
+		VoiceCommand command;
+		command.type = VoiceCommand::SET_REVERB_SEND;
+		command.voice = ( U16 ) bus;
+		command.value = Math::Max( level, 0.0f );
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetReverbBypass( VoiceHandle voice, bool bypass )
+{
+	VoiceCommand command;
+	if ( ResolveVoice( voice, command.voice ) )
+	{
+		command.type = VoiceCommand::SET_REVERB_BYPASS;
+		command.flag = bypass;
+		SendCommand( command );
+	}
+}
+
+void AudioSystem::SetMaxInstances( SoundPtr sound, int maxInstances )
+{
+	if ( sound )
+	{
+		soundInstances[sound.get()].maxInstances = maxInstances;
+	}
+}
 
-	system->createStream( 0, FMOD_DEFAULT, &info, &sound ); 
-	system->createSound( path, FMOD_DEFAULT, 0, &sound ); 
-	system->playSound( sound, nullptr, false, 0 ); // 2nd param: Channel group defaults to FMOD_CHANNEL_FREE
+void AudioSystem::SetRetriggerCooldown( SoundPtr sound, float cooldown )
+{
+	if ( sound )
+	{
+		soundInstances[sound.get()].cooldown = ( U32 ) SecondsToSamples( Math::Max( cooldown, 0.0f ) );
+	}
+}
 
+void AudioSystem::SetCoalesceWindow( float seconds )
+{
+	coalesceWindow = ( U32 ) SecondsToSamples( Math::Max( seconds, 0.0f ) );
+}
+
+FMOD_RESULT AudioSystem::PlayAudioData( const char* path )
+{
+	// Never blocks: if this is the first time the sound is used, it starts
+	// playing as soon as the loader thread has read it
+	if ( Play( LoadSoundAsync( path ) ) == 0 )
+	{
+		return FMOD_ERR_CHANNEL_ALLOC;
+	}
 	return FMOD_OK;
 }
 
+bool AudioSystem::GetThreadReport( AudioThreadReport& report ) const
+{
+	if ( !threadConfigured.load( std::memory_order_acquire ) )
+	{
+		return false;
+	}
+	report = threadReport;
+	return true;
+}
+
+void AudioSystem::SetPendingPlayDeadline( float seconds )
+{
+	pendingDeadline.store( ( U32 ) ( Math::Max( seconds, 0.0f ) * SAMPLE_RATE ), std::memory_order_relaxed );
+}
+
+float AudioSystem::GetPendingPlayDeadline() const
+{
+	return ( float ) pendingDeadline.load( std::memory_order_relaxed ) / SAMPLE_RATE;
+}
+
+AudioSystem::SoundInstances::SoundInstances()
+	: maxInstances( 0 ), cooldown( 0 ), liveCount( 0 ), lastVoice( 0 ), lastStart( 0 ), lastVolume( 0.0f ), lastLoop( false )
+{
+}
+
+bool AudioSystem::ResolveVoice( VoiceHandle handle, U16& outVoice ) const
+{
+	U32 index = handle & 0xFFFF;
+	if ( index == 0 || index > MAX_VOICES )
+	{
+		return false;
+	}
+
+	// A stale handle belongs to a voice that has finished and may have been reused
+	outVoice = ( U16 ) ( index - 1 );
+	return voiceGenerations[outVoice] == ( U16 ) ( handle >> 16 );
+}
+
+void AudioSystem::SendCommand( const VoiceCommand& command )
+{
+	if ( !commands.Push( command ) )
+	{
+		std::cout << "Audio command queue is full, dropping command" << std::endl;
+	}
+}
+
+void AudioSystem::OpenStream( U16 voice )
+{
+	const Sound* sound = voiceSounds[voice];
+	if ( sound->GetState() != SOUND_READY || sound->storage != STORAGE_STREAMED )
+	{
+		return;
+	}
+
+	SoundStreamPtr stream = std::make_shared<SoundStream>( sounds[sound->path], voiceLooping[voice] );
+
+	// If the queue is full this is tried again next Update
+	VoiceCommand command;
+	command.type = VoiceCommand::SET_STREAM;
+	command.voice = voice;
+	command.stream = stream.get();
+	if ( commands.Push( command ) )
+	{
+		voiceStreams[voice] = stream;
+		loader.AddStream( stream );
+	}
+}
+
+void AudioSystem::Render( PCM16* out, int frames )
+{
+	if ( system == 0 )
+	{
+		WriteSoundData( 0, out, frames * outputChannels * sizeof( PCM16 ) );
+	}
+}
+
 FMOD_RESULT F_CALLBACK AudioSystem::WriteSoundDataCB( FMOD_SOUND *sound, void *data, unsigned int datalen )
 {
-	AudioSystem* as = new AudioSystem();
-	return as->WriteSoundData( sound, data, datalen );	// trickery in order to keep this callback a static function
+	// The AudioSystem was attached to the stream as its user data
+	// in order to keep this callback a static function
+	void* userData = 0;
+	( ( FMOD::Sound* ) sound )->getUserData( &userData );
+	AudioSystem* as = ( AudioSystem* ) userData;
+	if ( as == 0 )
+	{
+		memset( data, 0, datalen );
+		return FMOD_OK;
+	}
+	return as->WriteSoundData( sound, data, datalen );
 }
 
 FMOD_RESULT AudioSystem::WriteSoundData( FMOD_SOUND *sound, void *data, unsigned int datalen )
 {
-	// Clear output
-	memset( data, 0, datalen ); 
-	// Cast to PCM and calculate sample count
+	// Cast to PCM and calculate frame count
 	PCM16* pcmData = ( PCM16* ) data;
-	// Number of samples that can fit in array when each sample is 2 bytes
-	int pcmDataCount = datalen / 2;
+	// Each frame is a 2 byte sample per output channel
+	int frameCount = datalen / ( outputChannels * sizeof( PCM16 ) );
+
+	// FMOD's thread is only known once it calls in
+	if ( !threadConfigured.load( std::memory_order_relaxed ) )
+	{
+		AudioThread::ConfigureCurrentThread( threadConfig, threadReport );
+		threadConfigured.store( true, std::memory_order_release );
+	}
+
+	// Decaying filters produce denormals, which are very slow on x86
+	_MM_SET_FLUSH_ZERO_MODE( _MM_FLUSH_ZERO_ON );
+	_MM_SET_DENORMALS_ZERO_MODE( _MM_DENORMALS_ZERO_ON );
+
+	ProcessCommands();
+
+	while ( frameCount > 0 )
+	{
+		int frames = Math::Min( frameCount, MIX_BLOCK_FRAMES );
+
+		// Clear output
+		memset( mixBuffer, 0, frames * busChannels * sizeof( float ) );
+
+		// Have the channels write to the output
+		Mix( mixBuffer, frames );
+		masterGain.Apply( mixBuffer, busChannels, frames );
+
+		// The analysis is of stereo, so surround is folded down for it
+		if ( busChannels == 2 )
+		{
+			analyzer.Process( mixBuffer, frames, mixClock + frames );
+		}
+		else
+		{
+			SampleConvert::Downmix( mixBuffer, busChannels, voiceBuffer, 2, downmixMatrix, frames );
+			analyzer.Process( voiceBuffer, frames, mixClock + frames );
+		}
+
+		// 5.1 only uses six of the bus's channels, so close up the gaps
+		if ( outputChannels != busChannels )
+		{
+			for ( int n = 0; n < frames; n++ )
+			{
+				memmove( mixBuffer + n * outputChannels, mixBuffer + n * busChannels, outputChannels * sizeof( float ) );
+			}
+		}
 
-	// Have the channel write to the output
-	mainChannel.WriteSoundData( pcmData, pcmDataCount );
+		// Convert the mix back to 16 bit, clipping anything out of range
+		SampleConvert::FromFloat( mixBuffer, pcmData, SAMPLE_PCM16, frames * outputChannels );
+
+		pcmData += frames * outputChannels;
+		frameCount -= frames;
+		mixClock += frames;
+		dspClock.store( mixClock, std::memory_order_release );
+	}
 
 	return FMOD_OK;
 }
 
+void AudioSystem::ProcessCommands()
+{
+	VoiceCommand command;
+	while ( commands.Pop( command ) )
+	{
+		Channel& channel = channels[command.voice];
+		switch ( command.type )
+		{
+		case VoiceCommand::PLAY:
+			channel.Play( command.sound, command.clock, command.keepTime );
+			channel.SetVolume( command.value );
+			channel.SetPan( 0.0f );
+			channel.SetLooping( command.flag );
+			channel.SetPaused( false );
+			filters.Reset( command.voice * 2 );
+			filters.Reset( command.voice * 2 + 1 );
+			spatializer.Reset( command.voice );
+			panner.Reset( command.voice );
+			reverbBypass[command.voice] = false;
+			break;
+		case VoiceCommand::STOP:
+			if ( channel.IsPlaying() )
+			{
+				FinishVoice( command.voice );
+			}
+			break;
+		case VoiceCommand::STOP_AT:
+			channel.SetStopClock( command.clock );
+			break;
+		case VoiceCommand::SET_VOLUME:
+			channel.SetVolume( command.value, command.shape );
+			break;
+		case VoiceCommand::SET_PAN:
+			channel.SetPan( command.value, command.shape );
+			break;
+		case VoiceCommand::SET_MASTER_VOLUME:
+			masterGain.SetTarget( command.value, command.shape );
+			break;
+		case VoiceCommand::SET_PAUSED:
+			channel.SetPaused( command.flag );
+			break;
+		case VoiceCommand::SET_LOOPING:
+			channel.SetLooping( command.flag );
+			break;
+		case VoiceCommand::SET_LOWPASS:
+			filters.SetLowPass( command.voice * 2, command.value );
+			filters.SetLowPass( command.voice * 2 + 1, command.value );
+			break;
+		case VoiceCommand::SET_HIGHPASS:
+			filters.SetHighPass( command.voice * 2, command.value );
+			filters.SetHighPass( command.voice * 2 + 1, command.value );
+			break;
+		case VoiceCommand::SET_DIRECTION:
+			if ( speakerLayout == SPEAKERS_STEREO )
+			{
+				spatializer.SetDirection( command.voice, command.direction );
+			}
+			else
+			{
+				panner.SetDirection( command.voice, command.direction );
+			}
+			break;
+		case VoiceCommand::SET_STREAM:
+			channel.SetStream( command.stream );
+			break;
+		case VoiceCommand::SET_REVERB_PRESET:
+			reverbs[command.voice]->SetPreset( command.reverb );
+			break;
+		case VoiceCommand::SET_REVERB_SEND:
+			reverbs[command.voice]->SetSend( command.value );
+			break;
+		case VoiceCommand::SET_REVERB_BYPASS:
+			reverbBypass[command.voice] = command.flag;
+			break;
+		}
+	}
+}
+
+void AudioSystem::Mix( float* out, int frames )
+{
+	U32 deadline = pendingDeadline.load( std::memory_order_relaxed );
+	U64 blockEnd = mixClock + frames;
+
+	// While any reverb is running, voices that go through the reverbs are
+	// mixed on their own so every bus can share that one input
+	bool reverbActive = false;
+	for ( int b = 0; b < MAX_REVERB_BUSES; b++ )
+	{
+		reverbActive = reverbActive || reverbs[b]->IsActive();
+	}
+	if ( reverbActive )
+	{
+		memset( sendBuffer, 0, frames * busChannels * sizeof( float ) );
+	}
+
+	// Voices with filters render dry into the filter bank, and are added
+	// to the mix (or spatialized) after the whole batch has been filtered
+	filters.BeginBatch();
+	U16 filteredVoices[MAX_VOICES];
+	int numFiltered = 0;
+
+	for ( U16 i = 0; i < MAX_VOICES; i++ )
+	{
+		Channel& channel = channels[i];
+		if ( !channel.IsPlaying() )
+		{
+			continue;
+		}
+
+		int offset = 0;
+		if ( channel.IsPending() )
+		{
+			// A voice whose data hasn't arrived is dropped once it is later than the
+			// deadline, or its stop time has gone by
+			U64 startClock = channel.GetStartClock();
+			SoundState state = channel.GetSound()->GetState();
+			if ( state == SOUND_FAILED || channel.GetStopClock() <= mixClock ||
+				( state == SOUND_PENDING && mixClock > startClock + deadline ) )
+			{
+				FinishVoice( i );
+				continue;
+			}
+
+			// Streamed sounds also wait for their buffer to fill
+			if ( state != SOUND_READY || startClock >= blockEnd || !channel.IsPrimed() )
+			{
+				continue;
+			}
+
+			// Start at the exact sample inside this block. If the start time has
+			// already been mixed (or the data arrived late) start right away, as
+			// far into the sound as it's late if the voice keeps to the clock
+			offset = startClock > mixClock ? ( int ) ( startClock - mixClock ) : 0;
+			channel.Start( startClock < mixClock ? mixClock - startClock : 0 );
+			if ( !channel.IsPlaying() )
+			{
+				// Its time has been and gone
+				FinishVoice( i );
+				continue;
+			}
+		}
+
+		float* mix = reverbActive && !reverbBypass[i] ? sendBuffer : out;
+
+		// A voice scheduled to stop in this block only writes up to that sample
+		U64 stopClock = channel.GetStopClock();
+		int end = frames;
+		if ( stopClock < blockEnd )
+		{
+			end = stopClock > mixClock ? ( int ) ( stopClock - mixClock ) : 0;
+		}
+
+		if ( end <= offset )
+		{
+			// Stopped before it got to start
+		}
+		else if ( filters.IsActive( i * 2 ) || filters.IsActive( i * 2 + 1 ) )
+		{
+			float* left = filters.AddToBatch( i * 2, frames );
+			float* right = filters.AddToBatch( i * 2 + 1, frames );
+			channel.WriteSoundData( left + offset, right + offset, 1, end - offset );
+			filteredVoices[numFiltered++] = i;
+		}
+		else if ( IsSpatialized( i ) )
+		{
+			float* left = voiceBuffer;
+			float* right = voiceBuffer + MIX_BLOCK_FRAMES;
+			memset( left, 0, frames * sizeof( float ) );
+			memset( right, 0, frames * sizeof( float ) );
+			channel.WriteSoundData( left + offset, right + offset, 1, end - offset );
+			Spatialize( i, left, right, frames, mix );
+		}
+		else
+		{
+			// The front pair of the bus
+			float* frame = mix + offset * busChannels;
+			channel.WriteSoundData( frame, frame + 1, busChannels, end - offset );
+		}
+
+		if ( !channel.IsPlaying() || end < frames )
+		{
+			FinishVoice( i );
+		}
+	}
+
+	if ( numFiltered > 0 )
+	{
+		filters.ProcessBatch( frames );
+		for ( int k = 0; k < numFiltered; k++ )
+		{
+			float* left = filters.GetBatchBuffer( k * 2 );
+			float* right = filters.GetBatchBuffer( k * 2 + 1 );
+			float* mix = reverbActive && !reverbBypass[filteredVoices[k]] ? sendBuffer : out;
+			if ( IsSpatialized( filteredVoices[k] ) )
+			{
+				Spatialize( filteredVoices[k], left, right, frames, mix );
+			}
+			else
+			{
+				SampleConvert::AddInterleaved( left, right, mix, busChannels, frames );
+			}
+		}
+	}
+
+	if ( reverbActive )
+	{
+		for ( int b = 0; b < MAX_REVERB_BUSES; b++ )
+		{
+			reverbs[b]->Process( sendBuffer, out, busChannels, frames );
+		}
+		for ( int n = 0; n < frames * busChannels; n++ )
+		{
+			out[n] += sendBuffer[n];
+		}
+	}
+}
+
+void AudioSystem::Spatialize( U16 voice, const float* left, const float* right, int frames, float* mix )
+{
+	if ( speakerLayout == SPEAKERS_STEREO )
+	{
+		spatializer.Process( voice, left, right, frames, mix );
+	}
+	else
+	{
+		panner.Process( voice, left, right, frames, mix );
+	}
+}
+
+bool AudioSystem::IsSpatialized( U16 voice ) const
+{
+	return spatializer.IsEnabled( voice ) || panner.IsEnabled( voice );
+}
+
+void AudioSystem::SetOutputChannels( int channels )
+{
+	outputChannels = channels;
+	busChannels = channels > 2 ? SURROUND_BUS_CHANNELS : 2;
+	if ( speakerLayout != SPEAKERS_STEREO )
+	{
+		panner.SetLayout( speakerLayout, channels == 2 );
+	}
+	if ( busChannels > 2 )
+	{
+		SampleConvert::GetDownmixMatrix( busChannels, 2, downmixMatrix );
+	}
+}
+
+void AudioSystem::FinishVoice( U16 voice )
+{
+	channels[voice].Stop();
+	// Can't fail, there are never more finished voices than voices
+	finishedVoices.Push( voice );
+}
+
 FMOD_RESULT AudioSystem::PCMSetPosCB(FMOD_SOUND *sound, int subsound, unsigned int position, FMOD_TIMEUNIT postype)
 {
 	// Seek callback is required with read
@@ -74,7 +905,7 @@ FMOD_RESULT AudioSystem::PCMSetPosCB(FMOD_SOUND *sound, int subsound, unsigned i
 	return FMOD_OK;
 }
 
-void AudioSystem::ErrorCheck(FMOD_RESULT result) 
+void AudioSystem::ErrorCheck(FMOD_RESULT result)
 {
 	// Useful function for getting string explanations from FMOD errors
 	if ( result != FMOD_OK )
@@ -82,4 +913,4 @@ void AudioSystem::ErrorCheck(FMOD_RESULT result)
 		const char* error = FMOD_ErrorString( result );
 		std::cout << "FMOD Error: " << error << std::endl;
 	}
-}
\ No newline at end of file
+}
@@ -1,28 +1,288 @@
 #pragma once
 #include "Channel.h"
+#include "AudioCommandQueue.h"
+#include "SoundLoader.h"
+#include "AudioMemoryManager.h"
+#include "AudioThread.h"
+#include "MixAnalyzer.h"
+#include "BiquadFilterBank.h"
+#include "HrtfSpatializer.h"
+#include "VbapPanner.h"
+#include "ReverbBus.h"
+#include "Math.h"
 #include <fmod.hpp>
 #include <fmod_errors.h>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #define SAMPLE_RATE 44100
+#define MAX_VOICES 64
+// Largest number of frames mixed in one pass
+#define MIX_BLOCK_FRAMES 1024
+#define MAX_REVERB_BUSES 4
 
+// Identifies a voice started with AudioSystem::Play.
+// Zero is never a valid handle
+typedef U32 VoiceHandle;
+
+enum AudioOutput
+{
+	// Mixed on FMOD's thread and played on the default device
+	AUDIO_OUTPUT_DEVICE,
+	// Nothing is played. The caller pulls the mix with Render, which makes
+	// the output depend only on the calls made, for tests and captures
+	AUDIO_OUTPUT_OFFLINE
+};
+
+// Owns the FMOD output stream and mixes every playing Channel into it.
+// Everything public is called from the game thread; the mixer runs on
+// FMOD's stream thread and only talks to the game through lock-free queues
 class AudioSystem
 {
 public:
-	AudioSystem();
+	// threadConfig sets up the mixer thread when it first runs. Whatever
+	// couldn't be applied is printed on the first Update after that.
+	// On a surround layout, voices that aren't positioned play from the front
+	// pair and positioned ones are panned between the speakers. If the device
+	// doesn't have that many channels the output stays stereo, and positioned
+	// voices are panned as if for the layout, then folded down
+	AudioSystem( const AudioThreadConfig& threadConfig = AudioThreadConfig(), AudioOutput output = AUDIO_OUTPUT_DEVICE,
+		SpeakerLayout speakers = SPEAKERS_STEREO );
+	~AudioSystem();
+
+	// Call once per frame
+	void Update();
+
+	// Returns immediately with a (possibly still loading) sound. The file is
+	// read on the loader thread. Every call with the same path shares one Sound.
+	// storage overrides how the memory manager would store it, and only
+	// applies to the first call for a path
+	SoundPtr LoadSoundAsync( const char* path, SoundStorage storage = STORAGE_AUTO );
+
+	// Starts a voice for sound. If the sound hasn't finished loading, the voice
+	// is held by the mixer and starts on the first block after the data is ready,
+	// or is dropped if it isn't ready within the pending play deadline.
+	// Plays of the same sound within the coalesce window of each other share one
+	// voice (and handle), whose volume is the combined volume.
+	// Returns 0 if no voice is free, or the sound's instance limits refuse it
+	VoiceHandle Play( SoundPtr sound, float volume = 1.0f, bool loop = false );
+
+	// Starts a voice for sound exactly at dspClockSample on the mixer clock, even
+	// if that falls in the middle of a mix block. Silence trimmed from the sound
+	// when it was loaded plays back as silence, so its first audible frame lands
+	// where it does in the file. The voice keeps to the clock even if that time
+	// has already been mixed, or its data (or stream) is ready late: it starts
+	// right away, that many frames into the sound, and a stream that falls
+	// behind skips what it missed. To hear the whole sound, schedule at least
+	// MIX_BLOCK_FRAMES past GetDspClock(). The pending play deadline counts from
+	// dspClockSample
+	VoiceHandle PlayAt( SoundPtr sound, U64 dspClockSample, float volume = 1.0f, bool loop = false );
+	void Stop( VoiceHandle voice );
+	// Stops voice exactly at dspClockSample, or right away if that's been mixed
+	void StopAt( VoiceHandle voice, U64 dspClockSample );
+	// False once the voice has finished (or been stopped) and its handle is stale
+	bool IsPlaying( VoiceHandle voice ) const;
+	// Volume and pan changes glide to the new value over one mix block.
+	// Exponential ramps suit fades, linear ones everything else
+	void SetVolume( VoiceHandle voice, float volume, RampShape shape = RAMP_LINEAR );
+	// -1 is full left, 1 full right. Centered (the default) leaves both sides alone
+	void SetPan( VoiceHandle voice, float pan, RampShape shape = RAMP_LINEAR );
+	// Gain on the final mix, ramped the same way
+	void SetMasterVolume( float volume, RampShape shape = RAMP_LINEAR );
+	void SetPaused( VoiceHandle voice, bool paused );
+	void SetLooping( VoiceHandle voice, bool loop );
+
+	// Per voice filters for occlusion, air absorption and muffling. Changes are
+	// interpolated over one mix block. A low pass cutoff of FILTER_MAX_CUTOFF or
+	// more, or a high pass cutoff of FILTER_MIN_CUTOFF or less, turns it off
+	void SetLowPass( VoiceHandle voice, float cutoff );
+	void SetHighPass( VoiceHandle voice, float cutoff );
+
+	// Positions voice in the world, which makes it render binaurally relative
+	// to the listener, or from the speakers around them on a surround layout.
+	// The direction is updated every frame, and filter and gain changes are
+	// glided over one mix block
+	void SetPosition( VoiceHandle voice, const Vector3& position );
+	// The listener is the camera: viewMatrix takes world space to view space
+	void SetListener( const Matrix4& viewMatrix );
+	const Vector3& GetListenerPosition() const { return listenerPosition; }
+
+	// Shared reverbs, one for each acoustic space that can be heard. Every
+	// voice sends the same amount to a bus, so the cost of a bus doesn't
+	// grow with the number of voices, and a bus with nothing sent to it
+	// costs nothing once its tail has died away
+	void SetReverbPreset( int bus, const ReverbPreset& preset );
+	// How much of the mix goes into bus, glided over one mix block
+	void SetReverbSend( int bus, float level );
+	// Keeps voice out of every reverb, for music and interface sounds
+	void SetReverbBypass( VoiceHandle voice, bool bypass );
+
+	// Per sound limits. A sound with maxInstances voices already playing won't
+	// start another (0, the default, is unlimited), and a sound won't start again
+	// until cooldown seconds after it last started, unless it can be coalesced
+	void SetMaxInstances( SoundPtr sound, int maxInstances );
+	void SetRetriggerCooldown( SoundPtr sound, float cooldown );
+	// Plays of one sound that start this close together are merged (default 20ms).
+	// Looping and non looping plays, and positioned voices, are never merged
+	void SetCoalesceWindow( float seconds );
+
+	// Budget and statistics for the memory held by loaded sounds. Sounds evicted
+	// to stay within the budget are loaded again the next time they're played
+	AudioMemoryManager& GetMemory() { return memory; }
+
+	// Loads (on first use, asynchronously) and plays the file at path
 	FMOD_RESULT PlayAudioData( const char* path );
 
+	// How long a voice may wait for its sound to load before it's dropped
+	void SetPendingPlayDeadline( float seconds );
+	float GetPendingPlayDeadline() const;
+
+	// Levels, loudness and spectrum of the final mix, updated every mix block
+	const MixAnalysis& GetMixAnalysis() { return analyzer.GetLatest(); }
+
+	// False until the mixer has run and configured its thread
+	bool GetThreadReport( AudioThreadReport& report ) const;
+
+	// AUDIO_OUTPUT_OFFLINE only. Runs the mixer on the calling thread for the
+	// next frames frames of GetOutputChannels() interleaved channels, exactly
+	// as the device callback would
+	void Render( PCM16* out, int frames );
+
+	SpeakerLayout GetSpeakerLayout() const { return speakerLayout; }
+	// 2, 6 or 8, in FMOD's speaker order. Stereo when a surround layout had
+	// to be folded down for the device
+	int GetOutputChannels() const { return outputChannels; }
+
+	// Number of output frames the mixer has produced since startup. Increases
+	// monotonically at SAMPLE_RATE and is the time base for PlayAt
+	U64 GetDspClock() const { return dspClock.load( std::memory_order_acquire ); }
+	static U64 SecondsToSamples( float seconds ) { return ( U64 ) ( seconds * SAMPLE_RATE + 0.5f ); }
+
 private:
+	struct VoiceCommand
+	{
+		// SET_MASTER_VOLUME applies to the whole mix, and ignores voice.
+		// SET_REVERB_PRESET and SET_REVERB_SEND use voice as the bus
+		enum Type { PLAY, STOP, STOP_AT, SET_VOLUME, SET_PAN, SET_MASTER_VOLUME, SET_PAUSED, SET_LOOPING, SET_LOWPASS, SET_HIGHPASS, SET_DIRECTION, SET_STREAM,
+			SET_REVERB_PRESET, SET_REVERB_SEND, SET_REVERB_BYPASS };
+		Type type;
+		U16 voice;
+		Sound* sound;
+		SoundStream* stream;
+		U64 clock;
+		float value;
+		RampShape shape;
+		bool flag;
+		// PLAY: start into the sound by however late the voice is, see PlayAt
+		bool keepTime;
+		// Listener space, for SET_DIRECTION
+		Vector3 direction;
+		ReverbPreset reverb;
+	};
+
+	// Game thread bookkeeping for every voice of one sound
+	struct SoundInstances
+	{
+		SoundInstances();
+
+		int maxInstances;
+		U32 cooldown;
+		int liveCount;
+		// The most recent voice, which later plays may be coalesced into
+		VoiceHandle lastVoice;
+		U64 lastStart;
+		float lastVolume;
+		bool lastLoop;
+	};
+
 	static FMOD_RESULT F_CALLBACK WriteSoundDataCB( FMOD_SOUND *sound, void *data, unsigned int datalen );
 	static FMOD_RESULT F_CALLBACK PCMSetPosCB( FMOD_SOUND *sound, int subsound, unsigned int position, FMOD_TIMEUNIT postype );
-	
+
 	FMOD_RESULT WriteSoundData( FMOD_SOUND *sound, void *data, unsigned int datalen );
+	void ProcessCommands();
+	void Mix( float* out, int frames );
+	// Adds a positioned voice's left and right to the mix, through whichever
+	// of the spatializer and the panner the layout uses
+	void Spatialize( U16 voice, const float* left, const float* right, int frames, float* mix );
+	bool IsSpatialized( U16 voice ) const;
+	void FinishVoice( U16 voice );
+	// Sizes the buses for outputChannels and sets up the panner for them
+	void SetOutputChannels( int channels );
+
+	// Play and PlayAt. keepTime is whether the voice keeps to dspClockSample
+	// when it starts late, rather than playing from the beginning
+	VoiceHandle StartVoice( SoundPtr sound, U64 dspClockSample, float volume, bool loop, bool keepTime );
+
+	// Game thread helpers for voice handles
+	bool ResolveVoice( VoiceHandle handle, U16& outVoice ) const;
+	void SendCommand( const VoiceCommand& command );
+	// Gives a voice playing a STORAGE_STREAMED sound its stream, once the
+	// sound has loaded
+	void OpenStream( U16 voice );
+
 	void ErrorCheck( FMOD_RESULT result );
 
-	// Mono: count = sampling rate * duration * channels
-	PCM16 data[SAMPLE_RATE];
+	// Game thread only
+	std::unordered_map<std::string, SoundPtr> sounds;
+	std::vector<U16> freeVoices;
+	U16 voiceGenerations[MAX_VOICES];
+	AudioMemoryManager memory;
+	SoundLoader loader;
+	Vector3 voicePositions[MAX_VOICES];
+	bool voicePositioned[MAX_VOICES];
+	Matrix4 listener;
+	Vector3 listenerPosition;
+	// Sounds are cached for the lifetime of the AudioSystem, so their
+	// addresses are never reused while an entry exists
+	std::unordered_map<const Sound*, SoundInstances> soundInstances;
+	const Sound* voiceSounds[MAX_VOICES];
+	bool voiceLooping[MAX_VOICES];
+	// Kept alive here until the voice finishes, so the mixer never sees it freed
+	SoundStreamPtr voiceStreams[MAX_VOICES];
+	U32 coalesceWindow;
+	bool threadReported;
+
+	// Shared between the game and mixer threads
+	AudioCommandQueue<VoiceCommand, 1024> commands;
+	AudioCommandQueue<U16, MAX_VOICES + 1> finishedVoices;
+	std::atomic<U64> dspClock;
+	std::atomic<U32> pendingDeadline;
+	// Written once by the constructor and the mixer's first callback, then
+	// read only after threadConfigured
+	AudioThreadConfig threadConfig;
+	AudioThreadReport threadReport;
+	std::atomic<bool> threadConfigured;
+
+	// Mixer thread only
+	Channel channels[MAX_VOICES];
+	// Two filters per voice, left at voice * 2 and right at voice * 2 + 1
+	BiquadFilterBank filters;
+	HrtfSpatializer spatializer;
+	VbapPanner panner;
+	ReverbBus* reverbs[MAX_REVERB_BUSES];
+	bool reverbBypass[MAX_VOICES];
+	ParamRamp masterGain;
+	// Only GetLatest is called from the game thread
+	MixAnalyzer analyzer;
+	// Interleaved busChannels wide: stereo, or SURROUND_BUS_CHANNELS
+	float mixBuffer[MIX_BLOCK_FRAMES * SURROUND_BUS_CHANNELS];
+	// Dry left and right for a positioned voice that isn't filtered. After
+	// the mix, the stereo downmix of a surround mix for the analyzer
+	float voiceBuffer[MIX_BLOCK_FRAMES * 2];
+	// Voices that go through the reverbs are mixed here first, then added to the mix
+	float sendBuffer[MIX_BLOCK_FRAMES * SURROUND_BUS_CHANNELS];
+	U64 mixClock;
+
+	// Set by the constructor
+	SpeakerLayout speakerLayout;
+	int outputChannels;
+	int busChannels;
+	// Surround bus to stereo, for the analyzer
+	float downmixMatrix[2 * SURROUND_BUS_CHANNELS];
 
-	// Stereo: count = 44100 Hz * 1 second * 2 channels
-	PCM16 stereoData[SAMPLE_RATE * 2];
-	Channel mainChannel;
 	FMOD::System* system;
-};
\ No newline at end of file
+	FMOD::Sound* stream;
+	FMOD::Channel* streamChannel;
+};
@@ -0,0 +1,136 @@
+#include "ITPEnginePCH.h"
+#include <iostream>
+#if !_WIN32
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+void AudioThread::ConfigureCurrentThread( const AudioThreadConfig& config, AudioThreadReport& report )
+{
+#if _WIN32
+	if ( config.realtime )
+	{
+		report.realtimeApplied = SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL ) != 0;
+		report.realtimeError = report.realtimeApplied ? 0 : ( int ) GetLastError();
+	}
+	if ( config.cpu >= 0 )
+	{
+		DWORD_PTR mask = ( DWORD_PTR ) 1 << config.cpu;
+		report.affinityApplied = SetThreadAffinityMask( GetCurrentThread(), mask ) != 0;
+		report.affinityError = report.affinityApplied ? 0 : ( int ) GetLastError();
+	}
+#else
+	if ( config.realtime )
+	{
+		sched_param param = {};
+		param.sched_priority = Math::Clamp( config.priority, sched_get_priority_min( SCHED_FIFO ), sched_get_priority_max( SCHED_FIFO ) );
+		report.realtimeError = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+		report.realtimeApplied = report.realtimeError == 0;
+	}
+	if ( config.cpu >= 0 )
+	{
+#if __linux__
+		cpu_set_t set;
+		CPU_ZERO( &set );
+		CPU_SET( config.cpu, &set );
+		report.affinityError = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+		report.affinityApplied = report.affinityError == 0;
+#else
+		report.affinityError = ENOTSUP;
+#endif
+	}
+#endif
+}
+
+void AudioThread::ReserveLockedMemory( size_t bytes )
+{
+#if _WIN32
+	HANDLE process = GetCurrentProcess();
+	SIZE_T minimum, maximum;
+	if ( GetProcessWorkingSetSize( process, &minimum, &maximum ) )
+	{
+		SetProcessWorkingSetSize( process, minimum + bytes, Math::Max( maximum, minimum + bytes ) );
+	}
+#else
+	// mlock only answers to RLIMIT_MEMLOCK, which the process can't raise
+	( void ) bytes;
+#endif
+}
+
+int AudioThread::LockMemory( const void* address, size_t bytes )
+{
+#if _WIN32
+	return VirtualLock( const_cast<void*>( address ), bytes ) ? 0 : ( int ) GetLastError();
+#else
+	return mlock( address, bytes ) == 0 ? 0 : errno;
+#endif
+}
+
+void AudioThread::UnlockMemory( const void* address, size_t bytes )
+{
+#if _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	size_t pageSize = info.dwPageSize;
+#else
+	size_t pageSize = ( size_t ) sysconf( _SC_PAGESIZE );
+#endif
+	uintptr_t first = ( ( uintptr_t ) address + pageSize - 1 ) / pageSize * pageSize;
+	uintptr_t end = ( ( uintptr_t ) address + bytes ) / pageSize * pageSize;
+	if ( end <= first )
+	{
+		return;
+	}
+#if _WIN32
+	VirtualUnlock( ( void* ) first, end - first );
+#else
+	munlock( ( const void* ) first, end - first );
+#endif
+}
+
+std::string AudioThread::GetErrorString( int error )
+{
+#if _WIN32
+	return "error " + std::to_string( error );
+#else
+	return strerror( error );
+#endif
+}
+
+void AudioThread::PrintReport( const AudioThreadConfig& config, const AudioThreadReport& report )
+{
+	struct Setting
+	{
+		const char* name;
+		bool requested;
+		bool applied;
+		int error;
+	};
+	const Setting settings[] =
+	{
+		{ "real-time priority", config.realtime, report.realtimeApplied, report.realtimeError },
+		{ "CPU affinity", config.cpu >= 0, report.affinityApplied, report.affinityError },
+		{ "locked mixer memory", config.lockMemory, report.memoryLocked, report.memoryError },
+	};
+
+	for ( const Setting& setting : settings )
+	{
+		if ( !setting.requested )
+		{
+			continue;
+		}
+		std::cout << "Audio thread " << setting.name << ": ";
+		if ( setting.applied )
+		{
+			std::cout << "applied" << std::endl;
+		}
+		else
+		{
+			std::cout << "not applied (" << GetErrorString( setting.error ) << ")" << std::endl;
+		}
+	}
+}
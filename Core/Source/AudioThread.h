@@ -0,0 +1,63 @@
+// AudioThread.h
+// Scheduling for the thread the mixer runs on. FMOD owns that thread and
+// gives it whatever priority it likes, so the mixer configures it itself
+// from inside its first callback: real-time priority, an optional CPU to
+// stay on, and the memory it reads locked so the callback never waits on a
+// page fault. Only the mixer's own state and the sound samples it plays are
+// locked, each region on its own, rather than the whole process.
+// Each of these needs permissions the game may not have, so the outcome
+// of each one is reported rather than treated as an error
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+struct AudioThreadConfig
+{
+	AudioThreadConfig() : realtime( true ), priority( 70 ), cpu( -1 ), lockMemory( true ) {}
+
+	// SCHED_FIFO on Linux, time critical priority on Windows
+	bool realtime;
+	// SCHED_FIFO priority, 1 to 99. Ignored on Windows
+	int priority;
+	// Pins the thread to this CPU. -1 leaves it wherever the OS puts it
+	int cpu;
+	// Locks the mixer's state, and the samples of every resident or
+	// compressed sound as it loads (see AudioMemoryManager::SetLockSamples)
+	bool lockMemory;
+};
+
+// 0 means the setting wasn't asked for. Otherwise the OS error from trying
+struct AudioThreadReport
+{
+	AudioThreadReport() : realtimeApplied( false ), realtimeError( 0 ), affinityApplied( false ), affinityError( 0 ),
+		memoryLocked( false ), memoryError( 0 ) {}
+
+	bool realtimeApplied;
+	int realtimeError;
+	bool affinityApplied;
+	int affinityError;
+	// Just the mixer's state. Sounds are reported as they load
+	bool memoryLocked;
+	int memoryError;
+};
+
+namespace AudioThread
+{
+	// Applies the priority and affinity in config to the calling thread
+	void ConfigureCurrentThread( const AudioThreadConfig& config, AudioThreadReport& report );
+
+	// Makes room to lock bytes more memory. Windows won't lock past the
+	// working set minimum, so it raises that. Elsewhere there's nothing to do
+	void ReserveLockedMemory( size_t bytes );
+	// Locks bytes at address into memory. Returns 0, or the OS error
+	int LockMemory( const void* address, size_t bytes );
+	// Unlocks only the pages that lie wholly inside bytes at address, since
+	// locks aren't counted and a page at either end may hold another region
+	void UnlockMemory( const void* address, size_t bytes );
+	// The OS's description of an error from the functions above
+	std::string GetErrorString( int error );
+
+	// Prints which settings took effect, and why the others didn't
+	void PrintReport( const AudioThreadConfig& config, const AudioThreadReport& report );
+}
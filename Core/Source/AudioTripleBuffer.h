@@ -0,0 +1,46 @@
+// AudioTripleBuffer.h
+// Hands the newest of a stream of values from the mixer callback to the
+// game thread. The producer fills one slot while the consumer reads another,
+// and the third holds the latest finished value. Publishing and picking up
+// are a single atomic exchange, so neither side waits and the consumer
+// never sees a slot that's half written. Values the consumer doesn't get to
+// in time are skipped, not queued
+
+#pragma once
+#include <atomic>
+
+template <typename T>
+class AudioTripleBuffer
+{
+public:
+	AudioTripleBuffer() : items(), shared( 1 ), back( 0 ), front( 2 ) {}
+
+	// Producer only. The slot to fill in before calling Publish. It holds
+	// whatever was there before, so every field should be written
+	T& GetBack() { return items[back]; }
+	void Publish()
+	{
+		back = shared.exchange( back | FRESH, std::memory_order_acq_rel ) & INDEX;
+	}
+
+	// Consumer only. Moves on to the newest published value, if there's been
+	// one since the last call, and returns the one now in front
+	const T& Update()
+	{
+		if ( shared.load( std::memory_order_relaxed ) & FRESH )
+		{
+			front = shared.exchange( front, std::memory_order_acq_rel ) & INDEX;
+		}
+		return items[front];
+	}
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+
+	T items[3];
+	// Index of the middle slot, plus FRESH if the producer has filled it since
+	// the consumer last took it
+	std::atomic<unsigned int> shared;
+	unsigned int back;
+	unsigned int front;
+};
@@ -0,0 +1,469 @@
+#include "ITPEnginePCH.h"
+#include <immintrin.h>
+
+namespace
+{
+	// Pass through: y = x
+	const float IDENTITY[5] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	// Loads array[ids[0..3]] into one register
+	inline __m128 Gather( const float* array, const int* ids )
+	{
+		return _mm_setr_ps( array[ids[0]], array[ids[1]], array[ids[2]], array[ids[3]] );
+	}
+
+	inline void Scatter( float* array, const int* ids, __m128 value )
+	{
+		alignas( 16 ) float temp[4];
+		_mm_store_ps( temp, value );
+		array[ids[0]] = temp[0];
+		array[ids[1]] = temp[1];
+		array[ids[2]] = temp[2];
+		array[ids[3]] = temp[3];
+	}
+
+	// Runs one sample through one transposed direct form II biquad for all four lanes
+	inline __m128 Biquad( __m128 x, const __m128* c, __m128& z1, __m128& z2 )
+	{
+		__m128 y = _mm_add_ps( _mm_mul_ps( c[0], x ), z1 );
+		z1 = _mm_add_ps( _mm_sub_ps( _mm_mul_ps( c[1], x ), _mm_mul_ps( c[3], y ) ), z2 );
+		z2 = _mm_sub_ps( _mm_mul_ps( c[2], x ), _mm_mul_ps( c[4], y ) );
+		return y;
+	}
+
+	AVX2_TARGET inline __m256 GatherAvx( const float* array, const int* ids )
+	{
+		return _mm256_setr_ps( array[ids[0]], array[ids[1]], array[ids[2]], array[ids[3]],
+			array[ids[4]], array[ids[5]], array[ids[6]], array[ids[7]] );
+	}
+
+	AVX2_TARGET inline __m256 BiquadAvx( __m256 x, const __m256* c, __m256& z1, __m256& z2 )
+	{
+		__m256 y = _mm256_add_ps( _mm256_mul_ps( c[0], x ), z1 );
+		z1 = _mm256_add_ps( _mm256_sub_ps( _mm256_mul_ps( c[1], x ), _mm256_mul_ps( c[3], y ) ), z2 );
+		z2 = _mm256_sub_ps( _mm256_mul_ps( c[2], x ), _mm256_mul_ps( c[4], y ) );
+		return y;
+	}
+
+	// Eight samples of eight lanes into eight registers that each hold the
+	// same sample of every lane, or back again
+	AVX2_TARGET inline void Transpose8( __m256* r )
+	{
+		__m256 t0 = _mm256_unpacklo_ps( r[0], r[1] );
+		__m256 t1 = _mm256_unpackhi_ps( r[0], r[1] );
+		__m256 t2 = _mm256_unpacklo_ps( r[2], r[3] );
+		__m256 t3 = _mm256_unpackhi_ps( r[2], r[3] );
+		__m256 t4 = _mm256_unpacklo_ps( r[4], r[5] );
+		__m256 t5 = _mm256_unpackhi_ps( r[4], r[5] );
+		__m256 t6 = _mm256_unpacklo_ps( r[6], r[7] );
+		__m256 t7 = _mm256_unpackhi_ps( r[6], r[7] );
+		__m256 s0 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 s1 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m256 s2 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 s3 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m256 s4 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 s5 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m256 s6 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 s7 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		r[0] = _mm256_permute2f128_ps( s0, s4, 0x20 );
+		r[1] = _mm256_permute2f128_ps( s1, s5, 0x20 );
+		r[2] = _mm256_permute2f128_ps( s2, s6, 0x20 );
+		r[3] = _mm256_permute2f128_ps( s3, s7, 0x20 );
+		r[4] = _mm256_permute2f128_ps( s0, s4, 0x31 );
+		r[5] = _mm256_permute2f128_ps( s1, s5, 0x31 );
+		r[6] = _mm256_permute2f128_ps( s2, s6, 0x31 );
+		r[7] = _mm256_permute2f128_ps( s3, s7, 0x31 );
+	}
+
+	// Cookbook biquad coefficients, normalized so a0 = 1
+	void ComputeCoefficients( bool highPass, float cutoff, float q, float sampleRate, float* out )
+	{
+		float w0 = Math::TwoPi * cutoff / sampleRate;
+		float cosW0 = Math::Cos( w0 );
+		float alpha = Math::Sin( w0 ) / ( 2.0f * q );
+		float invA0 = 1.0f / ( 1.0f + alpha );
+
+		float b1 = highPass ? -( 1.0f + cosW0 ) : 1.0f - cosW0;
+		out[0] = 0.5f * Math::Abs( b1 ) * invA0;
+		out[1] = b1 * invA0;
+		out[2] = out[0];
+		out[3] = -2.0f * cosW0 * invA0;
+		out[4] = ( 1.0f - alpha ) * invA0;
+	}
+}
+
+BiquadFilterBank::BiquadFilterBank( int numFilters, int maxFrames, float sampleRate )
+	: batchSize( 0 ), numFilters( numFilters ), maxFrames( maxFrames ), sampleRate( sampleRate )
+	, groupSize( SampleConvert::GetSimdLevel() == SIMD_AVX2 ? 8 : 4 )
+{
+	DbgAssert( maxFrames % 8 == 0, "Filter block size must be a multiple of 8" );
+
+	// One extra entry for the padding dummy
+	int count = numFilters + 1;
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			current[s][c] = new float[count];
+			target[s][c] = new float[count];
+		}
+		state[s][0] = new float[count];
+		state[s][1] = new float[count];
+	}
+	settleBlocks = new int[count];
+	batch = new int[numFilters];
+
+	// Round up to whole groups so the padding lanes have somewhere to write
+	int numBuffers = ( numFilters + 7 ) & ~7;
+	buffers = ( float* ) _mm_malloc( numBuffers * maxFrames * sizeof( float ), 32 );
+	memset( buffers, 0, numBuffers * maxFrames * sizeof( float ) );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		Reset( i );
+	}
+
+	// The dummy outputs silence
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			current[s][c][numFilters] = 0.0f;
+			target[s][c][numFilters] = 0.0f;
+		}
+	}
+}
+
+BiquadFilterBank::~BiquadFilterBank()
+{
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			delete[] current[s][c];
+			delete[] target[s][c];
+		}
+		delete[] state[s][0];
+		delete[] state[s][1];
+	}
+	delete[] settleBlocks;
+	delete[] batch;
+	_mm_free( buffers );
+}
+
+void BiquadFilterBank::Reset( int filter )
+{
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			current[s][c][filter] = IDENTITY[c];
+			target[s][c][filter] = IDENTITY[c];
+		}
+		state[s][0][filter] = 0.0f;
+		state[s][1][filter] = 0.0f;
+	}
+	settleBlocks[filter] = 0;
+}
+
+void BiquadFilterBank::SetLowPass( int filter, float cutoff, float q )
+{
+	float coefficients[NUM_COEFFICIENTS];
+	if ( cutoff >= FILTER_MAX_CUTOFF )
+	{
+		memcpy( coefficients, IDENTITY, sizeof( coefficients ) );
+	}
+	else
+	{
+		ComputeCoefficients( false, Math::Max( cutoff, FILTER_MIN_CUTOFF ), q, sampleRate, coefficients );
+	}
+	SetTarget( filter, LOW_PASS, coefficients );
+}
+
+void BiquadFilterBank::SetHighPass( int filter, float cutoff, float q )
+{
+	float coefficients[NUM_COEFFICIENTS];
+	if ( cutoff <= FILTER_MIN_CUTOFF )
+	{
+		memcpy( coefficients, IDENTITY, sizeof( coefficients ) );
+	}
+	else
+	{
+		ComputeCoefficients( true, Math::Min( cutoff, FILTER_MAX_CUTOFF ), q, sampleRate, coefficients );
+	}
+	SetTarget( filter, HIGH_PASS, coefficients );
+}
+
+void BiquadFilterBank::SetTarget( int filter, Stage stage, const float* coefficients )
+{
+	for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+	{
+		target[stage][c][filter] = coefficients[c];
+	}
+
+	// One block to interpolate to the new response, and one more so that
+	// when the target is a bypass the history fully drains before the
+	// filter is skipped
+	settleBlocks[filter] = 2;
+}
+
+bool BiquadFilterBank::IsActive( int filter ) const
+{
+	if ( settleBlocks[filter] > 0 )
+	{
+		return true;
+	}
+
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			if ( target[s][c][filter] != IDENTITY[c] )
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void BiquadFilterBank::BeginBatch()
+{
+	batchSize = 0;
+}
+
+float* BiquadFilterBank::AddToBatch( int filter, int frames )
+{
+	float* buffer = GetBatchBuffer( batchSize );
+	memset( buffer, 0, frames * sizeof( float ) );
+	batch[batchSize++] = filter;
+	return buffer;
+}
+
+void BiquadFilterBank::ProcessBatch( int frames )
+{
+	for ( int first = 0; first < batchSize; first += groupSize )
+	{
+		// Pad the last group with the dummy filter, which outputs silence
+		// into a spare buffer nobody reads
+		int ids[8];
+		float* lanes[8];
+		for ( int j = 0; j < groupSize; j++ )
+		{
+			int slot = first + j;
+			ids[j] = slot < batchSize ? batch[slot] : numFilters;
+			lanes[j] = GetBatchBuffer( slot );
+		}
+
+		if ( groupSize == 8 )
+		{
+			ProcessGroupAvx( ids, lanes, frames );
+		}
+		else
+		{
+			ProcessGroup( ids, lanes, frames );
+		}
+	}
+
+	for ( int i = 0; i < batchSize; i++ )
+	{
+		int filter = batch[i];
+		if ( settleBlocks[filter] > 0 && --settleBlocks[filter] == 0 && !IsActive( filter ) )
+		{
+			// Bypassed and drained, so start from silence next time
+			for ( int s = 0; s < NUM_STAGES; s++ )
+			{
+				state[s][0][filter] = 0.0f;
+				state[s][1][filter] = 0.0f;
+			}
+		}
+	}
+}
+
+void BiquadFilterBank::ProcessGroup( const int* ids, float** lanes, int frames )
+{
+	// Load coefficients and history for the four filters, one register per
+	// value, and work out how far to step the coefficients every 4 samples
+	__m128 coef[NUM_STAGES][NUM_COEFFICIENTS];
+	__m128 step[NUM_STAGES][NUM_COEFFICIENTS];
+	__m128 z1[NUM_STAGES];
+	__m128 z2[NUM_STAGES];
+
+	__m128 stepScale = _mm_set_ps1( 4.0f / frames );
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			coef[s][c] = Gather( current[s][c], ids );
+			step[s][c] = _mm_mul_ps( _mm_sub_ps( Gather( target[s][c], ids ), coef[s][c] ), stepScale );
+		}
+		z1[s] = Gather( state[s][0], ids );
+		z2[s] = Gather( state[s][1], ids );
+	}
+
+	// Four samples of four lanes at a time. Transposing turns four
+	// consecutive samples of each lane into four registers that each
+	// hold the same sample index of every lane
+	int n = 0;
+	for ( ; n + 4 <= frames; n += 4 )
+	{
+		__m128 x0 = _mm_load_ps( lanes[0] + n );
+		__m128 x1 = _mm_load_ps( lanes[1] + n );
+		__m128 x2 = _mm_load_ps( lanes[2] + n );
+		__m128 x3 = _mm_load_ps( lanes[3] + n );
+		_MM_TRANSPOSE4_PS( x0, x1, x2, x3 );
+
+		for ( int s = 0; s < NUM_STAGES; s++ )
+		{
+			x0 = Biquad( x0, coef[s], z1[s], z2[s] );
+			x1 = Biquad( x1, coef[s], z1[s], z2[s] );
+			x2 = Biquad( x2, coef[s], z1[s], z2[s] );
+			x3 = Biquad( x3, coef[s], z1[s], z2[s] );
+
+			for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+			{
+				coef[s][c] = _mm_add_ps( coef[s][c], step[s][c] );
+			}
+		}
+
+		_MM_TRANSPOSE4_PS( x0, x1, x2, x3 );
+		_mm_store_ps( lanes[0] + n, x0 );
+		_mm_store_ps( lanes[1] + n, x1 );
+		_mm_store_ps( lanes[2] + n, x2 );
+		_mm_store_ps( lanes[3] + n, x3 );
+	}
+
+	// Leftover samples if frames isn't a multiple of 4. The coefficients
+	// have (almost) reached their targets by now, so they're left alone
+	for ( ; n < frames; n++ )
+	{
+		__m128 x = _mm_setr_ps( lanes[0][n], lanes[1][n], lanes[2][n], lanes[3][n] );
+		for ( int s = 0; s < NUM_STAGES; s++ )
+		{
+			x = Biquad( x, coef[s], z1[s], z2[s] );
+		}
+
+		alignas( 16 ) float y[4];
+		_mm_store_ps( y, x );
+		for ( int j = 0; j < 4; j++ )
+		{
+			lanes[j][n] = y[j];
+		}
+	}
+
+	// Land exactly on the target so rounding in the steps doesn't accumulate
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			Scatter( current[s][c], ids, Gather( target[s][c], ids ) );
+		}
+		Scatter( state[s][0], ids, z1[s] );
+		Scatter( state[s][1], ids, z2[s] );
+	}
+}
+
+AVX2_TARGET void BiquadFilterBank::ProcessGroupAvx( const int* ids, float** lanes, int frames )
+{
+	// ProcessGroup eight filters wide. The coefficients still step every 4
+	// samples, and in the same order, so every lane comes out the same as
+	// it would from ProcessGroup
+	__m256 coef[NUM_STAGES][NUM_COEFFICIENTS];
+	__m256 step[NUM_STAGES][NUM_COEFFICIENTS];
+	__m256 z1[NUM_STAGES];
+	__m256 z2[NUM_STAGES];
+
+	__m256 stepScale = _mm256_set1_ps( 4.0f / frames );
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			coef[s][c] = GatherAvx( current[s][c], ids );
+			step[s][c] = _mm256_mul_ps( _mm256_sub_ps( GatherAvx( target[s][c], ids ), coef[s][c] ), stepScale );
+		}
+		z1[s] = GatherAvx( state[s][0], ids );
+		z2[s] = GatherAvx( state[s][1], ids );
+	}
+
+	int n = 0;
+	for ( ; n + 8 <= frames; n += 8 )
+	{
+		__m256 x[8];
+		for ( int j = 0; j < 8; j++ )
+		{
+			x[j] = _mm256_load_ps( lanes[j] + n );
+		}
+		Transpose8( x );
+
+		for ( int s = 0; s < NUM_STAGES; s++ )
+		{
+			for ( int half = 0; half < 8; half += 4 )
+			{
+				x[half] = BiquadAvx( x[half], coef[s], z1[s], z2[s] );
+				x[half + 1] = BiquadAvx( x[half + 1], coef[s], z1[s], z2[s] );
+				x[half + 2] = BiquadAvx( x[half + 2], coef[s], z1[s], z2[s] );
+				x[half + 3] = BiquadAvx( x[half + 3], coef[s], z1[s], z2[s] );
+
+				for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+				{
+					coef[s][c] = _mm256_add_ps( coef[s][c], step[s][c] );
+				}
+			}
+		}
+
+		Transpose8( x );
+		for ( int j = 0; j < 8; j++ )
+		{
+			_mm256_store_ps( lanes[j] + n, x[j] );
+		}
+	}
+
+	// Leftover samples a frame at a time, still stepping after each whole 4
+	int steppedFrames = frames & ~3;
+	for ( ; n < frames; n++ )
+	{
+		__m256 x = _mm256_setr_ps( lanes[0][n], lanes[1][n], lanes[2][n], lanes[3][n],
+			lanes[4][n], lanes[5][n], lanes[6][n], lanes[7][n] );
+		for ( int s = 0; s < NUM_STAGES; s++ )
+		{
+			x = BiquadAvx( x, coef[s], z1[s], z2[s] );
+		}
+
+		alignas( 32 ) float y[8];
+		_mm256_store_ps( y, x );
+		for ( int j = 0; j < 8; j++ )
+		{
+			lanes[j][n] = y[j];
+		}
+
+		if ( n % 4 == 3 && n < steppedFrames )
+		{
+			for ( int s = 0; s < NUM_STAGES; s++ )
+			{
+				for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+				{
+					coef[s][c] = _mm256_add_ps( coef[s][c], step[s][c] );
+				}
+			}
+		}
+	}
+
+	alignas( 32 ) float z[2][8];
+	for ( int s = 0; s < NUM_STAGES; s++ )
+	{
+		for ( int c = 0; c < NUM_COEFFICIENTS; c++ )
+		{
+			for ( int j = 0; j < 8; j++ )
+			{
+				current[s][c][ids[j]] = target[s][c][ids[j]];
+			}
+		}
+		_mm256_store_ps( z[0], z1[s] );
+		_mm256_store_ps( z[1], z2[s] );
+		for ( int j = 0; j < 8; j++ )
+		{
+			state[s][0][ids[j]] = z[0][j];
+			state[s][1][ids[j]] = z[1][j];
+		}
+	}
+}
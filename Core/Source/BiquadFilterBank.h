@@ -0,0 +1,75 @@
+// BiquadFilterBank.h
+// Low pass + high pass filters for every voice, run eight filters at a time
+// with AVX2 where the CPU has it, or four with SSE. A stereo voice is two
+// filters next to each other in the batch, so a group holds four voices
+// (two with SSE). Each filter is a low pass biquad followed by a high pass
+// biquad. Both widths give the same output, sample for sample.
+// Filter parameters are stored SoA so a batch of filters can be loaded into
+// one register per coefficient, and coefficients are interpolated across each
+// block so parameter changes don't click
+
+#pragma once
+#include <xmmintrin.h>
+
+// Butterworth response, no resonance peak
+#define FILTER_DEFAULT_Q 0.7071f
+// A low pass at or above this cutoff, or a high pass at or below
+// this cutoff, is bypassed
+#define FILTER_MAX_CUTOFF 20000.0f
+#define FILTER_MIN_CUTOFF 10.0f
+
+class BiquadFilterBank
+{
+public:
+	// numFilters filters that can each process up to maxFrames samples per block
+	BiquadFilterBank( int numFilters, int maxFrames, float sampleRate );
+	~BiquadFilterBank();
+
+	// Bypasses filter and clears its history. Call when a voice is reused
+	void Reset( int filter );
+
+	// Sets the target response. The change is interpolated over the next block
+	void SetLowPass( int filter, float cutoff, float q = FILTER_DEFAULT_Q );
+	void SetHighPass( int filter, float cutoff, float q = FILTER_DEFAULT_Q );
+
+	// True if the filter changes the signal, or is still settling after a change.
+	// Voices with no active filters can skip the bank entirely
+	bool IsActive( int filter ) const;
+
+	// A batch is the set of filters to run this block
+	void BeginBatch();
+	// Adds filter to this block's batch and returns a zeroed buffer of
+	// frames samples to write its input into
+	float* AddToBatch( int filter, int frames );
+	// Filters every buffer in the batch in place
+	void ProcessBatch( int frames );
+	float* GetBatchBuffer( int slot ) { return buffers + slot * maxFrames; }
+
+private:
+	enum Stage { LOW_PASS, HIGH_PASS, NUM_STAGES };
+	enum Coefficient { B0, B1, B2, A1, A2, NUM_COEFFICIENTS };
+
+	void SetTarget( int filter, Stage stage, const float* coefficients );
+	// GROUP_SIZE filters (ids) over their buffers (lanes) at once
+	void ProcessGroup( const int* ids, float** lanes, int frames );
+	void ProcessGroupAvx( const int* ids, float** lanes, int frames );
+
+	// Indexed [stage][coefficient][filter]. The extra filter at index numFilters
+	// is an all zero dummy used to pad out partial groups
+	float* current[NUM_STAGES][NUM_COEFFICIENTS];
+	float* target[NUM_STAGES][NUM_COEFFICIENTS];
+	// Transposed direct form II history, [stage][z1 or z2][filter]
+	float* state[NUM_STAGES][2];
+	// Blocks left until a changed filter has settled on its target
+	int* settleBlocks;
+
+	int* batch;
+	int batchSize;
+	float* buffers;
+
+	int numFilters;
+	int maxFrames;
+	float sampleRate;
+	// Filters per group, 8 for AVX2 or 4 for SSE
+	int groupSize;
+};
@@ -49,7 +49,7 @@ void BoxComponent::SetProperties(const rapidjson::Value& properties)
 	Super::SetProperties(properties);
 
 	// Mesh and Scale properties set from JSON
-	std::string mesh;
+	const char* mesh = nullptr;
 	if ( GetStringFromJSON( properties, "mesh", mesh ) )
 	{
 		BoxFromMesh( mOwner.GetGame().GetAssetCache().Load<Mesh>( mesh ) );
@@ -64,3 +64,12 @@ void BoxComponent::SetProperties(const rapidjson::Value& properties)
 	// Since the scale might've updated, update the world bounds
 	OnUpdatedTransform();
 }
+
+void BoxComponent::PreloadProperties(const rapidjson::Value& properties, LevelPreload& preload)
+{
+	const char* mesh = nullptr;
+	if ( GetStringFromJSON( properties, "mesh", mesh ) )
+	{
+		preload.Add<Mesh>( mesh );
+	}
+}
@@ -27,6 +27,8 @@ public:
 	void OnUpdatedTransform() override;
 
 	void SetProperties(const rapidjson::Value& properties) override;
+	// Adds the assets properties refer to, so the level loads them before spawning
+	static void PreloadProperties(const rapidjson::Value& properties, class LevelPreload& preload);
 private:
 	Collision::AxisAlignedBox mModelSpaceBounds;
 	Collision::AxisAlignedBox mWorldSpaceBounds;
@@ -32,6 +32,9 @@ void CameraComponent::Tick(float deltaTime)
 	
 	// Tell the renderer
 	mOwner.GetGame().GetRenderer().UpdateViewMatrix(mCameraMat);
+
+	// Positioned sounds are heard from the camera
+	mOwner.GetGame().GetAudio().SetListener(mCameraMat);
 }
 
 void CameraComponent::SetHorizontalDist(float min, float max)
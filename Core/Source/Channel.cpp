@@ -1,38 +1,264 @@
 #include "ITPEnginePCH.h"
 
-void Channel::Play( Sound* soundToPlay )
+namespace
+{
+	const U32 NO_BLOCK = 0xFFFFFFFF;
+
+	// Moves a gain one frame along its ramp
+	template <bool exponential>
+	void StepGain( float& gain, float step )
+	{
+		if ( exponential )
+		{
+			gain *= step;
+		}
+		else
+		{
+			gain += step;
+		}
+	}
+
+	// Adds frames source frames into left and right, moving each gain along
+	// its own ramp every frame
+	template <bool leftExponential, bool rightExponential>
+	void MixFrames( const PCM16* frame, U32 numChannels, float* left, float* right, int stride, U32 frames,
+		float& leftGain, float& rightGain, float leftStep, float rightStep )
+	{
+		for ( U32 n = 0; n < frames; n++ )
+		{
+			float leftSample = frame[0];
+			float rightSample = numChannels > 1 ? frame[1] : leftSample;
+
+			// Mix on top of whatever the other channels already wrote
+			*left += leftSample * leftGain;
+			*right += rightSample * rightGain;
+
+			StepGain<leftExponential>( leftGain, leftStep );
+			StepGain<rightExponential>( rightGain, rightStep );
+
+			frame += numChannels;
+			left += stride;
+			right += stride;
+		}
+	}
+
+	typedef void ( *MixFunction )( const PCM16* frame, U32 numChannels, float* left, float* right, int stride, U32 frames,
+		float& leftGain, float& rightGain, float leftStep, float rightStep );
+	// Indexed by whether the left and then the right ramp is exponential
+	const MixFunction mixFunctions[2][2] =
+	{
+		{ MixFrames<false, false>, MixFrames<false, true> },
+		{ MixFrames<true, false>, MixFrames<true, true> }
+	};
+
+	// Moves a gain along its ramp as if frames frames had been mixed
+	void SkipGain( U32 frames, bool exponential, float& gain, float step )
+	{
+		if ( exponential )
+		{
+			gain *= powf( step, ( float ) frames );
+		}
+		else
+		{
+			gain += step * frames;
+		}
+	}
+}
+
+Channel::Channel()
+	: sound( 0 ), stream( 0 ), decodeBuffer( ADPCM_BLOCK_FRAMES * 2 ), decodedBlock( NO_BLOCK )
+	, position( 0 ), startClock( 0 ), stopClock( ~0ULL ), volume( 1.0f ), pan( 0.0f ), leftGain( 1.0f ), rightGain( 1.0f )
+	, paused( false ), loop( false ), started( false ), keepTime( false ), streamSkip( 0 )
+{
+}
+
+void Channel::Play( Sound* soundToPlay, U64 startAt, bool keepsTime )
 {
 	sound = soundToPlay;
+	stream = 0;
+	decodedBlock = NO_BLOCK;
 	position = 0;
+	startClock = startAt;
+	stopClock = ~0ULL;
+	started = false;
+	keepTime = keepsTime;
+	streamSkip = 0;
+}
+
+void Channel::Start( U64 late )
+{
+	started = true;
+	if ( !keepTime || late == 0 )
+	{
+		return;
+	}
+
+	// A stream hasn't been read past its buffer yet, so it drops frames as
+	// they arrive instead
+	if ( stream )
+	{
+		streamSkip = late;
+		return;
+	}
+
+	U64 target = position + late;
+	U32 loopStart = sound->loopStart;
+	U32 loopEnd = sound->loopEnd;
+	if ( loop && loopEnd > loopStart && target >= loopEnd )
+	{
+		target = loopStart + ( target - loopStart ) % ( loopEnd - loopStart );
+	}
+	else if ( !loop && target >= sound->trimmedHead + sound->GetNumFrames() )
+	{
+		Stop();
+		return;
+	}
+	position = ( U32 ) target;
 }
 
 void Channel::Stop()
 {
 	sound = 0;
+	stream = 0;
+	started = false;
+}
+
+bool Channel::IsPrimed() const
+{
+	return sound->storage != STORAGE_STREAMED || ( stream != 0 && stream->IsPrimed() );
 }
 
-void Channel::SetVolume( float newVolume )
+void Channel::SetLooping( bool isLooping )
+{
+	loop = isLooping;
+	if ( stream )
+	{
+		stream->SetLooping( isLooping );
+	}
+}
+
+U32 Channel::GetFrames( const PCM16*& frames )
+{
+	U32 numChannels = sound->numChannels;
+	U32 frame = position - sound->trimmedHead;
+	switch ( sound->storage )
+	{
+	case STORAGE_COMPRESSED:
+	{
+		U32 block = frame / ADPCM_BLOCK_FRAMES;
+		if ( block != decodedBlock )
+		{
+			ImaAdpcm::DecodeBlock( &sound->compressed[block * ImaAdpcm::GetBlockSize( numChannels )], numChannels, decodeBuffer.data() );
+			decodedBlock = block;
+		}
+		U32 offset = frame - block * ADPCM_BLOCK_FRAMES;
+		frames = decodeBuffer.data() + offset * numChannels;
+		return ADPCM_BLOCK_FRAMES - offset;
+	}
+	case STORAGE_STREAMED:
+		return stream ? stream->Peek( frames ) : 0;
+	default:
+		frames = sound->data + frame * numChannels;
+		return sound->GetNumFrames() - frame;
+	}
+}
+
+void Channel::SetVolume( float newVolume, RampShape shape )
 {
 	// 0 = silence, 1 = full volume
-	volume = max( newVolume, 0.0f );
-	volume = min( newVolume, 1.0f );
+	volume = Math::Clamp( newVolume, 0.0f, 1.0f );
+	UpdateGains( shape );
+}
+
+void Channel::SetPan( float newPan, RampShape shape )
+{
+	pan = Math::Clamp( newPan, -1.0f, 1.0f );
+	UpdateGains( shape );
 }
 
-void Channel::WriteSoundData( PCM16* data, int count )
+void Channel::UpdateGains( RampShape shape )
 {
-	if ( sound == 0 || paused )
+	// Balance: centered leaves both sides at full volume, and panning fades
+	// the far side out along a quarter cosine
+	float left = volume * ( pan > 0.0f ? Math::Cos( pan * Math::PiOver2 ) : 1.0f );
+	float right = volume * ( pan < 0.0f ? Math::Cos( pan * Math::PiOver2 ) : 1.0f );
+	if ( started )
+	{
+		leftGain.SetTarget( left, shape );
+		rightGain.SetTarget( right, shape );
+	}
+	else
+	{
+		leftGain.Reset( left );
+		rightGain.Reset( right );
+	}
+}
+
+void Channel::WriteSoundData( float* left, float* right, int stride, int frames )
+{
+	if ( sound == 0 || !started || paused )
+		return;
+
+	// Sound data is interleaved, so one frame holds a sample per source channel
+	U32 numChannels = sound->numChannels;
+	U32 frameCount = sound->GetNumFrames();
+	if ( frameCount == 0 )
+	{
+		Stop();
+		return;
+	}
+
+	// position counts the silence trimmed from either end of the sound, which
+	// is played back by skipping over it. Streams have it in their buffer
+	U32 head = sound->trimmedHead;
+	U32 soundEnd = head + frameCount;
+
+	// Nothing left that can be heard at this volume, so skip ahead without
+	// mixing. The voice still ends at the same time, and comes back if the
+	// volume goes up again. Streams have to be read in order, so they can't
+	float loudestGain = Math::Max( leftGain.GetValue(), rightGain.GetValue() );
+	if ( !loop && stream == 0 && !leftGain.IsRamping() && !rightGain.IsRamping() &&
+		sound->GetTailPeak( position > head ? position - head : 0 ) * loudestGain < SOUND_SILENCE_THRESHOLD )
+	{
+		position += frames;
+		if ( position >= soundEnd )
+		{
+			Stop();
+		}
 		return;
+	}
+
+	// A looping voice wraps at the sound's loop points. Streams loop as
+	// they're read, so the mixer only sees one long run of frames
+	U32 end = loop ? sound->loopEnd : soundEnd;
+
+	// Where the gains start and how they move this block. 16 bit samples are
+	// scaled into [-1, 1] by the same multiply. Each side ramps with its own
+	// shape, so a pan glides linearly even while a fade is exponential
+	float leftScale, rightScale, leftStep, rightStep;
+	bool leftExponential = leftGain.BeginBlock( frames, leftScale, leftStep ) == RAMP_EXPONENTIAL;
+	bool rightExponential = rightGain.BeginBlock( frames, rightScale, rightStep ) == RAMP_EXPONENTIAL;
+	leftScale /= 32768.0f;
+	rightScale /= 32768.0f;
+	if ( !leftExponential )
+	{
+		leftStep /= 32768.0f;
+	}
+	if ( !rightExponential )
+	{
+		rightStep /= 32768.0f;
+	}
+	MixFunction mixFrames = mixFunctions[leftExponential][rightExponential];
 
-	// Write samples to array
-	// Increment in pairs because output is stereo
-	for ( int i = 0; i < count; i += 2 )
+	// Write samples to array, one contiguous run of source frames at a time
+	while ( frames > 0 )
 	{
-		if ( position >= sound->count )
+		if ( stream == 0 && position >= end )
 		{
 			if ( loop )
 			{
-				// Instead of stopping, set position back to beginning
-				position = 0;
+				// Instead of stopping, jump back to the loop start
+				position = sound->loopStart;
 			}
 			else
 			{
@@ -41,13 +267,61 @@ void Channel::WriteSoundData( PCM16* data, int count )
 			}
 		}
 
-		// Multiply value of audio data by volume before writing to output
-		PCM16 curVal = ( PCM16 ) sound->data[position] * volume;
+		// Trimmed silence: nothing to mix, but the gains still move on
+		if ( stream == 0 && ( position < head || position >= soundEnd ) )
+		{
+			U32 run = Math::Min( ( position < head ? head : end ) - position, ( U32 ) frames );
+			SkipGain( run, leftExponential, leftScale, leftStep );
+			SkipGain( run, rightExponential, rightScale, rightStep );
+			left += run * stride;
+			right += run * stride;
+			frames -= run;
+			position += run;
+			continue;
+		}
 
-		// Channels for both left and right
-		data[i] = curVal;
-		data[i+1] = curVal;
+		const PCM16* frame;
+		U32 run = GetFrames( frame );
+		if ( run == 0 )
+		{
+			// A stream that has fallen behind the loader is silent until it
+			// catches up, rather than stopping. One that keeps time skips
+			// what it missed once it has
+			if ( stream && stream->IsFinished() )
+			{
+				Stop();
+			}
+			else if ( keepTime )
+			{
+				streamSkip += frames;
+			}
+			return;
+		}
+		if ( streamSkip > 0 )
+		{
+			run = ( U32 ) Math::Min( ( U64 ) run, streamSkip );
+			stream->Consume( run );
+			streamSkip -= run;
+			continue;
+		}
+		if ( stream == 0 )
+		{
+			run = Math::Min( run, end - position );
+		}
+		run = Math::Min( run, ( U32 ) frames );
 
-		position++; // increments sample
+		mixFrames( frame, numChannels, left, right, stride, run, leftScale, rightScale, leftStep, rightStep );
+		left += run * stride;
+		right += run * stride;
+
+		frames -= run;
+		if ( stream )
+		{
+			stream->Consume( run );
+		}
+		else
+		{
+			position += run;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -1,28 +1,83 @@
 #pragma once
 #include "Sound.h"
+#include "ImaAdpcm.h"
+#include "SoundStream.h"
+#include "ParamRamp.h"
+#include <vector>
 
-// Encapsulates data and behaviors for playing sounds
+// Encapsulates data and behaviors for playing sounds.
+// Channels are owned by the mixer and only touched on the audio thread
 class Channel
 {
 public:
-	Channel() : sound( 0 ), position( 0 ) {}
-	void Play( Sound* soundToPlay );
+	Channel();
+
+	// Assigns soundToPlay to this channel. The channel stays pending until
+	// Start is called, which the mixer does at startAt on its sample clock
+	// once the sound's data is ready. A channel that keeps time stays in step
+	// with that clock when it starts late, or its stream falls behind
+	void Play( Sound* soundToPlay, U64 startAt, bool keepsTime );
+	// late is how many frames after startAt this is. A channel that keeps
+	// time starts that far into the sound, and stops if that's past the end
+	void Start( U64 late );
 	void Stop();
-	void WriteSoundData( PCM16* data, int count );
+
+	// Where a STORAGE_STREAMED sound reads from. Set after Play; the game
+	// thread keeps the stream alive until the voice has finished
+	void SetStream( SoundStream* newStream ) { stream = newStream; }
+	// False while a streamed sound is still filling its buffer
+	bool IsPrimed() const;
+
+	// Adds up to frames stereo frames of this channel into data
+	void WriteSoundData( float* data, int frames ) { WriteSoundData( data, data + 1, 2, frames ); }
+	// Same, but with the left and right outputs in separate buffers that
+	// advance stride floats per frame
+	void WriteSoundData( float* left, float* right, int stride, int frames );
+
+	Sound* GetSound() const { return sound; }
+	bool IsPlaying() const { return sound != 0; }
+	bool IsPending() const { return sound != 0 && !started; }
+	U64 GetStartClock() const { return startClock; }
+	// The mixer stops the channel at this clock. Cleared by Play
+	void SetStopClock( U64 clock ) { stopClock = clock; }
+	U64 GetStopClock() const { return stopClock; }
 
 	void SetPaused( bool isPaused ) { paused = isPaused; }
 	bool GetPaused() const { return paused; }
 
-	void SetLooping( bool isLooping ) { loop = isLooping; }
+	void SetLooping( bool isLooping );
 	bool GetLooping() const { return loop; }
 
-	void SetVolume( float newVolume );
+	// Volume and pan glide to their new values over the next block written,
+	// unless the channel hasn't started yet. Pan is -1 (left) to 1 (right)
+	void SetVolume( float newVolume, RampShape shape = RAMP_LINEAR );
 	float GetVolume() const { return volume; }
+	void SetPan( float newPan, RampShape shape = RAMP_LINEAR );
+	float GetPan() const { return pan; }
 
 private:
+	// Points frames at the samples from position on, in whichever storage the
+	// sound uses, and returns how many frames can be read from there
+	U32 GetFrames( const PCM16*& frames );
+	// Retargets the output gains from volume and pan
+	void UpdateGains( RampShape shape );
+
 	Sound* sound;
-	uint16_t position;
+	SoundStream* stream;
+	// One block of a STORAGE_COMPRESSED sound, decoded
+	std::vector<PCM16> decodeBuffer;
+	U32 decodedBlock;
+	U32 position;
+	U64 startClock;
+	U64 stopClock;
 	float volume;
+	float pan;
+	ParamRamp leftGain;
+	ParamRamp rightGain;
 	bool paused;
 	bool loop;
-};
\ No newline at end of file
+	bool started;
+	bool keepTime;
+	// Frames a stream still has to drop to catch up with the clock
+	U64 streamSkip;
+};
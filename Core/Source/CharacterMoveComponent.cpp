@@ -129,7 +129,7 @@ void CharacterMoveComponent::SetProperties(const rapidjson::Value& properties)
 	{
 		const rapidjson::Value& anims = properties["animations"];
 		
-		std::string animName;
+		const char* animName = nullptr;
 		if (GetStringFromJSON(anims, "idle", animName))
 		{
 			SetAnimation(CM_Idle, mOwner.GetGame().GetAssetCache().Load<Animation>(animName));
@@ -162,6 +162,24 @@ void CharacterMoveComponent::SetProperties(const rapidjson::Value& properties)
 	}
 }
 
+void CharacterMoveComponent::PreloadProperties(const rapidjson::Value& properties, LevelPreload& preload)
+{
+	auto anims = properties.FindMember("animations");
+	if (anims == properties.MemberEnd() || !anims->value.IsObject())
+	{
+		return;
+	}
+
+	// Every animation is preloaded, whichever state it's for
+	for (auto iter = anims->value.MemberBegin(); iter != anims->value.MemberEnd(); ++iter)
+	{
+		if (iter->value.IsString())
+		{
+			preload.Add<Animation>(iter->value.GetString());
+		}
+	}
+}
+
 bool CharacterMoveComponent::CheckFootCast(CollisionComponentPtr& outComp, Vector3& outPos)
 {
 	Vector3 start = mOwner.GetPosition();
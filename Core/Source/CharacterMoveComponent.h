@@ -45,6 +45,8 @@ public:
 	float GetFootCastOffset() const { return mFootCastOffset; }
 
 	void SetProperties(const rapidjson::Value& properties) override;
+	// Adds the assets properties refer to, so the level loads them before spawning
+	static void PreloadProperties(const rapidjson::Value& properties, class LevelPreload& preload);
 protected:
 	bool CheckFootCast(CollisionComponentPtr& outComp, Vector3& outPos);
 	void SetState(ECharState newState);
@@ -20,13 +20,13 @@ namespace Collision
 		// to determine the model space bounding box
 		void UpdateMinMax(const Vector3& point)
 		{
-			mMin.x = min( mMin.x, point.x );
-			mMin.y = min( mMin.y, point.y );
-			mMin.z = min( mMin.z, point.z );
+			mMin.x = Math::Min( mMin.x, point.x );
+			mMin.y = Math::Min( mMin.y, point.y );
+			mMin.z = Math::Min( mMin.z, point.z );
 
-			mMax.x = max( mMax.x, point.x );
-			mMax.y = max( mMax.y, point.y );
-			mMax.z = max( mMax.z, point.z );
+			mMax.x = Math::Max( mMax.x, point.x );
+			mMax.y = Math::Max( mMax.y, point.y );
+			mMax.z = Math::Max( mMax.z, point.z );
 		}
 	};
 
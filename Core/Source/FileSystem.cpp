@@ -0,0 +1,134 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+
+namespace
+{
+	MappedFile sArchive;
+	const PackFormat::Header* sHeader = nullptr;
+	std::string sRoot;
+}
+
+bool FileSystem::Mount(const char* archiveName, const char* root)
+{
+	Unmount();
+	if (!sArchive.Open(archiveName))
+	{
+		return false;
+	}
+
+	sHeader = PackFormat::GetHeader(sArchive.GetData(), sArchive.GetSize());
+	if (sHeader == nullptr)
+	{
+		SDL_Log("%s isn't a valid archive. Reading files from disk instead.", archiveName);
+		sArchive.Close();
+		return false;
+	}
+	sRoot = root;
+	return true;
+}
+
+void FileSystem::Unmount()
+{
+	sHeader = nullptr;
+	sArchive.Close();
+	sRoot.clear();
+}
+
+bool FileSystem::IsMounted()
+{
+	return sHeader != nullptr;
+}
+
+bool FileSystem::IsInArchive(const char* fileName)
+{
+	return FindEntry(fileName) != nullptr;
+}
+
+void FileSystem::Prefetch(const char* fileName)
+{
+	if (sHeader == nullptr)
+	{
+		return;
+	}
+
+	std::string cookedName(fileName);
+	cookedName += ".cooked";
+	const PackFormat::Entry* entry = FindEntry(cookedName.c_str());
+	if (entry == nullptr)
+	{
+		entry = FindEntry(fileName);
+	}
+	if (entry != nullptr)
+	{
+		sArchive.Prefetch(static_cast<size_t>(entry->mOffset), entry->mStoredSize);
+	}
+}
+
+const PackFormat::Entry* FileSystem::FindEntry(const char* fileName)
+{
+	// Entries are named relative to the root
+	if (sHeader == nullptr || strncmp(fileName, sRoot.c_str(), sRoot.size()) != 0)
+	{
+		return nullptr;
+	}
+	return PackFormat::FindEntry(*sHeader, AssetId(fileName + sRoot.size()));
+}
+
+const char* FileSystem::GetEntryData(const PackFormat::Entry& entry)
+{
+	return static_cast<const char*>(sArchive.GetData()) + entry.mOffset;
+}
+
+VirtualFile::VirtualFile()
+	:mData(nullptr)
+	,mSize(0)
+{
+
+}
+
+bool VirtualFile::Open(const char* fileName)
+{
+	Close();
+
+	const PackFormat::Entry* entry = FileSystem::FindEntry(fileName);
+	if (entry == nullptr)
+	{
+		if (!mFile.Open(fileName))
+		{
+			return false;
+		}
+		mData = mFile.GetData();
+		mSize = mFile.GetSize();
+		LoadProfiler::AddBytesRead(mSize);
+		return true;
+	}
+
+	const char* data = FileSystem::GetEntryData(*entry);
+	if ((entry->mFlags & PackFormat::FLAG_LZ4) == 0)
+	{
+		mData = data;
+		mSize = entry->mSize;
+		LoadProfiler::AddBytesRead(mSize);
+		return true;
+	}
+
+	mBuffer.resize(entry->mSize);
+	if (!Lz4::Decompress(data, entry->mStoredSize, mBuffer.data(), mBuffer.size()))
+	{
+		SDL_Log("%s is corrupt in the archive", fileName);
+		std::vector<char>().swap(mBuffer);
+		return false;
+	}
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+	LoadProfiler::AddBytesRead(mSize);
+	return true;
+}
+
+void VirtualFile::Close()
+{
+	mFile.Close();
+	std::vector<char>().swap(mBuffer);
+	mData = nullptr;
+	mSize = 0;
+}
@@ -0,0 +1,74 @@
+// FileSystem.h
+// Where the asset loaders read their files from. Normally those are just
+// the files on disk, but once an archive packed by the asset cooker is
+// mounted (see PackFormat), any file under the mounted root that's in the
+// archive is read from it instead. The whole archive is mapped once, so
+// opening a file in it is a binary search of its entry table, with no
+// calls to the OS at all. Files stored as they are can be used where they
+// are in the mapping; compressed ones are decompressed into a buffer.
+//
+// Mount before anything starts loading, since files are read from the
+// archive without any locking.
+//
+// Generally will be used like:
+// VirtualFile file;
+// if (file.Open("Assets/path/file.name")) { use file.GetData() and file.GetSize() }
+
+#pragma once
+#include <vector>
+#include "MappedFile.h"
+#include "PackFormat.h"
+
+class FileSystem
+{
+public:
+	// Maps archiveName and reads files under root from it from now on.
+	// Returns false, and carries on reading files from disk, if it's not
+	// there or not valid
+	static bool Mount(const char* archiveName, const char* root);
+	// Nothing read from the archive can still be open. Otherwise the
+	// archive stays mapped until the program exits
+	static void Unmount();
+	static bool IsMounted();
+
+	// True if fileName is in the mounted archive
+	static bool IsInArchive(const char* fileName);
+
+	// Hints that fileName (or its cooked version, if that's in the archive,
+	// since that's what'll be read) is about to be loaded, so the OS can
+	// start reading its part of the archive in now. Does nothing for a
+	// file that isn't in the archive
+	static void Prefetch(const char* fileName);
+private:
+	friend class VirtualFile;
+
+	// The archive's entry for fileName, or null if it isn't in the archive
+	static const PackFormat::Entry* FindEntry(const char* fileName);
+	static const char* GetEntryData(const PackFormat::Entry& entry);
+};
+
+// A file's contents, read through the FileSystem
+class VirtualFile
+{
+public:
+	VirtualFile();
+
+	// Closes whatever was open first. Returns false if the file couldn't
+	// be read, or is empty
+	bool Open(const char* fileName);
+	void Close();
+
+	bool IsOpen() const { return mData != nullptr; }
+	const void* GetData() const { return mData; }
+	size_t GetSize() const { return mSize; }
+private:
+	VirtualFile(const VirtualFile&) = delete;
+	VirtualFile& operator=(const VirtualFile&) = delete;
+
+	// A file on disk is mapped, and a compressed one is decompressed into
+	// mBuffer. mData points into one of those, or the archive
+	MappedFile mFile;
+	std::vector<char> mBuffer;
+	const void* mData;
+	size_t mSize;
+};
@@ -17,6 +17,12 @@ Font::~Font()
 
 bool Font::Load(const char* fileName, class AssetCache* cache)
 {
+	if (!mFile.Open(fileName))
+	{
+		SDL_Log("File not found: Font %s", fileName);
+		return false;
+	}
+
 	std::vector<int> fontSizes = {
 		8, 9,
 		10, 11, 12, 14, 16, 18,
@@ -28,9 +34,11 @@ bool Font::Load(const char* fileName, class AssetCache* cache)
 		72
 	};
 
+	LoadPhase phase(ELP_Parse);
 	for (auto& size : fontSizes)
 	{
-		TTF_Font* font = TTF_OpenFont(fileName, size);
+		SDL_RWops* file = SDL_RWFromConstMem(mFile.GetData(), static_cast<int>(mFile.GetSize()));
+		TTF_Font* font = TTF_OpenFontRW(file, 1, size);
 		if (!font)
 		{
 			SDL_Log("Failed to load font %s in size %d", fileName, size);
@@ -1,5 +1,6 @@
 #pragma once
 #include "Asset.h"
+#include "FileSystem.h"
 #include <unordered_map>
 #include <SDL/SDL_ttf.h>
 
@@ -15,6 +16,9 @@ public:
 	TTF_Font* GetFontData(int pointSize);
 private:
 	std::unordered_map<int, TTF_Font*> mFontData;
+	// SDL_ttf reads the glyphs from the file as they're needed, so it's
+	// kept open for as long as the fonts are
+	VirtualFile mFile;
 };
 
 DECL_PTR(Font);
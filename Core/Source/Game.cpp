@@ -2,9 +2,12 @@
 #include <SDL/SDL_mixer.h>
 #include "Player.h"
 
-Game::Game()
+Game::Game(SpeakerLayout speakers)
 	:mRenderer(*this)
 	,mAssetCache(*this, "Assets/")
+	,mAudio(AudioThreadConfig(), AUDIO_OUTPUT_DEVICE, speakers)
+	,mMusic(mAudio)
+	,mReverbZones(mAudio)
 	,mShouldQuit(false)
 {
 
@@ -21,6 +24,12 @@ Game::~Game()
 
 bool Game::Init()
 {
+	// Read the assets from the archive the asset cooker packed, if there is one
+	if (FileSystem::Mount("Assets.itppak", "Assets/"))
+	{
+		SDL_Log("Reading assets from Assets.itppak");
+	}
+
 	// Initialize SDL
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0)
 	{
@@ -81,8 +90,8 @@ void Game::Quit()
 
 void Game::StartGame()
 {
-	LevelLoader loader( *this );
-	loader.Load( "Assets/Levels/lab5.itplevel" );
+	LevelLoader loader( *this );
+	loader.Load( "Assets/Levels/lab5.itplevel" );
 }
 
 void Game::ProcessInput()
@@ -127,6 +136,9 @@ void Game::Tick()
 	// Lock @ 60 FPS
 	float deltaTime = mTimer.GetFrameTime(0.016666f);
 
+	// Finish any assets that have loaded in the background
+	mAssetCache.Update();
+
 	mGameTimers.Tick(deltaTime);
 
 	// Update game world
@@ -134,6 +146,13 @@ void Game::Tick()
 
 	// Update physics world
 	mPhysWorld.Tick(deltaTime);
+
+	// The camera has moved, so pick up the reverb for where it is now
+	mReverbZones.Update(deltaTime);
+
+	// Hand finished voices back to the audio system
+	mAudio.Update();
+	mMusic.Update();
 }
 
 void Game::GenerateOutput()
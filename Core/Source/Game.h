@@ -7,14 +7,19 @@
 #include "FrameTimer.h"
 #include "World.h"
 #include "AssetCache.h"
+#include "JobSystem.h"
 #include "PhysWorld.h"
 #include "GameTimers.h"
 #include "InputManager.h"
+#include "AudioSystem.h"
+#include "MusicSystem.h"
+#include "ReverbZoneManager.h"
 
 class Game
 {
 public:
-	Game();
+	// speakers is the layout the audio is mixed for
+	Game(SpeakerLayout speakers = SPEAKERS_STEREO);
 	~Game();
 	bool Init();
 	void RunLoop();
@@ -23,9 +28,13 @@ public:
 	Renderer& GetRenderer() { return mRenderer; }
 	World& GetWorld() { return mWorld; }
 	AssetCache& GetAssetCache() { return mAssetCache; }
+	JobSystem& GetJobs() { return mJobs; }
 	PhysWorld& GetPhysWorld() { return mPhysWorld; }
 	GameTimerManager& GetGameTimers() { return mGameTimers; }
 	InputManager& GetInput() { return mInput; }
+	AudioSystem& GetAudio() { return mAudio; }
+	MusicSystem& GetMusic() { return mMusic; }
+	ReverbZoneManager& GetReverbZones() { return mReverbZones; }
 private:
 	void StartGame();
 	
@@ -45,6 +54,11 @@ private:
 	PhysWorld mPhysWorld;
 	GameTimerManager mGameTimers;
 	InputManager mInput;
+	AudioSystem mAudio;
+	MusicSystem mMusic;
+	ReverbZoneManager mReverbZones;
+	// Declared last, so the workers stop before anything their jobs use is destroyed
+	JobSystem mJobs;
 
 	bool mShouldQuit;
 };
@@ -21,6 +21,48 @@ namespace
 		inResource->Release();
 	}
 
+	// Opens a shader's #includes through the FileSystem, relative to the
+	// shader, the way D3D_COMPILE_STANDARD_FILE_INCLUDE would from disk
+	class VirtualFileInclude : public ID3DInclude
+	{
+	public:
+		VirtualFileInclude( const char* inShaderFileName )
+		{
+			std::string fileName( inShaderFileName );
+			size_t slash = fileName.find_last_of( "/\\" );
+			mDirectory = slash != std::string::npos ? fileName.substr( 0, slash + 1 ) : std::string();
+		}
+
+		HRESULT __stdcall Open( D3D_INCLUDE_TYPE inIncludeType, LPCSTR inFileName, LPCVOID inParentData, LPCVOID* outData, UINT* outBytes ) override
+		{
+			std::unique_ptr< VirtualFile > file( new VirtualFile() );
+			if( !file->Open( ( mDirectory + inFileName ).c_str() ) )
+			{
+				return E_FAIL;
+			}
+			*outData = file->GetData();
+			*outBytes = static_cast< UINT >( file->GetSize() );
+			mFiles.emplace_back( std::move( file ) );
+			return S_OK;
+		}
+
+		HRESULT __stdcall Close( LPCVOID inData ) override
+		{
+			for( auto iter = mFiles.begin(); iter != mFiles.end(); ++iter )
+			{
+				if( ( *iter )->GetData() == inData )
+				{
+					mFiles.erase( iter );
+					break;
+				}
+			}
+			return S_OK;
+		}
+	private:
+		std::string mDirectory;
+		std::vector< std::unique_ptr< VirtualFile > > mFiles;
+	};
+
 
 	void CreateInternalDevice()
 	{
@@ -270,14 +312,20 @@ bool GraphicsDriver::CompileShaderFromFile( const char* inFileName, const char*
 	dwShaderFlags |= D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
-	const size_t cSize = strlen(inFileName) + 1;
-	size_t retCount;
-	std::wstring wc(cSize, L'#');
-	mbstowcs_s(&retCount, &wc[0], cSize, inFileName, _TRUNCATE);
-	
+	// Read through the FileSystem, so the shader can come from an archive
+	VirtualFile source;
+	if( !source.Open( inFileName ) )
+	{
+		OutputDebugStringA( "Shader file not found: " );
+		OutputDebugStringA( inFileName );
+		OutputDebugStringA( "\n" );
+		return false;
+	}
+
+	VirtualFileInclude include( inFileName );
 	ID3DBlob* pErrorBlob = nullptr;
 	ID3DBlob* pBlobOut = nullptr;
-	hr = D3DCompileFromFile(wc.c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, szEntryPoint, szShaderModel,
+	hr = D3DCompile(source.GetData(), source.GetSize(), inFileName, nullptr, &include, szEntryPoint, szShaderModel,
 							 dwShaderFlags, 0, &pBlobOut, &pErrorBlob);
 	if( FAILED( hr ) )
 	{
@@ -450,33 +498,27 @@ GraphicsBufferPtr GraphicsDriver::CreateGraphicsBuffer(const void* inRawData, in
 	return GraphicsBufferPtr(toRet, AutoReleaseD3D);
 }
 
-GraphicsTexturePtr GraphicsDriver::CreateTextureFromFile(const char* inFileName, int& outWidth, int& outHeight)
+GraphicsTexturePtr GraphicsDriver::CreateTextureFromFileData(const char* inFileName, const void* inData, size_t inSize, int& outWidth, int& outHeight)
 {
 	std::string fileStr(inFileName);
 	std::string extension = fileStr.substr(fileStr.find_last_of('.'));
-	
-	//erg, convert to widechar...
-	const size_t cSize = strlen(inFileName) + 1;
-	size_t retCount;
-	std::wstring wc(cSize, L'#');
-	mbstowcs_s(&retCount, &wc[0], cSize, inFileName, _TRUNCATE);
+
 	ID3D11ShaderResourceView* toRet = nullptr;
 	ID3D11Resource* texture = nullptr;
 	HRESULT hr = -1;
 	if (extension == ".dds" || extension == ".DDS")
 	{
-		hr = CreateDDSTextureFromFile(g_pd3dDevice, wc.c_str(), &texture, &toRet);
+		hr = CreateDDSTextureFromMemory(g_pd3dDevice, static_cast<const uint8_t*>(inData), inSize, &texture, &toRet);
 	}
 	else if (extension == ".png" || extension == ".bmp" || extension == ".PNG" || extension == ".BMP")
 	{
-		hr = CreateWICTextureFromFile(g_pd3dDevice, wc.c_str(), &texture, &toRet);
+		hr = CreateWICTextureFromMemory(g_pd3dDevice, static_cast<const uint8_t*>(inData), inSize, &texture, &toRet);
 	}
 	else
 	{
 		OutputDebugString(L"GraphicsDriver can only load images of type DDS, PNG, or BMP.");
 	}
 	DbgAssert( hr == S_OK, "Problem Creating Texture From File" );
-	
 
 	CD3D11_TEXTURE2D_DESC textureDesc;
 	((ID3D11Texture2D*)texture)->GetDesc(&textureDesc);
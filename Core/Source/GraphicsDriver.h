@@ -118,7 +118,9 @@ public:
 	InputLayoutPtr CreateInputLayout(const InputLayoutElement* inElements, int inNumElements, const std::vector<char>& inCompiledVertexShader);
 	GraphicsBufferPtr CreateGraphicsBuffer(const void* inRawData, int inRawDataSize, EBindflags inBindFlags, ECPUAccessFlags inCPUAccessFlags, EGraphicsBufferUsage inUsage);
 	SamplerStatePtr CreateSamplerState();
-	GraphicsTexturePtr CreateTextureFromFile(const char* inFileName, int& outWidth, int& outHeight);
+	// Creates a DDS, PNG or BMP texture from the contents of the file, already
+	// read into memory. inFileName is only used for its extension
+	GraphicsTexturePtr CreateTextureFromFileData(const char* inFileName, const void* inData, size_t inSize, int& outWidth, int& outHeight);
 	GraphicsTexturePtr CreateTextureFromMemory(const void* inPixels, int inWidth, int inHeight, ETextureFormat inTextureFormat);
 	DepthStencilPtr CreateDepthStencil(int inWidth, int inHeight);
 	DepthStencilStatePtr CreateDepthStencilState(bool inDepthTestEnable, EComparisonFunc inDepthComparisonFunction);
@@ -0,0 +1,331 @@
+#include "ITPEnginePCH.h"
+
+namespace
+{
+	// Spherical head model
+	const float HEAD_RADIUS = 0.0875f;
+	const float SPEED_OF_SOUND = 343.0f;
+	// Head shadow: high frequencies are boosted 6dB straight into the ear,
+	// and cut by ALPHA_MIN at THETA_MIN degrees away from it
+	const float ALPHA_MIN = 0.1f;
+	const float THETA_MIN = 150.0f;
+
+	// Pinna echoes: reflection strength, and the delay terms in samples at 44.1kHz
+	const int NUM_PINNA_ECHOES = 5;
+	const float PINNA_RHO[NUM_PINNA_ECHOES] = { 0.5f, -1.0f, 0.5f, -0.25f, 0.25f };
+	const float PINNA_A[NUM_PINNA_ECHOES] = { 1.0f, 5.0f, 5.0f, 5.0f, 5.0f };
+	const float PINNA_B[NUM_PINNA_ECHOES] = { 2.0f, 4.0f, 7.0f, 11.0f, 13.0f };
+	const float PINNA_D[NUM_PINNA_ECHOES] = { 1.0f, 0.5f, 0.5f, 0.5f, 0.5f };
+
+	// Table grid, in degrees. Azimuth wraps all the way round, elevation
+	// goes from below the ears to straight up
+	const float AZIMUTH_STEP = 10.0f;
+	const int NUM_AZIMUTHS = 36;
+	const float ELEVATION_MIN = -40.0f;
+	const float ELEVATION_STEP = 10.0f;
+	const int NUM_ELEVATIONS = 14;
+
+	// Taps at the end of each HRIR that are faded out, so truncating it doesn't click
+	const int FADE_TAPS = 8;
+
+	// Directions closer than about a degree share a filter
+	const float MOVE_THRESHOLD = 0.99985f;
+
+	const int HISTORY_LENGTH = HRTF_FIR_TAPS + HRTF_MAX_DELAY;
+
+	// y[n] = sum of taps[k] * x[n - delay - k]. x may be indexed back to
+	// -(delay + HRTF_FIR_TAPS - 1)
+	void Convolve( const float* x, const float* taps, int delay, float* y, int frames )
+	{
+		__m128 broadcast[HRTF_FIR_TAPS];
+		for ( int k = 0; k < HRTF_FIR_TAPS; k++ )
+		{
+			broadcast[k] = _mm_set_ps1( taps[k] );
+		}
+
+		const float* src = x - delay;
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			// Two accumulators so consecutive taps don't wait on each other
+			__m128 even = _mm_setzero_ps();
+			__m128 odd = _mm_setzero_ps();
+			for ( int k = 0; k < HRTF_FIR_TAPS; k += 2 )
+			{
+				even = _mm_add_ps( even, _mm_mul_ps( broadcast[k], _mm_loadu_ps( src + n - k ) ) );
+				odd = _mm_add_ps( odd, _mm_mul_ps( broadcast[k + 1], _mm_loadu_ps( src + n - k - 1 ) ) );
+			}
+			_mm_storeu_ps( y + n, _mm_add_ps( even, odd ) );
+		}
+		for ( ; n < frames; n++ )
+		{
+			float sum = 0.0f;
+			for ( int k = 0; k < HRTF_FIR_TAPS; k++ )
+			{
+				sum += taps[k] * src[n - k];
+			}
+			y[n] = sum;
+		}
+	}
+}
+
+HrtfSpatializer::HrtfSpatializer( int numVoices, int maxFrames, float sampleRate )
+	: voices( numVoices ), work( HISTORY_LENGTH + maxFrames ), sampleRate( sampleRate )
+{
+	earOut[RIGHT_EAR].resize( maxFrames );
+	earOut[LEFT_EAR].resize( maxFrames );
+	earFade[RIGHT_EAR].resize( maxFrames );
+	earFade[LEFT_EAR].resize( maxFrames );
+
+	for ( int i = 0; i < numVoices; i++ )
+	{
+		Reset( i );
+	}
+
+	BuildTable();
+}
+
+void HrtfSpatializer::Reset( int voice )
+{
+	VoiceState& state = voices[voice];
+	state.enabled = false;
+	state.hasFilter = false;
+	state.currentDirection = Vector3::UnitZ;
+	state.targetDirection = Vector3::UnitZ;
+	memset( state.history, 0, sizeof( state.history ) );
+}
+
+void HrtfSpatializer::SetDirection( int voice, const Vector3& direction )
+{
+	VoiceState& state = voices[voice];
+	state.enabled = true;
+
+	// A source on top of the listener is treated as straight ahead
+	if ( direction.LengthSq() > 0.0001f )
+	{
+		state.targetDirection = Normalize( direction );
+	}
+	else
+	{
+		state.targetDirection = Vector3::UnitZ;
+	}
+}
+
+void HrtfSpatializer::Process( int voice, const float* left, const float* right, int frames, float* out )
+{
+	VoiceState& state = voices[voice];
+
+	// The block goes right after the previous block's tail, so the
+	// convolution can reach back across the boundary
+	float* x = &work[HISTORY_LENGTH];
+	memcpy( &work[0], state.history, sizeof( state.history ) );
+
+	__m128 half = _mm_set_ps1( 0.5f );
+	int n = 0;
+	for ( ; n + 4 <= frames; n += 4 )
+	{
+		__m128 sum = _mm_add_ps( _mm_loadu_ps( left + n ), _mm_loadu_ps( right + n ) );
+		_mm_storeu_ps( x + n, _mm_mul_ps( sum, half ) );
+	}
+	for ( ; n < frames; n++ )
+	{
+		x[n] = ( left[n] + right[n] ) * 0.5f;
+	}
+
+	bool moved = false;
+	Filter next[2];
+	if ( !state.hasFilter )
+	{
+		// First block for this voice, nothing to fade from
+		ComputeFilter( state.targetDirection, RIGHT_EAR, state.current[RIGHT_EAR] );
+		ComputeFilter( state.targetDirection, LEFT_EAR, state.current[LEFT_EAR] );
+		state.currentDirection = state.targetDirection;
+		state.hasFilter = true;
+	}
+	else if ( Dot( state.currentDirection, state.targetDirection ) < MOVE_THRESHOLD )
+	{
+		ComputeFilter( state.targetDirection, RIGHT_EAR, next[RIGHT_EAR] );
+		ComputeFilter( state.targetDirection, LEFT_EAR, next[LEFT_EAR] );
+		moved = true;
+	}
+
+	for ( int ear = 0; ear < 2; ear++ )
+	{
+		float* y = &earOut[ear][0];
+		Convolve( x, state.current[ear].taps, state.current[ear].delay, y, frames );
+
+		if ( moved )
+		{
+			// Run the new filter too, and crossfade from the old to the new
+			// output over the block. Fading the outputs rather than the taps
+			// also covers the jump in delay
+			float* fade = &earFade[ear][0];
+			Convolve( x, next[ear].taps, next[ear].delay, fade, frames );
+
+			float step = 1.0f / frames;
+			__m128 gain = _mm_setr_ps( 0.5f * step, 1.5f * step, 2.5f * step, 3.5f * step );
+			__m128 gainStep = _mm_set_ps1( 4.0f * step );
+			n = 0;
+			for ( ; n + 4 <= frames; n += 4 )
+			{
+				__m128 from = _mm_loadu_ps( y + n );
+				__m128 to = _mm_loadu_ps( fade + n );
+				_mm_storeu_ps( y + n, _mm_add_ps( from, _mm_mul_ps( _mm_sub_ps( to, from ), gain ) ) );
+				gain = _mm_add_ps( gain, gainStep );
+			}
+			for ( ; n < frames; n++ )
+			{
+				y[n] += ( fade[n] - y[n] ) * ( n + 0.5f ) * step;
+			}
+
+			state.current[ear] = next[ear];
+		}
+	}
+
+	if ( moved )
+	{
+		state.currentDirection = state.targetDirection;
+	}
+
+	SampleConvert::AddInterleaved( &earOut[LEFT_EAR][0], &earOut[RIGHT_EAR][0], out, frames );
+
+	// Keep the end of the input for the next block
+	memcpy( state.history, &work[frames], sizeof( state.history ) );
+}
+
+void HrtfSpatializer::BuildTable()
+{
+	table.resize( NUM_ELEVATIONS * NUM_AZIMUTHS * HRIR_LENGTH );
+	for ( int e = 0; e < NUM_ELEVATIONS; e++ )
+	{
+		for ( int a = 0; a < NUM_AZIMUTHS; a++ )
+		{
+			float* taps = &table[( e * NUM_AZIMUTHS + a ) * HRIR_LENGTH];
+			ComputeHrir( a * AZIMUTH_STEP, ELEVATION_MIN + e * ELEVATION_STEP, taps );
+		}
+	}
+
+	// Scale to unit energy averaged over every direction, so a positioned
+	// voice is about as loud as an unpositioned one while the differences
+	// between directions are kept
+	double energy = 0.0;
+	for ( float tap : table )
+	{
+		energy += tap * tap;
+	}
+	energy /= NUM_ELEVATIONS * NUM_AZIMUTHS;
+
+	float scale = ( float ) ( 1.0 / sqrt( energy ) );
+	for ( float& tap : table )
+	{
+		tap *= scale;
+	}
+}
+
+void HrtfSpatializer::ComputeHrir( float azimuth, float elevation, float* outTaps ) const
+{
+	if ( azimuth > 180.0f )
+	{
+		azimuth -= 360.0f;
+	}
+
+	// Pinna: the direct sound plus echoes whose delays depend on elevation.
+	// Fractional delays are split between the two nearest taps
+	memset( outTaps, 0, HRIR_LENGTH * sizeof( float ) );
+	outTaps[0] = 1.0f;
+	float sampleScale = sampleRate / 44100.0f;
+	for ( int k = 0; k < NUM_PINNA_ECHOES; k++ )
+	{
+		float tau = PINNA_A[k] * Math::Cos( Math::ToRadians( azimuth * 0.5f ) ) *
+			Math::Sin( Math::ToRadians( PINNA_D[k] * ( 90.0f - elevation ) ) ) + PINNA_B[k];
+		tau = Math::Clamp( tau * sampleScale, 0.0f, HRIR_LENGTH - 2.0f );
+		int whole = ( int ) tau;
+		float frac = tau - whole;
+		outTaps[whole] += PINNA_RHO[k] * ( 1.0f - frac );
+		outTaps[whole + 1] += PINNA_RHO[k] * frac;
+	}
+
+	// Head shadow: a one pole, one zero shelf whose high frequency gain
+	// depends on the angle between the source and the (right) ear
+	float x = Math::Sin( Math::ToRadians( azimuth ) ) * Math::Cos( Math::ToRadians( elevation ) );
+	float angleFromEar = Math::ToDegrees( Math::Acos( Math::Clamp( x, -1.0f, 1.0f ) ) );
+	float alpha = ( 1.0f + ALPHA_MIN * 0.5f ) + ( 1.0f - ALPHA_MIN * 0.5f ) *
+		Math::Cos( Math::ToRadians( angleFromEar / THETA_MIN * 180.0f ) );
+
+	// Bilinear transform of ( alpha * s + beta ) / ( s + beta )
+	float beta = 2.0f * SPEED_OF_SOUND / HEAD_RADIUS;
+	float k = 2.0f * sampleRate;
+	float b0 = ( alpha * k + beta ) / ( k + beta );
+	float b1 = ( beta - alpha * k ) / ( k + beta );
+	float a1 = ( beta - k ) / ( k + beta );
+
+	float prevIn = 0.0f;
+	float prevOut = 0.0f;
+	for ( int n = 0; n < HRIR_LENGTH; n++ )
+	{
+		float in = outTaps[n];
+		outTaps[n] = b0 * in + b1 * prevIn - a1 * prevOut;
+		prevIn = in;
+		prevOut = outTaps[n];
+	}
+
+	for ( int n = 0; n < FADE_TAPS; n++ )
+	{
+		float fade = 0.5f + 0.5f * Math::Cos( Math::Pi * ( n + 1 ) / ( FADE_TAPS + 1 ) );
+		outTaps[HRIR_LENGTH - FADE_TAPS + n] *= fade;
+	}
+}
+
+void HrtfSpatializer::ComputeFilter( const Vector3& direction, Ear ear, Filter& outFilter ) const
+{
+	// The table is for the right ear, so the left ear looks it up mirrored
+	float x = ear == RIGHT_EAR ? direction.x : -direction.x;
+	float azimuth = Math::ToDegrees( atan2f( x, direction.z ) );
+	float elevation = Math::ToDegrees( asinf( Math::Clamp( direction.y, -1.0f, 1.0f ) ) );
+
+	// Bilinear interpolation between the four surrounding grid points
+	float a = ( azimuth < 0.0f ? azimuth + 360.0f : azimuth ) / AZIMUTH_STEP;
+	int a0 = ( int ) a;
+	float aFrac = a - a0;
+	a0 %= NUM_AZIMUTHS;
+	int a1 = ( a0 + 1 ) % NUM_AZIMUTHS;
+
+	float e = ( Math::Clamp( elevation, ELEVATION_MIN, 90.0f ) - ELEVATION_MIN ) / ELEVATION_STEP;
+	int e0 = Math::Min( ( int ) e, NUM_ELEVATIONS - 2 );
+	float eFrac = e - e0;
+
+	const float* h00 = &table[( e0 * NUM_AZIMUTHS + a0 ) * HRIR_LENGTH];
+	const float* h01 = &table[( e0 * NUM_AZIMUTHS + a1 ) * HRIR_LENGTH];
+	const float* h10 = &table[( ( e0 + 1 ) * NUM_AZIMUTHS + a0 ) * HRIR_LENGTH];
+	const float* h11 = &table[( ( e0 + 1 ) * NUM_AZIMUTHS + a1 ) * HRIR_LENGTH];
+
+	float hrir[HRIR_LENGTH];
+	for ( int i = 0; i < HRIR_LENGTH; i++ )
+	{
+		float low = Math::Lerp( h00[i], h01[i], aFrac );
+		float high = Math::Lerp( h10[i], h11[i], aFrac );
+		hrir[i] = Math::Lerp( low, high, eFrac );
+	}
+
+	// The whole part of the interaural delay offsets the convolution, and the
+	// fraction is baked into the taps as a two tap interpolation
+	float delay = ComputeDelay( Math::Acos( Math::Clamp( x, -1.0f, 1.0f ) ) );
+	outFilter.delay = ( int ) delay;
+	float frac = delay - outFilter.delay;
+
+	memset( outFilter.taps, 0, sizeof( outFilter.taps ) );
+	for ( int i = 0; i < HRIR_LENGTH; i++ )
+	{
+		outFilter.taps[i] += hrir[i] * ( 1.0f - frac );
+		outFilter.taps[i + 1] += hrir[i] * frac;
+	}
+}
+
+float HrtfSpatializer::ComputeDelay( float angleFromEar ) const
+{
+	// Woodworth: the path is straight to a lit ear, and wraps around
+	// the head to reach a shadowed one. Offset so the nearest ear is 0
+	float path = angleFromEar < Math::PiOver2 ? -Math::Cos( angleFromEar ) : angleFromEar - Math::PiOver2;
+	float delay = ( 1.0f + path ) * HEAD_RADIUS / SPEED_OF_SOUND * sampleRate;
+	return Math::Clamp( delay, 0.0f, HRTF_MAX_DELAY - 1.0f );
+}
@@ -0,0 +1,75 @@
+// HrtfSpatializer.h
+// Binaural rendering for positioned voices on headphones. Each voice is
+// downmixed to mono, delayed per ear by the interaural time difference and
+// convolved with a short head related impulse response (HRIR) per ear.
+//
+// The built in HRIR table is generated at startup from the Brown-Duda
+// structural model (spherical head shadow + pinna echoes) on a 10 degree
+// grid, for the right ear only; the left ear uses the mirrored azimuth.
+// Filters for a direction are bilinearly interpolated from the grid, and
+// when a voice moves the old and new filters are crossfaded over a block
+
+#pragma once
+#include "Math.h"
+#include <vector>
+
+// Taps per HRIR in the table
+#define HRIR_LENGTH 32
+// Taps actually convolved: the HRIR, spread by one tap for the fractional
+// part of the delay and padded to a multiple of 4
+#define HRTF_FIR_TAPS 36
+// Longest per ear delay, in samples (the head model tops out near 29 at 44.1kHz)
+#define HRTF_MAX_DELAY 32
+
+class HrtfSpatializer
+{
+public:
+	HrtfSpatializer( int numVoices, int maxFrames, float sampleRate );
+
+	// Turns spatialization off for voice and clears its history
+	void Reset( int voice );
+
+	// Enables spatialization for voice, coming from direction in listener
+	// space (x right, y up, z forward). Doesn't need to be normalized
+	void SetDirection( int voice, const Vector3& direction );
+	bool IsEnabled( int voice ) const { return voices[voice].enabled; }
+
+	// Downmixes left and right to mono, renders it binaurally and adds the
+	// result into the interleaved stereo out
+	void Process( int voice, const float* left, const float* right, int frames, float* out );
+
+private:
+	enum Ear { RIGHT_EAR, LEFT_EAR };
+
+	struct Filter
+	{
+		float taps[HRTF_FIR_TAPS];
+		int delay;
+	};
+
+	struct VoiceState
+	{
+		Filter current[2];
+		Vector3 currentDirection;
+		Vector3 targetDirection;
+		float history[HRTF_FIR_TAPS + HRTF_MAX_DELAY];
+		bool enabled;
+		bool hasFilter;
+	};
+
+	void BuildTable();
+	void ComputeHrir( float azimuth, float elevation, float* outTaps ) const;
+	void ComputeFilter( const Vector3& direction, Ear ear, Filter& outFilter ) const;
+	float ComputeDelay( float angleFromEar ) const;
+
+	std::vector<VoiceState> voices;
+	// Right ear HRIRs indexed [elevation][azimuth][tap]
+	std::vector<float> table;
+
+	// Scratch buffers for one block
+	std::vector<float> work;
+	std::vector<float> earOut[2];
+	std::vector<float> earFade[2];
+
+	float sampleRate;
+};
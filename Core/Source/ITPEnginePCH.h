@@ -1,5 +1,47 @@
 #pragma once
 
+#ifdef ITP_TOOLS
+// Tools (such as Tools/AssetCooker) only build the asset formats, with
+// none of the renderer, audio output or game, so they build anywhere
+
+// STL
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+// Core
+#include "Math.h"
+#include "SimdMath.h"
+#include "DbgAssert.h"
+#include "BoneTransform.h"
+#include "MatrixPalette.h"
+#include "CollisionHelpers.h"
+#include <rapidjson/document.h>
+#include "JsonFile.h"
+
+#include "JobSystem.h"
+
+// Assets
+#include "MappedFile.h"
+#include "Lz4.h"
+#include "AssetId.h"
+#include "PackFormat.h"
+#include "LoadProfiler.h"
+#include "FileSystem.h"
+#include "MeshFormat.h"
+#include "AnimFormat.h"
+#include "SkeletonFormat.h"
+#include "Asset.h"
+#include "Sound.h"
+#include "SampleConvert.h"
+#include "ImaAdpcm.h"
+#else
 // Windows/Directx
 #if _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -24,11 +66,24 @@
 #include "MatrixPalette.h"
 #include "CollisionHelpers.h"
 #include <rapidjson/document.h>
+#include "JsonFile.h"
 #include "Object.h"
 #include "LevelLoader.h"
 
+#include "JobSystem.h"
+
 // Assets
+#include "MappedFile.h"
+#include "Lz4.h"
+#include "AssetId.h"
+#include "PackFormat.h"
+#include "LoadProfiler.h"
+#include "FileSystem.h"
+#include "MeshFormat.h"
+#include "AnimFormat.h"
+#include "SkeletonFormat.h"
 #include "AssetCache.h"
+#include "LevelPreload.h"
 #include "Asset.h"
 #include "Animation.h"
 #include "Font.h"
@@ -59,10 +114,13 @@
 #include "Actor.h"
 
 #include "KillVolume.h"
+#include "ReverbZone.h"
 #include "AudioSystem.h"
 #include "Channel.h"
+#include "SampleConvert.h"
 
 #include "Player.h"
 
 #include "Game.h"
 #include "Renderer.h"
+#endif
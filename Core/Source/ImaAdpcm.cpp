@@ -0,0 +1,134 @@
+#include "ITPEnginePCH.h"
+
+namespace
+{
+	const int INDEX_TABLE[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+	const int STEP_TABLE[89] =
+	{
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+		50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+		253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+		1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+		3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+		12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+	};
+
+	// First sample (2 bytes), step index, padding
+	const U32 CHANNEL_HEADER_SIZE = 4;
+	// Codes for the other ADPCM_BLOCK_FRAMES - 1 samples, two per byte
+	const U32 CHANNEL_CODE_SIZE = ADPCM_BLOCK_FRAMES / 2;
+
+	// Moves the predictor and step index on by one code. The encoder runs this
+	// too, so both sides track exactly the same predictor
+	inline void Step( int code, int& predictor, int& index )
+	{
+		int step = STEP_TABLE[index];
+		int delta = step >> 3;
+		if ( code & 4 ) delta += step;
+		if ( code & 2 ) delta += step >> 1;
+		if ( code & 1 ) delta += step >> 2;
+
+		predictor += ( code & 8 ) ? -delta : delta;
+		predictor = Math::Clamp( predictor, -32768, 32767 );
+		index = Math::Clamp( index + INDEX_TABLE[code], 0, 88 );
+	}
+
+	inline int Quantize( int sample, int predictor, int index )
+	{
+		int step = STEP_TABLE[index];
+		int diff = sample - predictor;
+		int code = 0;
+		if ( diff < 0 )
+		{
+			code = 8;
+			diff = -diff;
+		}
+		if ( diff >= step )
+		{
+			code |= 4;
+			diff -= step;
+		}
+		if ( diff >= step >> 1 )
+		{
+			code |= 2;
+			diff -= step >> 1;
+		}
+		if ( diff >= step >> 2 )
+		{
+			code |= 1;
+		}
+		return code;
+	}
+}
+
+U32 ImaAdpcm::GetBlockSize( U32 numChannels )
+{
+	return numChannels * ( CHANNEL_HEADER_SIZE + CHANNEL_CODE_SIZE );
+}
+
+U32 ImaAdpcm::GetNumBlocks( U32 numFrames )
+{
+	return ( numFrames + ADPCM_BLOCK_FRAMES - 1 ) / ADPCM_BLOCK_FRAMES;
+}
+
+void ImaAdpcm::Encode( const PCM16* in, U32 numChannels, U32 numFrames, unsigned char* out )
+{
+	U32 numBlocks = GetNumBlocks( numFrames );
+	for ( U32 block = 0; block < numBlocks; block++ )
+	{
+		U32 first = block * ADPCM_BLOCK_FRAMES;
+		for ( U32 c = 0; c < numChannels; c++ )
+		{
+			unsigned char* header = out + c * ( CHANNEL_HEADER_SIZE + CHANNEL_CODE_SIZE );
+			unsigned char* codes = header + CHANNEL_HEADER_SIZE;
+
+			// Start each block from an exact sample. The step index carries
+			// over from a guess that suits the sample before
+			int predictor = in[first * numChannels + c];
+			int index = 0;
+			if ( first > 0 )
+			{
+				int change = abs( predictor - in[( first - 1 ) * numChannels + c] );
+				while ( index < 88 && STEP_TABLE[index] < change )
+				{
+					index++;
+				}
+			}
+			header[0] = ( unsigned char ) predictor;
+			header[1] = ( unsigned char ) ( predictor >> 8 );
+			header[2] = ( unsigned char ) index;
+			header[3] = 0;
+
+			memset( codes, 0, CHANNEL_CODE_SIZE );
+			for ( U32 n = 1; n < ADPCM_BLOCK_FRAMES; n++ )
+			{
+				U32 frame = Math::Min( first + n, numFrames - 1 );
+				int code = Quantize( in[frame * numChannels + c], predictor, index );
+				Step( code, predictor, index );
+				codes[( n - 1 ) >> 1] |= ( unsigned char ) ( code << ( ( ( n - 1 ) & 1 ) * 4 ) );
+			}
+		}
+		out += GetBlockSize( numChannels );
+	}
+}
+
+void ImaAdpcm::DecodeBlock( const unsigned char* block, U32 numChannels, PCM16* out )
+{
+	for ( U32 c = 0; c < numChannels; c++ )
+	{
+		const unsigned char* header = block + c * ( CHANNEL_HEADER_SIZE + CHANNEL_CODE_SIZE );
+		const unsigned char* codes = header + CHANNEL_HEADER_SIZE;
+
+		int predictor = ( PCM16 ) ( header[0] | ( header[1] << 8 ) );
+		int index = header[2];
+		out[c] = ( PCM16 ) predictor;
+
+		for ( U32 n = 1; n < ADPCM_BLOCK_FRAMES; n++ )
+		{
+			int code = ( codes[( n - 1 ) >> 1] >> ( ( ( n - 1 ) & 1 ) * 4 ) ) & 15;
+			Step( code, predictor, index );
+			out[n * numChannels + c] = ( PCM16 ) predictor;
+		}
+	}
+}
@@ -0,0 +1,24 @@
+// ImaAdpcm.h
+// 4:1 IMA ADPCM for sounds kept compressed in memory. Sounds are coded in
+// independent blocks of ADPCM_BLOCK_FRAMES frames, so the mixer can decode
+// just the block it's playing and jump anywhere (loop points) without
+// decoding what comes before
+
+#pragma once
+#include "Sound.h"
+
+#define ADPCM_BLOCK_FRAMES 1024
+
+namespace ImaAdpcm
+{
+	// Bytes per block. Each channel stores its first sample and step index,
+	// then 4 bits for every other sample
+	U32 GetBlockSize( U32 numChannels );
+	U32 GetNumBlocks( U32 numFrames );
+
+	// Codes numFrames interleaved frames into GetNumBlocks blocks at out.
+	// The last block is padded by repeating the final frame
+	void Encode( const PCM16* in, U32 numChannels, U32 numFrames, unsigned char* out );
+	// Decodes one block into ADPCM_BLOCK_FRAMES interleaved frames
+	void DecodeBlock( const unsigned char* block, U32 numChannels, PCM16* out );
+}
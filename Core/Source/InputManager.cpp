@@ -91,20 +91,13 @@ void InputManager::AddAxisMapping(const std::string& name, int positiveKey, int
 
 void InputManager::ParseMappings(const char* fileName)
 {
-	std::ifstream file(fileName);
-
-	if (!file.is_open())
+	JsonFile json;
+	if (!json.Load(fileName))
 	{
 		SDL_Log("Input mapping file %s not found", fileName);
 		return;
 	}
-
-	std::stringstream fileStream;
-	fileStream << file.rdbuf();
-	std::string contents = fileStream.str();
-	rapidjson::StringStream jsonStr(contents.c_str());
-	rapidjson::Document doc;
-	doc.ParseStream(jsonStr);
+	rapidjson::Document& doc = json.GetDocument();
 
 	if (!doc.IsObject())
 	{
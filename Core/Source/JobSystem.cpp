@@ -0,0 +1,104 @@
+#include "ITPEnginePCH.h"
+
+JobSystem::JobSystem(unsigned numWorkers)
+	:mQuit(false)
+{
+	if (numWorkers == 0)
+	{
+		// hardware_concurrency can be 0 if it isn't known
+		unsigned cores = std::thread::hardware_concurrency();
+		numWorkers = cores > 1 ? cores - 1 : 1;
+	}
+
+	for (unsigned i = 0; i < numWorkers; i++)
+	{
+		mWorkers.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+		mQueue.clear();
+	}
+	mWake.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::Submit(std::function<void()> job, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->fetch_add(1);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(Job{ std::move(job), counter });
+	}
+	mWake.notify_one();
+}
+
+bool JobSystem::RunOne()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mQueue.empty())
+		{
+			return false;
+		}
+		job = std::move(mQueue.front());
+		mQueue.pop_front();
+	}
+
+	Run(job);
+	return true;
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	while (counter.load() > 0)
+	{
+		// Nothing left to help with, so the rest is already running on workers
+		if (!RunOne())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this] { return mQuit || !mQueue.empty(); });
+			if (mQuit)
+			{
+				return;
+			}
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+		}
+
+		Run(job);
+	}
+}
+
+void JobSystem::Run(Job& job)
+{
+	job.mFunction();
+	if (job.mCounter)
+	{
+		job.mCounter->fetch_sub(1);
+	}
+}
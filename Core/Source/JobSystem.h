@@ -0,0 +1,55 @@
+// JobSystem.h
+// A pool of worker threads that runs jobs from a shared queue, for work
+// that would otherwise hold up the main thread, such as loading assets.
+// A thread that has to wait for jobs runs queued ones itself in the
+// meantime, so waiting never leaves a core idle
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts jobs that haven't finished yet. Pass one to Submit for every job
+// in a batch, then Wait on it
+typedef std::atomic<int> JobCounter;
+
+class JobSystem
+{
+public:
+	// A numWorkers of 0 starts one worker per core, less one for the main thread
+	JobSystem(unsigned numWorkers = 0);
+	// Jobs still queued are dropped, but any that are running finish first
+	~JobSystem();
+
+	// Queues job to run on a worker. If counter isn't null it's incremented
+	// now and decremented once the job has run
+	void Submit(std::function<void()> job, JobCounter* counter = nullptr);
+
+	// Runs the oldest queued job on the calling thread. Returns false if
+	// there wasn't one
+	bool RunOne();
+
+	// Returns once counter reaches zero, running queued jobs in the meantime
+	void Wait(const JobCounter& counter);
+
+	size_t GetNumWorkers() const { return mWorkers.size(); }
+private:
+	struct Job
+	{
+		std::function<void()> mFunction;
+		JobCounter* mCounter;
+	};
+
+	void WorkerLoop();
+	void Run(Job& job);
+
+	std::vector<std::thread> mWorkers;
+	std::deque<Job> mQueue;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	bool mQuit;
+};
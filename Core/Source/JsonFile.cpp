@@ -0,0 +1,81 @@
+#include "ITPEnginePCH.h"
+
+// The text buffer and allocator for one document, kept between loads
+struct JsonParsePool
+{
+	std::vector<char> mText;
+	// The allocator's first chunk, so a document that fits needs no allocations
+	std::vector<char> mChunk;
+	std::unique_ptr<rapidjson::MemoryPoolAllocator<>> mAllocator;
+};
+
+namespace
+{
+	const size_t MIN_POOL_CHUNK = 64 * 1024;
+	// A pool doesn't keep more than this between loads, so one huge file
+	// doesn't hold on to its memory for good
+	const size_t MAX_POOL_CHUNK = 16 * 1024 * 1024;
+
+	thread_local std::vector<std::unique_ptr<JsonParsePool>> sFreePools;
+}
+
+JsonFile::JsonFile()
+{
+	if (!sFreePools.empty())
+	{
+		mPool = std::move(sFreePools.back());
+		sFreePools.pop_back();
+	}
+	else
+	{
+		mPool.reset(new JsonParsePool());
+		mPool->mChunk.resize(MIN_POOL_CHUNK);
+		mPool->mAllocator.reset(new rapidjson::MemoryPoolAllocator<>(mPool->mChunk.data(), mPool->mChunk.size()));
+	}
+	mDocument.reset(new rapidjson::Document(mPool->mAllocator.get()));
+}
+
+JsonFile::~JsonFile()
+{
+	// The document's values are in the pool, so it has to go first
+	mDocument.reset();
+
+	// If the document outgrew the first chunk, grow it to fit next time
+	size_t capacity = mPool->mAllocator->Capacity();
+	if (capacity > mPool->mChunk.size() && mPool->mChunk.size() < MAX_POOL_CHUNK)
+	{
+		mPool->mAllocator.reset();
+		mPool->mChunk.resize(Math::Min(capacity, MAX_POOL_CHUNK));
+		mPool->mAllocator.reset(new rapidjson::MemoryPoolAllocator<>(mPool->mChunk.data(), mPool->mChunk.size()));
+	}
+	else
+	{
+		mPool->mAllocator->Clear();
+	}
+
+	if (mPool->mText.capacity() > MAX_POOL_CHUNK)
+	{
+		std::vector<char>().swap(mPool->mText);
+	}
+	sFreePools.emplace_back(std::move(mPool));
+}
+
+bool JsonFile::Load(const char* fileName)
+{
+	VirtualFile file;
+	if (!file.Open(fileName))
+	{
+		return false;
+	}
+
+	// Parsing in place writes to the text, and needs it null terminated,
+	// so it can't be parsed where it is in the file
+	std::vector<char>& text = mPool->mText;
+	size_t size = file.GetSize();
+	text.resize(size + 1);
+	memcpy(text.data(), file.GetData(), size);
+	text[size] = '\0';
+
+	mDocument->ParseInsitu(text.data());
+	return true;
+}
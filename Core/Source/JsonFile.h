@@ -0,0 +1,36 @@
+// JsonFile.h
+// Reads a JSON file for the text asset loaders. The file is read once into
+// a buffer that rapidjson parses in place (ParseInsitu), so strings point
+// into the buffer instead of being copied out of it, and the document's
+// values come from a memory pool that's kept for the next file. Each
+// thread keeps its own pools, and a file loaded while another is still
+// open (such as a mesh loaded by a level) gets a pool of its own.
+//
+// The document is only valid as long as the JsonFile is
+//
+// Generally will be used like:
+// JsonFile json;
+// if (json.Load("path/file.name")) { rapidjson::Document& doc = json.GetDocument(); ... }
+
+#pragma once
+#include <rapidjson/document.h>
+#include <memory>
+
+class JsonFile
+{
+public:
+	JsonFile();
+	~JsonFile();
+
+	// Reads and parses fileName. Returns false if the file couldn't be
+	// read. If it isn't valid JSON, the document won't be an object
+	bool Load(const char* fileName);
+
+	rapidjson::Document& GetDocument() { return *mDocument; }
+private:
+	JsonFile(const JsonFile&) = delete;
+	JsonFile& operator=(const JsonFile&) = delete;
+
+	std::unique_ptr<struct JsonParsePool> mPool;
+	std::unique_ptr<rapidjson::Document> mDocument;
+};
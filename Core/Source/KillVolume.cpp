@@ -11,6 +11,9 @@ KillVolume::KillVolume(Game& game)
 	box.mMin = Vector3(-0.5f, -0.5f, -0.5f);
 	box.mMax = Vector3(0.5f, 0.5f, 0.5f);
 	mBox->BoxFromBox(box);
+
+	// Start reading the sound now so the first death doesn't wait on the file
+	mDeathSound = game.GetAudio().LoadSoundAsync("Assets/Sounds/Death.wav");
 }
 
 void KillVolume::BeginTouch(Actor& other)
@@ -19,7 +22,6 @@ void KillVolume::BeginTouch(Actor& other)
 	{
 		auto& player = Cast<Player>(other);
 		player.OnRespawn();
-		AudioSystem *as = new AudioSystem();
-		as->PlayAudioData( "Assets/Sounds/Death.wav" );
+		mGame.GetAudio().Play( mDeathSound );
 	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Actor.h"
 #include "BoxComponent.h"
+#include "Sound.h"
 
 class KillVolume : public Actor
 {
@@ -11,6 +12,7 @@ public:
 	void BeginTouch(Actor& other) override;
 private:
 	BoxComponentPtr mBox;
+	SoundPtr mDeathSound;
 };
 
 DECL_PTR(KillVolume);
@@ -12,38 +12,46 @@ void LevelLoader::SetupSpawnMaps()
 	mActorSpawnMap.emplace("Actor", &Actor::SpawnWithProperties);
 	mActorSpawnMap.emplace("KillVolume", &KillVolume::SpawnWithProperties);
 	mActorSpawnMap.emplace("Player", &Player::SpawnWithProperties);
+	mActorSpawnMap.emplace("ReverbZone", &ReverbZone::SpawnWithProperties);
 
 	// Component spawn map
 	mCompSpawnMap.emplace("BoxComponent", 
-		ComponentInfo(BoxComponent::StaticType(), &BoxComponent::CreateWithProperties));
+		ComponentInfo(BoxComponent::StaticType(), &BoxComponent::CreateWithProperties,
+		&BoxComponent::PreloadProperties));
 	mCompSpawnMap.emplace("CameraComponent",
 		ComponentInfo(CameraComponent::StaticType(), &CameraComponent::CreateWithProperties));
 	mCompSpawnMap.emplace("CharacterMoveComponent",
-		ComponentInfo(CharacterMoveComponent::StaticType(), &CharacterMoveComponent::CreateWithProperties));
+		ComponentInfo(CharacterMoveComponent::StaticType(), &CharacterMoveComponent::CreateWithProperties,
+		&CharacterMoveComponent::PreloadProperties));
 	mCompSpawnMap.emplace("MeshComponent", 
-		ComponentInfo(MeshComponent::StaticType(), &MeshComponent::CreateWithProperties));
+		ComponentInfo(MeshComponent::StaticType(), &MeshComponent::CreateWithProperties,
+		&MeshComponent::PreloadProperties));
 	mCompSpawnMap.emplace("PointLightComponent",
 		ComponentInfo(PointLightComponent::StaticType(), &PointLightComponent::CreateWithProperties));
 	mCompSpawnMap.emplace("SkeletalMeshComponent",
-		ComponentInfo(SkeletalMeshComponent::StaticType(), &SkeletalMeshComponent::CreateWithProperties));
+		ComponentInfo(SkeletalMeshComponent::StaticType(), &SkeletalMeshComponent::CreateWithProperties,
+		&SkeletalMeshComponent::PreloadProperties));
 }
 
 void LevelLoader::Load(const char* fileName)
 {
-	std::ifstream file(fileName);
+	// The level's assets are profiled as its children
+	LoadScope scope(fileName, "Level", "Load");
 
-	if (!file.is_open())
+	// A cooked level is the same JSON without the whitespace
+	std::string cookedName = Asset::GetCookedFileName(fileName);
+	JsonFile json;
+	bool loaded = false;
+	{
+		LoadPhase phase(ELP_Parse);
+		loaded = json.Load(cookedName.empty() ? fileName : cookedName.c_str());
+	}
+	if (!loaded)
 	{
 		SDL_Log("Level file %s not found", fileName);
 		return;
 	}
-
-	std::stringstream fileStream;
-	fileStream << file.rdbuf();
-	std::string contents = fileStream.str();
-	rapidjson::StringStream jsonStr(contents.c_str());
-	rapidjson::Document doc;
-	doc.ParseStream(jsonStr);
+	rapidjson::Document& doc = json.GetDocument();
 
 	if (!doc.IsObject())
 	{
@@ -71,8 +79,18 @@ void LevelLoader::Load(const char* fileName)
 	GetVectorFromJSON( doc["world"], "ambientLight", ambientLight );
 	mGame.GetRenderer().SetAmbientLight( ambientLight );
 
-	// Step 2: Setup the actors (and each of their components)
+	// Step 2: Load every asset the actors need, all at once, so spawning
+	// them doesn't load each one in turn. The preload holds on to the
+	// assets until the actors have them
 	rapidjson::Value& actors = doc["actors"];
+	LevelPreload preload(mGame.GetAssetCache());
+	auto start = std::chrono::high_resolution_clock::now();
+	Preload(actors, preload);
+	preload.Wait();
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	SDL_Log("Level %s: Preloaded %u assets in %.2f ms", fileName, static_cast<unsigned>(preload.GetNumAssets()), seconds * 1000.0);
+
+	// Step 3: Setup the actors (and each of their components)
 
 	// Loop through all actors
 	for ( rapidjson::SizeType i = 0; i < actors.Size(); i++ )
@@ -126,6 +144,43 @@ void LevelLoader::Load(const char* fileName)
 	}
 }
 
+void LevelLoader::Preload(const rapidjson::Value& actors, LevelPreload& preload)
+{
+	for (rapidjson::SizeType i = 0; i < actors.Size(); i++)
+	{
+		auto updatedComps = actors[i].FindMember("updatedComponents");
+		if (updatedComps != actors[i].MemberEnd())
+		{
+			PreloadComponents(updatedComps->value, preload);
+		}
+
+		auto newComps = actors[i].FindMember("newComponents");
+		if (newComps != actors[i].MemberEnd())
+		{
+			PreloadComponents(newComps->value, preload);
+		}
+	}
+}
+
+void LevelLoader::PreloadComponents(const rapidjson::Value& components, LevelPreload& preload)
+{
+	for (rapidjson::SizeType i = 0; i < components.Size(); i++)
+	{
+		const char* compType = nullptr;
+		auto properties = components[i].FindMember("properties");
+		if (!GetStringFromJSON(components[i], "type", compType) || properties == components[i].MemberEnd())
+		{
+			continue;
+		}
+
+		auto info = mCompSpawnMap.find(compType);
+		if (info != mCompSpawnMap.end() && info->second.mPreload)
+		{
+			info->second.mPreload(properties->value, preload);
+		}
+	}
+}
+
 // Global helper functions
 bool GetFloatFromJSON(const rapidjson::Value& inObject, const char* inProperty, float& outFloat)
 {
@@ -181,6 +236,24 @@ bool GetStringFromJSON(const rapidjson::Value& inObject, const char* inProperty,
 	return true;
 }
 
+bool GetStringFromJSON(const rapidjson::Value& inObject, const char* inProperty, const char*& outStr)
+{
+	auto itr = inObject.FindMember(inProperty);
+	if (itr == inObject.MemberEnd())
+	{
+		return false;
+	}
+
+	auto& property = itr->value;
+	if (!property.IsString())
+	{
+		return false;
+	}
+
+	outStr = property.GetString();
+	return true;
+}
+
 bool GetBoolFromJSON(const rapidjson::Value& inObject, const char* inProperty, bool& outBool)
 {
 	auto itr = inObject.FindMember(inProperty);
@@ -10,6 +10,8 @@ class Game;
 typedef std::function<std::shared_ptr<class Actor>(Game&, const rapidjson::Value&)> ActorSpawnFunc;
 typedef std::function<std::shared_ptr<class Component>(class Actor&, Component::UpdateType,
 	const rapidjson::Value&)> ComponentSpawnFunc;
+// Adds the assets a component's properties refer to, so they load before it spawns
+typedef std::function<void(const rapidjson::Value&, class LevelPreload&)> ComponentPreloadFunc;
 
 class LevelLoader
 {
@@ -18,6 +20,9 @@ public:
 	void Load(const char* fileName);
 private:
 	void SetupSpawnMaps();
+	// Starts loading every asset the actors' components refer to
+	void Preload(const rapidjson::Value& actors, class LevelPreload& preload);
+	void PreloadComponents(const rapidjson::Value& components, class LevelPreload& preload);
 
 	Game& mGame;
 
@@ -25,9 +30,12 @@ private:
 	{
 		const TypeInfo* mType;
 		ComponentSpawnFunc mFunc;
-		ComponentInfo(const TypeInfo* type, ComponentSpawnFunc func)
+		// Null if the component doesn't load any assets
+		ComponentPreloadFunc mPreload;
+		ComponentInfo(const TypeInfo* type, ComponentSpawnFunc func, ComponentPreloadFunc preload = nullptr)
 			:mType(type)
 			,mFunc(func)
+			,mPreload(preload)
 		{ }
 	};
 
@@ -43,6 +51,8 @@ private:
 bool GetFloatFromJSON(const rapidjson::Value& inObject, const char* inProperty, float& outFloat);
 bool GetIntFromJSON(const rapidjson::Value& inObject, const char* inProperty, int& outInt);
 bool GetStringFromJSON(const rapidjson::Value& inObject, const char* inProperty, std::string& outStr);
+// Points outStr into the document rather than copying it, so it's only valid as long as the document is
+bool GetStringFromJSON(const rapidjson::Value& inObject, const char* inProperty, const char*& outStr);
 bool GetBoolFromJSON(const rapidjson::Value& inObject, const char* inProperty, bool& outBool);
 bool GetVectorFromJSON(const rapidjson::Value& inObject, const char* inProperty, Vector3& outVector);
 bool GetQuaternionFromJSON(const rapidjson::Value& inObject, const char* inProperty, Quaternion& outQuat);
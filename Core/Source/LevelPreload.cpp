@@ -0,0 +1,15 @@
+#include "ITPEnginePCH.h"
+
+LevelPreload::LevelPreload(AssetCache& cache)
+	:mCache(cache)
+{
+
+}
+
+void LevelPreload::Wait()
+{
+	for (auto& load : mLoads)
+	{
+		load.Wait();
+	}
+}
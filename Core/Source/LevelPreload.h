@@ -0,0 +1,47 @@
+// LevelPreload.h
+// Loads every asset a level refers to before any of its actors spawn.
+// LevelLoader asks each component in the level for the assets its
+// properties name, and they all start loading on the job system at
+// once. Loads that depend on others wait for them as part of the load
+// (a mesh isn't uploaded until its textures are in, for instance), so
+// the whole level takes about as long as its slowest chain of assets
+// rather than the sum of them.
+//
+// Once Wait returns, the components find their assets already in the
+// cache. Keep the LevelPreload around until they've spawned, since it
+// holds on to the assets so they can't be evicted before then.
+
+#pragma once
+#include <unordered_set>
+#include <vector>
+#include "AssetCache.h"
+#include "FileSystem.h"
+
+class LevelPreload
+{
+public:
+	LevelPreload(AssetCache& cache);
+
+	// Starts an asset loading, if it isn't already. If it's in an archive,
+	// the OS is asked to start reading it in first, so it's on its way
+	// while the loads ahead of it in the queue run
+	template <typename T>
+	void Add(const char* fileName)
+	{
+		if (mAdded.emplace(AssetId(fileName)).second)
+		{
+			FileSystem::Prefetch((std::string(mCache.GetRoot()) + fileName).c_str());
+			mLoads.emplace_back(mCache.LoadAsync<T>(fileName));
+		}
+	}
+
+	// Returns once everything added has finished loading, helping with
+	// the loads in the meantime
+	void Wait();
+
+	size_t GetNumAssets() const { return mLoads.size(); }
+private:
+	AssetCache& mCache;
+	std::unordered_set<AssetId> mAdded;
+	std::vector<AssetFuture<Asset>> mLoads;
+};
@@ -0,0 +1,336 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// One stage of one asset's load. Times are in microseconds since the
+	// profiler was enabled
+	struct LoadRecord
+	{
+		std::string mPath;
+		const char* mType;
+		const char* mStage;
+		std::string mParent;
+		int64_t mStart;
+		int64_t mDuration;
+		// Spent in loads nested inside this one on the same thread
+		int64_t mChildTime;
+		int64_t mParseTime;
+		int64_t mUploadTime;
+		size_t mBytes;
+		uint32_t mThread;
+		// How many loads this one is nested in on its thread
+		uint32_t mDepth;
+	};
+
+	std::atomic<bool> sEnabled(false);
+	std::chrono::high_resolution_clock::time_point sEpoch;
+	std::thread::id sMainThread;
+	std::atomic<uint32_t> sNextThread(1);
+
+	// Finished records, in the order they finished
+	std::vector<LoadRecord> sRecords;
+	std::mutex sRecordsMutex;
+
+	// The loads in progress on this thread, innermost last
+	thread_local std::vector<LoadRecord> tStack;
+	// This thread's number in the trace, once it has one. The main thread is 0
+	thread_local uint32_t tThread = UINT32_MAX;
+
+	int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::high_resolution_clock::now() - sEpoch).count();
+	}
+
+	uint32_t GetThread()
+	{
+		if (tThread == UINT32_MAX)
+		{
+			tThread = std::this_thread::get_id() == sMainThread ? 0 : sNextThread++;
+		}
+		return tThread;
+	}
+
+	double ToMs(int64_t microseconds)
+	{
+		return microseconds / 1000.0;
+	}
+
+	// Every stage of one asset added together, for the summary
+	struct AssetTotals
+	{
+		const std::string* mPath;
+		const char* mType;
+		int64_t mTime;
+		int64_t mSelfTime;
+		int64_t mParseTime;
+		int64_t mUploadTime;
+		size_t mBytes;
+	};
+}
+
+void LoadProfiler::Enable(bool enable)
+{
+	if (enable)
+	{
+		Clear();
+		sEpoch = std::chrono::high_resolution_clock::now();
+		sMainThread = std::this_thread::get_id();
+		tThread = 0;
+	}
+	sEnabled = enable;
+}
+
+bool LoadProfiler::IsEnabled()
+{
+	return sEnabled;
+}
+
+void LoadProfiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(sRecordsMutex);
+	sRecords.clear();
+}
+
+bool LoadProfiler::WriteTrace(const char* fileName)
+{
+	std::vector<LoadRecord> records;
+	{
+		std::lock_guard<std::mutex> lock(sRecordsMutex);
+		records = sRecords;
+	}
+	// In order of starting, so the viewer nests them properly
+	std::sort(records.begin(), records.end(), [](const LoadRecord& a, const LoadRecord& b)
+	{
+		return a.mStart < b.mStart || (a.mStart == b.mStart && a.mDepth < b.mDepth);
+	});
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("traceEvents");
+	writer.StartArray();
+
+	uint32_t numThreads = 0;
+	for (auto& record : records)
+	{
+		numThreads = Math::Max(numThreads, record.mThread + 1);
+	}
+	for (uint32_t i = 0; i < numThreads; i++)
+	{
+		std::string name = i == 0 ? "Main" : "Worker " + std::to_string(i);
+		writer.StartObject();
+		writer.Key("name"); writer.String("thread_name");
+		writer.Key("ph"); writer.String("M");
+		writer.Key("pid"); writer.Uint(1);
+		writer.Key("tid"); writer.Uint(i);
+		writer.Key("args");
+		writer.StartObject();
+		writer.Key("name"); writer.String(name.c_str());
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	for (auto& record : records)
+	{
+		writer.StartObject();
+		writer.Key("name"); writer.String(record.mPath.c_str());
+		writer.Key("cat"); writer.String(record.mType);
+		writer.Key("ph"); writer.String("X");
+		writer.Key("ts"); writer.Int64(record.mStart);
+		writer.Key("dur"); writer.Int64(record.mDuration);
+		writer.Key("pid"); writer.Uint(1);
+		writer.Key("tid"); writer.Uint(record.mThread);
+		writer.Key("args");
+		writer.StartObject();
+		writer.Key("stage"); writer.String(record.mStage);
+		writer.Key("bytes"); writer.Uint64(record.mBytes);
+		writer.Key("self_ms"); writer.Double(ToMs(record.mDuration - record.mChildTime));
+		writer.Key("parse_ms"); writer.Double(ToMs(record.mParseTime));
+		writer.Key("upload_ms"); writer.Double(ToMs(record.mUploadTime));
+		writer.Key("parent"); writer.String(record.mParent.c_str());
+		writer.Key("depth"); writer.Uint(record.mDepth);
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	writer.EndArray();
+	writer.Key("displayTimeUnit"); writer.String("ms");
+	writer.EndObject();
+
+	std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(buffer.GetString(), buffer.GetSize());
+	if (file.fail())
+	{
+		SDL_Log("Couldn't write load trace %s", fileName);
+		return false;
+	}
+	SDL_Log("Wrote %u asset loads to %s", static_cast<unsigned>(records.size()), fileName);
+	return true;
+}
+
+void LoadProfiler::PrintSummary(size_t maxAssets)
+{
+	std::lock_guard<std::mutex> lock(sRecordsMutex);
+
+	// An asynchronous load is recorded in two halves, so add them up
+	std::vector<AssetTotals> assets;
+	std::unordered_map<std::string, size_t> indices;
+	AssetTotals total;
+	memset(&total, 0, sizeof(total));
+	int64_t first = INT64_MAX;
+	int64_t last = 0;
+	for (auto& record : sRecords)
+	{
+		auto iter = indices.emplace(record.mPath, assets.size()).first;
+		if (iter->second == assets.size())
+		{
+			AssetTotals totals;
+			memset(&totals, 0, sizeof(totals));
+			totals.mPath = &iter->first;
+			totals.mType = record.mType;
+			assets.emplace_back(totals);
+		}
+
+		int64_t selfTime = record.mDuration - record.mChildTime;
+		AssetTotals& totals = assets[iter->second];
+		totals.mTime += record.mDuration;
+		totals.mSelfTime += selfTime;
+		totals.mParseTime += record.mParseTime;
+		totals.mUploadTime += record.mUploadTime;
+		totals.mBytes += record.mBytes;
+
+		total.mSelfTime += selfTime;
+		total.mParseTime += record.mParseTime;
+		total.mUploadTime += record.mUploadTime;
+		total.mBytes += record.mBytes;
+		first = Math::Min(first, record.mStart);
+		last = Math::Max(last, record.mStart + record.mDuration);
+	}
+
+	if (assets.empty())
+	{
+		SDL_Log("LoadProfiler: No asset loads recorded");
+		return;
+	}
+
+	std::sort(assets.begin(), assets.end(), [](const AssetTotals& a, const AssetTotals& b)
+	{
+		return a.mSelfTime > b.mSelfTime;
+	});
+
+	SDL_Log("LoadProfiler: %u assets loaded over %.2f ms, %.2f ms of loading on all threads (%.2f ms parsing, %.2f ms uploading), %.1f KB read",
+		static_cast<unsigned>(assets.size()), ToMs(last - first), ToMs(total.mSelfTime),
+		ToMs(total.mParseTime), ToMs(total.mUploadTime), total.mBytes / 1024.0);
+	SDL_Log("%9s %9s %9s %9s %9s  %-10s %s", "total ms", "self ms", "parse ms", "upload ms", "KB", "type", "path");
+	size_t count = Math::Min(maxAssets, assets.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		const AssetTotals& totals = assets[i];
+		SDL_Log("%9.2f %9.2f %9.2f %9.2f %9.1f  %-10s %s", ToMs(totals.mTime), ToMs(totals.mSelfTime),
+			ToMs(totals.mParseTime), ToMs(totals.mUploadTime), totals.mBytes / 1024.0,
+			totals.mType, totals.mPath->c_str());
+	}
+	if (count < assets.size())
+	{
+		SDL_Log("(%u more)", static_cast<unsigned>(assets.size() - count));
+	}
+}
+
+void LoadProfiler::AddBytesRead(size_t bytes)
+{
+	if (!tStack.empty())
+	{
+		tStack.back().mBytes += bytes;
+	}
+}
+
+std::string LoadProfiler::GetCurrentPath()
+{
+	return sEnabled && !tStack.empty() ? tStack.back().mPath : std::string();
+}
+
+LoadScope::LoadScope(const char* path, const char* type, const char* stage, const char* parent)
+	:mActive(sEnabled)
+{
+	if (!mActive)
+	{
+		return;
+	}
+
+	LoadRecord record;
+	record.mPath = path;
+	record.mType = type;
+	record.mStage = stage;
+	if (parent != nullptr)
+	{
+		record.mParent = parent;
+	}
+	else if (!tStack.empty())
+	{
+		record.mParent = tStack.back().mPath;
+	}
+	record.mChildTime = 0;
+	record.mParseTime = 0;
+	record.mUploadTime = 0;
+	record.mBytes = 0;
+	record.mThread = GetThread();
+	record.mDepth = static_cast<uint32_t>(tStack.size());
+	record.mStart = Now();
+	record.mDuration = 0;
+	tStack.emplace_back(std::move(record));
+}
+
+LoadScope::~LoadScope()
+{
+	if (!mActive)
+	{
+		return;
+	}
+
+	LoadRecord record = std::move(tStack.back());
+	tStack.pop_back();
+	record.mDuration = Now() - record.mStart;
+	if (!tStack.empty())
+	{
+		tStack.back().mChildTime += record.mDuration;
+	}
+
+	std::lock_guard<std::mutex> lock(sRecordsMutex);
+	sRecords.emplace_back(std::move(record));
+}
+
+LoadPhase::LoadPhase(ELoadPhase phase)
+	:mPhase(phase)
+	,mActive(sEnabled && !tStack.empty())
+	,mStart(mActive ? Now() : 0)
+{
+}
+
+LoadPhase::~LoadPhase()
+{
+	if (!mActive || tStack.empty())
+	{
+		return;
+	}
+
+	LoadRecord& record = tStack.back();
+	int64_t time = Now() - mStart;
+	if (mPhase == ELP_Parse)
+	{
+		record.mParseTime += time;
+	}
+	else
+	{
+		record.mUploadTime += time;
+	}
+}
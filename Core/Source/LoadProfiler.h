@@ -0,0 +1,93 @@
+// LoadProfiler.h
+// Records how long each asset takes to load, and where the time goes,
+// so it's clear which assets hold up startup and level loads. While it's
+// enabled, every load the AssetCache does is recorded with its path,
+// type, the thread it ran on, how many bytes it read, and how much of
+// its time went on parsing and on uploading to the GPU.
+//
+// Loads started from inside another load are recorded as its children,
+// such as a mesh's textures, whether they load right there on the same
+// thread or are started asynchronously and finish on another one. A
+// load's self time leaves out the time spent in loads nested inside it.
+//
+// WriteTrace exports everything recorded as a Chrome trace, which can be
+// opened in chrome://tracing or https://ui.perfetto.dev, and
+// PrintSummary logs each asset's totals, slowest first.
+//
+// Generally will be used like:
+// LoadProfiler::Enable(true);
+// (load things)
+// LoadProfiler::PrintSummary();
+// LoadProfiler::WriteTrace("LoadTrace.json");
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class LoadProfiler
+{
+public:
+	// Starts or stops recording. Enabling clears anything recorded before,
+	// and makes the calling thread the one named "Main" in the trace
+	static void Enable(bool enable);
+	static bool IsEnabled();
+	static void Clear();
+
+	// Writes everything recorded so far as Chrome trace event JSON.
+	// Returns false if the file couldn't be written
+	static bool WriteTrace(const char* fileName);
+	// Logs the maxAssets assets that took the most self time, with each
+	// one's load stages added together, and the totals for everything
+	static void PrintSummary(size_t maxAssets = 20);
+
+	// Counts bytes towards the innermost load on the calling thread, if
+	// there is one. VirtualFile calls this for every file it opens
+	static void AddBytesRead(size_t bytes);
+	// The path of the innermost load on the calling thread, or an empty
+	// string if it isn't loading anything, or recording is off
+	static std::string GetCurrentPath();
+};
+
+// What part of a load a LoadPhase times
+enum ELoadPhase
+{
+	// Reading the file's contents into the asset
+	ELP_Parse,
+	// Creating the asset's GPU resources
+	ELP_Upload
+};
+
+// Records one stage of an asset's load, from construction to destruction,
+// if the profiler is enabled. stage is "Load" for a synchronous load, or
+// "LoadData" or "Finalize" for the halves of an asynchronous one. The
+// parent is the innermost load on this thread, unless one is given (an
+// empty one for none), which is how asynchronous loads keep theirs.
+// path, type and stage have to last until the scope ends
+class LoadScope
+{
+public:
+	LoadScope(const char* path, const char* type, const char* stage, const char* parent = nullptr);
+	~LoadScope();
+private:
+	LoadScope(const LoadScope&) = delete;
+	LoadScope& operator=(const LoadScope&) = delete;
+
+	bool mActive;
+};
+
+// Adds the time until it's destroyed to the innermost load on this thread
+// as parse or upload time, if the profiler is enabled
+class LoadPhase
+{
+public:
+	explicit LoadPhase(ELoadPhase phase);
+	~LoadPhase();
+private:
+	LoadPhase(const LoadPhase&) = delete;
+	LoadPhase& operator=(const LoadPhase&) = delete;
+
+	ELoadPhase mPhase;
+	bool mActive;
+	int64_t mStart;
+};
@@ -0,0 +1,241 @@
+#include "ITPEnginePCH.h"
+
+namespace
+{
+	const size_t MIN_MATCH = 4;
+	// The format requires the last 5 bytes to be literals, and the last
+	// match to start at least 12 bytes from the end
+	const size_t LAST_LITERALS = 5;
+	const size_t MATCH_FIND_LIMIT = 12;
+	const size_t MAX_OFFSET = 65535;
+	const int HASH_BITS = 14;
+
+	uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761U) >> (32 - HASH_BITS);
+	}
+
+	// Lengths of 15 or more spill into extra bytes of 255, ending with one
+	// that's less. Returns false if there isn't room
+	bool WriteLength(size_t length, uint8_t*& out, const uint8_t* outEnd)
+	{
+		for (; length >= 255; length -= 255)
+		{
+			if (out >= outEnd)
+			{
+				return false;
+			}
+			*out++ = 255;
+		}
+		if (out >= outEnd)
+		{
+			return false;
+		}
+		*out++ = static_cast<uint8_t>(length);
+		return true;
+	}
+
+	bool ReadLength(size_t& length, const uint8_t*& in, const uint8_t* inEnd)
+	{
+		uint8_t byte;
+		do
+		{
+			if (in >= inEnd)
+			{
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	// Writes the literals from begin to end, followed by a match, or not if
+	// matchLength is 0 (which only the last sequence can be)
+	bool WriteSequence(const uint8_t* begin, const uint8_t* end, size_t offset, size_t matchLength,
+		uint8_t*& out, const uint8_t* outEnd)
+	{
+		size_t literals = end - begin;
+		size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+		if (out >= outEnd)
+		{
+			return false;
+		}
+		*out++ = static_cast<uint8_t>((Math::Min(literals, static_cast<size_t>(15)) << 4) | Math::Min(matchCode, static_cast<size_t>(15)));
+		if (literals >= 15 && !WriteLength(literals - 15, out, outEnd))
+		{
+			return false;
+		}
+
+		if (literals > static_cast<size_t>(outEnd - out))
+		{
+			return false;
+		}
+		memcpy(out, begin, literals);
+		out += literals;
+		if (matchLength == 0)
+		{
+			return true;
+		}
+
+		if (outEnd - out < 2)
+		{
+			return false;
+		}
+		*out++ = static_cast<uint8_t>(offset);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+		return matchCode < 15 || WriteLength(matchCode - 15, out, outEnd);
+	}
+}
+
+namespace Lz4
+{
+	size_t GetMaxCompressedSize(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	size_t Compress(const void* src, size_t size, void* dst, size_t capacity)
+	{
+		const uint8_t* in = static_cast<const uint8_t*>(src);
+		const uint8_t* inEnd = in + size;
+		uint8_t* out = static_cast<uint8_t*>(dst);
+		const uint8_t* outEnd = out + capacity;
+
+		// Where each hash of 4 bytes was last seen, from the start of src
+		std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, 0);
+
+		const uint8_t* anchor = in;
+		if (size > MATCH_FIND_LIMIT)
+		{
+			const uint8_t* matchStartLimit = inEnd - MATCH_FIND_LIMIT;
+			const uint8_t* matchEndLimit = inEnd - LAST_LITERALS;
+			const uint8_t* current = in;
+			while (current <= matchStartLimit)
+			{
+				uint32_t sequence = Read32(current);
+				uint32_t& slot = table[Hash(sequence)];
+				const uint8_t* match = in + slot;
+				slot = static_cast<uint32_t>(current - in);
+				if (match >= current || static_cast<size_t>(current - match) > MAX_OFFSET || Read32(match) != sequence)
+				{
+					current++;
+					continue;
+				}
+
+				// Take the match as far forward, then back, as it goes
+				const uint8_t* matchEnd = current + MIN_MATCH;
+				const uint8_t* compare = match + MIN_MATCH;
+				while (matchEnd < matchEndLimit && *matchEnd == *compare)
+				{
+					matchEnd++;
+					compare++;
+				}
+				while (current > anchor && match > in && current[-1] == match[-1])
+				{
+					current--;
+					match--;
+				}
+
+				if (!WriteSequence(anchor, current, current - match, matchEnd - current, out, outEnd))
+				{
+					return 0;
+				}
+				current = matchEnd;
+				anchor = current;
+			}
+		}
+
+		if (!WriteSequence(anchor, inEnd, 0, 0, out, outEnd))
+		{
+			return 0;
+		}
+		return out - static_cast<uint8_t*>(dst);
+	}
+
+	bool Decompress(const void* src, size_t srcSize, void* dst, size_t dstSize)
+	{
+		const uint8_t* in = static_cast<const uint8_t*>(src);
+		const uint8_t* inEnd = in + srcSize;
+		uint8_t* outStart = static_cast<uint8_t*>(dst);
+		uint8_t* out = outStart;
+		const uint8_t* outEnd = out + dstSize;
+
+		while (in < inEnd)
+		{
+			uint8_t token = *in++;
+			size_t literals = token >> 4;
+			if (literals == 15 && !ReadLength(literals, in, inEnd))
+			{
+				return false;
+			}
+			if (literals > static_cast<size_t>(inEnd - in) || literals > static_cast<size_t>(outEnd - out))
+			{
+				return false;
+			}
+			// Most runs of literals are short, and copying a fixed 16 bytes
+			// is quicker than copying exactly as many as there are. What's
+			// copied past the end is written over by what comes next
+			if (literals <= 16 && inEnd - in >= 16 && outEnd - out >= 16)
+			{
+				memcpy(out, in, 16);
+			}
+			else
+			{
+				memcpy(out, in, literals);
+			}
+			in += literals;
+			out += literals;
+
+			// The last sequence is only literals
+			if (in == inEnd)
+			{
+				return out == outEnd;
+			}
+
+			if (inEnd - in < 2)
+			{
+				return false;
+			}
+			size_t offset = in[0] | (in[1] << 8);
+			in += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !ReadLength(matchLength, in, inEnd))
+			{
+				return false;
+			}
+			matchLength += MIN_MATCH;
+			if (offset == 0 || offset > static_cast<size_t>(out - outStart) || matchLength > static_cast<size_t>(outEnd - out))
+			{
+				return false;
+			}
+
+			// A match can overlap what it's writing, to repeat a short run.
+			// 8 bytes at a time is safe as long as it's at least that far back
+			const uint8_t* match = out - offset;
+			if (offset >= 8 && static_cast<size_t>(outEnd - out) >= matchLength + 8)
+			{
+				for (size_t i = 0; i < matchLength; i += 8)
+				{
+					memcpy(out + i, match + i, 8);
+				}
+				out += matchLength;
+			}
+			else
+			{
+				for (size_t i = 0; i < matchLength; i++)
+				{
+					*out++ = *match++;
+				}
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,23 @@
+// Lz4.h
+// Compresses and decompresses blocks in the LZ4 block format, which
+// decompresses at a few GB/s, so a compressed file costs less to read from
+// a slow disk than an uncompressed one does. Only the block format is
+// supported (not the frame format with its headers and checksums), so the
+// caller has to keep track of how big the data was before it was compressed.
+
+#pragma once
+#include <cstddef>
+
+namespace Lz4
+{
+	// The most Compress can need for size bytes, if nothing repeats
+	size_t GetMaxCompressedSize(size_t size);
+
+	// Compresses size bytes of src into dst, which has room for capacity
+	// bytes. Returns the compressed size, or 0 if it doesn't fit
+	size_t Compress(const void* src, size_t size, void* dst, size_t capacity);
+
+	// Decompresses a whole block into exactly dstSize bytes. Returns false
+	// if the block is corrupt, or doesn't decompress to exactly dstSize
+	bool Decompress(const void* src, size_t srcSize, void* dst, size_t dstSize);
+}
@@ -1,11 +1,106 @@
 #include "ITPEnginePCH.h"
+#include "AudioRegression.h"
+#include "AssetCooker.h"
 
 int main(int argc, char* argv[])
 {
-	Game game;
+	// -audiotest [file] [-record] renders the mixer regression scenarios
+	// instead of running the game
+	if (argc > 1 && strcmp(argv[1], "-audiotest") == 0)
+	{
+		const char* path = "Assets/AudioTests/Mixer.itpaudiotest";
+		bool record = false;
+		for (int i = 2; i < argc; i++)
+		{
+			if (strcmp(argv[i], "-record") == 0)
+			{
+				record = true;
+			}
+			else
+			{
+				path = argv[i];
+			}
+		}
+		return AudioRegression::Run(path, record) ? 0 : 1;
+	}
+
+	// -cook [files] cooks the given assets, or all of them that have
+	// changed, and exits. -cook -force cooks all of them regardless
+	if (argc > 1 && strcmp(argv[1], "-cook") == 0)
+	{
+		bool force = argc > 2 && strcmp(argv[2], "-force") == 0;
+		int failed = argc > 2 && !force ? AssetCooker::CookFiles(argv + 2, argc - 2) : AssetCooker::CookAll("Assets/", force);
+		return failed == 0 ? 0 : 1;
+	}
+
+	// -pack cooks whatever's changed, then packs all the assets into the
+	// archive the game reads them from if it's there, and exits
+	if (argc > 1 && strcmp(argv[1], "-pack") == 0)
+	{
+		int failed = AssetCooker::CookAll("Assets/");
+		return failed == 0 && AssetCooker::Pack("Assets/", "Assets.itppak") ? 0 : 1;
+	}
+
+	// -speakers 5.1 or 7.1 mixes for surround instead of stereo
+	SpeakerLayout speakers = SPEAKERS_STEREO;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "-speakers") == 0)
+		{
+			if (strcmp(argv[i + 1], "5.1") == 0)
+			{
+				speakers = SPEAKERS_5_1;
+			}
+			else if (strcmp(argv[i + 1], "7.1") == 0)
+			{
+				speakers = SPEAKERS_7_1;
+			}
+		}
+	}
+
+	// -profileloads records every asset loaded at startup, including the
+	// first level, then logs the slowest and writes LoadTrace.json for
+	// chrome://tracing
+	bool profileLoads = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-profileloads") == 0)
+		{
+			profileLoads = true;
+		}
+	}
+	LoadProfiler::Enable(profileLoads);
+
+	// -music [stems] plays the given wav files as one looping segment of
+	// music, each pass as long as the longest stem, to try out the music system
+	std::vector<std::string> musicStems;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-music") == 0)
+		{
+			for (i++; i < argc && argv[i][0] != '-'; i++)
+			{
+				musicStems.emplace_back(argv[i]);
+			}
+			i--;
+		}
+	}
+
+	Game game(speakers);
 	
 	if (game.Init())
 	{
+		if (profileLoads)
+		{
+			LoadProfiler::Enable(false);
+			LoadProfiler::PrintSummary();
+			LoadProfiler::WriteTrace("LoadTrace.json");
+		}
+		if (!musicStems.empty())
+		{
+			MusicSystem& music = game.GetMusic();
+			music.Play(music.LoadSegment(musicStems, TempoMap(120.0f, 4, SAMPLE_RATE)));
+		}
 		game.RunLoop();
 	}
 
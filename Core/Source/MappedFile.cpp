@@ -0,0 +1,148 @@
+#include "ITPEnginePCH.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	:mData(nullptr)
+	,mSize(0)
+#ifdef _WIN32
+	,mFile(INVALID_HANDLE_VALUE)
+	,mMapping(nullptr)
+#endif
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	mFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+	mSize = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+	{
+		UnmapViewOfFile(mData);
+		mData = nullptr;
+	}
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+	mSize = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	// PrefetchVirtualMemory is new in Windows 8
+#if _WIN32_WINNT >= 0x0602
+	if (mData != nullptr && offset < mSize)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = const_cast<char*>(static_cast<const char*>(mData)) + offset;
+		range.NumberOfBytes = Math::Min(size, mSize - offset);
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#endif
+}
+#else
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	int file = open(fileName, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps the file open, so the descriptor isn't needed after this
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mData = data;
+	mSize = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+	{
+		munmap(const_cast<void*>(mData), mSize);
+		mData = nullptr;
+	}
+	mSize = 0;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (mData == nullptr || offset >= mSize)
+	{
+		return;
+	}
+
+	// madvise wants a page aligned address
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = offset & ~(pageSize - 1);
+	size_t end = offset + Math::Min(size, mSize - offset);
+	madvise(const_cast<char*>(static_cast<const char*>(mData)) + begin, end - begin, MADV_WILLNEED);
+}
+#endif
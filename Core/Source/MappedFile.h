@@ -0,0 +1,37 @@
+// MappedFile.h
+// Maps a whole file into memory, read only, so cooked data can be
+// used where it is instead of being read into a buffer first
+
+#pragma once
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Closes whatever was open first. Returns false if the file
+	// couldn't be opened or is empty
+	bool Open(const char* fileName);
+	void Close();
+
+	bool IsOpen() const { return mData != nullptr; }
+	const void* GetData() const { return mData; }
+	size_t GetSize() const { return mSize; }
+
+	// Asks the OS to start reading size bytes from offset into memory, so
+	// they're there by the time they're used. It's only a hint
+	void Prefetch(size_t offset, size_t size) const;
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const void* mData;
+	size_t mSize;
+#ifdef _WIN32
+	// HANDLEs, kept as void* so this header doesn't need windows.h
+	void* mFile;
+	void* mMapping;
+#endif
+};
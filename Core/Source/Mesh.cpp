@@ -1,15 +1,6 @@
 #include "ITPEnginePCH.h"
 #include <SDL/SDL_log.h>
 
-namespace
-{
-	union VertPacked
-	{
-		float f;
-		uint8_t b[4];
-	};
-}
-
 Mesh::Mesh(class Game& game)
 	:Asset(game)
 	,mShaderType(EMS_Basic)
@@ -30,218 +21,162 @@ Mesh::~Mesh()
 
 bool Mesh::Load(const char* fileName, AssetCache* cache)
 {
-	std::ifstream file(fileName);
-	if (!file.is_open())
+	if (!LoadData(fileName))
 	{
-		SDL_Log("File not found: Mesh %s", fileName);
 		return false;
 	}
-	
-	std::stringstream fileStream;
-	fileStream << file.rdbuf();
-	std::string contents = fileStream.str();
-	rapidjson::StringStream jsonStr(contents.c_str());
-	rapidjson::Document doc;
-	doc.ParseStream(jsonStr);
 
-	if (!doc.IsObject())
+	for (auto& textureName : mLoadedData->mTextureNames)
 	{
-		SDL_Log("Mesh %s is not valid json", fileName);
-		return false;
+		mTextures.emplace_back(cache->Load<Texture>(textureName));
 	}
+	CreateVertexArray(fileName, cache);
+	return true;
+}
 
-	std::string str = doc["metadata"]["type"].GetString();
-	int ver = doc["metadata"]["version"].GetInt();
-
- 	// Check the metadata
- 	if (!doc["metadata"].IsObject() ||
-		str != "itpmesh" ||
- 		ver != 2)
- 	{
- 		SDL_Log("Mesh %s unknown format", fileName);
- 		return false;
- 	}
+bool Mesh::LoadData(const char* fileName)
+{
+	LoadPhase phase(ELP_Parse);
+	mLoadedData.reset(new LoadedData());
 
-	// Load textures
-	const rapidjson::Value& textures = doc["textures"];
-	if (!textures.IsArray() || textures.Size() < 1)
+	// Use the cooked mesh if the asset cooker has made one, since it needs no parsing
+	std::string cookedName = GetCookedFileName(fileName);
+	if (!cookedName.empty())
 	{
-		SDL_Log("Mesh %s has no textures, there should be at least one", fileName);
-		return false;
-	}
-	
-	for (rapidjson::SizeType i = 0; i < textures.Size(); i++)
-	{
-		std::string textureName = textures[i].GetString();
-		mTextures.emplace_back(cache->Load<Texture>(textureName.c_str()));
-		if (mTextures[i] == nullptr)
+		if (LoadCooked(cookedName.c_str()))
 		{
-			// Failed to load this texture, so use the default
-			SDL_Log("Mesh %s: Failed to load texture %s. Using default.", fileName, textureName.c_str());
-			mTextures[i] = cache->Load<Texture>("Textures/Default.png");
+			return true;
 		}
+		SDL_Log("Mesh %s: Cooked mesh %s is invalid. Loading the source instead.", fileName, cookedName.c_str());
+		mLoadedData.reset(new LoadedData());
 	}
+	return LoadJson(fileName);
+}
 
-	// Read the vertex format
-	const rapidjson::Value& vertFormat = doc["vertexformat"];
-	if (!vertFormat.IsArray() || vertFormat.Size() < 1)
+bool Mesh::LoadCooked(const char* fileName)
+{
+	VirtualFile& file = mLoadedData->mCookedFile;
+	if (!file.Open(fileName))
 	{
-		SDL_Log("Mesh %s vertex format must have at least one element.", fileName);
 		return false;
 	}
 
-	size_t vertSize = 0;
-	size_t vertNumValues = 0;
-	std::string inputLayoutName;
-
-	for (rapidjson::SizeType i = 0; i < vertFormat.Size(); i++)
+	const MeshFormat::Header* header = MeshFormat::GetCookedHeader(file.GetData(), file.GetSize());
+	if (header == nullptr)
 	{
-		if (!vertFormat[i].IsObject())
-		{
-			SDL_Log("Mesh %s: Vertex format element %d is invalid.", fileName, i);
-			return false;
-		}
-
-		inputLayoutName += vertFormat[i]["name"].GetString();
+		return false;
+	}
 
-		std::string vertType = vertFormat[i]["type"].GetString();
-		size_t elementSize = 0;
-		if (vertType == "float")
-		{
-			elementSize = 4;
-		}
-		else
-		{
-			elementSize = 1;
-		}
+	const char* data = static_cast<const char*>(file.GetData());
+	mShaderType = static_cast<EMeshShader>(header->mShaderType);
+	mBoundingBox.mMin = Vector3(header->mBoxMin[0], header->mBoxMin[1], header->mBoxMin[2]);
+	mBoundingBox.mMax = Vector3(header->mBoxMax[0], header->mBoxMax[1], header->mBoxMax[2]);
+	mBoundingSphere.mCenter = Vector3(header->mSphereCenter[0], header->mSphereCenter[1], header->mSphereCenter[2]);
+	mBoundingSphere.mRadius = header->mSphereRadius;
 
-		vertNumValues += vertFormat[i]["count"].GetUint();
-		vertSize += elementSize * vertFormat[i]["count"].GetUint();
-	}
+	const MeshFormat::VertexElement* elements = reinterpret_cast<const MeshFormat::VertexElement*>(data + header->mElementsOffset);
+	mLoadedData->mInputLayoutName = MeshFormat::GetInputLayoutName(elements, header->mNumElements);
 
-	if (vertNumValues < 3)
+	// Texture paths are packed end to end
+	const char* textureName = data + header->mTexturesOffset;
+	const char* texturesEnd = textureName + header->mTexturesSize;
+	for (uint32_t i = 0; i < header->mNumTextures && textureName < texturesEnd; i++)
 	{
-		SDL_Log("Mesh %s must at least have 3D position coordinates!", fileName);
-		return false;
+		mLoadedData->mTextureNames.emplace_back(textureName);
+		textureName += mLoadedData->mTextureNames.back().size() + 1;
 	}
 
-	// Get the shader type
-	std::string shaderType = doc["shader"]["name"].GetString();
-	if (shaderType == "BasicMesh")
-	{
-		mShaderType = EMS_Basic;
-	}
-	else if (shaderType == "Phong")
-	{
-		mShaderType = EMS_Phong;
-	}
-	else if (shaderType == "Skinned")
-	{
-		mShaderType = EMS_Skinned;
-	}
-	else
-	{
-		SDL_Log("Mesh %s has unknown shader type. Defaulting to basic mesh.", fileName);
-	}
+	mLoadedData->mVertices = data + header->mVerticesOffset;
+	mLoadedData->mNumVerts = header->mNumVerts;
+	mLoadedData->mVertSize = header->mVertSize;
+	mLoadedData->mIndices = reinterpret_cast<const uint16_t*>(data + header->mIndicesOffset);
+	mLoadedData->mNumIndices = header->mNumIndices;
+	return true;
+}
 
-	// Load in the vertices
-	const rapidjson::Value& vertsJson = doc["vertices"];
-	if (!vertsJson.IsArray() || vertsJson.Size() < 1)
+bool Mesh::LoadJson(const char* fileName)
+{
+	MeshFormat::MeshData& json = mLoadedData->mJson;
+	if (!MeshFormat::ReadJson(fileName, json))
 	{
-		SDL_Log("Mesh %s has no vertices", fileName);
 		return false;
 	}
 
-	size_t numVerts = vertsJson.Size();
-	std::vector<VertPacked> vertices;
-	vertices.reserve(numVerts * vertSize);
-	for (rapidjson::SizeType i = 0; i < vertsJson.Size(); i++)
+	mShaderType = json.mShaderType;
+	mBoundingBox = json.mBoundingBox;
+	mBoundingSphere = json.mBoundingSphere;
+
+	mLoadedData->mInputLayoutName = MeshFormat::GetInputLayoutName(json.mVertexFormat.data(), json.mVertexFormat.size());
+	mLoadedData->mTextureNames = json.mTextureNames;
+	mLoadedData->mVertices = json.mVertices.data();
+	mLoadedData->mNumVerts = json.mNumVerts;
+	mLoadedData->mVertSize = json.mVertSize;
+	mLoadedData->mIndices = json.mIndices.data();
+	mLoadedData->mNumIndices = json.mIndices.size();
+	return true;
+}
+
+EFinalizeResult Mesh::Finalize(const char* fileName, AssetCache* cache)
+{
+	// Start every texture loading the first time through, then come back
+	// until they've all finished
+	std::vector<AssetFuture<Texture>>& loads = mLoadedData->mTextureLoads;
+	if (loads.empty())
 	{
-		const rapidjson::Value& vert = vertsJson[i];
-		if (!vert.IsArray() || vert.Size() != vertNumValues)
+		for (auto& textureName : mLoadedData->mTextureNames)
 		{
-			SDL_Log("Unexpected vertex format for %s", fileName);
-			return false;
+			loads.emplace_back(cache->LoadAsync<Texture>(textureName));
 		}
+	}
 
-		Vector3 pos(vert[0].GetDouble(), vert[1].GetDouble(), vert[2].GetDouble());
-		// Update the bounding box
-		mBoundingBox.UpdateMinMax(pos);
-		
-		// Now stuff all the vertices into the vertex buffer
-		if (mShaderType != EMS_Skinned)
+	for (auto& load : loads)
+	{
+		if (!load.IsReady())
 		{
-			for (rapidjson::SizeType j = 0; j < vert.Size(); j++)
-			{
-				VertPacked temp;
-				temp.f = vert[j].GetDouble();
-				vertices.emplace_back(temp);
-			}
-		}
-		else
-		{
-			// Special case code for skinned, for now...
-			VertPacked temp;
-			// Position/Normal
-			for (rapidjson::SizeType j = 0; j < 6; j++)
-			{
-				temp.f = vert[j].GetDouble();
-				vertices.emplace_back(temp);
-			}
-			
-			// Uints for bones and weights
-			for (rapidjson::SizeType j = 6; j < 14; j += 4)
-			{
-				temp.b[0] = vert[j].GetUint();
-				temp.b[1] = vert[j + 1].GetUint();
-				temp.b[2] = vert[j + 2].GetUint();
-				temp.b[3] = vert[j + 3].GetUint();
-				vertices.emplace_back(temp);
-			}
-
-			// Last two texture coordinates
-			for (rapidjson::SizeType j = 14; j < vert.Size(); j++)
-			{
-				temp.f = vert[j].GetDouble();
-				vertices.emplace_back(temp);
-			}
+			return EFR_Pending;
 		}
 	}
 
-	// Now that we have a bounding box, make a bounding sphere
-	// around it
-	mBoundingSphere.ComputeFromBox(mBoundingBox);
-
-	// Load in the indices
-	const rapidjson::Value& indJson = doc["indices"];
-	if (!indJson.IsArray() || indJson.Size() < 1)
+	for (auto& load : loads)
 	{
-		SDL_Log("Mesh %s has no indices", fileName);
-		return false;
+		mTextures.emplace_back(load.Get());
 	}
+	CreateVertexArray(fileName, cache);
+	return EFR_Done;
+}
 
-	std::vector<uint16_t> indices;
-	indices.reserve(indJson.Size() * 3);
-	for (rapidjson::SizeType i = 0; i < indJson.Size(); i++)
+void Mesh::CreateVertexArray(const char* fileName, AssetCache* cache)
+{
+	for (size_t i = 0; i < mTextures.size(); i++)
 	{
-		const rapidjson::Value& ind = indJson[i];
-		if (!ind.IsArray() || ind.Size() != 3)
+		if (mTextures[i] == nullptr)
 		{
-			SDL_Log("Invalid indices for %s", fileName);
-			return false;
+			// Failed to load this texture, so use the default
+			SDL_Log("Mesh %s: Failed to load texture %s. Using default.", fileName, mLoadedData->mTextureNames[i].c_str());
+			mTextures[i] = cache->Load<Texture>("Textures/Default.png");
 		}
-		
-		indices.emplace_back(static_cast<uint16_t>(ind[0].GetUint()));
-		indices.emplace_back(static_cast<uint16_t>(ind[1].GetUint()));
-		indices.emplace_back(static_cast<uint16_t>(ind[2].GetUint()));
 	}
 
 	// Now create a vertex array
-	mVertexArray = VertexArray::Create(mGame.GetRenderer().GetGraphicsDriver(), 
-		mGame.GetRenderer().GetInputLayoutCache(),
-		vertices.data(), numVerts, vertSize, inputLayoutName,
-		indices.data(), indices.size());
-	return true;
+	{
+		LoadPhase phase(ELP_Upload);
+		LoadedData& data = *mLoadedData;
+		mVertexArray = VertexArray::Create(mGame.GetRenderer().GetGraphicsDriver(), 
+			mGame.GetRenderer().GetInputLayoutCache(),
+			data.mVertices, data.mNumVerts, data.mVertSize, data.mInputLayoutName,
+			data.mIndices, data.mNumIndices);
+	}
+	mLoadedData.reset();
+}
+
+size_t Mesh::GetMemorySize() const
+{
+	if (mVertexArray == nullptr)
+	{
+		return 0;
+	}
+	return mVertexArray->GetVertexCount() * mVertexArray->GetVertexSize() +
+		mVertexArray->GetIndexCount() * sizeof(uint16_t);
 }
 
 TexturePtr Mesh::GetTexture(size_t index)
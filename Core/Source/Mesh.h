@@ -2,9 +2,12 @@
 #include "Asset.h"
 #include "VertexArray.h"
 #include "Texture.h"
+#include "AssetCache.h"
 #include <vector>
 #include "ShaderTypes.h"
 #include "CollisionHelpers.h"
+#include "MeshFormat.h"
+#include "FileSystem.h"
 
 class Mesh : public Asset
 {
@@ -22,7 +25,40 @@ public:
 	const Collision::AxisAlignedBox& GetBoundingBox() const { return mBoundingBox; }
 
 	EMeshShader GetShaderType() const { return mShaderType; }
+
+	// Just the vertex and index buffers. The textures are assets of their own
+	size_t GetMemorySize() const override;
+protected:
+	bool LoadData(const char* fileName) override;
+	EFinalizeResult Finalize(const char* fileName, class AssetCache* cache) override;
 private:
+	// Maps the cooked mesh into mLoadedData, so it can be uploaded as it is
+	bool LoadCooked(const char* fileName);
+	bool LoadJson(const char* fileName);
+
+	// Creates the vertex array from mLoadedData, falling back on the default
+	// texture for any that didn't load, and frees mLoadedData
+	void CreateVertexArray(const char* fileName, class AssetCache* cache);
+
+	// What LoadData read, kept until it's on the GPU
+	struct LoadedData
+	{
+		// The vertices and indices point into one of these, depending on
+		// whether the mesh was cooked
+		VirtualFile mCookedFile;
+		MeshFormat::MeshData mJson;
+
+		const void* mVertices;
+		size_t mNumVerts;
+		size_t mVertSize;
+		const uint16_t* mIndices;
+		size_t mNumIndices;
+		std::string mInputLayoutName;
+		std::vector<std::string> mTextureNames;
+		std::vector<AssetFuture<Texture>> mTextureLoads;
+	};
+	std::unique_ptr<LoadedData> mLoadedData;
+
 	Collision::Sphere mBoundingSphere;
 	Collision::AxisAlignedBox mBoundingBox;
 	VertexArrayPtr mVertexArray;
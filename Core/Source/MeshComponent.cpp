@@ -23,7 +23,7 @@ void MeshComponent::SetProperties(const rapidjson::Value& properties)
 	Super::SetProperties(properties);
 
 	// Mesh and Texture Index properties set from JSON
-	std::string mesh;
+	const char* mesh = nullptr;
 	if ( GetStringFromJSON( properties, "mesh", mesh ) )
 	{
 		SetMesh( mOwner.GetGame().GetAssetCache().Load<Mesh>( mesh ) );
@@ -35,3 +35,12 @@ void MeshComponent::SetProperties(const rapidjson::Value& properties)
 		SetTextureIndex( textureIndex );
 	}
 }
+
+void MeshComponent::PreloadProperties(const rapidjson::Value& properties, LevelPreload& preload)
+{
+	const char* mesh = nullptr;
+	if ( GetStringFromJSON( properties, "mesh", mesh ) )
+	{
+		preload.Add<Mesh>( mesh );
+	}
+}
@@ -15,6 +15,8 @@ public:
 	void SetTextureIndex(int idx) { mTextureIndex = idx; }
 
 	void SetProperties(const rapidjson::Value& properties) override;
+	// Adds the assets properties refer to, so the level loads them before spawning
+	static void PreloadProperties(const rapidjson::Value& properties, class LevelPreload& preload);
 protected:
 	MeshPtr mMesh;
 	int mTextureIndex;
@@ -0,0 +1,358 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+
+namespace
+{
+	// Vertices are uploaded straight from the mapped file, so keep them aligned
+	const size_t VERTEX_ALIGNMENT = 16;
+
+	size_t AlignUp(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	void WritePadding(std::ofstream& file, size_t& offset, size_t alignment)
+	{
+		static const char zeros[VERTEX_ALIGNMENT] = {};
+		size_t aligned = AlignUp(offset, alignment);
+		file.write(zeros, aligned - offset);
+		offset = aligned;
+	}
+}
+
+namespace MeshFormat
+{
+	bool ReadJson(const char* fileName, MeshData& outData)
+	{
+		JsonFile json;
+		if (!json.Load(fileName))
+		{
+			SDL_Log("File not found: Mesh %s", fileName);
+			return false;
+		}
+		rapidjson::Document& doc = json.GetDocument();
+
+		if (!doc.IsObject())
+		{
+			SDL_Log("Mesh %s is not valid json", fileName);
+			return false;
+		}
+
+		std::string str = doc["metadata"]["type"].GetString();
+		int ver = doc["metadata"]["version"].GetInt();
+
+		// Check the metadata
+		if (!doc["metadata"].IsObject() ||
+			str != "itpmesh" ||
+			ver != 2)
+		{
+			SDL_Log("Mesh %s unknown format", fileName);
+			return false;
+		}
+
+		// Load textures
+		const rapidjson::Value& textures = doc["textures"];
+		if (!textures.IsArray() || textures.Size() < 1)
+		{
+			SDL_Log("Mesh %s has no textures, there should be at least one", fileName);
+			return false;
+		}
+
+		for (rapidjson::SizeType i = 0; i < textures.Size(); i++)
+		{
+			outData.mTextureNames.emplace_back(textures[i].GetString());
+		}
+
+		// Read the vertex format
+		const rapidjson::Value& vertFormat = doc["vertexformat"];
+		if (!vertFormat.IsArray() || vertFormat.Size() < 1)
+		{
+			SDL_Log("Mesh %s vertex format must have at least one element.", fileName);
+			return false;
+		}
+
+		size_t vertSize = 0;
+		size_t vertNumValues = 0;
+
+		for (rapidjson::SizeType i = 0; i < vertFormat.Size(); i++)
+		{
+			if (!vertFormat[i].IsObject())
+			{
+				SDL_Log("Mesh %s: Vertex format element %d is invalid.", fileName, i);
+				return false;
+			}
+
+			VertexElement element;
+			memset(&element, 0, sizeof(element));
+			std::string name = vertFormat[i]["name"].GetString();
+			if (name.size() >= MAX_ELEMENT_NAME)
+			{
+				SDL_Log("Mesh %s: Vertex format element name %s is too long.", fileName, name.c_str());
+				return false;
+			}
+			memcpy(element.mName, name.c_str(), name.size());
+
+			std::string vertType = vertFormat[i]["type"].GetString();
+			size_t elementSize = 0;
+			if (vertType == "float")
+			{
+				element.mType = EET_Float;
+				elementSize = 4;
+			}
+			else
+			{
+				element.mType = EET_Byte;
+				elementSize = 1;
+			}
+			element.mCount = vertFormat[i]["count"].GetUint();
+			outData.mVertexFormat.emplace_back(element);
+
+			vertNumValues += element.mCount;
+			vertSize += elementSize * element.mCount;
+		}
+
+		if (vertNumValues < 3)
+		{
+			SDL_Log("Mesh %s must at least have 3D position coordinates!", fileName);
+			return false;
+		}
+
+		// Get the shader type
+		outData.mShaderType = EMS_Basic;
+		std::string shaderType = doc["shader"]["name"].GetString();
+		if (shaderType == "BasicMesh")
+		{
+			outData.mShaderType = EMS_Basic;
+		}
+		else if (shaderType == "Phong")
+		{
+			outData.mShaderType = EMS_Phong;
+		}
+		else if (shaderType == "Skinned")
+		{
+			outData.mShaderType = EMS_Skinned;
+		}
+		else
+		{
+			SDL_Log("Mesh %s has unknown shader type. Defaulting to basic mesh.", fileName);
+		}
+
+		// Load in the vertices
+		const rapidjson::Value& vertsJson = doc["vertices"];
+		if (!vertsJson.IsArray() || vertsJson.Size() < 1)
+		{
+			SDL_Log("Mesh %s has no vertices", fileName);
+			return false;
+		}
+
+		// Initialize the bounding box to maximal opposite values
+		Collision::AxisAlignedBox& box = outData.mBoundingBox;
+		box.mMin = Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+		box.mMax = Vector3(FLT_MIN, FLT_MIN, FLT_MIN);
+
+		size_t numVerts = vertsJson.Size();
+		std::vector<VertPacked>& vertices = outData.mVertices;
+		vertices.reserve(numVerts * vertSize);
+		for (rapidjson::SizeType i = 0; i < vertsJson.Size(); i++)
+		{
+			const rapidjson::Value& vert = vertsJson[i];
+			if (!vert.IsArray() || vert.Size() != vertNumValues)
+			{
+				SDL_Log("Unexpected vertex format for %s", fileName);
+				return false;
+			}
+
+			Vector3 pos(vert[0].GetDouble(), vert[1].GetDouble(), vert[2].GetDouble());
+			// Update the bounding box
+			box.UpdateMinMax(pos);
+
+			// Now stuff all the vertices into the vertex buffer
+			if (outData.mShaderType != EMS_Skinned)
+			{
+				for (rapidjson::SizeType j = 0; j < vert.Size(); j++)
+				{
+					VertPacked temp;
+					temp.f = vert[j].GetDouble();
+					vertices.emplace_back(temp);
+				}
+			}
+			else
+			{
+				// Special case code for skinned, for now...
+				VertPacked temp;
+				// Position/Normal
+				for (rapidjson::SizeType j = 0; j < 6; j++)
+				{
+					temp.f = vert[j].GetDouble();
+					vertices.emplace_back(temp);
+				}
+
+				// Uints for bones and weights
+				for (rapidjson::SizeType j = 6; j < 14; j += 4)
+				{
+					temp.b[0] = vert[j].GetUint();
+					temp.b[1] = vert[j + 1].GetUint();
+					temp.b[2] = vert[j + 2].GetUint();
+					temp.b[3] = vert[j + 3].GetUint();
+					vertices.emplace_back(temp);
+				}
+
+				// Last two texture coordinates
+				for (rapidjson::SizeType j = 14; j < vert.Size(); j++)
+				{
+					temp.f = vert[j].GetDouble();
+					vertices.emplace_back(temp);
+				}
+			}
+		}
+
+		// Now that we have a bounding box, make a bounding sphere
+		// around it
+		outData.mBoundingSphere.ComputeFromBox(box);
+
+		// Load in the indices
+		const rapidjson::Value& indJson = doc["indices"];
+		if (!indJson.IsArray() || indJson.Size() < 1)
+		{
+			SDL_Log("Mesh %s has no indices", fileName);
+			return false;
+		}
+
+		std::vector<uint16_t>& indices = outData.mIndices;
+		indices.reserve(indJson.Size() * 3);
+		for (rapidjson::SizeType i = 0; i < indJson.Size(); i++)
+		{
+			const rapidjson::Value& ind = indJson[i];
+			if (!ind.IsArray() || ind.Size() != 3)
+			{
+				SDL_Log("Invalid indices for %s", fileName);
+				return false;
+			}
+
+			indices.emplace_back(static_cast<uint16_t>(ind[0].GetUint()));
+			indices.emplace_back(static_cast<uint16_t>(ind[1].GetUint()));
+			indices.emplace_back(static_cast<uint16_t>(ind[2].GetUint()));
+		}
+
+		outData.mNumVerts = numVerts;
+		outData.mVertSize = vertSize;
+		return true;
+	}
+
+	bool WriteCooked(const char* fileName, const MeshData& data)
+	{
+		std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SDL_Log("Couldn't write cooked mesh %s", fileName);
+			return false;
+		}
+
+		size_t texturesSize = 0;
+		for (auto& textureName : data.mTextureNames)
+		{
+			texturesSize += textureName.size() + 1;
+		}
+
+		Header header;
+		memset(&header, 0, sizeof(header));
+		header.mMagic = COOKED_MAGIC;
+		header.mVersion = COOKED_VERSION;
+		header.mShaderType = data.mShaderType;
+		header.mNumElements = static_cast<uint32_t>(data.mVertexFormat.size());
+		header.mNumTextures = static_cast<uint32_t>(data.mTextureNames.size());
+		header.mNumVerts = static_cast<uint32_t>(data.mNumVerts);
+		header.mVertSize = static_cast<uint32_t>(data.mVertSize);
+		header.mNumIndices = static_cast<uint32_t>(data.mIndices.size());
+		const Collision::AxisAlignedBox& box = data.mBoundingBox;
+		const Collision::Sphere& sphere = data.mBoundingSphere;
+		float boxMin[3] = { box.mMin.x, box.mMin.y, box.mMin.z };
+		float boxMax[3] = { box.mMax.x, box.mMax.y, box.mMax.z };
+		float sphereCenter[3] = { sphere.mCenter.x, sphere.mCenter.y, sphere.mCenter.z };
+		memcpy(header.mBoxMin, boxMin, sizeof(boxMin));
+		memcpy(header.mBoxMax, boxMax, sizeof(boxMax));
+		memcpy(header.mSphereCenter, sphereCenter, sizeof(sphereCenter));
+		header.mSphereRadius = sphere.mRadius;
+
+		size_t offset = sizeof(Header);
+		header.mElementsOffset = static_cast<uint32_t>(offset);
+		offset += data.mVertexFormat.size() * sizeof(VertexElement);
+		header.mTexturesOffset = static_cast<uint32_t>(offset);
+		header.mTexturesSize = static_cast<uint32_t>(texturesSize);
+		offset = AlignUp(offset + texturesSize, VERTEX_ALIGNMENT);
+		header.mVerticesOffset = static_cast<uint32_t>(offset);
+		offset = AlignUp(offset + data.mNumVerts * data.mVertSize, sizeof(uint16_t));
+		header.mIndicesOffset = static_cast<uint32_t>(offset);
+		offset += data.mIndices.size() * sizeof(uint16_t);
+		header.mFileSize = static_cast<uint32_t>(offset);
+
+		// Now write it all out, in the same order as the offsets
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.mVertexFormat.data()), data.mVertexFormat.size() * sizeof(VertexElement));
+		offset = header.mTexturesOffset;
+		for (auto& textureName : data.mTextureNames)
+		{
+			file.write(textureName.c_str(), textureName.size() + 1);
+		}
+		offset += texturesSize;
+		WritePadding(file, offset, VERTEX_ALIGNMENT);
+		file.write(reinterpret_cast<const char*>(data.mVertices.data()), data.mNumVerts * data.mVertSize);
+		offset += data.mNumVerts * data.mVertSize;
+		WritePadding(file, offset, sizeof(uint16_t));
+		file.write(reinterpret_cast<const char*>(data.mIndices.data()), data.mIndices.size() * sizeof(uint16_t));
+
+		if (file.fail())
+		{
+			SDL_Log("Couldn't write cooked mesh %s", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	const Header* GetCookedHeader(const void* data, size_t size)
+	{
+		if (size < sizeof(Header))
+		{
+			return nullptr;
+		}
+
+		const Header* header = static_cast<const Header*>(data);
+		if (header->mMagic != COOKED_MAGIC || header->mVersion != COOKED_VERSION ||
+			header->mFileSize != size || header->mNumElements == 0 ||
+			header->mNumTextures == 0 || header->mTexturesSize == 0)
+		{
+			return nullptr;
+		}
+
+		// Every block has to fit in the file, in order
+		uint64_t elementsEnd = header->mElementsOffset + static_cast<uint64_t>(header->mNumElements) * sizeof(VertexElement);
+		uint64_t texturesEnd = header->mTexturesOffset + static_cast<uint64_t>(header->mTexturesSize);
+		uint64_t verticesEnd = header->mVerticesOffset + static_cast<uint64_t>(header->mNumVerts) * header->mVertSize;
+		uint64_t indicesEnd = header->mIndicesOffset + static_cast<uint64_t>(header->mNumIndices) * sizeof(uint16_t);
+		if (header->mElementsOffset < sizeof(Header) || elementsEnd > header->mTexturesOffset ||
+			texturesEnd > header->mVerticesOffset || verticesEnd > header->mIndicesOffset ||
+			indicesEnd > size || header->mVerticesOffset % VERTEX_ALIGNMENT != 0)
+		{
+			return nullptr;
+		}
+
+		// The last texture path has to be terminated, or reading it would run off the end
+		const char* textures = static_cast<const char*>(data) + header->mTexturesOffset;
+		if (textures[header->mTexturesSize - 1] != '\0')
+		{
+			return nullptr;
+		}
+		return header;
+	}
+
+	std::string GetInputLayoutName(const VertexElement* elements, size_t numElements)
+	{
+		std::string name;
+		for (size_t i = 0; i < numElements; i++)
+		{
+			// Names aren't terminated if they fill the whole array
+			name.append(elements[i].mName, strnlen(elements[i].mName, MAX_ELEMENT_NAME));
+		}
+		return name;
+	}
+}
@@ -0,0 +1,96 @@
+// MeshFormat.h
+// Reads .itpmesh2 JSON meshes, and the cooked binary version of them
+// that the asset cooker writes out next to them (with ".cooked" on the
+// end of the name). A cooked mesh is laid out so it can be mapped into
+// memory and uploaded to the GPU as it is:
+//   Header
+//   VertexElement[mNumElements]
+//   texture paths, each null terminated, mTexturesSize bytes in all
+//   vertices, 16 byte aligned, mNumVerts * mVertSize bytes
+//   uint16_t indices[mNumIndices]
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ShaderTypes.h"
+#include "CollisionHelpers.h"
+
+namespace MeshFormat
+{
+	// "ITPM"
+	const uint32_t COOKED_MAGIC = 0x4D505449;
+	// Bump this whenever the layout changes, so old cooked files get ignored
+	const uint32_t COOKED_VERSION = 1;
+	const size_t MAX_ELEMENT_NAME = 24;
+
+	enum EElementType
+	{
+		EET_Float = 0,
+		EET_Byte
+	};
+
+	struct VertexElement
+	{
+		char mName[MAX_ELEMENT_NAME];
+		uint32_t mType;
+		uint32_t mCount;
+	};
+
+	struct Header
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		uint32_t mShaderType;
+		uint32_t mNumElements;
+		uint32_t mNumTextures;
+		uint32_t mNumVerts;
+		uint32_t mVertSize;
+		uint32_t mNumIndices;
+		float mBoxMin[3];
+		float mBoxMax[3];
+		float mSphereCenter[3];
+		float mSphereRadius;
+		// Offsets are in bytes from the start of the file
+		uint32_t mElementsOffset;
+		uint32_t mTexturesOffset;
+		uint32_t mTexturesSize;
+		uint32_t mVerticesOffset;
+		uint32_t mIndicesOffset;
+		uint32_t mFileSize;
+	};
+
+	// Each value in a vertex is either a float, or four bytes packed together
+	union VertPacked
+	{
+		float f;
+		uint8_t b[4];
+	};
+
+	// A whole mesh, as read from JSON
+	struct MeshData
+	{
+		EMeshShader mShaderType;
+		std::vector<VertexElement> mVertexFormat;
+		std::vector<std::string> mTextureNames;
+		std::vector<VertPacked> mVertices;
+		std::vector<uint16_t> mIndices;
+		Collision::AxisAlignedBox mBoundingBox;
+		Collision::Sphere mBoundingSphere;
+		size_t mNumVerts;
+		size_t mVertSize;
+	};
+
+	// Parses an .itpmesh2 file, logging why if it can't
+	bool ReadJson(const char* fileName, MeshData& outData);
+
+	// Writes data out as a cooked mesh
+	bool WriteCooked(const char* fileName, const MeshData& data);
+
+	// Returns the header of the cooked mesh in data, or null if it's not
+	// one, is from a different version, or is cut short
+	const Header* GetCookedHeader(const void* data, size_t size);
+
+	// The input layout name for a vertex format is all its element names in order
+	std::string GetInputLayoutName(const VertexElement* elements, size_t numElements);
+}
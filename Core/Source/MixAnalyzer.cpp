@@ -0,0 +1,182 @@
+#include "ITPEnginePCH.h"
+
+namespace
+{
+	// ITU BS.1770 K weighting, designed for any sample rate from the
+	// analog prototypes rather than the 48kHz coefficients in the standard
+	void ShelfCoefficients( float sampleRate, float* out )
+	{
+		const double gain = 3.999843853973347;
+		const double frequency = 1681.974450955533;
+		const double q = 0.7071752369554196;
+
+		double k = tan( Math::Pi * frequency / sampleRate );
+		double vh = pow( 10.0, gain / 20.0 );
+		double vb = pow( vh, 0.4996667741545416 );
+		double a0 = 1.0 + k / q + k * k;
+		out[0] = ( float ) ( ( vh + vb * k / q + k * k ) / a0 );
+		out[1] = ( float ) ( 2.0 * ( k * k - vh ) / a0 );
+		out[2] = ( float ) ( ( vh - vb * k / q + k * k ) / a0 );
+		out[3] = ( float ) ( 2.0 * ( k * k - 1.0 ) / a0 );
+		out[4] = ( float ) ( ( 1.0 - k / q + k * k ) / a0 );
+	}
+
+	void HighPassCoefficients( float sampleRate, float* out )
+	{
+		const double frequency = 38.13547087602444;
+		const double q = 0.5003270373238773;
+
+		double k = tan( Math::Pi * frequency / sampleRate );
+		double a0 = 1.0 + k / q + k * k;
+		out[0] = 1.0f;
+		out[1] = -2.0f;
+		out[2] = 1.0f;
+		out[3] = ( float ) ( 2.0 * ( k * k - 1.0 ) / a0 );
+		out[4] = ( float ) ( ( 1.0 - k / q + k * k ) / a0 );
+	}
+
+	// Transposed direct form II
+	inline float Biquad( float x, const float* c, float& z1, float& z2 )
+	{
+		float y = c[0] * x + z1;
+		z1 = c[1] * x - c[3] * y + z2;
+		z2 = c[2] * x - c[4] * y;
+		return y;
+	}
+
+	float ToLufs( double meanSquare )
+	{
+		return meanSquare > 0.0 ? Math::Max( ( float ) ( -0.691 + 10.0 * log10( meanSquare ) ), ANALYSIS_SILENCE_LUFS ) : ANALYSIS_SILENCE_LUFS;
+	}
+}
+
+MixAnalyzer::MixAnalyzer( float sampleRate )
+	: binFrames( ( int ) ( sampleRate / 10.0f ) ), binFilled( 0 ), binSum( 0.0 ), numBins( 0 ), nextBin( 0 )
+	, fft( ANALYSIS_FFT_SIZE ), historyPos( 0 )
+{
+	ShelfCoefficients( sampleRate, kCoefficients[0] );
+	HighPassCoefficients( sampleRate, kCoefficients[1] );
+	memset( kFilters, 0, sizeof( kFilters ) );
+	memset( binSums, 0, sizeof( binSums ) );
+
+	history = new float[ANALYSIS_FFT_SIZE]();
+	window = new float[ANALYSIS_FFT_SIZE];
+	windowed = new float[ANALYSIS_FFT_SIZE];
+	binRe = new float[ANALYSIS_SPECTRUM_BINS];
+	binIm = new float[ANALYSIS_SPECTRUM_BINS];
+
+	// Hann window. Its coherent gain is 1/2, which MeasureSpectrum undoes
+	for ( int i = 0; i < ANALYSIS_FFT_SIZE; i++ )
+	{
+		window[i] = 0.5f - 0.5f * Math::Cos( Math::TwoPi * i / ANALYSIS_FFT_SIZE );
+	}
+}
+
+MixAnalyzer::~MixAnalyzer()
+{
+	delete[] history;
+	delete[] window;
+	delete[] windowed;
+	delete[] binRe;
+	delete[] binIm;
+}
+
+void MixAnalyzer::Process( const float* mix, int frames, U64 clock )
+{
+	MixAnalysis& out = results.GetBack();
+	out.clock = clock;
+
+	float peak[2] = { 0.0f, 0.0f };
+	float sumSquares[2] = { 0.0f, 0.0f };
+	for ( int i = 0; i < frames; i++ )
+	{
+		for ( int c = 0; c < 2; c++ )
+		{
+			float sample = mix[i * 2 + c];
+			peak[c] = Math::Max( peak[c], Math::Abs( sample ) );
+			sumSquares[c] += sample * sample;
+		}
+	}
+	for ( int c = 0; c < 2; c++ )
+	{
+		out.peak[c] = peak[c];
+		out.rms[c] = frames > 0 ? Math::Sqrt( sumSquares[c] / frames ) : 0.0f;
+	}
+
+	MeasureLoudness( mix, frames, out );
+	MeasureSpectrum( mix, frames, out );
+	results.Publish();
+}
+
+void MixAnalyzer::MeasureLoudness( const float* mix, int frames, MixAnalysis& out )
+{
+	for ( int i = 0; i < frames; i++ )
+	{
+		// Channels are weighted equally for stereo, so their powers just add
+		float power = 0.0f;
+		for ( int c = 0; c < 2; c++ )
+		{
+			KFilter& filter = kFilters[c];
+			float y = Biquad( mix[i * 2 + c], kCoefficients[0], filter.z1[0], filter.z2[0] );
+			y = Biquad( y, kCoefficients[1], filter.z1[1], filter.z2[1] );
+			power += y * y;
+		}
+		binSum += power;
+
+		if ( ++binFilled == binFrames )
+		{
+			binSums[nextBin] = binSum;
+			nextBin = ( nextBin + 1 ) % LOUDNESS_BINS;
+			numBins = Math::Min( numBins + 1, ( int ) LOUDNESS_BINS );
+			binFilled = 0;
+			binSum = 0.0;
+		}
+	}
+
+	// Until a window has filled, measure over what there is
+	double shortTerm = 0.0;
+	double momentary = 0.0;
+	for ( int b = 0; b < numBins; b++ )
+	{
+		double sum = binSums[( nextBin + LOUDNESS_BINS - 1 - b ) % LOUDNESS_BINS];
+		shortTerm += sum;
+		if ( b < MOMENTARY_BINS )
+		{
+			momentary += sum;
+		}
+	}
+	out.shortTermLoudness = numBins > 0 ? ToLufs( shortTerm / ( ( double ) numBins * binFrames ) ) : ANALYSIS_SILENCE_LUFS;
+	out.momentaryLoudness = numBins > 0 ? ToLufs( momentary / ( ( double ) Math::Min( numBins, ( int ) MOMENTARY_BINS ) * binFrames ) ) : ANALYSIS_SILENCE_LUFS;
+}
+
+void MixAnalyzer::MeasureSpectrum( const float* mix, int frames, MixAnalysis& out )
+{
+	// Only the newest frames matter if the block is longer than the window
+	int skip = Math::Max( frames - ANALYSIS_FFT_SIZE, 0 );
+	for ( int i = skip; i < frames; i++ )
+	{
+		history[historyPos] = 0.5f * ( mix[i * 2] + mix[i * 2 + 1] );
+		historyPos = ( historyPos + 1 ) % ANALYSIS_FFT_SIZE;
+	}
+
+	// Unroll the ring, oldest frame first
+	int tail = ANALYSIS_FFT_SIZE - historyPos;
+	for ( int i = 0; i < tail; i++ )
+	{
+		windowed[i] = history[historyPos + i] * window[i];
+	}
+	for ( int i = tail; i < ANALYSIS_FFT_SIZE; i++ )
+	{
+		windowed[i] = history[i - tail] * window[i];
+	}
+
+	fft.Forward( windowed, binRe, binIm );
+
+	// A sine's energy is split between the positive and negative frequency,
+	// and the window halves its amplitude
+	const float scale = 4.0f / ANALYSIS_FFT_SIZE;
+	for ( int k = 0; k < ANALYSIS_SPECTRUM_BINS; k++ )
+	{
+		out.spectrum[k] = scale * Math::Sqrt( binRe[k] * binRe[k] + binIm[k] * binIm[k] );
+	}
+}
@@ -0,0 +1,80 @@
+// MixAnalyzer.h
+// Analysis tap on the final mix, for music reactive visuals and loudness
+// metering. It runs on the mixer thread on each block just before output,
+// so nothing needs a second pass over the audio, and publishes its results
+// through a triple buffer that the game thread reads without locking
+
+#pragma once
+#include "AudioTripleBuffer.h"
+#include "RealFft.h"
+
+#define ANALYSIS_FFT_SIZE 1024
+#define ANALYSIS_SPECTRUM_BINS ( ANALYSIS_FFT_SIZE / 2 + 1 )
+// Reported loudness when there's nothing to measure
+#define ANALYSIS_SILENCE_LUFS -100.0f
+
+struct MixAnalysis
+{
+	// Mixer clock at the end of the block these results are for
+	U64 clock;
+	// Left and right, linear, over the latest block
+	float peak[2];
+	float rms[2];
+	// ITU BS.1770 loudness over the last 400ms and the last 3s, in LUFS
+	float momentaryLoudness;
+	float shortTermLoudness;
+	// Magnitude of the last ANALYSIS_FFT_SIZE frames of the mix (left and
+	// right averaged) through a Hann window, scaled so a full scale sine
+	// reads 1. Bin n is centred on n * sampleRate / ANALYSIS_FFT_SIZE Hz
+	float spectrum[ANALYSIS_SPECTRUM_BINS];
+};
+
+class MixAnalyzer
+{
+public:
+	explicit MixAnalyzer( float sampleRate );
+	~MixAnalyzer();
+
+	// Mixer thread. Analyses frames interleaved stereo frames and publishes
+	// the results. clock is the mixer clock at the end of the block
+	void Process( const float* mix, int frames, U64 clock );
+
+	// Game thread. The latest results, which are all zero until the mixer
+	// has run
+	const MixAnalysis& GetLatest() { return results.Update(); }
+
+private:
+	// Loudness is measured in 100ms bins, and the short term window is 30 of them
+	enum { LOUDNESS_BINS = 30, MOMENTARY_BINS = 4 };
+
+	// K weighting, a high shelf then a high pass, for one channel
+	struct KFilter
+	{
+		float z1[2];
+		float z2[2];
+	};
+
+	void MeasureLoudness( const float* mix, int frames, MixAnalysis& out );
+	void MeasureSpectrum( const float* mix, int frames, MixAnalysis& out );
+
+	AudioTripleBuffer<MixAnalysis> results;
+
+	// [stage][b0, b1, b2, a1, a2]
+	float kCoefficients[2][5];
+	KFilter kFilters[2];
+	int binFrames;
+	int binFilled;
+	double binSum;
+	double binSums[LOUDNESS_BINS];
+	int numBins;
+	int nextBin;
+
+	RealFft fft;
+	// The last ANALYSIS_FFT_SIZE mono frames, as a ring starting at historyPos
+	float* history;
+	int historyPos;
+	float* window;
+	float* windowed;
+	float* binRe;
+	float* binIm;
+};
@@ -0,0 +1,293 @@
+#include "ITPEnginePCH.h"
+
+MusicSystem::MusicSystem( AudioSystem& audio )
+	: audio( audio ), playing( false ), hasPending( false ), volume( 1.0f )
+	, prefetchFrames( AudioSystem::SecondsToSamples( MUSIC_PREFETCH_SECONDS ) )
+{
+}
+
+MusicSegmentPtr MusicSystem::LoadSegment( const std::vector<std::string>& stemPaths, const TempoMap& tempo,
+	int lengthBars, bool loop )
+{
+	MusicSegmentPtr segment = std::make_shared<MusicSegment>();
+	for ( const std::string& path : stemPaths )
+	{
+		segment->stems.push_back( audio.LoadSoundAsync( path.c_str(), STORAGE_STREAMED ) );
+	}
+	segment->tempo = tempo;
+	segment->lengthBars = lengthBars;
+	segment->loop = loop;
+	return segment;
+}
+
+void MusicSystem::Play( MusicSegmentPtr segment, MusicQuantize quantize, MusicTransition transition, float fadeSeconds )
+{
+	pending.segment = segment;
+	pending.quantize = quantize;
+	pending.transition = transition;
+	pending.fadeSeconds = fadeSeconds;
+	pending.boundary = GetBoundary( quantize, audio.GetDspClock() + prefetchFrames );
+	hasPending = true;
+}
+
+void MusicSystem::Stop( MusicQuantize quantize, float fadeSeconds )
+{
+	Play( nullptr, quantize, fadeSeconds > 0.0f ? MUSIC_CROSSFADE : MUSIC_CUT, fadeSeconds );
+}
+
+void MusicSystem::PlayStinger( SoundPtr sound, MusicQuantize quantize, float volume )
+{
+	if ( sound )
+	{
+		U64 boundary = GetBoundary( quantize, audio.GetDspClock() + prefetchFrames );
+		VoiceHandle voice = audio.PlayAt( sound, boundary, volume * this->volume );
+		audio.SetReverbBypass( voice, true );
+	}
+}
+
+void MusicSystem::SetStemVolume( int stem, float volume )
+{
+	if ( stem >= ( int ) stemVolumes.size() )
+	{
+		stemVolumes.resize( stem + 1, 1.0f );
+	}
+	stemVolumes[stem] = volume;
+}
+
+bool MusicSystem::GetPosition( int& bar, float& beat ) const
+{
+	if ( !playing )
+	{
+		return false;
+	}
+
+	const Playback& current = playbacks.back();
+	U64 now = audio.GetDspClock();
+	if ( now < current.startClock )
+	{
+		return false;
+	}
+	U64 elapsed = now - current.startClock;
+	if ( current.segment->loop )
+	{
+		elapsed %= current.passFrames;
+	}
+	current.segment->tempo.GetPosition( elapsed, bar, beat );
+	return true;
+}
+
+void MusicSystem::Update()
+{
+	U64 now = audio.GetDspClock();
+	U64 earliest = now + prefetchFrames;
+
+	// Changes are scheduled as late as possible, so a newer one can still
+	// replace them. If the stems haven't loaded by then, try the next boundary
+	if ( hasPending && earliest >= pending.boundary )
+	{
+		if ( !pending.segment || IsReady( *pending.segment ) )
+		{
+			ApplyChange( pending );
+			hasPending = false;
+			pending.segment.reset();
+		}
+		else
+		{
+			pending.boundary = GetBoundary( pending.quantize, earliest + 1 );
+		}
+	}
+
+	// Looping segments start over at their exit cue, while the last pass rings
+	// out. Other segments are over once they reach it
+	if ( playing )
+	{
+		Playback& current = playbacks.back();
+		U64 passEnd = current.passClock + current.passFrames;
+		if ( current.segment->loop && earliest >= passEnd )
+		{
+			StartPass( current, passEnd );
+		}
+		else if ( !current.segment->loop && now >= passEnd )
+		{
+			playing = false;
+		}
+	}
+
+	// Fades and stem volumes, and forget voices that have finished
+	for ( size_t p = 0; p < playbacks.size(); )
+	{
+		Playback& playback = playbacks[p];
+		for ( size_t v = 0; v < playback.voices.size(); )
+		{
+			if ( audio.IsPlaying( playback.voices[v] ) )
+			{
+				audio.SetVolume( playback.voices[v], GetGain( playback, playback.voiceStems[v], now ) );
+				v++;
+			}
+			else
+			{
+				playback.voices.erase( playback.voices.begin() + v );
+				playback.voiceStems.erase( playback.voiceStems.begin() + v );
+			}
+		}
+
+		bool isCurrent = playing && p + 1 == playbacks.size();
+		if ( !isCurrent && playback.voices.empty() )
+		{
+			playbacks.erase( playbacks.begin() + p );
+		}
+		else
+		{
+			p++;
+		}
+	}
+}
+
+bool MusicSystem::IsReady( const MusicSegment& segment ) const
+{
+	// A stem that failed to load is just left out
+	for ( const SoundPtr& stem : segment.stems )
+	{
+		SoundState state = stem->GetState();
+		if ( state != SOUND_READY && state != SOUND_FAILED )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+U64 MusicSystem::GetPassFrames( const MusicSegment& segment ) const
+{
+	if ( segment.lengthBars > 0 )
+	{
+		return segment.tempo.GetBarFrame( segment.lengthBars );
+	}
+
+	U64 frames = 0;
+	for ( const SoundPtr& stem : segment.stems )
+	{
+		if ( stem->GetState() == SOUND_READY )
+		{
+			frames = Math::Max( frames, ( U64 ) stem->GetAuthoredFrames() );
+		}
+	}
+	// Never repeat faster than once a bar, even if every stem failed
+	return Math::Max( frames, segment.tempo.GetBarFrame( 1 ) );
+}
+
+U64 MusicSystem::GetBoundary( MusicQuantize quantize, U64 earliest ) const
+{
+	if ( !playing || quantize == MUSIC_IMMEDIATE )
+	{
+		return earliest;
+	}
+
+	const Playback& current = playbacks.back();
+	if ( earliest <= current.startClock )
+	{
+		// Bar 0 is on every grid
+		return current.startClock;
+	}
+
+	// Every pass of a looping segment has the same bars
+	U64 elapsed = earliest - current.startClock;
+	U64 passStart = current.startClock;
+	if ( current.segment->loop )
+	{
+		passStart += elapsed / current.passFrames * current.passFrames;
+	}
+	else if ( elapsed >= current.passFrames )
+	{
+		// Finished, and just ringing out
+		return earliest;
+	}
+
+	U64 offset = earliest - passStart;
+	U64 next = current.passFrames;
+	if ( quantize == MUSIC_NEXT_BEAT )
+	{
+		next = current.segment->tempo.GetNextBeat( offset );
+	}
+	else if ( quantize == MUSIC_NEXT_BAR )
+	{
+		next = current.segment->tempo.GetNextBar( offset );
+	}
+	return passStart + Math::Min( next, current.passFrames );
+}
+
+void MusicSystem::StartPass( Playback& playback, U64 clock )
+{
+	// The mixer plays back the silence trimmed from each stem, so every
+	// stem's first authored frame lands on bar 0
+	const MusicSegment& segment = *playback.segment;
+	for ( size_t s = 0; s < segment.stems.size(); s++ )
+	{
+		const SoundPtr& stem = segment.stems[s];
+		VoiceHandle voice = audio.PlayAt( stem, clock, GetGain( playback, ( int ) s, clock ) );
+		if ( voice != 0 )
+		{
+			// Music isn't in the room with the listener
+			audio.SetReverbBypass( voice, true );
+			playback.voices.push_back( voice );
+			playback.voiceStems.push_back( ( int ) s );
+		}
+	}
+	playback.passClock = clock;
+}
+
+void MusicSystem::ApplyChange( const PendingChange& change )
+{
+	U64 boundary = change.boundary;
+	U64 fadeFrames = change.transition == MUSIC_CROSSFADE ? AudioSystem::SecondsToSamples( change.fadeSeconds ) : 0;
+
+	// Everything playing now, including tails, fades out from the boundary
+	// and stops when the fade is done
+	for ( Playback& playback : playbacks )
+	{
+		playback.fadeFrom = GetFade( playback, boundary );
+		playback.fadeTo = 0.0f;
+		playback.fadeStart = boundary;
+		playback.fadeEnd = boundary + fadeFrames;
+		for ( VoiceHandle voice : playback.voices )
+		{
+			audio.StopAt( voice, playback.fadeEnd );
+		}
+	}
+
+	playing = change.segment != nullptr;
+	if ( playing )
+	{
+		Playback playback;
+		playback.segment = change.segment;
+		playback.startClock = boundary;
+		playback.passClock = boundary;
+		playback.passFrames = GetPassFrames( *change.segment );
+		playback.fadeFrom = fadeFrames > 0 ? 0.0f : 1.0f;
+		playback.fadeTo = 1.0f;
+		playback.fadeStart = boundary;
+		playback.fadeEnd = boundary + fadeFrames;
+		playbacks.push_back( playback );
+		StartPass( playbacks.back(), boundary );
+	}
+}
+
+float MusicSystem::GetFade( const Playback& playback, U64 clock ) const
+{
+	if ( clock <= playback.fadeStart )
+	{
+		return playback.fadeFrom;
+	}
+	if ( clock >= playback.fadeEnd )
+	{
+		return playback.fadeTo;
+	}
+	float t = ( float ) ( clock - playback.fadeStart ) / ( float ) ( playback.fadeEnd - playback.fadeStart );
+	return Math::Lerp( playback.fadeFrom, playback.fadeTo, t );
+}
+
+float MusicSystem::GetGain( const Playback& playback, int stem, U64 clock ) const
+{
+	float stemVolume = stem < ( int ) stemVolumes.size() ? stemVolumes[stem] : 1.0f;
+	return GetFade( playback, clock ) * stemVolume * volume;
+}
@@ -0,0 +1,125 @@
+// MusicSystem.h
+// Plays music made of segments: a few streamed stems that play in sync, with
+// a tempo map. Changes to the music (switching segments, crossfades, stingers)
+// wait for the next beat, bar or end of segment, worked out on the mixer
+// clock, so they land exactly on the beat. Everything is scheduled with
+// PlayAt well before it's due, which gives each stem's stream time to fill
+// and keeps transitions gapless without holding whole tracks in memory
+
+#pragma once
+#include "AudioSystem.h"
+#include "TempoMap.h"
+#include <string>
+#include <vector>
+
+// How far ahead of a boundary its voices are scheduled
+#define MUSIC_PREFETCH_SECONDS 0.25f
+
+enum MusicQuantize
+{
+	MUSIC_IMMEDIATE,
+	MUSIC_NEXT_BEAT,
+	MUSIC_NEXT_BAR,
+	// When the current segment reaches its end (its exit cue)
+	MUSIC_SEGMENT_END
+};
+
+enum MusicTransition
+{
+	// The old segment stops dead where the new one starts
+	MUSIC_CUT,
+	// The old segment fades out while the new one fades in
+	MUSIC_CROSSFADE
+};
+
+struct MusicSegment
+{
+	std::vector<SoundPtr> stems;
+	TempoMap tempo;
+	// Bars until the segment repeats or hands over to the next. Whatever plays
+	// past that point rings out under the next pass. 0 is the whole length of
+	// the longest stem
+	int lengthBars;
+	bool loop;
+};
+
+DECL_PTR( MusicSegment );
+
+class MusicSystem
+{
+public:
+	MusicSystem( AudioSystem& audio );
+
+	// Starts streaming in the stems. Each stem's frame 0 is the start of bar 0,
+	// including any silence the loader trimmed from it
+	MusicSegmentPtr LoadSegment( const std::vector<std::string>& stemPaths, const TempoMap& tempo,
+		int lengthBars = 0, bool loop = true );
+
+	// Switches to segment at the next boundary of the one that's playing. With
+	// nothing playing it starts as soon as it can. A second call before the
+	// first has happened replaces it
+	void Play( MusicSegmentPtr segment, MusicQuantize quantize = MUSIC_NEXT_BAR,
+		MusicTransition transition = MUSIC_CUT, float fadeSeconds = 0.0f );
+	// Stops the music at the next boundary, fading out over fadeSeconds
+	void Stop( MusicQuantize quantize = MUSIC_NEXT_BAR, float fadeSeconds = 0.0f );
+	// Plays sound once, over the music, on the next boundary
+	void PlayStinger( SoundPtr sound, MusicQuantize quantize = MUSIC_NEXT_BEAT, float volume = 1.0f );
+
+	// Layers stems of the current and later segments in and out
+	void SetStemVolume( int stem, float volume );
+	void SetVolume( float newVolume ) { volume = newVolume; }
+
+	// Where the current segment is, for gameplay that follows the music.
+	// Returns false if nothing is playing
+	bool GetPosition( int& bar, float& beat ) const;
+
+	// Call once per frame, after AudioSystem::Update
+	void Update();
+
+private:
+	// One segment, from when it was started until its last voice finishes
+	struct Playback
+	{
+		MusicSegmentPtr segment;
+		// Mixer clock of bar 0 of the first pass, and of the latest one
+		U64 startClock;
+		U64 passClock;
+		U64 passFrames;
+		// Gain goes from fadeFrom to fadeTo between these clocks
+		U64 fadeStart;
+		U64 fadeEnd;
+		float fadeFrom;
+		float fadeTo;
+		std::vector<VoiceHandle> voices;
+		std::vector<int> voiceStems;
+	};
+
+	// segment is null for a stop
+	struct PendingChange
+	{
+		MusicSegmentPtr segment;
+		MusicQuantize quantize;
+		MusicTransition transition;
+		float fadeSeconds;
+		U64 boundary;
+	};
+
+	bool IsReady( const MusicSegment& segment ) const;
+	U64 GetPassFrames( const MusicSegment& segment ) const;
+	// First clock at or after earliest that lands on quantize in the current segment
+	U64 GetBoundary( MusicQuantize quantize, U64 earliest ) const;
+	void StartPass( Playback& playback, U64 clock );
+	void ApplyChange( const PendingChange& change );
+	float GetFade( const Playback& playback, U64 clock ) const;
+	float GetGain( const Playback& playback, int stem, U64 clock ) const;
+
+	AudioSystem& audio;
+	// The last playback is the current one, the rest are ringing out
+	std::vector<Playback> playbacks;
+	bool playing;
+	PendingChange pending;
+	bool hasPending;
+	std::vector<float> stemVolumes;
+	float volume;
+	U64 prefetchFrames;
+};
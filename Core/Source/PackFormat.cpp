@@ -0,0 +1,191 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+
+namespace
+{
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + PackFormat::ENTRY_ALIGNMENT - 1) & ~static_cast<uint64_t>(PackFormat::ENTRY_ALIGNMENT - 1);
+	}
+
+	// Compressing a file has to save at least an eighth of it, or it's
+	// quicker to read it as it is
+	bool IsWorthCompressing(size_t size, size_t compressedSize)
+	{
+		return compressedSize > 0 && compressedSize <= size - size / 8;
+	}
+}
+
+namespace PackFormat
+{
+	bool Write(const char* fileName, const std::vector<SourceFile>& files)
+	{
+		std::vector<Entry> entries(files.size());
+		std::vector<std::vector<char>> contents(files.size());
+		std::string names;
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			const SourceFile& source = files[i];
+			std::ifstream file(source.mFileName, std::ios::in | std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+			{
+				SDL_Log("Couldn't read %s to pack it", source.mFileName.c_str());
+				return false;
+			}
+
+			std::vector<char>& data = contents[i];
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			file.read(data.data(), data.size());
+			if (file.fail())
+			{
+				SDL_Log("Couldn't read %s to pack it", source.mFileName.c_str());
+				return false;
+			}
+
+			Entry& entry = entries[i];
+			entry.mId = AssetId(source.mName.c_str()).GetHash();
+			entry.mOffset = 0;
+			entry.mSize = static_cast<uint32_t>(data.size());
+			entry.mStoredSize = entry.mSize;
+			entry.mNameOffset = static_cast<uint32_t>(names.size());
+			entry.mFlags = 0;
+			names.append(source.mName.c_str(), source.mName.size() + 1);
+
+			if (source.mCompress)
+			{
+				std::vector<char> compressed(Lz4::GetMaxCompressedSize(data.size()));
+				size_t compressedSize = Lz4::Compress(data.data(), data.size(), compressed.data(), compressed.size());
+				if (IsWorthCompressing(data.size(), compressedSize))
+				{
+					compressed.resize(compressedSize);
+					data.swap(compressed);
+					entry.mStoredSize = static_cast<uint32_t>(compressedSize);
+					entry.mFlags |= FLAG_LZ4;
+				}
+			}
+		}
+
+		// Sorted by ID, so a file can be found with a binary search. The
+		// data stays in the order it was given in, so files that are loaded
+		// together can be kept together
+		std::vector<size_t> order(entries.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&entries](size_t a, size_t b)
+		{
+			return entries[a].mId < entries[b].mId;
+		});
+		for (size_t i = 1; i < order.size(); i++)
+		{
+			if (entries[order[i]].mId == entries[order[i - 1]].mId)
+			{
+				SDL_Log("Couldn't pack %s: %s and %s have the same ID. Rename one of them.", fileName,
+					files[order[i - 1]].mName.c_str(), files[order[i]].mName.c_str());
+				return false;
+			}
+		}
+
+		Header header;
+		memset(&header, 0, sizeof(header));
+		header.mMagic = MAGIC;
+		header.mVersion = VERSION;
+		header.mNumEntries = static_cast<uint32_t>(entries.size());
+		header.mEntriesOffset = static_cast<uint32_t>(Align(sizeof(Header)));
+		header.mNamesOffset = static_cast<uint32_t>(header.mEntriesOffset + entries.size() * sizeof(Entry));
+		header.mNamesSize = static_cast<uint32_t>(names.size());
+		uint64_t offset = header.mNamesOffset + names.size();
+		for (auto& entry : entries)
+		{
+			entry.mOffset = Align(offset);
+			offset = entry.mOffset + entry.mStoredSize;
+		}
+		header.mFileSize = offset;
+
+		std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SDL_Log("Couldn't write archive %s", fileName);
+			return false;
+		}
+
+		std::vector<char> padding(ENTRY_ALIGNMENT, 0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(padding.data(), header.mEntriesOffset - sizeof(header));
+		for (size_t i : order)
+		{
+			file.write(reinterpret_cast<const char*>(&entries[i]), sizeof(Entry));
+		}
+		file.write(names.data(), names.size());
+
+		uint64_t written = header.mNamesOffset + names.size();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			file.write(padding.data(), entries[i].mOffset - written);
+			file.write(contents[i].data(), contents[i].size());
+			written = entries[i].mOffset + entries[i].mStoredSize;
+		}
+
+		if (file.fail())
+		{
+			SDL_Log("Couldn't write archive %s", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	const Header* GetHeader(const void* data, size_t size)
+	{
+		if (size < sizeof(Header))
+		{
+			return nullptr;
+		}
+
+		const Header* header = static_cast<const Header*>(data);
+		if (header->mMagic != MAGIC || header->mVersion != VERSION || header->mFileSize != size)
+		{
+			return nullptr;
+		}
+
+		uint64_t entriesEnd = header->mEntriesOffset + static_cast<uint64_t>(header->mNumEntries) * sizeof(Entry);
+		uint64_t namesEnd = header->mNamesOffset + static_cast<uint64_t>(header->mNamesSize);
+		if (header->mEntriesOffset < sizeof(Header) || header->mEntriesOffset % ENTRY_ALIGNMENT != 0 ||
+			entriesEnd > header->mNamesOffset || namesEnd > size)
+		{
+			return nullptr;
+		}
+
+		// Every entry has to be in the file, with its name terminated, and
+		// in order, or the binary search could miss it
+		const Entry* entries = reinterpret_cast<const Entry*>(static_cast<const char*>(data) + header->mEntriesOffset);
+		const char* names = static_cast<const char*>(data) + header->mNamesOffset;
+		if (header->mNumEntries > 0 && (header->mNamesSize == 0 || names[header->mNamesSize - 1] != '\0'))
+		{
+			return nullptr;
+		}
+		for (uint32_t i = 0; i < header->mNumEntries; i++)
+		{
+			const Entry& entry = entries[i];
+			if (entry.mOffset < namesEnd || entry.mOffset > size || entry.mStoredSize > size - entry.mOffset ||
+				entry.mNameOffset >= header->mNamesSize || (i > 0 && entry.mId <= entries[i - 1].mId) ||
+				((entry.mFlags & FLAG_LZ4) == 0 && entry.mStoredSize != entry.mSize))
+			{
+				return nullptr;
+			}
+		}
+		return header;
+	}
+
+	const Entry* FindEntry(const Header& header, AssetId id)
+	{
+		const Entry* begin = reinterpret_cast<const Entry*>(reinterpret_cast<const char*>(&header) + header.mEntriesOffset);
+		const Entry* end = begin + header.mNumEntries;
+		const Entry* entry = std::lower_bound(begin, end, id.GetHash(), [](const Entry& e, uint64_t hash)
+		{
+			return e.mId < hash;
+		});
+		return entry != end && entry->mId == id.GetHash() ? entry : nullptr;
+	}
+}
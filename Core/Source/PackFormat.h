@@ -0,0 +1,74 @@
+// PackFormat.h
+// The archive the asset cooker packs the assets into, so the game opens
+// and maps one file rather than one for every asset (see FileSystem).
+// Entries are keyed by the AssetId of their path relative to the asset
+// root, and laid out as:
+//   Header
+//   Entry[mNumEntries], sorted by ID, starting on an ENTRY_ALIGNMENT boundary
+//   entry paths, each null terminated, mNamesSize bytes in all
+//   each entry's data, starting on an ENTRY_ALIGNMENT boundary
+// so an uncompressed entry is as aligned in the mapping as a file of its
+// own would be, and cooked formats can be used where they are.
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AssetId.h"
+
+namespace PackFormat
+{
+	// "ITPK"
+	const uint32_t MAGIC = 0x4B505449;
+	// Bump this whenever the layout changes, so old archives get ignored
+	const uint32_t VERSION = 1;
+	const uint32_t ENTRY_ALIGNMENT = 64;
+
+	// The entry's data is an LZ4 block that decompresses to mSize bytes
+	const uint32_t FLAG_LZ4 = 1;
+
+	struct Header
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		uint32_t mNumEntries;
+		// Offsets are in bytes from the start of the file
+		uint32_t mEntriesOffset;
+		uint32_t mNamesOffset;
+		uint32_t mNamesSize;
+		uint64_t mFileSize;
+	};
+
+	struct Entry
+	{
+		uint64_t mId;
+		uint64_t mOffset;
+		// Size of the file, and of what's stored for it, which are the
+		// same unless it's compressed
+		uint32_t mSize;
+		uint32_t mStoredSize;
+		// From the start of the names
+		uint32_t mNameOffset;
+		uint32_t mFlags;
+	};
+
+	// A file to pack, and the path it's packed as
+	struct SourceFile
+	{
+		std::string mName;
+		std::string mFileName;
+		// Compressed if that makes it enough smaller to be worth it
+		bool mCompress;
+	};
+
+	// Packs files into an archive, logging why if it can't. Fails if two
+	// of the names have the same ID
+	bool Write(const char* fileName, const std::vector<SourceFile>& files);
+
+	// Returns the header of the archive in data, or null if it's not one,
+	// is from a different version, or any of its entries are out of bounds
+	const Header* GetHeader(const void* data, size_t size);
+
+	// The entry for id, or null if it's not in the archive
+	const Entry* FindEntry(const Header& header, AssetId id);
+}
@@ -0,0 +1,96 @@
+#include "ITPEnginePCH.h"
+#include <emmintrin.h>
+
+RampShape ParamRamp::BeginBlock( int frames, float& start, float& step )
+{
+	RampShape blockShape = shape;
+	if ( current == target || frames <= 0 )
+	{
+		start = target;
+		step = 0.0f;
+		blockShape = RAMP_LINEAR;
+	}
+	else if ( shape == RAMP_EXPONENTIAL )
+	{
+		start = Math::Max( current, RAMP_EXPONENTIAL_FLOOR );
+		step = powf( Math::Max( target, RAMP_EXPONENTIAL_FLOOR ) / start, 1.0f / frames );
+	}
+	else
+	{
+		start = current;
+		step = ( target - current ) / frames;
+	}
+
+	current = target;
+	return blockShape;
+}
+
+void ParamRamp::Apply( float* data, int numChannels, int frames )
+{
+	float start, step;
+	RampShape blockShape = BeginBlock( frames, start, step );
+	bool exponential = blockShape == RAMP_EXPONENTIAL;
+	if ( !exponential && step == 0.0f && start == 1.0f )
+	{
+		return;
+	}
+
+	int count = frames * numChannels;
+	int i = 0;
+	if ( numChannels == 1 || numChannels == 2 || numChannels == 4 )
+	{
+		// Gains for the first four samples, and how to move all four lanes on
+		// to the next four. Each lane holds a frame's gain for each of its channels
+		int framesPerVector = 4 / numChannels;
+		float lanes[4];
+		float gain = start;
+		for ( int n = 0; n < 4; n++ )
+		{
+			if ( n > 0 && n % numChannels == 0 )
+			{
+				gain = exponential ? gain * step : gain + step;
+			}
+			lanes[n] = gain;
+		}
+		__m128 gains = _mm_loadu_ps( lanes );
+
+		if ( exponential )
+		{
+			__m128 ratio = _mm_set1_ps( powf( step, ( float ) framesPerVector ) );
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				_mm_storeu_ps( data + i, _mm_mul_ps( _mm_loadu_ps( data + i ), gains ) );
+				gains = _mm_mul_ps( gains, ratio );
+			}
+		}
+		else
+		{
+			__m128 increment = _mm_set1_ps( step * framesPerVector );
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				_mm_storeu_ps( data + i, _mm_mul_ps( _mm_loadu_ps( data + i ), gains ) );
+				gains = _mm_add_ps( gains, increment );
+			}
+		}
+	}
+	else if ( numChannels == 8 )
+	{
+		// Surround buses: a frame is two registers with the same gain
+		float gain = start;
+		for ( ; i < count; i += 8 )
+		{
+			__m128 gains = _mm_set1_ps( gain );
+			_mm_storeu_ps( data + i, _mm_mul_ps( _mm_loadu_ps( data + i ), gains ) );
+			_mm_storeu_ps( data + i + 4, _mm_mul_ps( _mm_loadu_ps( data + i + 4 ), gains ) );
+			gain = exponential ? gain * step : gain + step;
+		}
+	}
+
+	// Whatever's left, and layouts that don't fit a register evenly
+	for ( ; i < count; i++ )
+	{
+		int frame = i / numChannels;
+		float gain = exponential ? start * powf( step, ( float ) frame ) : start + step * frame;
+		data[i] *= gain;
+	}
+}
@@ -0,0 +1,49 @@
+// ParamRamp.h
+// Block rate smoothing for mixer parameters. A new value isn't applied
+// straight away, it glides there across the next block, so changes never
+// click. The ramp is worked out once per block as a start value and a per
+// frame step, and the mixing loops apply it without any per sample branches
+
+#pragma once
+
+enum RampShape
+{
+	// Equal steps, for pan and short gain changes
+	RAMP_LINEAR,
+	// Equal ratios, so fades sound even in dB
+	RAMP_EXPONENTIAL
+};
+
+// Exponential ramps can't reach zero, so they stop here (-80dB) and the
+// next block jumps the rest of the way
+#define RAMP_EXPONENTIAL_FLOOR 0.0001f
+
+class ParamRamp
+{
+public:
+	ParamRamp( float value = 0.0f ) : current( value ), target( value ), shape( RAMP_LINEAR ) {}
+
+	// Jumps straight to value, for a voice that hasn't started yet
+	void Reset( float value ) { current = target = value; }
+	// Glides to value over the next block
+	void SetTarget( float value, RampShape newShape = RAMP_LINEAR ) { target = value; shape = newShape; }
+
+	float GetValue() const { return current; }
+	float GetTarget() const { return target; }
+	RampShape GetShape() const { return shape; }
+	bool IsRamping() const { return current != target; }
+
+	// Starts a block of frames frames and moves on to the target. The value at
+	// frame n is start + n * step for a linear ramp and start * step^n for an
+	// exponential one. Returns the shape to apply it with
+	RampShape BeginBlock( int frames, float& start, float& step );
+
+	// Multiplies interleaved data by the ramp across one block, with SSE for
+	// 1, 2, 4 and 8 channels
+	void Apply( float* data, int numChannels, int frames );
+
+private:
+	float current;
+	float target;
+	RampShape shape;
+};
@@ -0,0 +1,152 @@
+#include "ITPEnginePCH.h"
+
+RealFft::RealFft( int size )
+	: size( size ), half( size / 2 )
+{
+	DbgAssert( size >= 16 && ( size & ( size - 1 ) ) == 0, "FFT size must be a power of two, at least 16" );
+
+	bitReverse = new int[half];
+	int bits = 0;
+	while ( ( 1 << bits ) < half )
+	{
+		bits++;
+	}
+	for ( int i = 0; i < half; i++ )
+	{
+		int reversed = 0;
+		for ( int b = 0; b < bits; b++ )
+		{
+			reversed |= ( ( i >> b ) & 1 ) << ( bits - 1 - b );
+		}
+		bitReverse[i] = reversed;
+	}
+
+	twiddleRe = ( float* ) _mm_malloc( half * sizeof( float ), 16 );
+	twiddleIm = ( float* ) _mm_malloc( half * sizeof( float ), 16 );
+	for ( int h = 1; h < half; h *= 2 )
+	{
+		for ( int k = 0; k < h; k++ )
+		{
+			double angle = -Math::Pi * k / h;
+			twiddleRe[h - 1 + k] = ( float ) cos( angle );
+			twiddleIm[h - 1 + k] = ( float ) sin( angle );
+		}
+	}
+
+	unpackRe = new float[half + 1];
+	unpackIm = new float[half + 1];
+	for ( int k = 0; k <= half; k++ )
+	{
+		double angle = -Math::TwoPi * k / size;
+		unpackRe[k] = ( float ) cos( angle );
+		unpackIm[k] = ( float ) sin( angle );
+	}
+
+	workRe = ( float* ) _mm_malloc( half * sizeof( float ), 16 );
+	workIm = ( float* ) _mm_malloc( half * sizeof( float ), 16 );
+}
+
+RealFft::~RealFft()
+{
+	delete[] bitReverse;
+	_mm_free( twiddleRe );
+	_mm_free( twiddleIm );
+	delete[] unpackRe;
+	delete[] unpackIm;
+	_mm_free( workRe );
+	_mm_free( workIm );
+}
+
+void RealFft::Forward( const float* in, float* outRe, float* outIm )
+{
+	// Even samples are the real part and odd samples the imaginary part
+	for ( int i = 0; i < half; i++ )
+	{
+		int j = bitReverse[i];
+		workRe[j] = in[2 * i];
+		workIm[j] = in[2 * i + 1];
+	}
+
+	Transform();
+
+	// Split the packed transform back into the even and odd transforms, and
+	// combine them into the transform of the real signal
+	for ( int k = 0; k <= half; k++ )
+	{
+		int a = k < half ? k : 0;
+		int b = k > 0 ? half - k : 0;
+
+		// Even part ( Z[k] + conj( Z[half - k] ) ) / 2 and odd part
+		// ( Z[k] - conj( Z[half - k] ) ) / 2i
+		float evenRe = 0.5f * ( workRe[a] + workRe[b] );
+		float evenIm = 0.5f * ( workIm[a] - workIm[b] );
+		float oddRe = 0.5f * ( workIm[a] + workIm[b] );
+		float oddIm = -0.5f * ( workRe[a] - workRe[b] );
+
+		outRe[k] = evenRe + unpackRe[k] * oddRe - unpackIm[k] * oddIm;
+		outIm[k] = evenIm + unpackRe[k] * oddIm + unpackIm[k] * oddRe;
+	}
+}
+
+void RealFft::Transform()
+{
+	// The first two stages have fewer butterflies per group than a register
+	// holds. Stage 1 needs no twiddles at all
+	for ( int j = 0; j < half; j += 2 )
+	{
+		float re = workRe[j + 1];
+		float im = workIm[j + 1];
+		workRe[j + 1] = workRe[j] - re;
+		workIm[j + 1] = workIm[j] - im;
+		workRe[j] += re;
+		workIm[j] += im;
+	}
+
+	// Stage 2 only multiplies by 1 and -i
+	for ( int j = 0; j < half; j += 4 )
+	{
+		float re = workRe[j + 2];
+		float im = workIm[j + 2];
+		workRe[j + 2] = workRe[j] - re;
+		workIm[j + 2] = workIm[j] - im;
+		workRe[j] += re;
+		workIm[j] += im;
+
+		re = workIm[j + 3];
+		im = -workRe[j + 3];
+		workRe[j + 3] = workRe[j + 1] - re;
+		workIm[j + 3] = workIm[j + 1] - im;
+		workRe[j + 1] += re;
+		workIm[j + 1] += im;
+	}
+
+	// Every other stage, four butterflies at a time
+	for ( int h = 4; h < half; h *= 2 )
+	{
+		const float* stageRe = twiddleRe + h - 1;
+		const float* stageIm = twiddleIm + h - 1;
+		for ( int j = 0; j < half; j += 2 * h )
+		{
+			float* re0 = workRe + j;
+			float* im0 = workIm + j;
+			float* re1 = re0 + h;
+			float* im1 = im0 + h;
+			for ( int k = 0; k < h; k += 4 )
+			{
+				__m128 wr = _mm_loadu_ps( stageRe + k );
+				__m128 wi = _mm_loadu_ps( stageIm + k );
+				__m128 br = _mm_load_ps( re1 + k );
+				__m128 bi = _mm_load_ps( im1 + k );
+				__m128 tr = _mm_sub_ps( _mm_mul_ps( br, wr ), _mm_mul_ps( bi, wi ) );
+				__m128 ti = _mm_add_ps( _mm_mul_ps( br, wi ), _mm_mul_ps( bi, wr ) );
+
+				__m128 ar = _mm_load_ps( re0 + k );
+				__m128 ai = _mm_load_ps( im0 + k );
+				_mm_store_ps( re0 + k, _mm_add_ps( ar, tr ) );
+				_mm_store_ps( im0 + k, _mm_add_ps( ai, ti ) );
+				_mm_store_ps( re1 + k, _mm_sub_ps( ar, tr ) );
+				_mm_store_ps( im1 + k, _mm_sub_ps( ai, ti ) );
+			}
+		}
+	}
+}
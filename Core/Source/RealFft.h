@@ -0,0 +1,38 @@
+// RealFft.h
+// Forward FFT of real signals for the mix analysis. A real signal of size
+// samples is packed into a complex one of half the size, transformed with an
+// iterative radix 2 FFT, then unpacked. The data is kept as separate real
+// and imaginary arrays so the butterflies run four at a time with SSE
+
+#pragma once
+
+class RealFft
+{
+public:
+	// size must be a power of two, 16 or more
+	explicit RealFft( int size );
+	~RealFft();
+
+	int GetSize() const { return size; }
+
+	// Transforms size samples from in into the size / 2 + 1 bins from DC up
+	// to Nyquist. outRe and outIm must each hold that many. Not normalized
+	void Forward( const float* in, float* outRe, float* outIm );
+
+private:
+	// In place complex FFT of half samples, on data that's already in
+	// bit reversed order
+	void Transform();
+
+	int size;
+	int half;
+	int* bitReverse;
+	// exp( -i pi k / h ) for every stage of h butterflies, stage h starting at h - 1
+	float* twiddleRe;
+	float* twiddleIm;
+	// exp( -2 i pi k / size ), to unpack the half size transform
+	float* unpackRe;
+	float* unpackIm;
+	float* workRe;
+	float* workIm;
+};
@@ -0,0 +1,237 @@
+#include "ITPEnginePCH.h"
+
+namespace
+{
+	// Delay lengths in frames at 44.1kHz, from Freeverb. They're mutually
+	// prime enough that the combs' echoes don't line up into a buzz
+	const int COMB_TUNING[REVERB_NUM_COMBS] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+	const int ALLPASS_TUNING[REVERB_NUM_ALLPASSES] = { 556, 441, 341, 225 };
+	// Extra delay on the right side
+	const int STEREO_SPREAD = 23;
+
+	// The combs add up to a lot, so the input is turned down going in
+	const float INPUT_GAIN = 0.015f;
+	// So a wet level of 1 comes out about as loud as the dry signal
+	const float WET_SCALE = 3.0f;
+	const float ROOM_SCALE = 0.28f;
+	const float ROOM_OFFSET = 0.7f;
+	const float DAMP_SCALE = 0.4f;
+	const float ALLPASS_FEEDBACK = 0.5f;
+	// Level of each pair the tail comes from in surround
+	const float SURROUND_SPREAD = 0.7071f;
+
+	struct NamedPreset
+	{
+		const char* name;
+		ReverbPreset preset;
+	};
+
+	const NamedPreset PRESETS[] =
+	{
+		//  name          room   damp   wet    width  preDelay
+		{ "Room",     { 0.50f, 0.50f, 0.15f, 1.00f, 0.005f } },
+		{ "Hall",     { 0.85f, 0.30f, 0.25f, 1.00f, 0.025f } },
+		{ "Cave",     { 0.95f, 0.15f, 0.35f, 1.00f, 0.040f } },
+		{ "Tunnel",   { 0.90f, 0.60f, 0.30f, 0.50f, 0.015f } },
+		{ "Outdoors", { 0.20f, 0.80f, 0.08f, 1.00f, 0.060f } },
+	};
+
+	int ScaleLength( int frames, float sampleRate )
+	{
+		return Math::Max( ( int ) ( frames * sampleRate / 44100.0f + 0.5f ), 1 );
+	}
+}
+
+ReverbBus::ReverbBus( float sampleRate )
+	: preDelayFrames( 0 ), sampleRate( sampleRate ), send( 0.0f ), active( false )
+{
+	int lengths[2][REVERB_NUM_COMBS + REVERB_NUM_ALLPASSES];
+	memorySize = 0;
+	for ( int side = 0; side < 2; side++ )
+	{
+		int spread = side * STEREO_SPREAD;
+		for ( int i = 0; i < REVERB_NUM_COMBS; i++ )
+		{
+			lengths[side][i] = ScaleLength( COMB_TUNING[i] + spread, sampleRate );
+			memorySize += lengths[side][i];
+		}
+		for ( int i = 0; i < REVERB_NUM_ALLPASSES; i++ )
+		{
+			lengths[side][REVERB_NUM_COMBS + i] = ScaleLength( ALLPASS_TUNING[i] + spread, sampleRate );
+			memorySize += lengths[side][REVERB_NUM_COMBS + i];
+		}
+	}
+	// One more than the longest pre-delay, so a delay of zero reads what was just written
+	int preDelayLength = ( int ) ( REVERB_MAX_PREDELAY * sampleRate ) + 1;
+	memorySize += preDelayLength;
+
+	memory = new float[memorySize];
+	float* next = memory;
+	for ( int side = 0; side < 2; side++ )
+	{
+		for ( int i = 0; i < REVERB_NUM_COMBS; i++ )
+		{
+			combs[side][i].buffer = next;
+			combs[side][i].length = lengths[side][i];
+			next += lengths[side][i];
+		}
+		for ( int i = 0; i < REVERB_NUM_ALLPASSES; i++ )
+		{
+			allpasses[side][i].buffer = next;
+			allpasses[side][i].length = lengths[side][REVERB_NUM_COMBS + i];
+			next += lengths[side][REVERB_NUM_COMBS + i];
+		}
+	}
+	preDelay.buffer = next;
+	preDelay.length = preDelayLength;
+
+	Reset();
+	SetPreset( PRESETS[0].preset );
+}
+
+ReverbBus::~ReverbBus()
+{
+	delete[] memory;
+}
+
+bool ReverbBus::FindPreset( const std::string& name, ReverbPreset& outPreset )
+{
+	for ( const NamedPreset& named : PRESETS )
+	{
+		if ( name == named.name )
+		{
+			outPreset = named.preset;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ReverbBus::SetPreset( const ReverbPreset& preset )
+{
+	feedback = Math::Clamp( preset.roomSize, 0.0f, 1.0f ) * ROOM_SCALE + ROOM_OFFSET;
+	damp = Math::Clamp( preset.damping, 0.0f, 1.0f ) * DAMP_SCALE;
+
+	float width = Math::Clamp( preset.width, 0.0f, 1.0f );
+	wet1 = preset.wet * WET_SCALE * ( width * 0.5f + 0.5f );
+	wet2 = preset.wet * WET_SCALE * ( 1.0f - width ) * 0.5f;
+
+	float seconds = Math::Clamp( preset.preDelay, 0.0f, REVERB_MAX_PREDELAY );
+	preDelayFrames = Math::Min( ( int ) ( seconds * sampleRate + 0.5f ), preDelay.length - 1 );
+}
+
+void ReverbBus::Process( const float* in, float* out, int channels, int frames )
+{
+	if ( !IsActive() )
+	{
+		return;
+	}
+	active = true;
+
+	float sendLevel, sendStep;
+	send.BeginBlock( frames, sendLevel, sendStep );
+	bool sending = sendLevel > 0.0f || sendStep != 0.0f;
+
+	float damp2 = 1.0f - damp;
+	float peak = 0.0f;
+	for ( int n = 0; n < frames; n++ )
+	{
+		// Both sides are fed the same mono signal. Their different delays
+		// are what make the output stereo
+		const float* frame = in + n * channels;
+		float sum = frame[0];
+		for ( int c = 1; c < channels; c++ )
+		{
+			sum += frame[c];
+		}
+		float input = sum * INPUT_GAIN * ( sendLevel + n * sendStep );
+
+		preDelay.buffer[preDelay.position] = input;
+		int read = preDelay.position - preDelayFrames;
+		if ( read < 0 )
+		{
+			read += preDelay.length;
+		}
+		input = preDelay.buffer[read];
+		if ( ++preDelay.position == preDelay.length )
+		{
+			preDelay.position = 0;
+		}
+
+		float result[2];
+		for ( int side = 0; side < 2; side++ )
+		{
+			// The combs each low pass their feedback, so the tail darkens as it decays
+			float sum = 0.0f;
+			for ( int i = 0; i < REVERB_NUM_COMBS; i++ )
+			{
+				DelayLine& comb = combs[side][i];
+				float delayed = comb.buffer[comb.position];
+				combFilter[side][i] = delayed * damp2 + combFilter[side][i] * damp;
+				comb.buffer[comb.position] = input + combFilter[side][i] * feedback;
+				if ( ++comb.position == comb.length )
+				{
+					comb.position = 0;
+				}
+				sum += delayed;
+			}
+
+			// Then the allpasses thicken the echoes without colouring them
+			for ( int i = 0; i < REVERB_NUM_ALLPASSES; i++ )
+			{
+				DelayLine& allpass = allpasses[side][i];
+				float delayed = allpass.buffer[allpass.position];
+				allpass.buffer[allpass.position] = sum + delayed * ALLPASS_FEEDBACK;
+				if ( ++allpass.position == allpass.length )
+				{
+					allpass.position = 0;
+				}
+				sum = delayed - sum;
+			}
+			result[side] = sum;
+		}
+
+		float left = result[0] * wet1 + result[1] * wet2;
+		float right = result[1] * wet1 + result[0] * wet2;
+		float* dest = out + n * channels;
+		if ( channels == 2 )
+		{
+			dest[0] += left;
+			dest[1] += right;
+		}
+		else
+		{
+			dest[0] += left * SURROUND_SPREAD;
+			dest[1] += right * SURROUND_SPREAD;
+			dest[4] += left * SURROUND_SPREAD;
+			dest[5] += right * SURROUND_SPREAD;
+		}
+		peak = Math::Max( peak, Math::Max( Math::Abs( left ), Math::Abs( right ) ) );
+	}
+
+	// Nothing going in and nothing audible coming out, so stop until the
+	// send comes back up
+	if ( !sending && send.GetTarget() <= 0.0f && peak < REVERB_SILENCE )
+	{
+		Reset();
+	}
+}
+
+void ReverbBus::Reset()
+{
+	memset( memory, 0, memorySize * sizeof( float ) );
+	memset( combFilter, 0, sizeof( combFilter ) );
+	for ( int side = 0; side < 2; side++ )
+	{
+		for ( int i = 0; i < REVERB_NUM_COMBS; i++ )
+		{
+			combs[side][i].position = 0;
+		}
+		for ( int i = 0; i < REVERB_NUM_ALLPASSES; i++ )
+		{
+			allpasses[side][i].position = 0;
+		}
+	}
+	preDelay.position = 0;
+	active = false;
+}
@@ -0,0 +1,90 @@
+// ReverbBus.h
+// A shared stereo reverb that the whole mix sends into, one per acoustic
+// space rather than one per voice, so it costs the same however many voices
+// are playing. It's a Schroeder/Moorer network in the Freeverb layout: a
+// pre-delay, eight damped comb filters per side in parallel, then four
+// allpass filters in series. The right side's delays are slightly longer
+// than the left's, which decorrelates the two and makes the tail wide
+
+#pragma once
+#include "ParamRamp.h"
+#include <string>
+
+#define REVERB_NUM_COMBS 8
+#define REVERB_NUM_ALLPASSES 4
+#define REVERB_MAX_PREDELAY 0.1f
+// Once nothing is sent and the tail drops below this the bus switches off
+#define REVERB_SILENCE 0.00001f
+
+struct ReverbPreset
+{
+	// 0 to 1. Bigger rooms have longer tails
+	float roomSize;
+	// 0 to 1. High frequencies die away faster in more damped rooms
+	float damping;
+	// Gain of the reverb added back to the mix
+	float wet;
+	// 0 is the same reverb on both sides, 1 is fully decorrelated
+	float width;
+	// Seconds before the first reflections, up to REVERB_MAX_PREDELAY
+	float preDelay;
+};
+
+class ReverbBus
+{
+public:
+	explicit ReverbBus( float sampleRate );
+	~ReverbBus();
+
+	// Named presets a level can refer to: Room, Hall, Cave, Tunnel, Outdoors.
+	// Returns false for an unknown name
+	static bool FindPreset( const std::string& name, ReverbPreset& outPreset );
+
+	// Changes the room. The tail so far keeps ringing through the new settings
+	void SetPreset( const ReverbPreset& preset );
+	// How much of the input goes into the reverb. Glides over the next block
+	void SetSend( float level ) { send.SetTarget( level ); }
+
+	// False once the send is zero and the tail has died away. Inactive
+	// buses can be skipped
+	bool IsActive() const { return active || send.GetTarget() > 0.0f; }
+
+	// Adds the reverb of frames frames of in to out, both interleaved with
+	// channels channels: stereo, or a surround bus in FMOD's speaker order.
+	// Every channel of in goes into the reverb. In surround the tail comes
+	// from the side pair (channels 4 and 5) as well as the front pair, each
+	// 3dB down, so the room is all round the listener at the same power
+	void Process( const float* in, float* out, int channels, int frames );
+
+private:
+	// Clears every delay line, for a bus that has gone quiet
+	void Reset();
+
+	struct DelayLine
+	{
+		float* buffer;
+		int length;
+		int position;
+	};
+
+	// Lowpass state for each comb's feedback, which is what damping controls
+	float combFilter[2][REVERB_NUM_COMBS];
+	DelayLine combs[2][REVERB_NUM_COMBS];
+	DelayLine allpasses[2][REVERB_NUM_ALLPASSES];
+	// Allocated at its longest, and preDelayFrames of it used
+	DelayLine preDelay;
+	int preDelayFrames;
+	float sampleRate;
+
+	float feedback;
+	float damp;
+	// Left and right outputs are mixed by these to set the width
+	float wet1;
+	float wet2;
+	ParamRamp send;
+	bool active;
+
+	// Every delay line's buffer, carved up by the constructor
+	float* memory;
+	int memorySize;
+};
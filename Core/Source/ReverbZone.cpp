@@ -0,0 +1,45 @@
+#include "ITPEnginePCH.h"
+
+IMPL_ACTOR(ReverbZone, Actor);
+
+ReverbZone::ReverbZone(Game& game)
+	:Actor(game)
+	,mPreset("Room")
+	,mFadeDistance(100.0f)
+	,mLevel(1.0f)
+{
+	mBox = BoxComponent::Create(*this);
+	Collision::AxisAlignedBox box;
+	box.mMin = Vector3(-0.5f, -0.5f, -0.5f);
+	box.mMax = Vector3(0.5f, 0.5f, 0.5f);
+	mBox->BoxFromBox(box);
+
+	// The box only marks out a space for the listener. Left in the physics
+	// world it would get in the way of the player's ground checks
+	game.GetPhysWorld().RemoveComponent(mBox);
+}
+
+void ReverbZone::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// The level file has set the position and scale by now
+	mBox->OnUpdatedTransform();
+	mGame.GetReverbZones().AddZone(*this);
+}
+
+void ReverbZone::EndPlay()
+{
+	mGame.GetReverbZones().RemoveZone(*this);
+
+	Super::EndPlay();
+}
+
+void ReverbZone::SetProperties(const rapidjson::Value& properties)
+{
+	Super::SetProperties(properties);
+
+	GetStringFromJSON(properties, "preset", mPreset);
+	GetFloatFromJSON(properties, "fadeDistance", mFadeDistance);
+	GetFloatFromJSON(properties, "level", mLevel);
+}
@@ -0,0 +1,38 @@
+// ReverbZone.h
+// A box in the level with its own acoustics. While the listener is inside
+// it, the sounds it hears go through the zone's reverb preset. Like a
+// KillVolume, the box is a unit cube scaled by the BoxComponent's
+// properties in the level file
+
+#pragma once
+#include "Actor.h"
+#include "BoxComponent.h"
+#include <string>
+
+class ReverbZone : public Actor
+{
+	DECL_ACTOR(ReverbZone, Actor);
+public:
+	ReverbZone(Game& game);
+
+	void BeginPlay() override;
+	void EndPlay() override;
+
+	const Collision::AxisAlignedBox& GetBounds() const { return mBox->GetWorldSpaceBounds(); }
+	// One of the ReverbBus presets
+	const std::string& GetPreset() const { return mPreset; }
+	float GetFadeDistance() const { return mFadeDistance; }
+	float GetLevel() const { return mLevel; }
+
+	void SetProperties(const rapidjson::Value& properties) override;
+private:
+	BoxComponentPtr mBox;
+	std::string mPreset;
+	// The send fades in over this distance in from the edges of the box,
+	// so walking through a doorway blends one room into the next
+	float mFadeDistance;
+	// Send level at full strength
+	float mLevel;
+};
+
+DECL_PTR(ReverbZone);
@@ -0,0 +1,180 @@
+#include "ITPEnginePCH.h"
+#include "ReverbZone.h"
+#include <algorithm>
+
+ReverbZoneManager::ReverbZoneManager(AudioSystem& audio)
+	:mAudio(audio)
+	,mGridDirty(false)
+{
+	for (int i = 0; i < MAX_REVERB_BUSES; i++)
+	{
+		mSends[i] = 0.0f;
+	}
+}
+
+void ReverbZoneManager::AddZone(const ReverbZone& zone)
+{
+	Zone added;
+	added.mOwner = &zone;
+	added.mBounds = zone.GetBounds();
+	Vector3 size = added.mBounds.mMax - added.mBounds.mMin;
+	added.mVolume = size.x * size.y * size.z;
+	added.mFadeDistance = zone.GetFadeDistance();
+	added.mLevel = zone.GetLevel();
+	added.mBus = GetBus(zone.GetPreset());
+	mZones.push_back(added);
+
+	// A level adds all of its zones at once, so the grid is built on the next Update
+	mGridDirty = true;
+}
+
+void ReverbZoneManager::RemoveZone(const ReverbZone& zone)
+{
+	auto iter = std::find_if(mZones.begin(), mZones.end(), [&zone](const Zone& z)
+	{
+		return z.mOwner == &zone;
+	});
+	if (iter != mZones.end())
+	{
+		mZones.erase(iter);
+		mGridDirty = true;
+	}
+
+	// With the level gone, its presets can give up their buses
+	if (mZones.empty())
+	{
+		mPresetBuses.clear();
+	}
+}
+
+void ReverbZoneManager::Update(float deltaTime)
+{
+	if (mGridDirty)
+	{
+		BuildGrid();
+	}
+
+	Vector3 listener = mAudio.GetListenerPosition();
+	mCandidates = mLargeZones;
+	auto cell = mCells.find(GetCellKey(GetCell(listener.x), GetCell(listener.y), GetCell(listener.z)));
+	if (cell != mCells.end())
+	{
+		mCandidates.insert(mCandidates.end(), cell->second.begin(), cell->second.end());
+	}
+
+	// A smaller zone inside a bigger one (a cave in a valley) takes over from
+	// it, so zones are weighed smallest first and each gets what's left
+	std::sort(mCandidates.begin(), mCandidates.end(), [this](int a, int b)
+	{
+		return mZones[a].mVolume < mZones[b].mVolume;
+	});
+
+	float targets[MAX_REVERB_BUSES] = {};
+	float remaining = 1.0f;
+	for (int index : mCandidates)
+	{
+		const Zone& zone = mZones[index];
+		const Collision::AxisAlignedBox& box = zone.mBounds;
+
+		// Distance in from the nearest face, which is negative outside
+		float depth = Math::Min(Math::Min(listener.x - box.mMin.x, box.mMax.x - listener.x),
+			Math::Min(Math::Min(listener.y - box.mMin.y, box.mMax.y - listener.y),
+			Math::Min(listener.z - box.mMin.z, box.mMax.z - listener.z)));
+		if (zone.mBus < 0 || depth < 0.0f)
+		{
+			continue;
+		}
+
+		float weight = remaining;
+		if (zone.mFadeDistance > 0.0f)
+		{
+			weight *= Math::Min(depth / zone.mFadeDistance, 1.0f);
+		}
+		targets[zone.mBus] += weight * zone.mLevel;
+		remaining -= weight;
+	}
+
+	// The audio system smooths each change over a mix block, this smooths
+	// them over REVERB_ZONE_FADE_TIME
+	float maxChange = deltaTime / REVERB_ZONE_FADE_TIME;
+	for (int i = 0; i < MAX_REVERB_BUSES; i++)
+	{
+		float send = mSends[i] + Math::Clamp(targets[i] - mSends[i], -maxChange, maxChange);
+		if (send != mSends[i])
+		{
+			mSends[i] = send;
+			mAudio.SetReverbSend(i, send);
+		}
+	}
+}
+
+int ReverbZoneManager::GetBus(const std::string& preset)
+{
+	auto iter = mPresetBuses.find(preset);
+	if (iter != mPresetBuses.end())
+	{
+		return iter->second;
+	}
+
+	ReverbPreset settings;
+	if (!ReverbBus::FindPreset(preset, settings))
+	{
+		SDL_Log("Unknown reverb preset %s", preset.c_str());
+		return -1;
+	}
+	if (mPresetBuses.size() >= MAX_REVERB_BUSES)
+	{
+		SDL_Log("No reverb bus left for preset %s", preset.c_str());
+		return -1;
+	}
+
+	int bus = static_cast<int>(mPresetBuses.size());
+	mPresetBuses.emplace(preset, bus);
+	mAudio.SetReverbPreset(bus, settings);
+	return bus;
+}
+
+void ReverbZoneManager::BuildGrid()
+{
+	mCells.clear();
+	mLargeZones.clear();
+
+	for (size_t i = 0; i < mZones.size(); i++)
+	{
+		const Collision::AxisAlignedBox& box = mZones[i].mBounds;
+		int minX = GetCell(box.mMin.x), maxX = GetCell(box.mMax.x);
+		int minY = GetCell(box.mMin.y), maxY = GetCell(box.mMax.y);
+		int minZ = GetCell(box.mMin.z), maxZ = GetCell(box.mMax.z);
+
+		double cells = static_cast<double>(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+		if (cells > REVERB_ZONE_MAX_CELLS)
+		{
+			mLargeZones.push_back(static_cast<int>(i));
+			continue;
+		}
+
+		for (int x = minX; x <= maxX; x++)
+		{
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					mCells[GetCellKey(x, y, z)].push_back(static_cast<int>(i));
+				}
+			}
+		}
+	}
+
+	mGridDirty = false;
+}
+
+U64 ReverbZoneManager::GetCellKey(int x, int y, int z)
+{
+	const U64 mask = (1 << 21) - 1;
+	return ((static_cast<U64>(x) & mask) << 42) | ((static_cast<U64>(y) & mask) << 21) | (static_cast<U64>(z) & mask);
+}
+
+int ReverbZoneManager::GetCell(float coordinate)
+{
+	return static_cast<int>(floorf(coordinate / REVERB_ZONE_CELL_SIZE));
+}
@@ -0,0 +1,67 @@
+// ReverbZoneManager.h
+// Works out which reverb zones the listener is in, and sets the audio
+// system's reverb sends to match. Zones are looked up in a uniform grid
+// over their bounds, so only the few zones around the listener are tested
+// however many the level has. Every zone using the same preset shares one
+// reverb bus, so the cost stays fixed as zones are added
+
+#pragma once
+#include "AudioSystem.h"
+#include "CollisionHelpers.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ReverbZone;
+
+// Edge length of a grid cell, in world units
+#define REVERB_ZONE_CELL_SIZE 1000.0f
+// Zones that would cover more cells than this stay out of the grid and
+// are always tested
+#define REVERB_ZONE_MAX_CELLS 4096
+// Seconds for a send to go all the way between 0 and 1, so jumping
+// somewhere else (respawning) doesn't snap from one room to the next
+#define REVERB_ZONE_FADE_TIME 0.5f
+
+class ReverbZoneManager
+{
+public:
+	ReverbZoneManager(AudioSystem& audio);
+
+	// Zones are expected to stay where they are once added
+	void AddZone(const ReverbZone& zone);
+	void RemoveZone(const ReverbZone& zone);
+
+	// Call once per frame, after the listener has moved
+	void Update(float deltaTime);
+private:
+	struct Zone
+	{
+		const ReverbZone* mOwner;
+		Collision::AxisAlignedBox mBounds;
+		float mVolume;
+		float mFadeDistance;
+		float mLevel;
+		// -1 if the preset is unknown, or there were no buses left for it
+		int mBus;
+	};
+
+	int GetBus(const std::string& preset);
+	void BuildGrid();
+	// Cell coordinates packed into one key, 21 bits each
+	static U64 GetCellKey(int x, int y, int z);
+	static int GetCell(float coordinate);
+
+	AudioSystem& mAudio;
+	std::vector<Zone> mZones;
+
+	// Indices into mZones for every cell that a zone overlaps
+	std::unordered_map<U64, std::vector<int>> mCells;
+	std::vector<int> mLargeZones;
+	bool mGridDirty;
+	// Zones around the listener this frame
+	std::vector<int> mCandidates;
+
+	std::unordered_map<std::string, int> mPresetBuses;
+	float mSends[MAX_REVERB_BUSES];
+};
@@ -0,0 +1,1217 @@
+#include "ITPEnginePCH.h"
+#include <immintrin.h>
+#if _WIN32
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const float PCM8_TO_FLOAT = 1.0f / 128.0f;
+	const float PCM16_TO_FLOAT = 1.0f / 32768.0f;
+	const float PCM24_TO_FLOAT = 1.0f / 8388608.0f;
+	const float PCM32_TO_FLOAT = 1.0f / 2147483648.0f;
+
+	// Output is symmetric, so +1 and -1 are the same distance from zero
+	const float FLOAT_TO_PCM8 = 127.0f;
+	const float FLOAT_TO_PCM16 = 32767.0f;
+	const float FLOAT_TO_PCM24 = 8388607.0f;
+	// 2^31 - 1 isn't representable as a float, so 32 bit is scaled by 2^31
+	// and the top clamped to the largest float below it
+	const float FLOAT_TO_PCM32 = 2147483648.0f;
+	const float PCM32_MAX = 2147483520.0f;
+
+	// Samples converted per pass when Convert goes through float
+	const int CONVERT_CHUNK = 256;
+
+	bool CpuHasAvx2()
+	{
+#if _WIN32
+		int info[4];
+		__cpuid( info, 0 );
+		if ( info[0] < 7 )
+		{
+			return false;
+		}
+
+		// The OS also has to save the AVX registers on context switches
+		__cpuid( info, 1 );
+		bool osSaves = ( info[2] & ( 1 << 27 ) ) != 0 && ( info[2] & ( 1 << 28 ) ) != 0;
+		if ( !osSaves || ( _xgetbv( 0 ) & 6 ) != 6 )
+		{
+			return false;
+		}
+
+		__cpuidex( info, 7, 0 );
+		return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+		return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+	}
+
+	SimdLevel GetBestSimdLevel()
+	{
+		static SimdLevel best = CpuHasAvx2() ? SIMD_AVX2 : SIMD_SSE2;
+		return best;
+	}
+
+	SimdLevel simdLevel = GetBestSimdLevel();
+
+	// Unaligned 32 bit read, for picking 24 bit samples out of a byte stream
+	inline int Load32( const unsigned char* p )
+	{
+		int value;
+		memcpy( &value, p, sizeof( value ) );
+		return value;
+	}
+
+	inline int Clip( float sample, float scale )
+	{
+		return ( int ) lrintf( Math::Clamp( sample, -1.0f, 1.0f ) * scale );
+	}
+
+	// Scalar ------------------------------------------------------------
+
+	void ToFloatScalar( const void* in, SampleFormat format, float* out, int count )
+	{
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			const unsigned char* src = ( const unsigned char* ) in;
+			for ( int i = 0; i < count; i++ )
+			{
+				out[i] = ( src[i] - 128 ) * PCM8_TO_FLOAT;
+			}
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			const short* src = ( const short* ) in;
+			for ( int i = 0; i < count; i++ )
+			{
+				out[i] = src[i] * PCM16_TO_FLOAT;
+			}
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			const unsigned char* src = ( const unsigned char* ) in;
+			for ( int i = 0; i < count; i++ )
+			{
+				const unsigned char* p = src + i * 3;
+				// Shifted up unsigned, then back down to sign extend
+				int sample = ( int ) ( ( U32 ) p[2] << 24 | p[1] << 16 | p[0] << 8 ) >> 8;
+				out[i] = sample * PCM24_TO_FLOAT;
+			}
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			const int* src = ( const int* ) in;
+			for ( int i = 0; i < count; i++ )
+			{
+				out[i] = ( float ) src[i] * PCM32_TO_FLOAT;
+			}
+			break;
+		}
+		case SAMPLE_FLOAT32:
+			memcpy( out, in, count * sizeof( float ) );
+			break;
+		}
+	}
+
+	void FromFloatScalar( const float* in, void* out, SampleFormat format, int count )
+	{
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			unsigned char* dest = ( unsigned char* ) out;
+			for ( int i = 0; i < count; i++ )
+			{
+				dest[i] = ( unsigned char ) ( Clip( in[i], FLOAT_TO_PCM8 ) + 128 );
+			}
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			short* dest = ( short* ) out;
+			for ( int i = 0; i < count; i++ )
+			{
+				dest[i] = ( short ) Clip( in[i], FLOAT_TO_PCM16 );
+			}
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			unsigned char* dest = ( unsigned char* ) out;
+			for ( int i = 0; i < count; i++ )
+			{
+				int sample = Clip( in[i], FLOAT_TO_PCM24 );
+				dest[i * 3] = ( unsigned char ) sample;
+				dest[i * 3 + 1] = ( unsigned char ) ( sample >> 8 );
+				dest[i * 3 + 2] = ( unsigned char ) ( sample >> 16 );
+			}
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			int* dest = ( int* ) out;
+			for ( int i = 0; i < count; i++ )
+			{
+				float sample = Math::Clamp( in[i], -1.0f, 1.0f ) * FLOAT_TO_PCM32;
+				dest[i] = ( int ) lrintf( Math::Min( sample, PCM32_MAX ) );
+			}
+			break;
+		}
+		case SAMPLE_FLOAT32:
+		{
+			float* dest = ( float* ) out;
+			for ( int i = 0; i < count; i++ )
+			{
+				dest[i] = Math::Clamp( in[i], -1.0f, 1.0f );
+			}
+			break;
+		}
+		}
+	}
+
+	void InterleaveScalar( const float* const* planes, int numChannels, float* out, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			for ( int c = 0; c < numChannels; c++ )
+			{
+				out[n * numChannels + c] = planes[c][n];
+			}
+		}
+	}
+
+	void DeinterleaveScalar( const float* in, int numChannels, float* const* planes, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			for ( int c = 0; c < numChannels; c++ )
+			{
+				planes[c][n] = in[n * numChannels + c];
+			}
+		}
+	}
+
+	void AddInterleavedScalar( const float* left, const float* right, float* out, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			out[n * 2] += left[n];
+			out[n * 2 + 1] += right[n];
+		}
+	}
+
+	void AddInterleavedScalar( const float* left, const float* right, float* out, int outChannels, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			out[n * outChannels] += left[n];
+			out[n * outChannels + 1] += right[n];
+		}
+	}
+
+	void AddPannedScalar( const float* in, float* out, int outChannels, const float* gains, const float* steps, int frames )
+	{
+		float gain[MAX_DOWNMIX_CHANNELS];
+		memcpy( gain, gains, outChannels * sizeof( float ) );
+		for ( int n = 0; n < frames; n++ )
+		{
+			for ( int c = 0; c < outChannels; c++ )
+			{
+				out[n * outChannels + c] += in[n] * gain[c];
+				gain[c] += steps[c];
+			}
+		}
+	}
+
+	void MonoToStereoScalar( const float* in, float* out, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			out[n * 2] = in[n];
+			out[n * 2 + 1] = in[n];
+		}
+	}
+
+	void StereoToMonoScalar( const float* in, float* out, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			out[n] = ( in[n * 2] + in[n * 2 + 1] ) * 0.5f;
+		}
+	}
+
+	void DownmixScalar( const float* in, int inChannels, float* out, int outChannels, const float* matrix, int frames )
+	{
+		for ( int n = 0; n < frames; n++ )
+		{
+			const float* frame = in + n * inChannels;
+			for ( int o = 0; o < outChannels; o++ )
+			{
+				const float* row = matrix + o * inChannels;
+				float sum = 0.0f;
+				for ( int i = 0; i < inChannels; i++ )
+				{
+					sum += row[i] * frame[i];
+				}
+				out[n * outChannels + o] = sum;
+			}
+		}
+	}
+
+	// SSE2 --------------------------------------------------------------
+	// Each kernel does as many whole registers as it can and leaves the
+	// rest to the scalar version
+
+	inline __m128 ClampSse( __m128 x )
+	{
+		return _mm_min_ps( _mm_max_ps( x, _mm_set_ps1( -1.0f ) ), _mm_set_ps1( 1.0f ) );
+	}
+
+	void ToFloatSse2( const void* in, SampleFormat format, float* out, int count )
+	{
+		int i = 0;
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			// Flipping the top bit makes the bytes signed. Unpacking puts each in
+			// the top byte of a 32 bit lane, and the arithmetic shift sign extends
+			const unsigned char* src = ( const unsigned char* ) in;
+			__m128i flip = _mm_set1_epi8( ( char ) 0x80 );
+			__m128i zero = _mm_setzero_si128();
+			__m128 scale = _mm_set_ps1( PCM8_TO_FLOAT );
+			for ( ; i + 16 <= count; i += 16 )
+			{
+				__m128i bytes = _mm_xor_si128( _mm_loadu_si128( ( const __m128i* ) ( src + i ) ), flip );
+				__m128i low = _mm_unpacklo_epi8( zero, bytes );
+				__m128i high = _mm_unpackhi_epi8( zero, bytes );
+				__m128i s0 = _mm_srai_epi32( _mm_unpacklo_epi16( zero, low ), 24 );
+				__m128i s1 = _mm_srai_epi32( _mm_unpackhi_epi16( zero, low ), 24 );
+				__m128i s2 = _mm_srai_epi32( _mm_unpacklo_epi16( zero, high ), 24 );
+				__m128i s3 = _mm_srai_epi32( _mm_unpackhi_epi16( zero, high ), 24 );
+				_mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( s0 ), scale ) );
+				_mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( s1 ), scale ) );
+				_mm_storeu_ps( out + i + 8, _mm_mul_ps( _mm_cvtepi32_ps( s2 ), scale ) );
+				_mm_storeu_ps( out + i + 12, _mm_mul_ps( _mm_cvtepi32_ps( s3 ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			const short* src = ( const short* ) in;
+			__m128 scale = _mm_set_ps1( PCM16_TO_FLOAT );
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				__m128i samples = _mm_loadu_si128( ( const __m128i* ) ( src + i ) );
+				__m128i low = _mm_srai_epi32( _mm_unpacklo_epi16( samples, samples ), 16 );
+				__m128i high = _mm_srai_epi32( _mm_unpackhi_epi16( samples, samples ), 16 );
+				_mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( low ), scale ) );
+				_mm_storeu_ps( out + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( high ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			// Each 32 bit read picks up one sample plus the first byte of the
+			// next, which shifting up and back down discards. The last read
+			// ends one byte into the sample after the group, so that has to exist
+			const unsigned char* src = ( const unsigned char* ) in;
+			__m128 scale = _mm_set_ps1( PCM24_TO_FLOAT );
+			for ( ; i + 4 < count; i += 4 )
+			{
+				const unsigned char* p = src + i * 3;
+				__m128i samples = _mm_setr_epi32( Load32( p ), Load32( p + 3 ), Load32( p + 6 ), Load32( p + 9 ) );
+				samples = _mm_srai_epi32( _mm_slli_epi32( samples, 8 ), 8 );
+				_mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( samples ), scale ) );
+			}
+			ToFloatScalar( src + i * 3, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			const int* src = ( const int* ) in;
+			__m128 scale = _mm_set_ps1( PCM32_TO_FLOAT );
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				__m128i samples = _mm_loadu_si128( ( const __m128i* ) ( src + i ) );
+				_mm_storeu_ps( out + i, _mm_mul_ps( _mm_cvtepi32_ps( samples ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_FLOAT32:
+			memcpy( out, in, count * sizeof( float ) );
+			break;
+		}
+	}
+
+	void FromFloatSse2( const float* in, void* out, SampleFormat format, int count )
+	{
+		int i = 0;
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			// Saturating packs narrow to signed bytes, then flipping the top
+			// bit offsets them to unsigned
+			unsigned char* dest = ( unsigned char* ) out;
+			__m128 scale = _mm_set_ps1( FLOAT_TO_PCM8 );
+			__m128i flip = _mm_set1_epi8( ( char ) 0x80 );
+			for ( ; i + 16 <= count; i += 16 )
+			{
+				__m128i s0 = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i ) ), scale ) );
+				__m128i s1 = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i + 4 ) ), scale ) );
+				__m128i s2 = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i + 8 ) ), scale ) );
+				__m128i s3 = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i + 12 ) ), scale ) );
+				__m128i bytes = _mm_packs_epi16( _mm_packs_epi32( s0, s1 ), _mm_packs_epi32( s2, s3 ) );
+				_mm_storeu_si128( ( __m128i* ) ( dest + i ), _mm_xor_si128( bytes, flip ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			short* dest = ( short* ) out;
+			__m128 scale = _mm_set_ps1( FLOAT_TO_PCM16 );
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				__m128i low = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i ) ), scale ) );
+				__m128i high = _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i + 4 ) ), scale ) );
+				_mm_storeu_si128( ( __m128i* ) ( dest + i ), _mm_packs_epi32( low, high ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			// Convert four at a time, then write out the low three bytes of each
+			unsigned char* dest = ( unsigned char* ) out;
+			__m128 scale = _mm_set_ps1( FLOAT_TO_PCM24 );
+			alignas( 16 ) int samples[4];
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				_mm_store_si128( ( __m128i* ) samples, _mm_cvtps_epi32( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i ) ), scale ) ) );
+				unsigned char* p = dest + i * 3;
+				for ( int j = 0; j < 4; j++ )
+				{
+					p[j * 3] = ( unsigned char ) samples[j];
+					p[j * 3 + 1] = ( unsigned char ) ( samples[j] >> 8 );
+					p[j * 3 + 2] = ( unsigned char ) ( samples[j] >> 16 );
+				}
+			}
+			FromFloatScalar( in + i, dest + i * 3, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			int* dest = ( int* ) out;
+			__m128 scale = _mm_set_ps1( FLOAT_TO_PCM32 );
+			__m128 top = _mm_set_ps1( PCM32_MAX );
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				__m128 sample = _mm_min_ps( _mm_mul_ps( ClampSse( _mm_loadu_ps( in + i ) ), scale ), top );
+				_mm_storeu_si128( ( __m128i* ) ( dest + i ), _mm_cvtps_epi32( sample ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_FLOAT32:
+		{
+			float* dest = ( float* ) out;
+			for ( ; i + 4 <= count; i += 4 )
+			{
+				_mm_storeu_ps( dest + i, ClampSse( _mm_loadu_ps( in + i ) ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		}
+	}
+
+	void InterleaveStereoSse2( const float* left, const float* right, float* out, int frames )
+	{
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 l = _mm_loadu_ps( left + n );
+			__m128 r = _mm_loadu_ps( right + n );
+			_mm_storeu_ps( out + n * 2, _mm_unpacklo_ps( l, r ) );
+			_mm_storeu_ps( out + n * 2 + 4, _mm_unpackhi_ps( l, r ) );
+		}
+		const float* planes[2] = { left + n, right + n };
+		InterleaveScalar( planes, 2, out + n * 2, frames - n );
+	}
+
+	void DeinterleaveStereoSse2( const float* in, float* left, float* right, int frames )
+	{
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 a = _mm_loadu_ps( in + n * 2 );
+			__m128 b = _mm_loadu_ps( in + n * 2 + 4 );
+			_mm_storeu_ps( left + n, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			_mm_storeu_ps( right + n, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+		}
+		float* planes[2] = { left + n, right + n };
+		DeinterleaveScalar( in + n * 2, 2, planes, frames - n );
+	}
+
+	void AddInterleavedSse2( const float* left, const float* right, float* out, int frames )
+	{
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 l = _mm_loadu_ps( left + n );
+			__m128 r = _mm_loadu_ps( right + n );
+			float* dest = out + n * 2;
+			_mm_storeu_ps( dest, _mm_add_ps( _mm_loadu_ps( dest ), _mm_unpacklo_ps( l, r ) ) );
+			_mm_storeu_ps( dest + 4, _mm_add_ps( _mm_loadu_ps( dest + 4 ), _mm_unpackhi_ps( l, r ) ) );
+		}
+		AddInterleavedScalar( left + n, right + n, out + n * 2, frames - n );
+	}
+
+	void AddInterleavedSse2( const float* left, const float* right, float* out, int outChannels, int frames )
+	{
+		// A frame's left and right go into the low half of one register
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 l = _mm_loadu_ps( left + n );
+			__m128 r = _mm_loadu_ps( right + n );
+			__m128 pairs[2] = { _mm_unpacklo_ps( l, r ), _mm_unpackhi_ps( l, r ) };
+			for ( int j = 0; j < 4; j++ )
+			{
+				__m128 pair = j & 1 ? _mm_movehl_ps( pairs[j >> 1], pairs[j >> 1] ) : pairs[j >> 1];
+				__m64* dest = ( __m64* ) ( out + ( n + j ) * outChannels );
+				_mm_storel_pi( dest, _mm_add_ps( _mm_loadl_pi( _mm_setzero_ps(), dest ), pair ) );
+			}
+		}
+		AddInterleavedScalar( left + n, right + n, out + n * outChannels, outChannels, frames - n );
+	}
+
+	void AddPannedSse2( const float* in, float* out, int outChannels, const float* gains, const float* steps, int frames )
+	{
+		if ( outChannels == 2 )
+		{
+			// Two frames per register, so the gains start a frame apart and
+			// move two frames at a time
+			__m128 gain = _mm_setr_ps( gains[0], gains[1], gains[0] + steps[0], gains[1] + steps[1] );
+			__m128 step = _mm_setr_ps( steps[0] * 2.0f, steps[1] * 2.0f, steps[0] * 2.0f, steps[1] * 2.0f );
+			int n = 0;
+			for ( ; n + 4 <= frames; n += 4 )
+			{
+				__m128 x = _mm_loadu_ps( in + n );
+				float* dest = out + n * 2;
+				_mm_storeu_ps( dest, _mm_add_ps( _mm_loadu_ps( dest ), _mm_mul_ps( _mm_unpacklo_ps( x, x ), gain ) ) );
+				gain = _mm_add_ps( gain, step );
+				_mm_storeu_ps( dest + 4, _mm_add_ps( _mm_loadu_ps( dest + 4 ), _mm_mul_ps( _mm_unpackhi_ps( x, x ), gain ) ) );
+				gain = _mm_add_ps( gain, step );
+			}
+			alignas( 16 ) float rest[4];
+			_mm_store_ps( rest, gain );
+			AddPannedScalar( in + n, out + n * 2, 2, rest, steps, frames - n );
+		}
+		else if ( outChannels % 4 == 0 )
+		{
+			// A frame at a time, a register per four channels
+			__m128 gain[MAX_DOWNMIX_CHANNELS / 4];
+			__m128 step[MAX_DOWNMIX_CHANNELS / 4];
+			int registers = outChannels / 4;
+			for ( int r = 0; r < registers; r++ )
+			{
+				gain[r] = _mm_loadu_ps( gains + r * 4 );
+				step[r] = _mm_loadu_ps( steps + r * 4 );
+			}
+			for ( int n = 0; n < frames; n++ )
+			{
+				__m128 x = _mm_set_ps1( in[n] );
+				float* dest = out + n * outChannels;
+				for ( int r = 0; r < registers; r++ )
+				{
+					_mm_storeu_ps( dest + r * 4, _mm_add_ps( _mm_loadu_ps( dest + r * 4 ), _mm_mul_ps( x, gain[r] ) ) );
+					gain[r] = _mm_add_ps( gain[r], step[r] );
+				}
+			}
+		}
+		else
+		{
+			AddPannedScalar( in, out, outChannels, gains, steps, frames );
+		}
+	}
+
+	void StereoToMonoSse2( const float* in, float* out, int frames )
+	{
+		__m128 half = _mm_set_ps1( 0.5f );
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 a = _mm_loadu_ps( in + n * 2 );
+			__m128 b = _mm_loadu_ps( in + n * 2 + 4 );
+			__m128 sum = _mm_add_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ), _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+			_mm_storeu_ps( out + n, _mm_mul_ps( sum, half ) );
+		}
+		StereoToMonoScalar( in + n * 2, out + n, frames - n );
+	}
+
+	void DownmixSse2( const float* in, int inChannels, float* out, int outChannels, const float* matrix, int frames )
+	{
+		// Four frames at a time: gather each input channel into a register,
+		// and accumulate it into every output channel
+		int n = 0;
+		for ( ; n + 4 <= frames; n += 4 )
+		{
+			__m128 sums[MAX_DOWNMIX_CHANNELS];
+			for ( int o = 0; o < outChannels; o++ )
+			{
+				sums[o] = _mm_setzero_ps();
+			}
+
+			const float* frame = in + n * inChannels;
+			for ( int i = 0; i < inChannels; i++ )
+			{
+				__m128 channel = _mm_setr_ps( frame[i], frame[inChannels + i], frame[inChannels * 2 + i], frame[inChannels * 3 + i] );
+				for ( int o = 0; o < outChannels; o++ )
+				{
+					sums[o] = _mm_add_ps( sums[o], _mm_mul_ps( _mm_set_ps1( matrix[o * inChannels + i] ), channel ) );
+				}
+			}
+
+			float* dest = out + n * outChannels;
+			if ( outChannels == 2 )
+			{
+				_mm_storeu_ps( dest, _mm_unpacklo_ps( sums[0], sums[1] ) );
+				_mm_storeu_ps( dest + 4, _mm_unpackhi_ps( sums[0], sums[1] ) );
+			}
+			else
+			{
+				for ( int o = 0; o < outChannels; o++ )
+				{
+					alignas( 16 ) float values[4];
+					_mm_store_ps( values, sums[o] );
+					for ( int j = 0; j < 4; j++ )
+					{
+						dest[j * outChannels + o] = values[j];
+					}
+				}
+			}
+		}
+		DownmixScalar( in + n * inChannels, inChannels, out + n * outChannels, outChannels, matrix, frames - n );
+	}
+
+	// AVX2 --------------------------------------------------------------
+
+	AVX2_TARGET inline __m256 ClampAvx( __m256 x )
+	{
+		return _mm256_min_ps( _mm256_max_ps( x, _mm256_set1_ps( -1.0f ) ), _mm256_set1_ps( 1.0f ) );
+	}
+
+	AVX2_TARGET void ToFloatAvx2( const void* in, SampleFormat format, float* out, int count )
+	{
+		int i = 0;
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			const unsigned char* src = ( const unsigned char* ) in;
+			__m256i offset = _mm256_set1_epi32( 128 );
+			__m256 scale = _mm256_set1_ps( PCM8_TO_FLOAT );
+			for ( ; i + 16 <= count; i += 16 )
+			{
+				__m128i bytes = _mm_loadu_si128( ( const __m128i* ) ( src + i ) );
+				__m256i low = _mm256_sub_epi32( _mm256_cvtepu8_epi32( bytes ), offset );
+				__m256i high = _mm256_sub_epi32( _mm256_cvtepu8_epi32( _mm_srli_si128( bytes, 8 ) ), offset );
+				_mm256_storeu_ps( out + i, _mm256_mul_ps( _mm256_cvtepi32_ps( low ), scale ) );
+				_mm256_storeu_ps( out + i + 8, _mm256_mul_ps( _mm256_cvtepi32_ps( high ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			const short* src = ( const short* ) in;
+			__m256 scale = _mm256_set1_ps( PCM16_TO_FLOAT );
+			for ( ; i + 16 <= count; i += 16 )
+			{
+				__m256i low = _mm256_cvtepi16_epi32( _mm_loadu_si128( ( const __m128i* ) ( src + i ) ) );
+				__m256i high = _mm256_cvtepi16_epi32( _mm_loadu_si128( ( const __m128i* ) ( src + i + 8 ) ) );
+				_mm256_storeu_ps( out + i, _mm256_mul_ps( _mm256_cvtepi32_ps( low ), scale ) );
+				_mm256_storeu_ps( out + i + 8, _mm256_mul_ps( _mm256_cvtepi32_ps( high ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			// Two 16 byte loads each cover four packed samples. The shuffle moves
+			// each sample into the top three bytes of a 32 bit lane and the shift
+			// sign extends it. The second load reads 4 bytes past the group
+			const unsigned char* src = ( const unsigned char* ) in;
+			__m256i spread = _mm256_setr_epi8(
+				-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+				-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+			__m256 scale = _mm256_set1_ps( PCM24_TO_FLOAT );
+			for ( ; i + 10 <= count; i += 8 )
+			{
+				const unsigned char* p = src + i * 3;
+				__m256i bytes = _mm256_inserti128_si256( _mm256_castsi128_si256(
+					_mm_loadu_si128( ( const __m128i* ) p ) ), _mm_loadu_si128( ( const __m128i* ) ( p + 12 ) ), 1 );
+				__m256i samples = _mm256_srai_epi32( _mm256_shuffle_epi8( bytes, spread ), 8 );
+				_mm256_storeu_ps( out + i, _mm256_mul_ps( _mm256_cvtepi32_ps( samples ), scale ) );
+			}
+			ToFloatSse2( src + i * 3, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			const int* src = ( const int* ) in;
+			__m256 scale = _mm256_set1_ps( PCM32_TO_FLOAT );
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				__m256i samples = _mm256_loadu_si256( ( const __m256i* ) ( src + i ) );
+				_mm256_storeu_ps( out + i, _mm256_mul_ps( _mm256_cvtepi32_ps( samples ), scale ) );
+			}
+			ToFloatScalar( src + i, format, out + i, count - i );
+			break;
+		}
+		case SAMPLE_FLOAT32:
+			memcpy( out, in, count * sizeof( float ) );
+			break;
+		}
+		_mm256_zeroupper();
+	}
+
+	AVX2_TARGET void FromFloatAvx2( const float* in, void* out, SampleFormat format, int count )
+	{
+		// The 256 bit packs work within each 128 bit half, so their results
+		// come out with the halves interleaved and need permuting back
+		int i = 0;
+		switch ( format )
+		{
+		case SAMPLE_PCM8:
+		{
+			unsigned char* dest = ( unsigned char* ) out;
+			__m256 scale = _mm256_set1_ps( FLOAT_TO_PCM8 );
+			__m256i flip = _mm256_set1_epi8( ( char ) 0x80 );
+			__m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+			for ( ; i + 32 <= count; i += 32 )
+			{
+				__m256i s0 = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i ) ), scale ) );
+				__m256i s1 = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i + 8 ) ), scale ) );
+				__m256i s2 = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i + 16 ) ), scale ) );
+				__m256i s3 = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i + 24 ) ), scale ) );
+				__m256i bytes = _mm256_packs_epi16( _mm256_packs_epi32( s0, s1 ), _mm256_packs_epi32( s2, s3 ) );
+				bytes = _mm256_permutevar8x32_epi32( bytes, order );
+				_mm256_storeu_si256( ( __m256i* ) ( dest + i ), _mm256_xor_si256( bytes, flip ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM16:
+		{
+			short* dest = ( short* ) out;
+			__m256 scale = _mm256_set1_ps( FLOAT_TO_PCM16 );
+			for ( ; i + 16 <= count; i += 16 )
+			{
+				__m256i low = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i ) ), scale ) );
+				__m256i high = _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i + 8 ) ), scale ) );
+				__m256i packed = _mm256_permute4x64_epi64( _mm256_packs_epi32( low, high ), _MM_SHUFFLE( 3, 1, 2, 0 ) );
+				_mm256_storeu_si256( ( __m256i* ) ( dest + i ), packed );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM24:
+		{
+			unsigned char* dest = ( unsigned char* ) out;
+			__m256 scale = _mm256_set1_ps( FLOAT_TO_PCM24 );
+			alignas( 32 ) int samples[8];
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				_mm256_store_si256( ( __m256i* ) samples, _mm256_cvtps_epi32( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i ) ), scale ) ) );
+				unsigned char* p = dest + i * 3;
+				for ( int j = 0; j < 8; j++ )
+				{
+					p[j * 3] = ( unsigned char ) samples[j];
+					p[j * 3 + 1] = ( unsigned char ) ( samples[j] >> 8 );
+					p[j * 3 + 2] = ( unsigned char ) ( samples[j] >> 16 );
+				}
+			}
+			FromFloatScalar( in + i, dest + i * 3, format, count - i );
+			break;
+		}
+		case SAMPLE_PCM32:
+		{
+			int* dest = ( int* ) out;
+			__m256 scale = _mm256_set1_ps( FLOAT_TO_PCM32 );
+			__m256 top = _mm256_set1_ps( PCM32_MAX );
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				__m256 sample = _mm256_min_ps( _mm256_mul_ps( ClampAvx( _mm256_loadu_ps( in + i ) ), scale ), top );
+				_mm256_storeu_si256( ( __m256i* ) ( dest + i ), _mm256_cvtps_epi32( sample ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		case SAMPLE_FLOAT32:
+		{
+			float* dest = ( float* ) out;
+			for ( ; i + 8 <= count; i += 8 )
+			{
+				_mm256_storeu_ps( dest + i, ClampAvx( _mm256_loadu_ps( in + i ) ) );
+			}
+			FromFloatScalar( in + i, dest + i, format, count - i );
+			break;
+		}
+		}
+		_mm256_zeroupper();
+	}
+
+	// Unpacks work within 128 bit halves, so the halves of the two results
+	// are swapped round to get consecutive frames
+	AVX2_TARGET inline void ZipAvx( __m256 a, __m256 b, __m256& first, __m256& second )
+	{
+		__m256 low = _mm256_unpacklo_ps( a, b );
+		__m256 high = _mm256_unpackhi_ps( a, b );
+		first = _mm256_permute2f128_ps( low, high, 0x20 );
+		second = _mm256_permute2f128_ps( low, high, 0x31 );
+	}
+
+	// The reverse of ZipAvx: even samples into evens, odd into odds
+	AVX2_TARGET inline void UnzipAvx( __m256 first, __m256 second, __m256& evens, __m256& odds )
+	{
+		__m256 e = _mm256_shuffle_ps( first, second, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+		__m256 o = _mm256_shuffle_ps( first, second, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+		evens = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd( e ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+		odds = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd( o ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+	}
+
+	AVX2_TARGET void InterleaveStereoAvx2( const float* left, const float* right, float* out, int frames )
+	{
+		int n = 0;
+		for ( ; n + 8 <= frames; n += 8 )
+		{
+			__m256 first, second;
+			ZipAvx( _mm256_loadu_ps( left + n ), _mm256_loadu_ps( right + n ), first, second );
+			_mm256_storeu_ps( out + n * 2, first );
+			_mm256_storeu_ps( out + n * 2 + 8, second );
+		}
+		_mm256_zeroupper();
+		InterleaveStereoSse2( left + n, right + n, out + n * 2, frames - n );
+	}
+
+	AVX2_TARGET void DeinterleaveStereoAvx2( const float* in, float* left, float* right, int frames )
+	{
+		int n = 0;
+		for ( ; n + 8 <= frames; n += 8 )
+		{
+			__m256 l, r;
+			UnzipAvx( _mm256_loadu_ps( in + n * 2 ), _mm256_loadu_ps( in + n * 2 + 8 ), l, r );
+			_mm256_storeu_ps( left + n, l );
+			_mm256_storeu_ps( right + n, r );
+		}
+		_mm256_zeroupper();
+		DeinterleaveStereoSse2( in + n * 2, left + n, right + n, frames - n );
+	}
+
+	AVX2_TARGET void AddInterleavedAvx2( const float* left, const float* right, float* out, int frames )
+	{
+		int n = 0;
+		for ( ; n + 8 <= frames; n += 8 )
+		{
+			__m256 first, second;
+			ZipAvx( _mm256_loadu_ps( left + n ), _mm256_loadu_ps( right + n ), first, second );
+			float* dest = out + n * 2;
+			_mm256_storeu_ps( dest, _mm256_add_ps( _mm256_loadu_ps( dest ), first ) );
+			_mm256_storeu_ps( dest + 8, _mm256_add_ps( _mm256_loadu_ps( dest + 8 ), second ) );
+		}
+		_mm256_zeroupper();
+		AddInterleavedSse2( left + n, right + n, out + n * 2, frames - n );
+	}
+
+	AVX2_TARGET void AddPannedAvx2( const float* in, float* out, int outChannels, const float* gains, const float* steps, int frames )
+	{
+		if ( outChannels == 2 )
+		{
+			// Four frames per register
+			__m256 gain = _mm256_setr_ps( gains[0], gains[1], gains[0] + steps[0], gains[1] + steps[1],
+				gains[0] + steps[0] * 2.0f, gains[1] + steps[1] * 2.0f, gains[0] + steps[0] * 3.0f, gains[1] + steps[1] * 3.0f );
+			__m256 step = _mm256_setr_ps( steps[0] * 4.0f, steps[1] * 4.0f, steps[0] * 4.0f, steps[1] * 4.0f,
+				steps[0] * 4.0f, steps[1] * 4.0f, steps[0] * 4.0f, steps[1] * 4.0f );
+			int n = 0;
+			for ( ; n + 4 <= frames; n += 4 )
+			{
+				__m128 x = _mm_loadu_ps( in + n );
+				__m256 doubled = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_unpacklo_ps( x, x ) ), _mm_unpackhi_ps( x, x ), 1 );
+				float* dest = out + n * 2;
+				_mm256_storeu_ps( dest, _mm256_add_ps( _mm256_loadu_ps( dest ), _mm256_mul_ps( doubled, gain ) ) );
+				gain = _mm256_add_ps( gain, step );
+			}
+			alignas( 32 ) float rest[8];
+			_mm256_store_ps( rest, gain );
+			_mm256_zeroupper();
+			AddPannedScalar( in + n, out + n * 2, 2, rest, steps, frames - n );
+		}
+		else if ( outChannels == 8 )
+		{
+			// A frame per register
+			__m256 gain = _mm256_loadu_ps( gains );
+			__m256 step = _mm256_loadu_ps( steps );
+			for ( int n = 0; n < frames; n++ )
+			{
+				float* dest = out + n * 8;
+				_mm256_storeu_ps( dest, _mm256_add_ps( _mm256_loadu_ps( dest ), _mm256_mul_ps( _mm256_set1_ps( in[n] ), gain ) ) );
+				gain = _mm256_add_ps( gain, step );
+			}
+			_mm256_zeroupper();
+		}
+		else
+		{
+			AddPannedSse2( in, out, outChannels, gains, steps, frames );
+		}
+	}
+
+	AVX2_TARGET void StereoToMonoAvx2( const float* in, float* out, int frames )
+	{
+		__m256 half = _mm256_set1_ps( 0.5f );
+		int n = 0;
+		for ( ; n + 8 <= frames; n += 8 )
+		{
+			__m256 l, r;
+			UnzipAvx( _mm256_loadu_ps( in + n * 2 ), _mm256_loadu_ps( in + n * 2 + 8 ), l, r );
+			_mm256_storeu_ps( out + n, _mm256_mul_ps( _mm256_add_ps( l, r ), half ) );
+		}
+		_mm256_zeroupper();
+		StereoToMonoSse2( in + n * 2, out + n, frames - n );
+	}
+
+	AVX2_TARGET void DownmixAvx2( const float* in, int inChannels, float* out, int outChannels, const float* matrix, int frames )
+	{
+		// Eight frames at a time, gathering each input channel with one instruction
+		__m256i stride = _mm256_mullo_epi32( _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ), _mm256_set1_epi32( inChannels ) );
+		int n = 0;
+		for ( ; n + 8 <= frames; n += 8 )
+		{
+			__m256 sums[MAX_DOWNMIX_CHANNELS];
+			for ( int o = 0; o < outChannels; o++ )
+			{
+				sums[o] = _mm256_setzero_ps();
+			}
+
+			const float* frame = in + n * inChannels;
+			for ( int i = 0; i < inChannels; i++ )
+			{
+				__m256 channel = _mm256_i32gather_ps( frame + i, stride, 4 );
+				for ( int o = 0; o < outChannels; o++ )
+				{
+					sums[o] = _mm256_add_ps( sums[o], _mm256_mul_ps( _mm256_set1_ps( matrix[o * inChannels + i] ), channel ) );
+				}
+			}
+
+			float* dest = out + n * outChannels;
+			if ( outChannels == 2 )
+			{
+				__m256 first, second;
+				ZipAvx( sums[0], sums[1], first, second );
+				_mm256_storeu_ps( dest, first );
+				_mm256_storeu_ps( dest + 8, second );
+			}
+			else
+			{
+				for ( int o = 0; o < outChannels; o++ )
+				{
+					alignas( 32 ) float values[8];
+					_mm256_store_ps( values, sums[o] );
+					for ( int j = 0; j < 8; j++ )
+					{
+						dest[j * outChannels + o] = values[j];
+					}
+				}
+			}
+		}
+		_mm256_zeroupper();
+		DownmixSse2( in + n * inChannels, inChannels, out + n * outChannels, outChannels, matrix, frames - n );
+	}
+}
+
+int SampleConvert::GetSampleSize( SampleFormat format )
+{
+	switch ( format )
+	{
+	case SAMPLE_PCM8:
+		return 1;
+	case SAMPLE_PCM16:
+		return 2;
+	case SAMPLE_PCM24:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+SimdLevel SampleConvert::GetSimdLevel()
+{
+	return simdLevel;
+}
+
+void SampleConvert::SetSimdLevel( SimdLevel level )
+{
+	simdLevel = level > GetBestSimdLevel() ? GetBestSimdLevel() : level;
+}
+
+void SampleConvert::ToFloat( const void* in, SampleFormat format, float* out, int count )
+{
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		ToFloatAvx2( in, format, out, count );
+		break;
+	case SIMD_SSE2:
+		ToFloatSse2( in, format, out, count );
+		break;
+	default:
+		ToFloatScalar( in, format, out, count );
+		break;
+	}
+}
+
+void SampleConvert::FromFloat( const float* in, void* out, SampleFormat format, int count )
+{
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		FromFloatAvx2( in, out, format, count );
+		break;
+	case SIMD_SSE2:
+		FromFloatSse2( in, out, format, count );
+		break;
+	default:
+		FromFloatScalar( in, out, format, count );
+		break;
+	}
+}
+
+void SampleConvert::Convert( const void* in, SampleFormat inFormat, void* out, SampleFormat outFormat, int count )
+{
+	if ( inFormat == outFormat )
+	{
+		memcpy( out, in, count * GetSampleSize( inFormat ) );
+		return;
+	}
+
+	// Through a small float buffer that stays in cache
+	const char* src = ( const char* ) in;
+	char* dest = ( char* ) out;
+	int inSize = GetSampleSize( inFormat );
+	int outSize = GetSampleSize( outFormat );
+	float buffer[CONVERT_CHUNK];
+	for ( int i = 0; i < count; i += CONVERT_CHUNK )
+	{
+		int chunk = Math::Min( count - i, CONVERT_CHUNK );
+		ToFloat( src + i * inSize, inFormat, buffer, chunk );
+		FromFloat( buffer, dest + i * outSize, outFormat, chunk );
+	}
+}
+
+void SampleConvert::Interleave( const float* const* planes, int numChannels, float* out, int frames )
+{
+	if ( numChannels == 1 )
+	{
+		memcpy( out, planes[0], frames * sizeof( float ) );
+	}
+	else if ( numChannels == 2 && simdLevel == SIMD_AVX2 )
+	{
+		InterleaveStereoAvx2( planes[0], planes[1], out, frames );
+	}
+	else if ( numChannels == 2 && simdLevel == SIMD_SSE2 )
+	{
+		InterleaveStereoSse2( planes[0], planes[1], out, frames );
+	}
+	else
+	{
+		InterleaveScalar( planes, numChannels, out, frames );
+	}
+}
+
+void SampleConvert::Deinterleave( const float* in, int numChannels, float* const* planes, int frames )
+{
+	if ( numChannels == 1 )
+	{
+		memcpy( planes[0], in, frames * sizeof( float ) );
+	}
+	else if ( numChannels == 2 && simdLevel == SIMD_AVX2 )
+	{
+		DeinterleaveStereoAvx2( in, planes[0], planes[1], frames );
+	}
+	else if ( numChannels == 2 && simdLevel == SIMD_SSE2 )
+	{
+		DeinterleaveStereoSse2( in, planes[0], planes[1], frames );
+	}
+	else
+	{
+		DeinterleaveScalar( in, numChannels, planes, frames );
+	}
+}
+
+void SampleConvert::AddInterleaved( const float* left, const float* right, float* out, int frames )
+{
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		AddInterleavedAvx2( left, right, out, frames );
+		break;
+	case SIMD_SSE2:
+		AddInterleavedSse2( left, right, out, frames );
+		break;
+	default:
+		AddInterleavedScalar( left, right, out, frames );
+		break;
+	}
+}
+
+void SampleConvert::AddInterleaved( const float* left, const float* right, float* out, int outChannels, int frames )
+{
+	if ( outChannels == 2 )
+	{
+		AddInterleaved( left, right, out, frames );
+	}
+	else if ( simdLevel != SIMD_SCALAR )
+	{
+		AddInterleavedSse2( left, right, out, outChannels, frames );
+	}
+	else
+	{
+		AddInterleavedScalar( left, right, out, outChannels, frames );
+	}
+}
+
+void SampleConvert::AddPanned( const float* in, float* out, int outChannels, const float* gains, const float* steps, int frames )
+{
+	DbgAssert( outChannels <= MAX_DOWNMIX_CHANNELS, "Too many channels to pan" );
+
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		AddPannedAvx2( in, out, outChannels, gains, steps, frames );
+		break;
+	case SIMD_SSE2:
+		AddPannedSse2( in, out, outChannels, gains, steps, frames );
+		break;
+	default:
+		AddPannedScalar( in, out, outChannels, gains, steps, frames );
+		break;
+	}
+}
+
+void SampleConvert::MonoToStereo( const float* in, float* out, int frames )
+{
+	// Interleaving a channel with itself
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		InterleaveStereoAvx2( in, in, out, frames );
+		break;
+	case SIMD_SSE2:
+		InterleaveStereoSse2( in, in, out, frames );
+		break;
+	default:
+		MonoToStereoScalar( in, out, frames );
+		break;
+	}
+}
+
+void SampleConvert::StereoToMono( const float* in, float* out, int frames )
+{
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		StereoToMonoAvx2( in, out, frames );
+		break;
+	case SIMD_SSE2:
+		StereoToMonoSse2( in, out, frames );
+		break;
+	default:
+		StereoToMonoScalar( in, out, frames );
+		break;
+	}
+}
+
+void SampleConvert::Downmix( const float* in, int inChannels, float* out, int outChannels, const float* matrix, int frames )
+{
+	DbgAssert( inChannels <= MAX_DOWNMIX_CHANNELS && outChannels <= MAX_DOWNMIX_CHANNELS, "Too many channels to downmix" );
+
+	switch ( simdLevel )
+	{
+	case SIMD_AVX2:
+		DownmixAvx2( in, inChannels, out, outChannels, matrix, frames );
+		break;
+	case SIMD_SSE2:
+		DownmixSse2( in, inChannels, out, outChannels, matrix, frames );
+		break;
+	default:
+		DownmixScalar( in, inChannels, out, outChannels, matrix, frames );
+		break;
+	}
+}
+
+bool SampleConvert::GetDownmixMatrix( int inChannels, int outChannels, float* matrix )
+{
+	if ( outChannels < 1 || outChannels > 2 )
+	{
+		return false;
+	}
+
+	// Left and right rows first. Centre and surrounds go in at -3dB (ITU-R BS.775)
+	const float minus3dB = 0.7071f;
+	float left[MAX_DOWNMIX_CHANNELS] = {};
+	float right[MAX_DOWNMIX_CHANNELS] = {};
+	switch ( inChannels )
+	{
+	case 1:
+		left[0] = 1.0f;
+		right[0] = 1.0f;
+		break;
+	case 2:
+		left[0] = 1.0f;
+		right[1] = 1.0f;
+		break;
+	case 6:
+	case 8:
+		// FL FR FC LFE BL BR, then SL SR for 7.1
+		left[0] = 1.0f;
+		right[1] = 1.0f;
+		left[2] = minus3dB;
+		right[2] = minus3dB;
+		for ( int c = 4; c < inChannels; c += 2 )
+		{
+			left[c] = minus3dB;
+			right[c + 1] = minus3dB;
+		}
+		break;
+	default:
+		return false;
+	}
+
+	for ( int i = 0; i < inChannels; i++ )
+	{
+		if ( outChannels == 2 )
+		{
+			matrix[i] = left[i];
+			matrix[inChannels + i] = right[i];
+		}
+		else
+		{
+			// Mono from stereo is the average, but mono stays as it is
+			matrix[i] = inChannels == 1 ? 1.0f : ( left[i] + right[i] ) * 0.5f;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,79 @@
+// SampleConvert.h
+// Conversions between the sample formats and channel layouts audio comes in,
+// shared by the sound loader and the mixer. Formats convert through float in
+// [-1, 1]. Every routine has SSE2 and AVX2 kernels, picked once at startup
+// from what the CPU supports, and a scalar version they're checked against
+// (see AudioRegression)
+
+#pragma once
+
+enum SampleFormat
+{
+	SAMPLE_PCM8,		// Unsigned, as stored in WAV files
+	SAMPLE_PCM16,
+	SAMPLE_PCM24,		// Packed, 3 bytes per sample
+	SAMPLE_PCM32,
+	SAMPLE_FLOAT32
+};
+
+enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2
+};
+
+// MSVC compiles AVX2 intrinsics anywhere; GCC and Clang need the
+// functions that use them marked
+#if defined( __GNUC__ )
+#define AVX2_TARGET __attribute__( ( target( "avx2" ) ) )
+#else
+#define AVX2_TARGET
+#endif
+
+// Most channels Downmix and GetDownmixMatrix handle (7.1)
+#define MAX_DOWNMIX_CHANNELS 8
+
+namespace SampleConvert
+{
+	// Bytes per sample
+	int GetSampleSize( SampleFormat format );
+
+	// Defaults to the best level the CPU supports. Setting a level the CPU
+	// doesn't support picks the best one it does. Lowering it is only useful
+	// for comparing the kernels against each other, as -audiotest does
+	SimdLevel GetSimdLevel();
+	void SetSimdLevel( SimdLevel level );
+
+	// count is in samples, not frames
+	void ToFloat( const void* in, SampleFormat format, float* out, int count );
+	// Clips to [-1, 1] and rounds to the nearest integer sample
+	void FromFloat( const float* in, void* out, SampleFormat format, int count );
+	void Convert( const void* in, SampleFormat inFormat, void* out, SampleFormat outFormat, int count );
+
+	// Between one buffer per channel and interleaved frames
+	void Interleave( const float* const* planes, int numChannels, float* out, int frames );
+	void Deinterleave( const float* in, int numChannels, float* const* planes, int frames );
+	// out[2n] += left[n], out[2n + 1] += right[n]
+	void AddInterleaved( const float* left, const float* right, float* out, int frames );
+	// Same, into the first two channels of out, which has outChannels
+	// interleaved channels
+	void AddInterleaved( const float* left, const float* right, float* out, int outChannels, int frames );
+	// Adds mono in to every channel of interleaved out, at a gain per channel
+	// that starts at gains[c] and moves by steps[c] every frame. Stereo and
+	// layouts a whole number of registers wide have SIMD kernels
+	void AddPanned( const float* in, float* out, int outChannels, const float* gains, const float* steps, int frames );
+
+	// Copies mono in to both channels of interleaved stereo out
+	void MonoToStereo( const float* in, float* out, int frames );
+	// Averages the channels of interleaved stereo in
+	void StereoToMono( const float* in, float* out, int frames );
+
+	// Interleaved in to interleaved out, where output channel o is the sum of
+	// matrix[o * inChannels + i] * input channel i
+	void Downmix( const float* in, int inChannels, float* out, int outChannels, const float* matrix, int frames );
+	// Fills matrix (outChannels * inChannels) with the standard mix from mono,
+	// stereo, 5.1 or 7.1 in WAV channel order, to mono or stereo. The LFE channel
+	// is dropped. Returns false for any other layout
+	bool GetDownmixMatrix( int inChannels, int outChannels, float* matrix );
+}
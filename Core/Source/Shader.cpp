@@ -74,14 +74,21 @@ void Shader::BindTexture(TexturePtr texture, int slot)
 
 bool Shader::Load( const char* fileName, class AssetCache* cache )
 {
-	bool successVertex = mGraphicsDriver.CompileShaderFromFile( fileName, "VS", "vs_4_0", mCompiledVS );
-	bool successPixel = mGraphicsDriver.CompileShaderFromFile( fileName, "PS", "ps_4_0", mCompiledPS );
+	bool successVertex = false;
+	bool successPixel = false;
+	{
+		LoadPhase phase( ELP_Parse );
+		successVertex = mGraphicsDriver.CompileShaderFromFile( fileName, "VS", "vs_4_0", mCompiledVS );
+		successPixel = mGraphicsDriver.CompileShaderFromFile( fileName, "PS", "ps_4_0", mCompiledPS );
+	}
 
 	if ( !successVertex || !successPixel )
 	{
 		return false;
 	}
 
+	LoadPhase phase( ELP_Upload );
+
 	mVertexShader = mGraphicsDriver.CreateVertexShader( mCompiledVS );
 	mPixelShader = mGraphicsDriver.CreatePixelShader( mCompiledPS );
 
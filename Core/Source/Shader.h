@@ -53,6 +53,8 @@ public:
 
 	const std::vector<char>& GetCompiledVS() const { return mCompiledVS; }
 	const std::vector<char>& GetCompiledPS() const { return mCompiledPS; }
+
+	size_t GetMemorySize() const override { return mCompiledVS.size() + mCompiledPS.size(); }
 protected:
 	bool Load(const char* fileName, class AssetCache* cache) override;
 private:
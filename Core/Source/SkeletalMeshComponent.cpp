@@ -52,13 +52,24 @@ void SkeletalMeshComponent::SetProperties(const rapidjson::Value& properties)
 {
 	Super::SetProperties(properties);
 
-	std::string skeleton;
+	const char* skeleton = nullptr;
 	if (GetStringFromJSON(properties, "skeleton", skeleton))
 	{
 		mSkeleton = mOwner.GetGame().GetAssetCache().Load<Skeleton>(skeleton);
 	}
 }
 
+void SkeletalMeshComponent::PreloadProperties(const rapidjson::Value& properties, LevelPreload& preload)
+{
+	Super::PreloadProperties(properties, preload);
+
+	const char* skeleton = nullptr;
+	if (GetStringFromJSON(properties, "skeleton", skeleton))
+	{
+		preload.Add<Skeleton>(skeleton);
+	}
+}
+
 void SkeletalMeshComponent::ComputeMatrixPalette()
 {
 	auto bindPoses = mSkeleton->GetGlobalInvBindPoses();
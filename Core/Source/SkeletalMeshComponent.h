@@ -19,6 +19,8 @@ public:
 	float PlayAnimation(AnimationPtr anim, float playRate = 1.0f, float blendTime = 0.0f);
 
 	void SetProperties(const rapidjson::Value& properties) override;
+	// Adds the assets properties refer to, so the level loads them before spawning
+	static void PreloadProperties(const rapidjson::Value& properties, class LevelPreload& preload);
 protected:
 	void ComputeMatrixPalette();
 
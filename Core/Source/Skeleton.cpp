@@ -9,133 +9,66 @@ Skeleton::Skeleton(class Game& game)
 
 bool Skeleton::Load(const char* fileName, class AssetCache* cache)
 {
-	std::ifstream file(fileName);
-	if (!file.is_open())
-	{
-		SDL_Log("File not found: Skeleton %s", fileName);
-		return false;
-	}
-
-	std::stringstream fileStream;
-	fileStream << file.rdbuf();
-	std::string contents = fileStream.str();
-	rapidjson::StringStream jsonStr(contents.c_str());
-	rapidjson::Document doc;
-	doc.ParseStream(jsonStr);
-
-	if (!doc.IsObject())
-	{
-		SDL_Log("Skeleton %s is not valid json", fileName);
-		return false;
-	}
-
-	std::string str = doc["metadata"]["type"].GetString();
-	int ver = doc["metadata"]["version"].GetInt();
+	LoadPhase phase(ELP_Parse);
 
-	// Check the metadata
-	if (!doc["metadata"].IsObject() ||
-		str != "itpskel" ||
-		ver != 1)
+	// Use the cooked skeleton if the asset cooker has made one, since it needs no parsing
+	std::string cookedName = GetCookedFileName(fileName);
+	if (!cookedName.empty())
 	{
-		SDL_Log("Skeleton %s unknown format", fileName);
-		return false;
+		if (LoadCooked(cookedName.c_str()))
+		{
+			return true;
+		}
+		SDL_Log("Skeleton %s: Cooked skeleton %s is invalid. Loading the source instead.", fileName, cookedName.c_str());
+		mBones.clear();
+		mGlobalInvBindPoses.clear();
 	}
 
-	const rapidjson::Value& bonecount = doc["bonecount"];
-	if (!bonecount.IsUint())
+	if (!SkeletonFormat::ReadJson(fileName, mBones))
 	{
-		SDL_Log("Skeleton %s doesn't have a bone count.", fileName);
 		return false;
 	}
 
-	size_t count = bonecount.GetUint();
-
-	DbgAssert(count <= MAX_SKELETON_BONES, "Skeleton exceeds maximum allowed bones.");
+	// Now that we have the bones
+	ComputeGlobalInvBindPose();
 
-	mBones.reserve(count);
+	return true;
+}
 
-	const rapidjson::Value& bones = doc["bones"];
-	if (!bones.IsArray())
+bool Skeleton::LoadCooked(const char* fileName)
+{
+	VirtualFile file;
+	if (!file.Open(fileName))
 	{
-		SDL_Log("Skeleton %s doesn't have a bone array?", fileName);
 		return false;
 	}
 
-	if (bones.Size() != count)
+	const SkeletonFormat::Header* header = SkeletonFormat::GetCookedHeader(file.GetData(), file.GetSize());
+	if (header == nullptr)
 	{
-		SDL_Log("Skeleton %s has a mismatch between the bone count and number of bones", fileName);
 		return false;
 	}
 
-	Bone temp;
-
-	for (rapidjson::SizeType i = 0; i < count; i++)
+	const char* data = static_cast<const char*>(file.GetData());
+	const SkeletonFormat::CookedBone* bones = reinterpret_cast<const SkeletonFormat::CookedBone*>(data + header->mBonesOffset);
+	const char* names = data + header->mNamesOffset;
+	mBones.resize(header->mNumBones);
+	for (uint32_t i = 0; i < header->mNumBones; i++)
 	{
-		if (!bones[i].IsObject())
-		{
-			SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
-			return false;
-		}
-
-		const rapidjson::Value& name = bones[i]["name"];
-		temp.mName = name.GetString();
-
-		const rapidjson::Value& parent = bones[i]["parent"];
-		temp.mParent = parent.GetInt();
-
-		const rapidjson::Value& bindpose = bones[i]["bindpose"];
-		if (!bindpose.IsObject())
-		{
-			SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
-			return false;
-		}
-
-		const rapidjson::Value& rot = bindpose["rot"];
-		const rapidjson::Value& trans = bindpose["trans"];
-
-		if (!rot.IsArray() || !trans.IsArray())
-		{
-			SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
-			return false;
-		}
-
-		temp.mLocalBindPose.mRotation.x = rot[0].GetDouble();
-		temp.mLocalBindPose.mRotation.y = rot[1].GetDouble();
-		temp.mLocalBindPose.mRotation.z = rot[2].GetDouble();
-		temp.mLocalBindPose.mRotation.w = rot[3].GetDouble();
-
-		temp.mLocalBindPose.mTranslation.x = trans[0].GetDouble();
-		temp.mLocalBindPose.mTranslation.y = trans[1].GetDouble();
-		temp.mLocalBindPose.mTranslation.z = trans[2].GetDouble();
-
-		mBones.emplace_back(temp);
+		const SkeletonFormat::CookedBone& cooked = bones[i];
+		Bone& bone = mBones[i];
+		bone.mLocalBindPose.mRotation = Quaternion(cooked.mRotation[0], cooked.mRotation[1], cooked.mRotation[2], cooked.mRotation[3]);
+		bone.mLocalBindPose.mTranslation = Vector3(cooked.mTranslation[0], cooked.mTranslation[1], cooked.mTranslation[2]);
+		bone.mName = names + cooked.mNameOffset;
+		bone.mParent = cooked.mParent;
 	}
 
-	// Now that we have the bones
-	ComputeGlobalInvBindPose();
-
+	const Matrix4* poses = reinterpret_cast<const Matrix4*>(data + header->mInvBindPosesOffset);
+	mGlobalInvBindPoses.assign(poses, poses + header->mNumBones);
 	return true;
 }
 
 void Skeleton::ComputeGlobalInvBindPose()
 {
-	// First pass: compute global bind pose matrix for every bone
-	// Second pass: invert every matrix
-	
-	for ( auto &b : mBones ) 
-	{
-		if ( b.mParent < 0 ) // first bone has no parent, -1
-		{
-			mGlobalInvBindPoses.push_back( Matrix4::Identity );
-		}
-		else
-		{
-			Matrix4 parent = mGlobalInvBindPoses[b.mParent];
-			mGlobalInvBindPoses.push_back( b.mLocalBindPose.ToMatrix() * parent ); 
-		}
-	}
-	for ( auto &j : mGlobalInvBindPoses ) 
-	{
-		j.Invert();
-	}
-}
\ No newline at end of file
+	SkeletonFormat::ComputeGlobalInvBindPoses(mBones, mGlobalInvBindPoses);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "Asset.h"
 #include "BoneTransform.h"
+#include "SkeletonFormat.h"
 #include <string>
 #include <vector>
 
@@ -8,25 +9,34 @@ class Skeleton : public Asset
 {
 	DECL_ASSET(Skeleton, Asset);
 public:
-	struct Bone
-	{
-		BoneTransform mLocalBindPose;
-		std::string mName;
-		int mParent;
-	};
+	typedef SkeletonFormat::Bone Bone;
+
 	Skeleton(class Game& game);
 
 	bool Load(const char* fileName, class AssetCache* cache) override;
+protected:
+	// Nothing goes on the GPU, so an asynchronous load does it all on the worker
+	bool LoadData(const char* fileName) override { return Load(fileName, nullptr); }
+	EFinalizeResult Finalize(const char* fileName, class AssetCache* cache) override { return EFR_Done; }
+public:
 
 	size_t GetNumBones() const { return mBones.size(); }
 	const Bone& GetBone(size_t idx) const { return mBones[idx]; }
 	const std::vector<Bone>& GetBones() const { return mBones; }
 
 	const std::vector<Matrix4>& GetGlobalInvBindPoses() const { return mGlobalInvBindPoses; }
+
+	size_t GetMemorySize() const override
+	{
+		return mBones.size() * sizeof(Bone) + mGlobalInvBindPoses.size() * sizeof(Matrix4);
+	}
 protected:
 	// Automatically called once the skeleton has been loaded
 	void ComputeGlobalInvBindPose();
 private:
+	// Reads the cooked skeleton, which has the inverse bind poses already
+	bool LoadCooked(const char* fileName);
+
 	std::vector<Bone> mBones;
 	std::vector<Matrix4> mGlobalInvBindPoses;
 };
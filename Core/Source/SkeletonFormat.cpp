@@ -0,0 +1,228 @@
+#include "ITPEnginePCH.h"
+#include <SDL/SDL_log.h>
+
+namespace SkeletonFormat
+{
+	bool ReadJson(const char* fileName, std::vector<Bone>& outBones)
+	{
+		JsonFile json;
+		if (!json.Load(fileName))
+		{
+			SDL_Log("File not found: Skeleton %s", fileName);
+			return false;
+		}
+		rapidjson::Document& doc = json.GetDocument();
+
+		if (!doc.IsObject())
+		{
+			SDL_Log("Skeleton %s is not valid json", fileName);
+			return false;
+		}
+
+		std::string str = doc["metadata"]["type"].GetString();
+		int ver = doc["metadata"]["version"].GetInt();
+
+		// Check the metadata
+		if (!doc["metadata"].IsObject() ||
+			str != "itpskel" ||
+			ver != 1)
+		{
+			SDL_Log("Skeleton %s unknown format", fileName);
+			return false;
+		}
+
+		const rapidjson::Value& bonecount = doc["bonecount"];
+		if (!bonecount.IsUint())
+		{
+			SDL_Log("Skeleton %s doesn't have a bone count.", fileName);
+			return false;
+		}
+
+		size_t count = bonecount.GetUint();
+
+		DbgAssert(count <= MAX_SKELETON_BONES, "Skeleton exceeds maximum allowed bones.");
+
+		outBones.reserve(count);
+
+		const rapidjson::Value& bones = doc["bones"];
+		if (!bones.IsArray())
+		{
+			SDL_Log("Skeleton %s doesn't have a bone array?", fileName);
+			return false;
+		}
+
+		if (bones.Size() != count)
+		{
+			SDL_Log("Skeleton %s has a mismatch between the bone count and number of bones", fileName);
+			return false;
+		}
+
+		Bone temp;
+
+		for (rapidjson::SizeType i = 0; i < count; i++)
+		{
+			if (!bones[i].IsObject())
+			{
+				SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
+				return false;
+			}
+
+			const rapidjson::Value& name = bones[i]["name"];
+			temp.mName = name.GetString();
+
+			const rapidjson::Value& parent = bones[i]["parent"];
+			temp.mParent = parent.GetInt();
+
+			const rapidjson::Value& bindpose = bones[i]["bindpose"];
+			if (!bindpose.IsObject())
+			{
+				SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
+				return false;
+			}
+
+			const rapidjson::Value& rot = bindpose["rot"];
+			const rapidjson::Value& trans = bindpose["trans"];
+
+			if (!rot.IsArray() || !trans.IsArray())
+			{
+				SDL_Log("Skeleton %s: Bone %d is invalid.", fileName, i);
+				return false;
+			}
+
+			temp.mLocalBindPose.mRotation.x = rot[0].GetDouble();
+			temp.mLocalBindPose.mRotation.y = rot[1].GetDouble();
+			temp.mLocalBindPose.mRotation.z = rot[2].GetDouble();
+			temp.mLocalBindPose.mRotation.w = rot[3].GetDouble();
+
+			temp.mLocalBindPose.mTranslation.x = trans[0].GetDouble();
+			temp.mLocalBindPose.mTranslation.y = trans[1].GetDouble();
+			temp.mLocalBindPose.mTranslation.z = trans[2].GetDouble();
+
+			outBones.emplace_back(temp);
+		}
+
+		return true;
+	}
+
+	void ComputeGlobalInvBindPoses(const std::vector<Bone>& bones, std::vector<Matrix4>& outPoses)
+	{
+		// First pass: compute global bind pose matrix for every bone
+		// Second pass: invert every matrix
+		outPoses.clear();
+		outPoses.reserve(bones.size());
+		for ( auto &b : bones )
+		{
+			if ( b.mParent < 0 ) // first bone has no parent, -1
+			{
+				outPoses.push_back( Matrix4::Identity );
+			}
+			else
+			{
+				Matrix4 parent = outPoses[b.mParent];
+				outPoses.push_back( b.mLocalBindPose.ToMatrix() * parent );
+			}
+		}
+		for ( auto &j : outPoses )
+		{
+			j.Invert();
+		}
+	}
+
+	bool WriteCooked(const char* fileName, const std::vector<Bone>& bones, const std::vector<Matrix4>& invBindPoses)
+	{
+		std::ofstream file(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SDL_Log("Couldn't write cooked skeleton %s", fileName);
+			return false;
+		}
+
+		std::vector<CookedBone> cookedBones(bones.size());
+		size_t namesSize = 0;
+		for (size_t i = 0; i < bones.size(); i++)
+		{
+			const BoneTransform& pose = bones[i].mLocalBindPose;
+			CookedBone& cooked = cookedBones[i];
+			cooked.mRotation[0] = pose.mRotation.x;
+			cooked.mRotation[1] = pose.mRotation.y;
+			cooked.mRotation[2] = pose.mRotation.z;
+			cooked.mRotation[3] = pose.mRotation.w;
+			cooked.mTranslation[0] = pose.mTranslation.x;
+			cooked.mTranslation[1] = pose.mTranslation.y;
+			cooked.mTranslation[2] = pose.mTranslation.z;
+			cooked.mParent = bones[i].mParent;
+			cooked.mNameOffset = static_cast<uint32_t>(namesSize);
+			namesSize += bones[i].mName.size() + 1;
+		}
+
+		Header header;
+		memset(&header, 0, sizeof(header));
+		header.mMagic = COOKED_MAGIC;
+		header.mVersion = COOKED_VERSION;
+		header.mNumBones = static_cast<uint32_t>(bones.size());
+		header.mBonesOffset = sizeof(Header);
+		header.mInvBindPosesOffset = static_cast<uint32_t>(header.mBonesOffset + bones.size() * sizeof(CookedBone));
+		header.mNamesOffset = static_cast<uint32_t>(header.mInvBindPosesOffset + bones.size() * sizeof(Matrix4));
+		header.mNamesSize = static_cast<uint32_t>(namesSize);
+		header.mFileSize = static_cast<uint32_t>(header.mNamesOffset + namesSize);
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(cookedBones.data()), cookedBones.size() * sizeof(CookedBone));
+		file.write(reinterpret_cast<const char*>(invBindPoses.data()), invBindPoses.size() * sizeof(Matrix4));
+		for (auto& bone : bones)
+		{
+			file.write(bone.mName.c_str(), bone.mName.size() + 1);
+		}
+
+		if (file.fail())
+		{
+			SDL_Log("Couldn't write cooked skeleton %s", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	const Header* GetCookedHeader(const void* data, size_t size)
+	{
+		if (size < sizeof(Header))
+		{
+			return nullptr;
+		}
+
+		const Header* header = static_cast<const Header*>(data);
+		if (header->mMagic != COOKED_MAGIC || header->mVersion != COOKED_VERSION ||
+			header->mFileSize != size || header->mNumBones > MAX_SKELETON_BONES)
+		{
+			return nullptr;
+		}
+
+		// Every block has to fit in the file, in order
+		uint64_t bonesEnd = header->mBonesOffset + static_cast<uint64_t>(header->mNumBones) * sizeof(CookedBone);
+		uint64_t posesEnd = header->mInvBindPosesOffset + static_cast<uint64_t>(header->mNumBones) * sizeof(Matrix4);
+		uint64_t namesEnd = header->mNamesOffset + static_cast<uint64_t>(header->mNamesSize);
+		if (header->mBonesOffset < sizeof(Header) || bonesEnd > header->mInvBindPosesOffset ||
+			posesEnd > header->mNamesOffset || namesEnd > size ||
+			header->mBonesOffset % sizeof(float) != 0 || header->mInvBindPosesOffset % sizeof(float) != 0)
+		{
+			return nullptr;
+		}
+
+		// Every name has to start inside the names and the last one has to be
+		// terminated, or reading them would run off the end. Parents have to
+		// come before their children
+		const CookedBone* bones = reinterpret_cast<const CookedBone*>(static_cast<const char*>(data) + header->mBonesOffset);
+		const char* names = static_cast<const char*>(data) + header->mNamesOffset;
+		if (header->mNumBones > 0 && (header->mNamesSize == 0 || names[header->mNamesSize - 1] != '\0'))
+		{
+			return nullptr;
+		}
+		for (uint32_t i = 0; i < header->mNumBones; i++)
+		{
+			if (bones[i].mNameOffset >= header->mNamesSize || bones[i].mParent >= static_cast<int32_t>(i))
+			{
+				return nullptr;
+			}
+		}
+		return header;
+	}
+}
@@ -0,0 +1,65 @@
+// SkeletonFormat.h
+// Reads .itpskel JSON skeletons, and the cooked binary version of them
+// that the asset cooker writes out next to them (with ".cooked" on the
+// end of the name). A cooked skeleton has its global inverse bind poses
+// worked out already, and is laid out as:
+//   Header
+//   CookedBone[mNumBones]
+//   Matrix4 global inverse bind poses[mNumBones]
+//   bone names, each null terminated, mNamesSize bytes in all
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BoneTransform.h"
+
+namespace SkeletonFormat
+{
+	// "ITPS"
+	const uint32_t COOKED_MAGIC = 0x53505449;
+	// Bump this whenever the layout changes, so old cooked files get ignored
+	const uint32_t COOKED_VERSION = 1;
+
+	struct Header
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		uint32_t mNumBones;
+		// Offsets are in bytes from the start of the file
+		uint32_t mBonesOffset;
+		uint32_t mInvBindPosesOffset;
+		uint32_t mNamesOffset;
+		uint32_t mNamesSize;
+		uint32_t mFileSize;
+	};
+
+	struct CookedBone
+	{
+		float mRotation[4];
+		float mTranslation[3];
+		int32_t mParent;
+		// From the start of the names
+		uint32_t mNameOffset;
+	};
+
+	struct Bone
+	{
+		BoneTransform mLocalBindPose;
+		std::string mName;
+		int mParent;
+	};
+
+	// Parses an .itpskel file, logging why if it can't
+	bool ReadJson(const char* fileName, std::vector<Bone>& outBones);
+
+	// Works out each bone's global inverse bind pose from the local bind
+	// poses. Every bone's parent has to come before it
+	void ComputeGlobalInvBindPoses(const std::vector<Bone>& bones, std::vector<Matrix4>& outPoses);
+
+	bool WriteCooked(const char* fileName, const std::vector<Bone>& bones, const std::vector<Matrix4>& invBindPoses);
+
+	// Returns the header of the cooked skeleton in data, or null if it's not
+	// one, is from a different version, or is cut short
+	const Header* GetCookedHeader(const void* data, size_t size);
+}
@@ -1,41 +1,480 @@
 #include "ITPEnginePCH.h"
 #include <iostream>
-#include <fstream>
+#include <fstream>
+
+Sound::Sound()
+	: samplingRate( 0 ), numChannels( 0 ), bitsPerSample( 0 ), data( 0 ), length( 0 ), count( 0 )
+	, storage( STORAGE_RESIDENT ), storageHint( STORAGE_AUTO ), dataOffset( 0 ), fileFormat( SAMPLE_PCM16 ), fileChannels( 0 )
+	, fileTrimmedHead( 0 ), trimmedHead( 0 ), trimmedTail( 0 ), peak( 0.0f ), rms( 0.0f ), loopStart( 0 ), loopEnd( 0 ), state( SOUND_PENDING )
+{
+}
 
 Sound::Sound( const char* path )
+	: Sound()
 {
-	// Open stream for binary input file
-	std::ifstream file;
-	file.open( path, std::ios::in | std::ios::binary );
+	this->path = path;
+	bool loaded = Load( path );
+	DbgAssert( loaded, "Path to Audio file is not valid" );
+	SetState( loaded ? SOUND_READY : SOUND_FAILED );
+}
 
-	if ( !file )
+bool Sound::Load( const char* path, bool useCooked )
+{
+	// Evicted sounds are loaded again over what's left of them
+	delete[] data;
+	data = 0;
+	std::vector<unsigned char>().swap( compressed );
+	storage = STORAGE_RESIDENT;
+
+	bool cooked = false;
+	std::string cookedPath = useCooked ? Asset::GetCookedFileName( path ) : std::string();
+	if ( !cookedPath.empty() )
 	{
-		std::cout << "FAILED TO PARSE AUDIO FILE" << std::endl;
+		if ( LoadFile( cookedPath.c_str(), cooked ) && cooked )
+		{
+			filePath = cookedPath;
+			fileTrimmedHead = 0;
+			return true;
+		}
+		std::cout << "IGNORING COOKED AUDIO FILE " << cookedPath << std::endl;
+		delete[] data;
+		data = 0;
 	}
-	DbgAssert( !file.fail(), "Path to Audio file is not valid" );
 
-	// Read number of channels and sampling rate at offset 22 and 24 respectively
-	file.seekg( 22 );
-	file.read( ( char* ) &numChannels, 2 );
-	file.read( ( char* ) &samplingRate, 4 );
+	if ( !LoadFile( path, cooked ) )
+	{
+		return false;
+	}
+	filePath = path;
+	fileTrimmedHead = trimmedHead;
+	return true;
+}
+
+bool Sound::LoadFile( const char* path, bool& cooked )
+{
+	cooked = false;
+
+	VirtualFile file;
+	const char* bytes = file.Open( path ) ? ( const char* ) file.GetData() : 0;
+	size_t fileSize = file.GetSize();
+	if ( !bytes || fileSize < 12 || memcmp( bytes, "RIFF", 4 ) != 0 || memcmp( bytes + 8, "WAVE", 4 ) != 0 )
+	{
+		std::cout << "FAILED TO PARSE AUDIO FILE " << path << std::endl;
+		return false;
+	}
+
+	// Walk the chunks for the format and the samples, skipping anything
+	// else (LIST, id3, ...) wherever it appears
+	U16 formatTag = 0;
+	U32 dataSize = 0;
+	const char* raw = 0;
+	size_t position = 12;
+	while ( !raw && fileSize - position >= 8 )
+	{
+		const char* id = bytes + position;
+		U32 size = 0;
+		memcpy( &size, bytes + position + 4, 4 );
+		position += 8;
+		if ( size > fileSize - position )
+		{
+			break;
+		}
 
-	// Read bits per sample at offset 34
-	file.seekg( 34 );
-	file.read( ( char* ) &bitsPerSample, 2 );
+		const char* chunk = bytes + position;
+		if ( memcmp( id, "fmt ", 4 ) == 0 )
+		{
+			char format[40] = {};
+			memcpy( format, chunk, Math::Min( size, ( U32 ) sizeof( format ) ) );
+			memcpy( &formatTag, format, 2 );
+			memcpy( &numChannels, format + 2, 2 );
+			memcpy( &samplingRate, format + 4, 4 );
+			memcpy( &bitsPerSample, format + 14, 2 );
 
-	// Read data chunk size at offset 40
-	file.seekg( 40 );
-	file.read( ( char* ) &length, 4 );
+			// WAVE_FORMAT_EXTENSIBLE keeps the real format tag in its sub format GUID
+			if ( formatTag == 0xFFFE && size >= 26 )
+			{
+				memcpy( &formatTag, format + 24, 2 );
+			}
+		}
+		else if ( memcmp( id, "data", 4 ) == 0 )
+		{
+			dataSize = size;
+			dataOffset = ( U32 ) position;
+			raw = chunk;
+		}
+		else if ( memcmp( id, "itpa", 4 ) == 0 )
+		{
+			cooked = ReadCookedAnalysis( chunk, size );
+		}
+
+		// Chunks are padded to an even length, though the last one's padding
+		// is sometimes missing
+		position = Math::Min( position + size + ( size & 1 ), fileSize );
+	}
+
+	// PCM (1) or IEEE float (3)
+	bool foundData = raw != 0;
+	SampleFormat format;
+	if ( formatTag == 1 && bitsPerSample == 8 )
+		format = SAMPLE_PCM8;
+	else if ( formatTag == 1 && bitsPerSample == 16 )
+		format = SAMPLE_PCM16;
+	else if ( formatTag == 1 && bitsPerSample == 24 )
+		format = SAMPLE_PCM24;
+	else if ( formatTag == 1 && bitsPerSample == 32 )
+		format = SAMPLE_PCM32;
+	else if ( formatTag == 3 && bitsPerSample == 32 )
+		format = SAMPLE_FLOAT32;
+	else
+		foundData = false;
+
+	if ( !foundData || numChannels == 0 )
+	{
+		std::cout << "FAILED TO PARSE AUDIO FILE " << path << std::endl;
+		return false;
+	}
+
+	float matrix[2 * MAX_DOWNMIX_CHANNELS];
+	if ( numChannels > 2 && !SampleConvert::GetDownmixMatrix( numChannels, 2, matrix ) )
+	{
+		std::cout << "UNSUPPORTED CHANNEL LAYOUT IN AUDIO FILE " << path << std::endl;
+		return false;
+	}
+
+	fileFormat = format;
+	fileChannels = numChannels;
+	numChannels = Math::Min( numChannels, ( U16 ) 2 );
 
 	// Allocate array to hold all the data as PCM samples
-	count = length / 2;
+	U32 frames = dataSize / ( SampleConvert::GetSampleSize( format ) * fileChannels );
+	count = frames * numChannels;
 	data = new PCM16[count];
+	DecodeFrames( raw, frames, data );
+
+	bitsPerSample = 16;
+	length = count * sizeof( PCM16 );
+
+	// A cooked sound is trimmed already, so its analysis just has to match it
+	cooked = cooked && format == SAMPLE_PCM16 && fileChannels <= 2 &&
+		tailPeaks.size() == ( frames + TAIL_PEAK_FRAMES - 1 ) / TAIL_PEAK_FRAMES &&
+		loopStart <= loopEnd && loopEnd <= GetAuthoredFrames();
+	if ( !cooked )
+	{
+		Analyze();
+	}
+	return true;
+}
+
+bool Sound::ReadCookedAnalysis( const char* chunk, U32 size )
+{
+	U32 version = 0;
+	U32 numTailPeaks = 0;
+	if ( size < 8 * sizeof( U32 ) )
+	{
+		return false;
+	}
+	memcpy( &version, chunk, sizeof( version ) );
+	memcpy( &trimmedHead, chunk + 4, sizeof( trimmedHead ) );
+	memcpy( &trimmedTail, chunk + 8, sizeof( trimmedTail ) );
+	memcpy( &peak, chunk + 12, sizeof( peak ) );
+	memcpy( &rms, chunk + 16, sizeof( rms ) );
+	memcpy( &loopStart, chunk + 20, sizeof( loopStart ) );
+	memcpy( &loopEnd, chunk + 24, sizeof( loopEnd ) );
+	memcpy( &numTailPeaks, chunk + 28, sizeof( numTailPeaks ) );
+	if ( version != SOUND_COOKED_VERSION || numTailPeaks > ( size - 8 * sizeof( U32 ) ) / sizeof( float ) )
+	{
+		return false;
+	}
+
+	tailPeaks.resize( numTailPeaks );
+	memcpy( tailPeaks.data(), chunk + 8 * sizeof( U32 ), numTailPeaks * sizeof( float ) );
+	return true;
+}
+
+bool Sound::WriteCooked( const char* cookedPath ) const
+{
+	if ( !data )
+	{
+		return false;
+	}
+
+	std::ofstream file( cookedPath, std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( !file.is_open() )
+	{
+		std::cout << "FAILED TO WRITE COOKED AUDIO FILE " << cookedPath << std::endl;
+		return false;
+	}
+
+	U16 formatTag = 1;
+	U16 bits = 16;
+	U16 blockAlign = numChannels * sizeof( PCM16 );
+	U32 bytesPerSecond = samplingRate * blockAlign;
+	U32 fmtSize = 16;
+	U32 analysisSize = 8 * sizeof( U32 ) + ( U32 ) ( tailPeaks.size() * sizeof( float ) );
+	U32 dataSize = count * sizeof( PCM16 );
+	U32 riffSize = 4 + ( 8 + fmtSize ) + ( 8 + analysisSize ) + ( 8 + dataSize + ( dataSize & 1 ) );
+
+	file.write( "RIFF", 4 );
+	file.write( ( const char* ) &riffSize, 4 );
+	file.write( "WAVE", 4 );
+
+	file.write( "fmt ", 4 );
+	file.write( ( const char* ) &fmtSize, 4 );
+	file.write( ( const char* ) &formatTag, 2 );
+	file.write( ( const char* ) &numChannels, 2 );
+	file.write( ( const char* ) &samplingRate, 4 );
+	file.write( ( const char* ) &bytesPerSecond, 4 );
+	file.write( ( const char* ) &blockAlign, 2 );
+	file.write( ( const char* ) &bits, 2 );
 
-	// All data after past offset 44 is audio data, read into data variable
-	file.read( ( char* ) data, length );
+	// Before the samples, so it's been read by the time they're decoded
+	U32 version = SOUND_COOKED_VERSION;
+	U32 numTailPeaks = ( U32 ) tailPeaks.size();
+	file.write( "itpa", 4 );
+	file.write( ( const char* ) &analysisSize, 4 );
+	file.write( ( const char* ) &version, sizeof( version ) );
+	file.write( ( const char* ) &trimmedHead, sizeof( trimmedHead ) );
+	file.write( ( const char* ) &trimmedTail, sizeof( trimmedTail ) );
+	file.write( ( const char* ) &peak, sizeof( peak ) );
+	file.write( ( const char* ) &rms, sizeof( rms ) );
+	file.write( ( const char* ) &loopStart, sizeof( loopStart ) );
+	file.write( ( const char* ) &loopEnd, sizeof( loopEnd ) );
+	file.write( ( const char* ) &numTailPeaks, sizeof( numTailPeaks ) );
+	file.write( ( const char* ) tailPeaks.data(), numTailPeaks * sizeof( float ) );
+
+	file.write( "data", 4 );
+	file.write( ( const char* ) &dataSize, 4 );
+	file.write( ( const char* ) data, dataSize );
+	if ( dataSize & 1 )
+	{
+		file.put( 0 );
+	}
+
+	if ( file.fail() )
+	{
+		std::cout << "FAILED TO WRITE COOKED AUDIO FILE " << cookedPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Sound::SetStorage( SoundStorage newStorage )
+{
+	storage = newStorage;
+	if ( storage == STORAGE_COMPRESSED )
+	{
+		U32 frames = GetNumFrames();
+		compressed.resize( ImaAdpcm::GetNumBlocks( frames ) * ImaAdpcm::GetBlockSize( numChannels ) );
+		ImaAdpcm::Encode( data, numChannels, frames, compressed.data() );
+	}
+	if ( storage != STORAGE_RESIDENT )
+	{
+		delete[] data;
+		data = 0;
+	}
+}
+
+void Sound::Evict()
+{
+	delete[] data;
+	data = 0;
+	std::vector<unsigned char>().swap( compressed );
+	SetState( SOUND_EVICTED );
+}
+
+size_t Sound::GetMemorySize() const
+{
+	return ( data ? count * sizeof( PCM16 ) : 0 ) + compressed.size();
+}
+
+bool Sound::ReadFrames( const VirtualFile& file, U32 first, U32 frames, PCM16* out ) const
+{
+	size_t frameSize = SampleConvert::GetSampleSize( fileFormat ) * fileChannels;
+	size_t begin = dataOffset + ( size_t ) ( fileTrimmedHead + first ) * frameSize;
+	if ( begin > file.GetSize() || frames * frameSize > file.GetSize() - begin )
+	{
+		return false;
+	}
+
+	DecodeFrames( ( const char* ) file.GetData() + begin, frames, out );
+	return true;
+}
+
+void Sound::DecodeFrames( const char* raw, U32 frames, PCM16* out ) const
+{
+	if ( fileChannels <= 2 )
+	{
+		SampleConvert::Convert( raw, fileFormat, out, SAMPLE_PCM16, frames * fileChannels );
+		return;
+	}
+
+	// Surround files are folded down to stereo a piece at a time
+	float matrix[2 * MAX_DOWNMIX_CHANNELS];
+	SampleConvert::GetDownmixMatrix( fileChannels, 2, matrix );
+
+	const U32 chunkFrames = 256;
+	float in[chunkFrames * MAX_DOWNMIX_CHANNELS];
+	float mixed[chunkFrames * 2];
+	int inFrameSize = SampleConvert::GetSampleSize( fileFormat ) * fileChannels;
+	for ( U32 n = 0; n < frames; n += chunkFrames )
+	{
+		int chunk = ( int ) Math::Min( frames - n, chunkFrames );
+		SampleConvert::ToFloat( raw + n * inFrameSize, fileFormat, in, chunk * fileChannels );
+		SampleConvert::Downmix( in, fileChannels, mixed, 2, matrix, chunk );
+		SampleConvert::FromFloat( mixed, out + n * 2, SAMPLE_PCM16, chunk * 2 );
+	}
+}
+
+float Sound::GetTailPeak( U32 frame ) const
+{
+	U32 block = frame / TAIL_PEAK_FRAMES;
+	return block < tailPeaks.size() ? tailPeaks[block] : 0.0f;
+}
+
+void Sound::Analyze()
+{
+	Trim();
+
+	U32 frames = count / numChannels;
+	double sumSquares = 0.0;
+	int loudest = 0;
+
+	// Peak of every block, then a running max from the end back to the start
+	tailPeaks.assign( ( frames + TAIL_PEAK_FRAMES - 1 ) / TAIL_PEAK_FRAMES, 0.0f );
+	for ( U32 block = 0; block < tailPeaks.size(); block++ )
+	{
+		U32 begin = block * TAIL_PEAK_FRAMES * numChannels;
+		U32 end = Math::Min( begin + TAIL_PEAK_FRAMES * numChannels, count );
+		int blockPeak = 0;
+		for ( U32 i = begin; i < end; i++ )
+		{
+			int sample = data[i];
+			blockPeak = Math::Max( blockPeak, sample < 0 ? -sample : sample );
+			sumSquares += ( double ) sample * sample;
+		}
+		tailPeaks[block] = blockPeak / 32768.0f;
+		loudest = Math::Max( loudest, blockPeak );
+	}
+	for ( int block = ( int ) tailPeaks.size() - 2; block >= 0; block-- )
+	{
+		tailPeaks[block] = Math::Max( tailPeaks[block], tailPeaks[block + 1] );
+	}
+
+	peak = loudest / 32768.0f;
+	rms = count > 0 ? ( float ) ( sqrt( sumSquares / count ) / 32768.0 ) : 0.0f;
+
+	FindLoopPoints();
+}
+
+void Sound::Trim()
+{
+	U32 frames = count / numChannels;
+	U32 first = 0;
+	while ( first < frames && IsSilent( first ) )
+	{
+		first++;
+	}
+	U32 last = frames;
+	while ( last > first && IsSilent( last - 1 ) )
+	{
+		last--;
+	}
+
+	trimmedHead = first;
+	trimmedTail = frames - last;
+	if ( first == 0 && last == frames )
+	{
+		return;
+	}
+
+	// Copy into an array of the new size so the memory is actually freed
+	count = ( last - first ) * numChannels;
+	PCM16* trimmed = new PCM16[count];
+	memcpy( trimmed, data + first * numChannels, count * sizeof( PCM16 ) );
+	delete[] data;
+	data = trimmed;
+	length = count * sizeof( PCM16 );
+}
+
+void Sound::FindLoopPoints()
+{
+	// The whole file loops, so the loop keeps its length and whatever
+	// silence was at either end. An end that was trimmed is silent already
+	U32 frames = GetNumFrames();
+	loopStart = 0;
+	loopEnd = GetAuthoredFrames();
+
+	// Only nudge an end by a frame or two, which can't be heard in the timing
+	U32 start = 0;
+	if ( trimmedHead == 0 )
+	{
+		U32 searchEnd = Math::Min( ( U32 ) LOOP_SNAP_FRAMES + 1, frames );
+		U32 crossing = FindZeroCrossing( 0, searchEnd, 0 );
+		start = crossing < searchEnd ? crossing : 0;
+		loopStart = start;
+	}
+
+	// The end should look like the start, so playback carries on from the
+	// start as if it had never jumped
+	if ( trimmedTail == 0 )
+	{
+		U32 searchBegin = frames > LOOP_SNAP_FRAMES ? frames - LOOP_SNAP_FRAMES : 0;
+		U32 crossing = FindZeroCrossing( Math::Max( searchBegin, start + 1 ), frames, start );
+		if ( crossing < frames )
+		{
+			loopEnd = trimmedHead + crossing;
+		}
+	}
+}
+
+U32 Sound::FindZeroCrossing( U32 begin, U32 end, U32 match ) const
+{
+	// Without a frame to match, compare against silence
+	const PCM16* target = match > 0 ? data + match * numChannels : 0;
+	const PCM16* targetPrevious = target ? target - numChannels : 0;
+	U32 channels = Math::Min( numChannels, ( U16 ) 2 );
+
+	U32 best = end;
+	int bestScore = 0;
+	for ( U32 n = Math::Max( begin, 1u ); n < end; n++ )
+	{
+		const PCM16* frame = data + n * numChannels;
+		const PCM16* previous = frame - numChannels;
+		if ( previous[0] < 0 && frame[0] >= 0 )
+		{
+			// Both the frame and the one before it, in both channels
+			int score = 0;
+			for ( U32 c = 0; c < channels; c++ )
+			{
+				int want = target ? target[c] : 0;
+				int wantPrevious = target ? targetPrevious[c] : 0;
+				score += abs( frame[c] - want ) + abs( previous[c] - wantPrevious );
+			}
+			if ( best == end || score < bestScore )
+			{
+				best = n;
+				bestScore = score;
+			}
+		}
+	}
+	return best;
+}
+
+bool Sound::IsSilent( U32 frame ) const
+{
+	const int threshold = ( int ) ( SOUND_SILENCE_THRESHOLD * 32768.0f );
+	const PCM16* samples = data + frame * numChannels;
+	for ( U32 c = 0; c < numChannels; c++ )
+	{
+		if ( samples[c] > threshold || samples[c] < -threshold )
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
-Sound::~Sound() 
+Sound::~Sound()
 {
 	delete[] data;
 }
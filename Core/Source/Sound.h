@@ -1,19 +1,156 @@
 #pragma once
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ObjectMacros.h"
+#include "SampleConvert.h"
 
 // Set some aliases for common audio formats
 typedef signed short PCM16;
 typedef unsigned int U32;
 typedef unsigned short U16;
+typedef unsigned long long U64;
+
+// Samples quieter than this (about -66dB) count as silence, both when
+// trimming sounds and when the mixer decides a voice can't be heard
+#define SOUND_SILENCE_THRESHOLD ( 1.0f / 2048.0f )
+// Frames covered by each entry of Sound::tailPeaks
+#define TAIL_PEAK_FRAMES 1024
+// Furthest a loop point is moved from the end of the sound to put it on a zero crossing
+#define LOOP_SNAP_FRAMES 2
+// Bump this whenever the cooked analysis changes, so old cooked sounds get analyzed again
+#define SOUND_COOKED_VERSION 2
+
+// Load state of a Sound. Written by the loader thread,
+// read by the game and mixer threads
+enum SoundState
+{
+	SOUND_PENDING,
+	SOUND_READY,
+	SOUND_FAILED,
+	// Unloaded to stay within the memory budget. Playing it loads it again
+	SOUND_EVICTED
+};
+
+// How a sound's samples are kept once loaded
+enum SoundStorage
+{
+	// Let the AudioMemoryManager decide from size and use
+	STORAGE_AUTO,
+	// Decoded 16 bit samples in data
+	STORAGE_RESIDENT,
+	// IMA ADPCM blocks in compressed, decoded a block at a time as it plays
+	STORAGE_COMPRESSED,
+	// Nothing kept; every voice reads the file through a SoundStream
+	STORAGE_STREAMED
+};
 
 class Sound
 {
 public:
+	// Creates an empty, pending sound to be filled in by Load
+	Sound();
+	// Loads the file at path immediately on the calling thread
 	Sound(const char* path);
 	~Sound();
+
+	// Reads the WAV file at path into data. Returns false on failure.
+	// Doesn't touch the state, so the caller decides when to publish it.
+	// If the asset cooker has cooked path, that's read instead unless
+	// useCooked is false
+	bool Load( const char* path, bool useCooked = true );
+	// Writes the loaded sound out as a cooked WAV: 16 bit, at most stereo
+	// and trimmed, with the analysis in an extra chunk so loading it doesn't
+	// have to convert or analyze anything. data has to still be resident
+	bool WriteCooked( const char* cookedPath ) const;
+
+	// Converts freshly loaded data to the given storage. Call before publishing
+	// the state, since it frees data for anything but STORAGE_RESIDENT
+	void SetStorage( SoundStorage newStorage );
+	// Frees the samples but keeps the analysis, and marks the sound SOUND_EVICTED.
+	// Nothing may be playing it
+	void Evict();
+	// Bytes held for samples, in whatever storage
+	size_t GetMemorySize() const;
+	U32 GetNumFrames() const { return numChannels > 0 ? count / numChannels : 0; }
+	// Length of the file as it was authored, counting the trimmed silence
+	U32 GetAuthoredFrames() const { return trimmedHead + GetNumFrames() + trimmedTail; }
+
+	// Reads frames frames starting at frame first (after trimming) from file,
+	// which must be open on filePath, converted the same way Load converts.
+	// Used to stream sounds that aren't resident
+	bool ReadFrames( const class VirtualFile& file, U32 first, U32 frames, PCM16* out ) const;
+
+	SoundState GetState() const { return ( SoundState ) state.load( std::memory_order_acquire ); }
+	void SetState( SoundState newState ) { state.store( newState, std::memory_order_release ); }
+	bool IsReady() const { return GetState() == SOUND_READY; }
+
+	// Loudest sample anywhere from frame to the end, in [0, 1]. Conservative:
+	// it may include a little audio before frame, never less than what's after
+	float GetTailPeak( U32 frame ) const;
+
 	U32 samplingRate;
 	U16 numChannels;
 	U16 bitsPerSample;
+	// Always 16 bit and at most stereo. Other formats are converted when loaded.
+	// Only kept for STORAGE_RESIDENT, but count is the number of samples regardless
 	PCM16* data;
 	U32 length;
 	U32 count;
-};
\ No newline at end of file
+	std::string path;
+
+	SoundStorage storage;
+	// Storage asked for when the sound was loaded, used again if it's reloaded
+	SoundStorage storageHint;
+	std::vector<unsigned char> compressed;
+
+	// Where the samples are in the file, for streaming. filePath is path,
+	// or its cooked version if that's what Load read
+	std::string filePath;
+	U32 dataOffset;
+	SampleFormat fileFormat;
+	U16 fileChannels;
+	// How many of the trimmed frames are still in the file before the first
+	// one that's kept. None are, for a cooked sound
+	U32 fileTrimmedHead;
+
+	// Filled in by the analysis pass at the end of Load. Near silent frames
+	// at either end are trimmed off before anything else is measured. The
+	// mixer plays them back as silence, so a voice still starts and loops
+	// on the same frames as the file
+	U32 trimmedHead;
+	U32 trimmedTail;
+	float peak;
+	float rms;
+	// A looping voice jumps from loopEnd back to loopStart. Both are frames
+	// of the sound as authored, so they count the trimmed silence. They're
+	// the ends of the file, except that an end that isn't silent is moved
+	// onto a rising zero crossing within LOOP_SNAP_FRAMES, if there is one,
+	// so the seam doesn't click
+	U32 loopStart;
+	U32 loopEnd;
+	// tailPeaks[i] = GetTailPeak( i * TAIL_PEAK_FRAMES )
+	std::vector<float> tailPeaks;
+
+private:
+	// Load, from the one file. cooked is set if the file had the cooked
+	// analysis in it, so there was no need to analyze it
+	bool LoadFile( const char* fileName, bool& cooked );
+	// Reads the cooked analysis chunk. Returns false if it's from another version
+	bool ReadCookedAnalysis( const char* chunk, U32 size );
+	// Converts frames frames of the file's raw samples into data's format
+	void DecodeFrames( const char* raw, U32 frames, PCM16* out ) const;
+	void Analyze();
+	void Trim();
+	void FindLoopPoints();
+	// Rising zero crossing in the first channel, between data frames begin and end,
+	// where the frame and the one before it are closest to those at frame match
+	// (or to silence if match is 0). Returns end if there's none
+	U32 FindZeroCrossing( U32 begin, U32 end, U32 match ) const;
+	bool IsSilent( U32 frame ) const;
+
+	std::atomic<int> state;
+};
+
+DECL_PTR(Sound);
@@ -0,0 +1,108 @@
+#include "ITPEnginePCH.h"
+
+#include <algorithm>
+#include <chrono>
+
+SoundLoader::SoundLoader( AudioMemoryManager* memory )
+	: memory( memory ), quit( false )
+{
+	// Start the worker last so every other member is ready
+	worker = std::thread( &SoundLoader::Run, this );
+}
+
+SoundLoader::~SoundLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock( queueMutex );
+		quit = true;
+	}
+	queueCondition.notify_one();
+	worker.join();
+}
+
+void SoundLoader::Enqueue( SoundPtr sound )
+{
+	{
+		std::lock_guard<std::mutex> lock( queueMutex );
+		queue.push_back( sound );
+	}
+	queueCondition.notify_one();
+}
+
+void SoundLoader::AddStream( SoundStreamPtr stream )
+{
+	{
+		std::lock_guard<std::mutex> lock( queueMutex );
+		streams.push_back( stream );
+	}
+	queueCondition.notify_one();
+}
+
+void SoundLoader::Run()
+{
+	// A stream buffer lasts far longer than this, so one late
+	// refill behind a big load doesn't starve it
+	const std::chrono::milliseconds streamInterval( 10 );
+
+	std::vector<SoundStreamPtr> active;
+	while ( true )
+	{
+		SoundPtr sound;
+		{
+			std::unique_lock<std::mutex> lock( queueMutex );
+			auto ready = [this] { return quit || !queue.empty(); };
+			if ( streams.empty() )
+			{
+				// Wake for a new stream too, not just a sound to load
+				queueCondition.wait( lock, [this] { return quit || !queue.empty() || !streams.empty(); } );
+			}
+			else
+			{
+				queueCondition.wait_for( lock, streamInterval, ready );
+			}
+			if ( quit )
+			{
+				return;
+			}
+
+			streams.erase( std::remove_if( streams.begin(), streams.end(), []( const SoundStreamPtr& stream )
+			{
+				return stream->IsClosed();
+			} ), streams.end() );
+			active = streams;
+
+			if ( !queue.empty() )
+			{
+				sound = queue.front();
+				queue.pop_front();
+			}
+		}
+
+		for ( const SoundStreamPtr& stream : active )
+		{
+			stream->Fill();
+		}
+		active.clear();
+
+		if ( sound )
+		{
+			// Publish the result with release semantics, so once the mixer
+			// sees SOUND_READY all of the sample data is visible to it
+			bool loaded = sound->Load( sound->path.c_str() );
+			if ( loaded )
+			{
+				SoundStorage storage = sound->storageHint;
+				if ( storage == STORAGE_AUTO )
+				{
+					storage = memory ? memory->ChooseStorage( *sound ) : STORAGE_RESIDENT;
+				}
+				sound->SetStorage( storage );
+				if ( memory )
+				{
+					memory->OnLoaded( *sound );
+				}
+			}
+			sound->SetState( loaded ? SOUND_READY : SOUND_FAILED );
+		}
+	}
+}
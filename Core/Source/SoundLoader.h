@@ -0,0 +1,40 @@
+// SoundLoader.h
+// Background I/O worker that reads and decodes sounds, so
+// the game thread never waits on a WAV file. It also keeps
+// streamed sounds topped up
+
+#pragma once
+#include "Sound.h"
+#include "SoundStream.h"
+#include "AudioMemoryManager.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SoundLoader
+{
+public:
+	// memory chooses how sounds loaded with STORAGE_AUTO are stored. Without
+	// one they're resident
+	SoundLoader( AudioMemoryManager* memory = 0 );
+	~SoundLoader();
+
+	// Queues sound to be loaded from sound->path. Its state moves from
+	// SOUND_PENDING to SOUND_READY or SOUND_FAILED once the worker is done
+	void Enqueue( SoundPtr sound );
+	// Refills stream every few milliseconds until it's closed
+	void AddStream( SoundStreamPtr stream );
+
+private:
+	void Run();
+
+	AudioMemoryManager* memory;
+	std::deque<SoundPtr> queue;
+	std::vector<SoundStreamPtr> streams;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool quit;
+	std::thread worker;
+};
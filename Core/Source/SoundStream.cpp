@@ -0,0 +1,101 @@
+#include "ITPEnginePCH.h"
+#include <iostream>
+
+SoundStream::SoundStream( SoundPtr sound, bool loop )
+	: sound( sound ), readPosition( 0 ), buffer( STREAM_BUFFER_FRAMES * sound->numChannels )
+	, written( 0 ), consumed( 0 ), loop( loop ), ended( false ), closed( false )
+{
+}
+
+void SoundStream::Fill()
+{
+	if ( ended.load( std::memory_order_relaxed ) )
+	{
+		return;
+	}
+
+	if ( !file.IsOpen() )
+	{
+		if ( !file.Open( sound->filePath.c_str() ) )
+		{
+			std::cout << "FAILED TO OPEN AUDIO STREAM " << sound->path << std::endl;
+			ended.store( true, std::memory_order_release );
+			return;
+		}
+	}
+
+	// Positions count the silence trimmed from either end, which goes into
+	// the buffer as silence, so the voice plays the sound as authored
+	U32 numChannels = sound->numChannels;
+	U32 head = sound->trimmedHead;
+	U32 soundEnd = head + sound->GetNumFrames();
+	U64 writePosition = written.load( std::memory_order_relaxed );
+	U32 space = STREAM_BUFFER_FRAMES - ( U32 ) ( writePosition - consumed.load( std::memory_order_acquire ) );
+	while ( space > 0 )
+	{
+		bool looping = loop.load( std::memory_order_relaxed ) && sound->loopEnd > sound->loopStart;
+		U32 end = looping ? sound->loopEnd : soundEnd;
+		if ( readPosition >= end )
+		{
+			if ( !looping )
+			{
+				ended.store( true, std::memory_order_release );
+				return;
+			}
+			readPosition = sound->loopStart;
+		}
+
+		U32 offset = ( U32 ) ( writePosition % STREAM_BUFFER_FRAMES );
+		U32 frames = Math::Min( Math::Min( space, STREAM_BUFFER_FRAMES - offset ), Math::Min( end - readPosition, ( U32 ) STREAM_READ_FRAMES ) );
+		PCM16* out = &buffer[offset * numChannels];
+		if ( readPosition < head )
+		{
+			frames = Math::Min( frames, head - readPosition );
+			memset( out, 0, frames * numChannels * sizeof( PCM16 ) );
+		}
+		else if ( readPosition >= soundEnd )
+		{
+			memset( out, 0, frames * numChannels * sizeof( PCM16 ) );
+		}
+		else if ( !sound->ReadFrames( file, readPosition - head, Math::Min( frames, soundEnd - readPosition ), out ) )
+		{
+			std::cout << "FAILED TO READ AUDIO STREAM " << sound->path << std::endl;
+			ended.store( true, std::memory_order_release );
+			return;
+		}
+
+		// Publish the frames before the mixer can see the new count
+		readPosition += frames;
+		writePosition += frames;
+		written.store( writePosition, std::memory_order_release );
+		space -= frames;
+	}
+}
+
+U32 SoundStream::Peek( const PCM16*& frames ) const
+{
+	U64 readFrom = consumed.load( std::memory_order_relaxed );
+	U32 available = ( U32 ) ( written.load( std::memory_order_acquire ) - readFrom );
+	U32 offset = ( U32 ) ( readFrom % STREAM_BUFFER_FRAMES );
+	frames = &buffer[offset * sound->numChannels];
+	return Math::Min( available, STREAM_BUFFER_FRAMES - offset );
+}
+
+void SoundStream::Consume( U32 frames )
+{
+	// Release, so the loader doesn't overwrite frames still being read
+	consumed.store( consumed.load( std::memory_order_relaxed ) + frames, std::memory_order_release );
+}
+
+bool SoundStream::IsPrimed() const
+{
+	return ended.load( std::memory_order_acquire )
+		|| written.load( std::memory_order_acquire ) - consumed.load( std::memory_order_relaxed ) >= STREAM_PRIME_FRAMES;
+}
+
+bool SoundStream::IsFinished() const
+{
+	// ended is set after the last write, so written is final once it's seen
+	return ended.load( std::memory_order_acquire )
+		&& consumed.load( std::memory_order_relaxed ) == written.load( std::memory_order_acquire );
+}
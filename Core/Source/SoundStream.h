@@ -0,0 +1,57 @@
+// SoundStream.h
+// Plays a STORAGE_STREAMED sound straight from its file. The sound loader
+// thread reads ahead into a ring buffer and the voice playing the stream
+// reads from the other end on the mixer thread. Each voice gets its own
+
+#pragma once
+#include "Sound.h"
+#include "FileSystem.h"
+#include <atomic>
+#include <vector>
+
+// About 0.75 seconds at 44.1kHz
+#define STREAM_BUFFER_FRAMES 32768
+// A voice doesn't start until this much is buffered, or the whole sound is
+#define STREAM_PRIME_FRAMES 8192
+// Most frames read from the file at once
+#define STREAM_READ_FRAMES 4096
+
+class SoundStream
+{
+public:
+	SoundStream( SoundPtr sound, bool loop );
+
+	// Loader thread. Reads until the buffer is full or the sound runs out
+	void Fill();
+
+	// Mixer thread. Points frames at the next run of buffered frames and
+	// returns its length, which stops short where the ring wraps around
+	U32 Peek( const PCM16*& frames ) const;
+	void Consume( U32 frames );
+	bool IsPrimed() const;
+	// True once the whole sound has been read and played
+	bool IsFinished() const;
+
+	// Takes effect from wherever the loader has read up to
+	void SetLooping( bool isLooping ) { loop.store( isLooping, std::memory_order_relaxed ); }
+
+	// Game thread. The loader drops a stream once it's closed
+	void Close() { closed.store( true, std::memory_order_release ); }
+	bool IsClosed() const { return closed.load( std::memory_order_acquire ); }
+
+private:
+	SoundPtr sound;
+	VirtualFile file;
+	// Next frame of the sound to read. Only the loader touches it
+	U32 readPosition;
+
+	std::vector<PCM16> buffer;
+	std::atomic<U64> written;
+	std::atomic<U64> consumed;
+	std::atomic<bool> loop;
+	// Set after the last frame is written
+	std::atomic<bool> ended;
+	std::atomic<bool> closed;
+};
+
+DECL_PTR( SoundStream );
@@ -0,0 +1,107 @@
+#include "ITPEnginePCH.h"
+
+TempoMap::TempoMap( float bpm, int beatsPerBar, float sampleRate )
+	: sampleRate( sampleRate )
+{
+	AddChange( 0, bpm, beatsPerBar );
+}
+
+void TempoMap::AddChange( int bar, float bpm, int beatsPerBar )
+{
+	Section section;
+	section.bar = bar;
+	section.bpm = bpm;
+	section.beatsPerBar = Math::Max( beatsPerBar, 1 );
+	section.frame = 0.0;
+	section.beatFrames = 0.0;
+
+	// Replace a change on the same bar, otherwise keep them in bar order
+	auto iter = sections.begin();
+	while ( iter != sections.end() && iter->bar < bar )
+	{
+		++iter;
+	}
+	if ( iter != sections.end() && iter->bar == bar )
+	{
+		*iter = section;
+	}
+	else
+	{
+		sections.insert( iter, section );
+	}
+	Layout();
+}
+
+void TempoMap::Layout()
+{
+	double frame = 0.0;
+	for ( size_t i = 0; i < sections.size(); i++ )
+	{
+		Section& section = sections[i];
+		if ( i > 0 )
+		{
+			const Section& previous = sections[i - 1];
+			frame += ( section.bar - previous.bar ) * previous.beatsPerBar * previous.beatFrames;
+		}
+		section.frame = frame;
+		section.beatFrames = sampleRate * 60.0 / section.bpm;
+	}
+}
+
+const TempoMap::Section& TempoMap::FindSection( U64 frame ) const
+{
+	size_t i = 0;
+	while ( i + 1 < sections.size() && sections[i + 1].frame <= frame )
+	{
+		i++;
+	}
+	return sections[i];
+}
+
+U64 TempoMap::GetBarFrame( int bar ) const
+{
+	size_t i = 0;
+	while ( i + 1 < sections.size() && sections[i + 1].bar <= bar )
+	{
+		i++;
+	}
+	const Section& section = sections[i];
+	return ( U64 ) ( section.frame + ( bar - section.bar ) * section.beatsPerBar * section.beatFrames + 0.5 );
+}
+
+U64 TempoMap::GetNext( U64 frame, bool wholeBars ) const
+{
+	const Section& section = FindSection( frame );
+	double step = wholeBars ? section.beatsPerBar * section.beatFrames : section.beatFrames;
+
+	// Rounding to whole frames can put a boundary a fraction before frame
+	double steps = ceil( ( frame - section.frame ) / step - 1e-6 );
+	U64 next = ( U64 ) ( section.frame + steps * step + 0.5 );
+
+	// A tempo change always starts on a new bar
+	const Section* following = &section + 1;
+	if ( following < sections.data() + sections.size() && next > following->frame )
+	{
+		next = ( U64 ) ( following->frame + 0.5 );
+	}
+	return next;
+}
+
+U64 TempoMap::GetNextBeat( U64 frame ) const
+{
+	return GetNext( frame, false );
+}
+
+U64 TempoMap::GetNextBar( U64 frame ) const
+{
+	return GetNext( frame, true );
+}
+
+void TempoMap::GetPosition( U64 frame, int& bar, float& beat ) const
+{
+	const Section& section = FindSection( frame );
+	double beats = ( frame - section.frame ) / section.beatFrames;
+	int bars = ( int ) ( beats / section.beatsPerBar );
+	bar = section.bar + bars;
+	beat = ( float ) ( beats - bars * section.beatsPerBar );
+}
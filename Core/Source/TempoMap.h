@@ -0,0 +1,43 @@
+// TempoMap.h
+// Bars and beats of a piece of music, laid out in frames from its start. The
+// tempo and meter can change at the start of any bar
+
+#pragma once
+#include <vector>
+
+class TempoMap
+{
+public:
+	TempoMap( float bpm = 120.0f, int beatsPerBar = 4, float sampleRate = 44100.0f );
+
+	// From bar (0 based) onwards, play at bpm with beatsPerBar beats to a bar
+	void AddChange( int bar, float bpm, int beatsPerBar );
+
+	// Frame where bar starts
+	U64 GetBarFrame( int bar ) const;
+	// First beat or bar that starts at or after frame
+	U64 GetNextBeat( U64 frame ) const;
+	U64 GetNextBar( U64 frame ) const;
+	// Bars and beats at frame, as a fraction of a beat past the bar's first beat
+	void GetPosition( U64 frame, int& bar, float& beat ) const;
+
+private:
+	struct Section
+	{
+		int bar;
+		float bpm;
+		int beatsPerBar;
+		// Where the section starts, and how long its beats are
+		double frame;
+		double beatFrames;
+	};
+
+	const Section& FindSection( U64 frame ) const;
+	// First beat or bar at or after frame. A tempo change always
+	// starts a new bar
+	U64 GetNext( U64 frame, bool wholeBars ) const;
+	void Layout();
+
+	std::vector<Section> sections;
+	float sampleRate;
+};
@@ -21,8 +21,36 @@ void Texture::SetActive(int slot)
 
 bool Texture::Load(const char* fileName, class AssetCache* cache)
 {
-	mTexture = mGraphicsDriver.CreateTextureFromFile( fileName, mWidth, mHeight );
-	return mTexture != nullptr;
+	return LoadData(fileName) && Finalize(fileName, cache) == EFR_Done;
+}
+
+bool Texture::LoadData(const char* fileName)
+{
+	if (!mFile.Open(fileName))
+	{
+		SDL_Log("File not found: Texture %s", fileName);
+		return false;
+	}
+	return true;
+}
+
+EFinalizeResult Texture::Finalize(const char* fileName, class AssetCache* cache)
+{
+	// The image is decoded by the same call that creates the texture, so
+	// that counts as uploading too
+	LoadPhase phase(ELP_Upload);
+	mTexture = mGraphicsDriver.CreateTextureFromFileData(fileName, mFile.GetData(), mFile.GetSize(), mWidth, mHeight);
+	mFile.Close();
+	return mTexture != nullptr ? EFR_Done : EFR_Failed;
+}
+
+size_t Texture::GetMemorySize() const
+{
+	if (mTexture == nullptr)
+	{
+		return mFile.GetSize();
+	}
+	return static_cast<size_t>(mWidth) * mHeight * 4 + mFile.GetSize();
 }
 
 std::shared_ptr<Texture> Texture::CreateFromSurface(class Game& game, struct SDL_Surface* surface)
@@ -3,7 +3,9 @@
 
 #pragma once
 #include "Asset.h"
+#include "FileSystem.h"
 #include "GraphicsDriver.h"
+#include <vector>
 
 class Texture : public Asset
 {
@@ -15,6 +17,9 @@ public:
 	int GetWidth() const { return mWidth; }
 	int GetHeight() const { return mHeight; }
 
+	// Assumes 32 bits a pixel, without mips
+	size_t GetMemorySize() const override;
+
 	void SetActive(int slot);
 
 	// Helper to create a texture from an SDL surface --
@@ -24,7 +29,11 @@ public:
 	static std::shared_ptr<Texture> CreateFromSurface(class Game& game, struct SDL_Surface* surface);
 protected:
 	bool Load(const char* fileName, class AssetCache* cache) override;
+	bool LoadData(const char* fileName) override;
+	EFinalizeResult Finalize(const char* fileName, class AssetCache* cache) override;
 private:
+	// The file opened by LoadData, until Finalize decodes it onto the GPU
+	VirtualFile mFile;
 	GraphicsTexturePtr mTexture;
 	int mWidth;
 	int mHeight;
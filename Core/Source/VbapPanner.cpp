@@ -0,0 +1,192 @@
+#include "ITPEnginePCH.h"
+#include <algorithm>
+
+namespace
+{
+	struct SpeakerPosition
+	{
+		// Degrees clockwise from straight ahead, seen from above
+		float azimuth;
+		// Where it is in the bus (FMOD's speaker order)
+		int channel;
+	};
+
+	// The LFE (channel 3) isn't a direction, so it's never panned to
+	const SpeakerPosition LAYOUT_5_1[] = { { -30.0f, 0 }, { 30.0f, 1 }, { 0.0f, 2 }, { -110.0f, 4 }, { 110.0f, 5 } };
+	const SpeakerPosition LAYOUT_7_1[] = { { -30.0f, 0 }, { 30.0f, 1 }, { 0.0f, 2 }, { -90.0f, 4 }, { 90.0f, 5 }, { -150.0f, 6 }, { 150.0f, 7 } };
+
+	// Directions this close to straight up or down have no azimuth to speak of
+	const float MIN_HORIZONTAL = 0.0001f;
+	// A direction exactly on a speaker can come out a hair negative for
+	// the pair on either side of it
+	const float PAIR_EPSILON = -0.0001f;
+}
+
+VbapPanner::VbapPanner( int numVoices, int maxFrames )
+	: numSpeakers( 0 ), folded( false ), busChannels( 2 ), voices( numVoices ), mono( maxFrames )
+{
+	memset( fold, 0, sizeof( fold ) );
+	for ( int i = 0; i < numVoices; i++ )
+	{
+		Reset( i );
+	}
+}
+
+void VbapPanner::SetLayout( SpeakerLayout layout, bool foldToStereo )
+{
+	const SpeakerPosition* positions = layout == SPEAKERS_7_1 ? LAYOUT_7_1 : LAYOUT_5_1;
+	numSpeakers = layout == SPEAKERS_7_1 ? sizeof( LAYOUT_7_1 ) / sizeof( LAYOUT_7_1[0] ) : sizeof( LAYOUT_5_1 ) / sizeof( LAYOUT_5_1[0] );
+
+	// Round the circle in order, so neighbours are next to each other
+	SpeakerPosition sorted[SURROUND_BUS_CHANNELS];
+	std::copy( positions, positions + numSpeakers, sorted );
+	std::sort( sorted, sorted + numSpeakers, []( const SpeakerPosition& a, const SpeakerPosition& b )
+	{
+		return a.azimuth < b.azimuth;
+	} );
+	for ( int i = 0; i < numSpeakers; i++ )
+	{
+		float angle = Math::ToRadians( sorted[i].azimuth );
+		speakers[i].x = Math::Sin( angle );
+		speakers[i].z = Math::Cos( angle );
+		speakers[i].channel = sorted[i].channel;
+	}
+
+	// Every arc is less than 180 degrees, so no pair's matrix is singular
+	for ( int i = 0; i < numSpeakers; i++ )
+	{
+		Pair& pair = pairs[i];
+		pair.first = i;
+		pair.second = ( i + 1 ) % numSpeakers;
+		const Speaker& a = speakers[pair.first];
+		const Speaker& b = speakers[pair.second];
+		float determinant = a.x * b.z - a.z * b.x;
+		pair.inverse[0] = b.z / determinant;
+		pair.inverse[1] = -a.z / determinant;
+		pair.inverse[2] = -b.x / determinant;
+		pair.inverse[3] = a.x / determinant;
+	}
+
+	folded = foldToStereo;
+	busChannels = folded ? 2 : SURROUND_BUS_CHANNELS;
+	if ( folded )
+	{
+		// The bus order matches the 7.1 downmix's closely enough: fronts at
+		// full level, then centre and both surround pairs at -3dB
+		SampleConvert::GetDownmixMatrix( SURROUND_BUS_CHANNELS, 2, fold );
+	}
+
+	for ( size_t i = 0; i < voices.size(); i++ )
+	{
+		Reset( ( int ) i );
+	}
+}
+
+void VbapPanner::Reset( int voice )
+{
+	VoiceState& state = voices[voice];
+	memset( state.gains, 0, sizeof( state.gains ) );
+	memset( state.targetGains, 0, sizeof( state.targetGains ) );
+	state.enabled = false;
+	state.hasGains = false;
+}
+
+void VbapPanner::SetDirection( int voice, const Vector3& direction )
+{
+	VoiceState& state = voices[voice];
+	ComputeGains( direction, state.targetGains );
+	state.enabled = true;
+}
+
+void VbapPanner::Process( int voice, const float* left, const float* right, int frames, float* out )
+{
+	VoiceState& state = voices[voice];
+
+	// A voice that has just started jumps straight to its direction
+	if ( !state.hasGains )
+	{
+		memcpy( state.gains, state.targetGains, sizeof( state.gains ) );
+		state.hasGains = true;
+	}
+
+	float steps[SURROUND_BUS_CHANNELS];
+	for ( int c = 0; c < busChannels; c++ )
+	{
+		steps[c] = ( state.targetGains[c] - state.gains[c] ) / frames;
+	}
+
+	float* x = &mono[0];
+	for ( int n = 0; n < frames; n++ )
+	{
+		x[n] = ( left[n] + right[n] ) * 0.5f;
+	}
+	SampleConvert::AddPanned( x, out, busChannels, state.gains, steps, frames );
+
+	memcpy( state.gains, state.targetGains, sizeof( state.gains ) );
+}
+
+void VbapPanner::ComputeGains( const Vector3& direction, float* outGains ) const
+{
+	float speakerGains[SURROUND_BUS_CHANNELS] = {};
+
+	// Pan the horizontal part between the pair it falls between
+	float horizontal = Math::Sqrt( direction.x * direction.x + direction.z * direction.z );
+	float length = direction.Length();
+	if ( horizontal > MIN_HORIZONTAL )
+	{
+		float x = direction.x / horizontal;
+		float z = direction.z / horizontal;
+		for ( int i = 0; i < numSpeakers; i++ )
+		{
+			const Pair& pair = pairs[i];
+			float first = x * pair.inverse[0] + z * pair.inverse[2];
+			float second = x * pair.inverse[1] + z * pair.inverse[3];
+			if ( first >= PAIR_EPSILON && second >= PAIR_EPSILON )
+			{
+				first = Math::Max( first, 0.0f );
+				second = Math::Max( second, 0.0f );
+				float power = Math::Sqrt( first * first + second * second );
+				speakerGains[pair.first] = first / power;
+				speakerGains[pair.second] = second / power;
+				break;
+			}
+		}
+	}
+
+	// Then spread it over every speaker as it rises or falls out of the
+	// plane of the speakers, and renormalize so the power stays the same
+	float spread = length > MIN_HORIZONTAL ? 1.0f - horizontal / length : 1.0f;
+	float even = 1.0f / Math::Sqrt( ( float ) numSpeakers );
+	float power = 0.0f;
+	for ( int i = 0; i < numSpeakers; i++ )
+	{
+		speakerGains[i] += ( even - speakerGains[i] ) * spread;
+		power += speakerGains[i] * speakerGains[i];
+	}
+	float normalize = 1.0f / Math::Sqrt( power );
+
+	float busGains[SURROUND_BUS_CHANNELS] = {};
+	for ( int i = 0; i < numSpeakers; i++ )
+	{
+		busGains[speakers[i].channel] = speakerGains[i] * normalize;
+	}
+
+	if ( folded )
+	{
+		// Folding the gains is the same as downmixing what they'd have
+		// produced, without mixing all the speakers first
+		for ( int o = 0; o < 2; o++ )
+		{
+			float sum = 0.0f;
+			for ( int c = 0; c < SURROUND_BUS_CHANNELS; c++ )
+			{
+				sum += fold[o * SURROUND_BUS_CHANNELS + c] * busGains[c];
+			}
+			outGains[o] = sum;
+		}
+	}
+	else
+	{
+		memcpy( outGains, busGains, sizeof( busGains ) );
+	}
+}
@@ -0,0 +1,97 @@
+// VbapPanner.h
+// Speaker panning for positioned voices on surround layouts, by vector base
+// amplitude panning (Pulkki 1997). The speakers around the listener are
+// taken in adjacent pairs, and a voice plays from the pair whose arc its
+// direction falls in, with the gains that point exactly at it at constant
+// power. The higher a voice is above or below the listener, the more it is
+// spread over every speaker, since there are none overhead.
+//
+// Gains only change when a voice's direction does, and glide to the new
+// ones across the next block, so mixing a voice costs one multiply-add per
+// bus channel per frame. On a stereo device the speaker gains are folded
+// down to two channels with the standard downmix, which costs no more than
+// panning a stereo voice
+
+#pragma once
+#include "Math.h"
+#include <vector>
+
+enum SpeakerLayout
+{
+	// Left and right. Positioned voices render binaurally, for headphones
+	SPEAKERS_STEREO,
+	// L R C LFE Ls Rs, with the surrounds at 110 degrees (ITU-R BS.775)
+	SPEAKERS_5_1,
+	// L R C LFE Ls Rs Lb Rb, with the sides at 90 degrees and the backs at 150
+	SPEAKERS_7_1
+};
+
+// Surround layouts mix into buses with this many interleaved channels, so
+// every frame is two whole SSE registers. 5.1 leaves the last two silent
+#define SURROUND_BUS_CHANNELS 8
+
+class VbapPanner
+{
+public:
+	VbapPanner( int numVoices, int maxFrames );
+
+	// Places the speakers of a surround layout, and folds the gains down to
+	// stereo if foldToStereo. Turns off every voice
+	void SetLayout( SpeakerLayout layout, bool foldToStereo );
+	// Interleaved channels in the bus Process adds to
+	int GetBusChannels() const { return busChannels; }
+
+	// Turns panning off for voice
+	void Reset( int voice );
+
+	// Enables panning for voice, coming from direction in listener space (x
+	// right, y up, z forward). Doesn't need to be normalized
+	void SetDirection( int voice, const Vector3& direction );
+	bool IsEnabled( int voice ) const { return voices[voice].enabled; }
+
+	// Downmixes left and right to mono and adds it to every channel of the
+	// interleaved bus out, at gains gliding from the last block's to the
+	// voice's current direction
+	void Process( int voice, const float* left, const float* right, int frames, float* out );
+
+private:
+	struct Speaker
+	{
+		// Unit vector in the horizontal plane
+		float x;
+		float z;
+		int channel;
+	};
+
+	// Two neighbouring speakers and the inverse of the matrix of their
+	// directions, which takes a direction to their gains
+	struct Pair
+	{
+		int first;
+		int second;
+		float inverse[4];
+	};
+
+	struct VoiceState
+	{
+		float gains[SURROUND_BUS_CHANNELS];
+		float targetGains[SURROUND_BUS_CHANNELS];
+		bool enabled;
+		bool hasGains;
+	};
+
+	void ComputeGains( const Vector3& direction, float* outGains ) const;
+
+	Speaker speakers[SURROUND_BUS_CHANNELS];
+	int numSpeakers;
+	// Pair i is speakers i and i + 1, round the circle in order of azimuth
+	Pair pairs[SURROUND_BUS_CHANNELS];
+	// Row 0 of the downmix to stereo, then row 1
+	float fold[2 * SURROUND_BUS_CHANNELS];
+	bool folded;
+	int busChannels;
+
+	std::vector<VoiceState> voices;
+	// Scratch for one block of a voice's mono downmix
+	std::vector<float> mono;
+};
@@ -0,0 +1,46 @@
+// The asset cooker on its own. Run it with the asset root, then either
+// the files under it to cook, or nothing to cook everything that's
+// changed. -force after the root cooks everything regardless, and -pack
+// cooks what's changed then packs the assets into an archive next to the
+// root, named after it (Assets/ is packed into Assets.itppak)
+#include "ITPEnginePCH.h"
+#include "AssetCooker.h"
+#include <SDL/SDL_log.h>
+#include <cstdarg>
+#include <cstdio>
+
+// The formats log through SDL, which the cooker doesn't link
+extern "C" void SDLCALL SDL_Log(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: AssetCooker <asset root> [-force | -pack | files...]" << std::endl;
+		return 1;
+	}
+
+	std::string root(argv[1]);
+	if (root.back() != '/' && root.back() != '\\')
+	{
+		root += '/';
+	}
+
+	if (argc > 2 && strcmp(argv[2], "-pack") == 0)
+	{
+		std::string archiveName = root.substr(0, root.size() - 1) + ".itppak";
+		int failed = AssetCooker::CookAll(root.c_str());
+		return failed == 0 && AssetCooker::Pack(root.c_str(), archiveName.c_str()) ? 0 : 1;
+	}
+
+	bool force = argc > 2 && strcmp(argv[2], "-force") == 0;
+	int failed = argc > 2 && !force ? AssetCooker::CookFiles(argv + 2, argc - 2) : AssetCooker::CookAll(root.c_str(), force);
+	return failed == 0 ? 0 : 1;
+}